@@ -0,0 +1,64 @@
+/**
+ * Copyright (C) 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "mongo/base/status.h"
+#include "mongo/transport/session.h"
+#include "mongo/util/duration.h"
+
+namespace mongo {
+namespace transport {
+
+/*
+ * This is the interface for deciding whether, and how quickly, the ServiceEntryPoint lets a
+ * client in. It's consulted for each new session before a ServiceStateMachine is created for it,
+ * and before each operation that session runs, so that one misbehaving client can be held back
+ * before it takes up executor threads that everyone else needs.
+ *
+ * Implementations must be thread-safe.
+ */
+class AdmissionController {
+public:
+    virtual ~AdmissionController() = default;
+
+    /*
+     * Decides whether to accept a new session. If this returns an error, the session is closed
+     * without being started.
+     */
+    virtual Status admitSession(const SessionHandle& session) = 0;
+
+    /*
+     * Called when a session that admitSession() accepted has ended.
+     */
+    virtual void endSession(const SessionHandle& session) = 0;
+
+    /*
+     * Called when a session has received a request and is about to run it. Returns how long the
+     * session should wait before asking again, or zero if it may run the operation now. A session
+     * only runs one operation at a time.
+     */
+    virtual Milliseconds admitOperation(const SessionHandle& session) = 0;
+
+    /*
+     * Called when an operation that admitOperation() let run has finished. If the session ends
+     * first, endSession() is called instead.
+     */
+    virtual void endOperation(const SessionHandle& session) = 0;
+};
+
+}  // namespace transport
+}  // namespace mongo
@@ -0,0 +1,319 @@
+/**
+ * Copyright (C) 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/transport/admission_controller_token_bucket.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "mongo/bson/bsonobj.h"
+#include "mongo/util/mongoutils/str.h"
+#include "mongo/util/net/hostandport.h"
+#include "mongo/util/net/sockaddr.h"
+
+namespace mongo {
+namespace transport {
+namespace {
+// Clients are only pruned once there are at least this many of them.
+constexpr size_t kMinPruneThreshold = 1024;
+
+// How long an operation waits before asking again when its client has too many in flight. There's
+// no telling when one of them will finish, so this is short.
+const Milliseconds kInFlightRetryInterval{2};
+
+// Reads a non-negative number out of a rule
+StatusWith<double> parseAmount(const BSONElement& elem) {
+    if (!elem.isNumber()) {
+        return {ErrorCodes::TypeMismatch,
+                str::stream() << "admission control rule field '" << elem.fieldName()
+                              << "' must be a number"};
+    }
+
+    const auto amount = elem.numberDouble();
+    if (!(amount >= 0)) {
+        return {ErrorCodes::BadValue,
+                str::stream() << "admission control rule field '" << elem.fieldName()
+                              << "' must not be negative"};
+    }
+    return amount;
+}
+
+StatusWith<AdmissionControllerTokenBucket::Rule> parseRule(const BSONObj& obj) {
+    auto swRange = CIDR::parse(obj["range"]);
+    if (!swRange.isOK()) {
+        return swRange.getStatus();
+    }
+
+    AdmissionControllerTokenBucket::Rule rule(std::move(swRange.getValue()));
+    for (const auto& elem : obj) {
+        const auto name = elem.fieldNameStringData();
+        if (name == "range"_sd) {
+            continue;
+        }
+
+        if (name == "exemptInternalClients"_sd) {
+            if (!elem.isBoolean()) {
+                return {ErrorCodes::TypeMismatch,
+                        "admission control rule field 'exemptInternalClients' must be a boolean"};
+            }
+            rule.exemptTags = elem.Bool() ? Session::kInternalClient : Session::kEmptyTagMask;
+            continue;
+        }
+
+        auto swAmount = parseAmount(elem);
+        if (!swAmount.isOK()) {
+            return swAmount.getStatus();
+        }
+        const auto amount = swAmount.getValue();
+
+        if (name == "connectionsPerSecond"_sd) {
+            rule.connections.ratePerSecond = amount;
+        } else if (name == "connectionBurst"_sd) {
+            rule.connections.burst = amount;
+        } else if (name == "operationsPerSecond"_sd) {
+            rule.operations.ratePerSecond = amount;
+        } else if (name == "operationBurst"_sd) {
+            rule.operations.burst = amount;
+        } else if (name == "maxOperationsInFlight"_sd) {
+            rule.maxOperationsInFlight = static_cast<size_t>(amount);
+        } else {
+            return {ErrorCodes::BadValue,
+                    str::stream() << "unknown admission control rule field '" << name << "'"};
+        }
+    }
+    return rule;
+}
+}  // namespace
+
+const Session::Decoration<AdmissionControllerTokenBucket::SessionState>
+    AdmissionControllerTokenBucket::_stateForSession =
+        Session::declareDecoration<SessionState>();
+
+AdmissionControllerTokenBucket::TokenBucket::TokenBucket(const Limit& limit, Date_t now)
+    : _limit{limit.ratePerSecond, std::max(limit.burst, 1.0)},
+      _tokens(_limit.burst),
+      _lastRefill(now) {}
+
+bool AdmissionControllerTokenBucket::TokenBucket::tryTake(Date_t now) {
+    if (_limit.ratePerSecond <= 0) {
+        return true;
+    }
+
+    _refill(now);
+    if (_tokens < 1) {
+        return false;
+    }
+    _tokens -= 1;
+    return true;
+}
+
+Milliseconds AdmissionControllerTokenBucket::TokenBucket::take(Date_t now) {
+    if (_limit.ratePerSecond <= 0) {
+        return Milliseconds{0};
+    }
+
+    _refill(now);
+    _tokens -= 1;
+    if (_tokens >= 0) {
+        return Milliseconds{0};
+    }
+    return Milliseconds{static_cast<int64_t>(std::ceil(-_tokens * 1000 / _limit.ratePerSecond))};
+}
+
+bool AdmissionControllerTokenBucket::TokenBucket::isFull(Date_t now) {
+    if (_limit.ratePerSecond <= 0) {
+        return true;
+    }
+
+    _refill(now);
+    return _tokens >= _limit.burst;
+}
+
+void AdmissionControllerTokenBucket::TokenBucket::_refill(Date_t now) {
+    if (now <= _lastRefill) {
+        return;
+    }
+
+    const double elapsedSeconds = durationCount<Milliseconds>(now - _lastRefill) / 1000.0;
+    _tokens = std::min(_limit.burst, _tokens + elapsedSeconds * _limit.ratePerSecond);
+    _lastRefill = now;
+}
+
+StatusWith<std::vector<AdmissionControllerTokenBucket::Rule>>
+AdmissionControllerTokenBucket::parseRules(const BSONElement& rules) {
+    if (rules.type() != Array) {
+        return {ErrorCodes::TypeMismatch, "admission control rules must be an array"};
+    }
+
+    std::vector<Rule> parsed;
+    for (const auto& elem : rules.Obj()) {
+        if (elem.type() != Object) {
+            return {ErrorCodes::TypeMismatch, "each admission control rule must be an object"};
+        }
+
+        auto swRule = parseRule(elem.Obj());
+        if (!swRule.isOK()) {
+            return swRule.getStatus();
+        }
+        parsed.push_back(std::move(swRule.getValue()));
+    }
+    return parsed;
+}
+
+AdmissionControllerTokenBucket::AdmissionControllerTokenBucket(ClockSource* clockSource,
+                                                               std::vector<Rule> rules)
+    : _clockSource(clockSource), _rules(std::move(rules)), _pruneThreshold(kMinPruneThreshold) {}
+
+Status AdmissionControllerTokenBucket::admitSession(const SessionHandle& session) {
+    const auto& remote = session->remote().sockAddr();
+    if (!remote || !remote->isIP()) {
+        return Status::OK();
+    }
+
+    const auto address = remote->getAddr();
+    const auto rule = _findRule(address);
+    if (!rule) {
+        return Status::OK();
+    }
+
+    const auto now = _clockSource->now();
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    auto it = _clients.find(address);
+    if (it == _clients.end()) {
+        _pruneClients(now);
+        it = _clients.emplace(address, std::make_shared<ClientState>(rule, now)).first;
+    }
+
+    auto& client = it->second;
+    if (!client->connections.tryTake(now)) {
+        return {ErrorCodes::OperationFailed,
+                str::stream() << "Too many new connections from " << address << ", which is "
+                              << "limited by the rule for " << rule->range};
+    }
+
+    client->sessions += 1;
+    _stateForSession(*session).client = client;
+    return Status::OK();
+}
+
+void AdmissionControllerTokenBucket::endSession(const SessionHandle& session) {
+    auto& state = _stateForSession(*session);
+    if (!state.client) {
+        return;
+    }
+
+    {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        _endOperation(&state);
+        invariant(state.client->sessions > 0);
+        state.client->sessions -= 1;
+    }
+    state = SessionState();
+}
+
+Milliseconds AdmissionControllerTokenBucket::admitOperation(const SessionHandle& session) {
+    auto& state = _stateForSession(*session);
+    const auto& client = state.client;
+    if (!client || (session->getTags() & client->rule->exemptTags)) {
+        return Milliseconds{0};
+    }
+
+    const auto now = _clockSource->now();
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    invariant(!state.operationRunning);
+
+    // An operation that was held back has already taken its token, so it only waits for it
+    if (!state.tokenEarnedAt) {
+        state.tokenEarnedAt = now + client->operations.take(now);
+    }
+    if (now < *state.tokenEarnedAt) {
+        return *state.tokenEarnedAt - now;
+    }
+
+    const auto maxInFlight = client->rule->maxOperationsInFlight;
+    if (maxInFlight && client->operationsInFlight >= maxInFlight) {
+        return kInFlightRetryInterval;
+    }
+
+    state.tokenEarnedAt = boost::none;
+    state.operationRunning = true;
+    client->operationsInFlight += 1;
+    return Milliseconds{0};
+}
+
+void AdmissionControllerTokenBucket::endOperation(const SessionHandle& session) {
+    auto& state = _stateForSession(*session);
+    if (!state.client) {
+        return;
+    }
+
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    _endOperation(&state);
+}
+
+void AdmissionControllerTokenBucket::_endOperation(SessionState* state) {
+    if (!state->operationRunning) {
+        return;
+    }
+
+    invariant(state->client->operationsInFlight > 0);
+    state->client->operationsInFlight -= 1;
+    state->operationRunning = false;
+}
+
+size_t AdmissionControllerTokenBucket::numTrackedClients() const {
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    return _clients.size();
+}
+
+const AdmissionControllerTokenBucket::Rule* AdmissionControllerTokenBucket::_findRule(
+    const std::string& address) const {
+    auto swCIDR = CIDR::parse(address);
+    if (!swCIDR.isOK()) {
+        return nullptr;
+    }
+
+    for (const auto& rule : _rules) {
+        if (rule.range.contains(swCIDR.getValue())) {
+            return &rule;
+        }
+    }
+    return nullptr;
+}
+
+void AdmissionControllerTokenBucket::_pruneClients(Date_t now) {
+    if (_clients.size() < _pruneThreshold) {
+        return;
+    }
+
+    for (auto it = _clients.begin(); it != _clients.end();) {
+        auto& client = *it->second;
+        if (client.sessions == 0 && client.connections.isFull(now) &&
+            client.operations.isFull(now)) {
+            it = _clients.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Don't look again until the number of clients has doubled, so pruning stays cheap
+    _pruneThreshold = std::max(kMinPruneThreshold, _clients.size() * 2);
+}
+
+}  // namespace transport
+}  // namespace mongo
@@ -0,0 +1,175 @@
+/**
+ * Copyright (C) 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/base/status_with.h"
+#include "mongo/stdx/mutex.h"
+#include "mongo/stdx/unordered_map.h"
+#include "mongo/transport/admission_controller.h"
+#include "mongo/util/clock_source.h"
+#include "mongo/util/net/cidr.h"
+#include "mongo/util/time_support.h"
+
+namespace mongo {
+class BSONElement;
+
+namespace transport {
+
+/*
+ * An AdmissionController which rate limits each client address with token buckets, and caps how
+ * many operations each one has in flight.
+ *
+ * Each client address gets the limits of the first rule whose range contains it, and addresses
+ * that match no rule (including unix sockets) aren't limited at all. A client's limits are shared
+ * by all of its sessions. New sessions over the connection limit are refused, while operations
+ * over the operation limit are delayed until the client has earned a token for them, and then
+ * until it has fewer than maxOperationsInFlight operations running.
+ */
+class AdmissionControllerTokenBucket final : public AdmissionController {
+    MONGO_DISALLOW_COPYING(AdmissionControllerTokenBucket);
+
+public:
+    struct Limit {
+        // How many tokens are added each second. 0 means there is no limit.
+        double ratePerSecond = 0;
+
+        // How many tokens can build up while the client is quiet, which is how large a burst
+        // it can make at once.
+        double burst = 1;
+    };
+
+    struct Rule {
+        explicit Rule(CIDR range) : range(std::move(range)) {}
+
+        // The client addresses this rule applies to
+        CIDR range;
+
+        // Operations on sessions with any of these tags aren't limited. Tags are only set after a
+        // session has started, so these don't exempt a client from the connection limit.
+        Session::TagMask exemptTags = Session::kEmptyTagMask;
+
+        Limit connections;
+        Limit operations;
+
+        // How many operations the client may be running at once across all of its sessions. 0
+        // means there is no limit.
+        size_t maxOperationsInFlight = 0;
+    };
+
+    /*
+     * Parses an array of rules, each of which looks like
+     *
+     *     {range: "10.0.0.0/8", connectionsPerSecond: 10, connectionBurst: 20,
+     *      operationsPerSecond: 1000, operationBurst: 100, maxOperationsInFlight: 8,
+     *      exemptInternalClients: true}
+     *
+     * Only "range" is required. Limits left out aren't enforced, and bursts default to 1.
+     */
+    static StatusWith<std::vector<Rule>> parseRules(const BSONElement& rules);
+
+    AdmissionControllerTokenBucket(ClockSource* clockSource, std::vector<Rule> rules);
+
+    Status admitSession(const SessionHandle& session) final;
+    void endSession(const SessionHandle& session) final;
+    Milliseconds admitOperation(const SessionHandle& session) final;
+    void endOperation(const SessionHandle& session) final;
+
+    /*
+     * Returns how many client addresses are being tracked, for testing.
+     */
+    size_t numTrackedClients() const;
+
+private:
+    class TokenBucket {
+    public:
+        TokenBucket(const Limit& limit, Date_t now);
+
+        /*
+         * Takes a token if one is available, and returns whether it did.
+         */
+        bool tryTake(Date_t now);
+
+        /*
+         * Takes a token, borrowing from future refills if none is available, and returns how long
+         * it will be until the borrowed token has been earned.
+         */
+        Milliseconds take(Date_t now);
+
+        /*
+         * Returns true if the bucket has refilled completely, so forgetting it loses nothing.
+         */
+        bool isFull(Date_t now);
+
+    private:
+        void _refill(Date_t now);
+
+        const Limit _limit;
+        double _tokens;
+        Date_t _lastRefill;
+    };
+
+    struct ClientState {
+        ClientState(const Rule* rule, Date_t now)
+            : rule(rule), connections(rule->connections, now), operations(rule->operations, now) {}
+
+        const Rule* const rule;
+
+        // These are protected by _mutex
+        TokenBucket connections;
+        TokenBucket operations;
+        size_t sessions = 0;
+        size_t operationsInFlight = 0;
+    };
+
+    struct SessionState {
+        // The client the session was admitted as, or null if its address isn't limited
+        std::shared_ptr<ClientState> client;
+
+        // These are protected by _mutex. If the session's next operation has taken its token, it
+        // may run once tokenEarnedAt has passed and the client has room for it.
+        boost::optional<Date_t> tokenEarnedAt;
+        bool operationRunning = false;
+    };
+
+    static const Session::Decoration<SessionState> _stateForSession;
+
+    // Must be called with _mutex held.
+    void _endOperation(SessionState* state);
+
+    const Rule* _findRule(const std::string& address) const;
+
+    // Forgets clients with no sessions whose buckets have refilled. Must be called with _mutex
+    // held.
+    void _pruneClients(Date_t now);
+
+    ClockSource* const _clockSource;
+    const std::vector<Rule> _rules;
+
+    mutable stdx::mutex _mutex;
+    stdx::unordered_map<std::string, std::shared_ptr<ClientState>> _clients;
+    size_t _pruneThreshold;
+};
+
+}  // namespace transport
+}  // namespace mongo
@@ -0,0 +1,205 @@
+/**
+ * Copyright (C) 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/transport/admission_controller_token_bucket.h"
+
+#include "mongo/bson/json.h"
+#include "mongo/transport/mock_session.h"
+#include "mongo/unittest/unittest.h"
+#include "mongo/util/clock_source_mock.h"
+#include "mongo/util/mongoutils/str.h"
+#include "mongo/util/net/sockaddr.h"
+
+namespace mongo {
+namespace transport {
+namespace {
+
+SessionHandle makeSession(StringData ip) {
+    return MockSession::create(HostAndPort(SockAddr(ip, 27017, AF_INET)),
+                               HostAndPort(SockAddr("127.0.0.1", 27017, AF_INET)),
+                               nullptr);
+}
+
+std::vector<AdmissionControllerTokenBucket::Rule> makeRules() {
+    AdmissionControllerTokenBucket::Rule rule(CIDR("10.0.0.0/8"));
+    rule.connections = {1, 2};
+    rule.operations = {10, 5};
+    rule.exemptTags = Session::kInternalClient;
+    return {rule};
+}
+
+TEST(AdmissionControllerTokenBucket, RefusesConnectionsOverTheLimit) {
+    ClockSourceMock clock;
+    AdmissionControllerTokenBucket controller(&clock, makeRules());
+
+    auto first = makeSession("10.1.1.1");
+    auto second = makeSession("10.1.1.1");
+    auto third = makeSession("10.1.1.1");
+    ASSERT_OK(controller.admitSession(first));
+    ASSERT_OK(controller.admitSession(second));
+    ASSERT_NOT_OK(controller.admitSession(third));
+
+    // Other clients have their own limits
+    ASSERT_OK(controller.admitSession(makeSession("10.2.2.2")));
+
+    clock.advance(Seconds{1});
+    ASSERT_OK(controller.admitSession(third));
+}
+
+TEST(AdmissionControllerTokenBucket, UnmatchedClientsAreNotLimited) {
+    ClockSourceMock clock;
+    AdmissionControllerTokenBucket controller(&clock, makeRules());
+
+    for (int i = 0; i < 10; ++i) {
+        auto session = makeSession("192.168.0.1");
+        ASSERT_OK(controller.admitSession(session));
+        ASSERT_EQ(controller.admitOperation(session), Milliseconds{0});
+    }
+    ASSERT_EQ(controller.numTrackedClients(), 0U);
+}
+
+TEST(AdmissionControllerTokenBucket, DelaysOperationsOverTheLimit) {
+    ClockSourceMock clock;
+    AdmissionControllerTokenBucket controller(&clock, makeRules());
+
+    auto session = makeSession("10.1.1.1");
+    auto other = makeSession("10.1.1.1");
+    ASSERT_OK(controller.admitSession(session));
+    ASSERT_OK(controller.admitSession(other));
+
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_EQ(controller.admitOperation(session), Milliseconds{0});
+        controller.endOperation(session);
+    }
+    ASSERT_EQ(controller.admitOperation(session), Milliseconds{100});
+    ASSERT_EQ(controller.admitOperation(other), Milliseconds{200});
+
+    // An operation that was held back keeps the token it borrowed, so asking again only waits for
+    // that token to be earned
+    clock.advance(Milliseconds{60});
+    ASSERT_EQ(controller.admitOperation(session), Milliseconds{40});
+    clock.advance(Milliseconds{40});
+    ASSERT_EQ(controller.admitOperation(session), Milliseconds{0});
+    ASSERT_EQ(controller.admitOperation(other), Milliseconds{100});
+}
+
+TEST(AdmissionControllerTokenBucket, LimitsOperationsInFlight) {
+    ClockSourceMock clock;
+    AdmissionControllerTokenBucket::Rule rule(CIDR("10.0.0.0/8"));
+    rule.maxOperationsInFlight = 2;
+    AdmissionControllerTokenBucket controller(&clock, {rule});
+
+    std::vector<SessionHandle> sessions;
+    for (int i = 0; i < 3; ++i) {
+        sessions.push_back(makeSession("10.1.1.1"));
+        ASSERT_OK(controller.admitSession(sessions.back()));
+    }
+
+    // The limit is for the client, however many sessions it spreads its operations over
+    ASSERT_EQ(controller.admitOperation(sessions[0]), Milliseconds{0});
+    ASSERT_EQ(controller.admitOperation(sessions[1]), Milliseconds{0});
+    ASSERT_GT(controller.admitOperation(sessions[2]), Milliseconds{0});
+    auto elsewhere = makeSession("10.2.2.2");
+    ASSERT_OK(controller.admitSession(elsewhere));
+    ASSERT_EQ(controller.admitOperation(elsewhere), Milliseconds{0});
+
+    controller.endOperation(sessions[0]);
+    ASSERT_EQ(controller.admitOperation(sessions[2]), Milliseconds{0});
+    ASSERT_GT(controller.admitOperation(sessions[0]), Milliseconds{0});
+
+    // Ending a session ends the operation it was running
+    controller.endSession(sessions[1]);
+    ASSERT_EQ(controller.admitOperation(sessions[0]), Milliseconds{0});
+}
+
+TEST(AdmissionControllerTokenBucket, ExemptTagsSkipOperationLimit) {
+    ClockSourceMock clock;
+    AdmissionControllerTokenBucket controller(&clock, makeRules());
+
+    auto session = makeSession("10.1.1.1");
+    ASSERT_OK(controller.admitSession(session));
+    session->setTags(Session::kInternalClient);
+
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_EQ(controller.admitOperation(session), Milliseconds{0});
+    }
+}
+
+TEST(AdmissionControllerTokenBucket, IdleClientsAreForgotten) {
+    ClockSourceMock clock;
+    AdmissionControllerTokenBucket controller(&clock, makeRules());
+
+    const int kClients = 2048;
+    for (int i = 0; i < kClients; ++i) {
+        auto session = makeSession(str::stream() << "10.0." << i / 256 << "." << i % 256);
+        ASSERT_OK(controller.admitSession(session));
+        controller.endSession(session);
+    }
+    ASSERT_EQ(controller.numTrackedClients(), static_cast<size_t>(kClients));
+
+    // Once their buckets have refilled, the next new client prunes them
+    clock.advance(Seconds{10});
+    auto session = makeSession("10.255.0.1");
+    ASSERT_OK(controller.admitSession(session));
+    ASSERT_EQ(controller.numTrackedClients(), 1U);
+}
+
+TEST(AdmissionControllerTokenBucket, ParsesRules) {
+    auto obj = fromjson(
+        "{rules: [{range: '10.0.0.0/8', connectionsPerSecond: 1, connectionBurst: 2,"
+        "          operationsPerSecond: 10, operationBurst: 5, maxOperationsInFlight: 3,"
+        "          exemptInternalClients: true},"
+        "         {range: '0.0.0.0/0', operationsPerSecond: 100}]}");
+    auto swRules = AdmissionControllerTokenBucket::parseRules(obj["rules"]);
+    ASSERT_OK(swRules.getStatus());
+    const auto& rules = swRules.getValue();
+    ASSERT_EQ(rules.size(), 2U);
+
+    ASSERT_TRUE(rules[0].range.contains(CIDR("10.1.2.3")));
+    ASSERT_FALSE(rules[0].range.contains(CIDR("11.1.2.3")));
+    ASSERT_EQ(rules[0].connections.ratePerSecond, 1);
+    ASSERT_EQ(rules[0].connections.burst, 2);
+    ASSERT_EQ(rules[0].operations.ratePerSecond, 10);
+    ASSERT_EQ(rules[0].operations.burst, 5);
+    ASSERT_EQ(rules[0].maxOperationsInFlight, 3U);
+    ASSERT_EQ(rules[0].exemptTags, Session::kInternalClient);
+
+    ASSERT_EQ(rules[1].connections.ratePerSecond, 0);
+    ASSERT_EQ(rules[1].operations.ratePerSecond, 100);
+    ASSERT_EQ(rules[1].operations.burst, 1);
+    ASSERT_EQ(rules[1].maxOperationsInFlight, 0U);
+    ASSERT_EQ(rules[1].exemptTags, Session::kEmptyTagMask);
+}
+
+TEST(AdmissionControllerTokenBucket, RejectsBadRules) {
+    for (auto json : {"{rules: {range: '10.0.0.0/8'}}",
+                      "{rules: [1]}",
+                      "{rules: [{connectionsPerSecond: 1}]}",
+                      "{rules: [{range: 'not a range'}]}",
+                      "{rules: [{range: '10.0.0.0/8', operationsPerSecond: -1}]}",
+                      "{rules: [{range: '10.0.0.0/8', operationsPerSecond: 'fast'}]}",
+                      "{rules: [{range: '10.0.0.0/8', exemptInternalClients: 1}]}",
+                      "{rules: [{range: '10.0.0.0/8', operationsPerMinute: 1}]}"}) {
+        auto obj = fromjson(json);
+        ASSERT_NOT_OK(AdmissionControllerTokenBucket::parseRules(obj["rules"]).getStatus());
+    }
+}
+
+}  // namespace
+}  // namespace transport
+}  // namespace mongo
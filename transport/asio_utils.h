@@ -16,6 +16,9 @@
 
 #pragma once
 
+#include <algorithm>
+#include <vector>
+
 #include "mongo/base/status.h"
 #include "mongo/base/system_error.h"
 #include "mongo/config.h"
@@ -306,6 +309,51 @@ boost::optional<std::array<std::uint8_t, 7>> checkTLSRequest(const Buffer& buffe
 }
 #endif
 
+/**
+ * Returns a buffer over just the first byte of "buffer", or an empty buffer if it's empty. Used to
+ * simulate short reads and writes.
+ */
+template <typename Buffer>
+Buffer firstByteOf(const Buffer& buffer) {
+    return Buffer(buffer.data(), std::min<size_t>(buffer.size(), 1));
+}
+
+/**
+ * Same as above, for a gather/scatter list of buffers.
+ */
+template <typename Buffer>
+Buffer firstByteOf(const std::vector<Buffer>& buffers) {
+    for (const auto& buffer : buffers) {
+        if (buffer.size()) {
+            return firstByteOf(buffer);
+        }
+    }
+    return Buffer();
+}
+
+/**
+ * Advances "buffer" past the first "bytes" bytes, after they've been read into or written out.
+ */
+template <typename Buffer>
+void consumeBuffers(Buffer& buffer, size_t bytes) {
+    buffer += bytes;
+}
+
+/**
+ * Same as above, for a gather/scatter list of buffers. Buffers which are used up are removed.
+ */
+template <typename Buffer>
+void consumeBuffers(std::vector<Buffer>& buffers, size_t bytes) {
+    auto iter = buffers.begin();
+    for (; iter != buffers.end() && bytes >= iter->size(); ++iter) {
+        bytes -= iter->size();
+    }
+    if (iter != buffers.end()) {
+        *iter += bytes;
+    }
+    buffers.erase(buffers.begin(), iter);
+}
+
 /**
  * Pass this to asio functions in place of a callback to have them return a Future<T>. This behaves
  * similarly to asio::use_future_t, however it returns a mongo::Future<T> rather than a
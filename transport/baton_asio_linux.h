@@ -16,17 +16,19 @@
 
 #pragma once
 
+#include <array>
 #include <memory>
 #include <set>
 #include <vector>
 
-#include <poll.h>
+#include <sys/epoll.h>
 #include <sys/eventfd.h>
 
 #include "mongo/base/checked_cast.h"
 #include "mongo/db/operation_context.h"
 #include "mongo/stdx/mutex.h"
 #include "mongo/stdx/unordered_map.h"
+#include "mongo/stdx/unordered_set.h"
 #include "mongo/transport/baton.h"
 #include "mongo/transport/session_asio.h"
 #include "mongo/util/errno_util.h"
@@ -39,7 +41,9 @@ namespace transport {
 /**
  * TransportLayerASIO Baton implementation for linux.
  *
- * We implement our networking reactor on top of poll + eventfd for wakeups
+ * We implement our networking reactor on top of epoll + eventfd for wakeups. Sessions are
+ * registered with epoll when they're added, rather than on every call to run(), so the cost of a
+ * wakeup doesn't grow with the number of sessions attached to the baton.
  */
 class TransportLayerASIO::BatonASIO : public Baton {
 
@@ -85,8 +89,40 @@ class TransportLayerASIO::BatonASIO : public Baton {
         const int fd;
     };
 
+    /**
+     * RAII type that wraps up an epoll instance.
+     */
+    struct EpollHolder {
+        EpollHolder() : fd(::epoll_create1(EPOLL_CLOEXEC)) {
+            if (fd < 0) {
+                severe() << "error in epoll_create1: " << errnoWithDescription(errno);
+                fassertFailed(50835);
+            }
+        }
+
+        ~EpollHolder() {
+            ::close(fd);
+        }
+
+        // Returns 0, or the errno of a failed epoll_ctl
+        int control(int op, int targetFd, uint32_t events) {
+            epoll_event event{};
+            event.events = events;
+            event.data.fd = targetFd;
+            return ::epoll_ctl(fd, op, targetFd, &event) == 0 ? 0 : errno;
+        }
+
+        const int fd;
+    };
+
 public:
-    BatonASIO(OperationContext* opCtx) : _opCtx(opCtx) {}
+    BatonASIO(OperationContext* opCtx) : _opCtx(opCtx) {
+        // The eventfd stays in the epoll set for the life of the baton
+        if (auto error = _epoll.control(EPOLL_CTL_ADD, _efd.fd, EPOLLIN | EPOLLET)) {
+            severe() << "error in epoll_ctl: " << errnoWithDescription(error);
+            fassertFailed(50836);
+        }
+    }
 
     ~BatonASIO() {
         invariant(!_opCtx);
@@ -118,6 +154,7 @@ public:
 
         _safeExecute([ fd, type, sp = pf.promise.share(), this ] {
             _sessions[fd] = TransportSession{type, sp};
+            _registerSession(fd, type);
         });
 
         return std::move(pf.future);
@@ -152,7 +189,11 @@ public:
         // TODO: There's an ABA issue here with fds where between previously and before we could
         // have removed the fd, then opened and added a new socket with the same fd.  We need to
         // solve it via using session id's for handles.
-        _safeExecute(std::move(lk), [fd, this] { _sessions.erase(fd); });
+        _safeExecute(std::move(lk), [fd, this] {
+            if (_sessions.erase(fd)) {
+                _unregisterSession(fd);
+            }
+        });
 
         return true;
     }
@@ -235,6 +276,21 @@ public:
             return true;
         }
 
+        // Sessions which epoll refused to watch are treated as ready, so that their next read or
+        // write surfaces the error, just as poll would have reported them with POLLERR or
+        // POLLNVAL.
+        if (_unwatchableSessions.size()) {
+            for (auto fd : _unwatchableSessions) {
+                auto iter = _sessions.find(fd);
+                if (iter != _sessions.end()) {
+                    toFulfill.push_back(std::move(iter->second.promise));
+                    _sessions.erase(iter);
+                }
+            }
+            _unwatchableSessions.clear();
+            return true;
+        }
+
         boost::optional<Milliseconds> timeout;
 
         // If we have a timer, poll no longer than that
@@ -252,37 +308,24 @@ public:
             }
         }
 
-        std::vector<decltype(_sessions)::iterator> sessions;
-        sessions.reserve(_sessions.size());
-        std::vector<pollfd> pollSet;
-        pollSet.reserve(_sessions.size() + 1);
-
-        pollSet.push_back(pollfd{_efd.fd, POLLIN, 0});
-
-        for (auto iter = _sessions.begin(); iter != _sessions.end(); ++iter) {
-            pollSet.push_back(
-                pollfd{iter->first,
-                       static_cast<short>(iter->second.type == Type::In ? POLLIN : POLLOUT),
-                       0});
-            sessions.push_back(iter);
-        }
-
         int rval = 0;
-        // If we don't have a timeout, or we have a timeout that's unexpired, run poll.
+        // If we don't have a timeout, or we have a timeout that's unexpired, run epoll_wait.
         if (!timeout || (*timeout > Milliseconds(0))) {
             _inPoll = true;
             lk.unlock();
-            rval =
-                ::poll(pollSet.data(), pollSet.size(), timeout.value_or(Milliseconds(-1)).count());
+            rval = ::epoll_wait(_epoll.fd,
+                                _events.data(),
+                                _events.size(),
+                                timeout.value_or(Milliseconds(-1)).count());
 
             const auto pollGuard = MakeGuard([&] {
                 lk.lock();
                 _inPoll = false;
             });
 
-            // If poll failed, it better be in EINTR
+            // If epoll_wait failed, it better be in EINTR
             if (rval < 0 && errno != EINTR) {
-                severe() << "error in poll: " << errnoWithDescription(errno);
+                severe() << "error in epoll_wait: " << errnoWithDescription(errno);
                 fassertFailed(50834);
             }
 
@@ -307,30 +350,22 @@ public:
             iter = _timers.erase(iter);
         }
 
-        // If poll found some activity
-        if (rval > 0) {
-            size_t remaining = rval;
-
-            auto pollIter = pollSet.begin();
-
-            if (pollIter->revents) {
+        // If epoll found some activity. Any events that didn't fit in _events stay queued in the
+        // kernel for the next call.
+        for (int i = 0; i < rval; ++i) {
+            const int fd = _events[i].data.fd;
+            if (fd == _efd.fd) {
                 _efd.wait();
-
-                remaining--;
+                continue;
             }
 
-            ++pollIter;
-            for (auto sessionIter = sessions.begin(); sessionIter != sessions.end() && remaining;
-                 ++sessionIter, ++pollIter) {
-                if (pollIter->revents) {
-                    toFulfill.push_back(std::move((*sessionIter)->second.promise));
-                    _sessions.erase(*sessionIter);
-
-                    remaining--;
-                }
+            // Sessions are registered one-shot, so the fd is now disarmed until it's added again.
+            // It may also have been cancelled while we were waiting.
+            auto iter = _sessions.find(fd);
+            if (iter != _sessions.end()) {
+                toFulfill.push_back(std::move(iter->second.promise));
+                _sessions.erase(iter);
             }
-
-            invariant(remaining == 0);
         }
 
         return true;
@@ -354,6 +389,40 @@ private:
         SharedPromise<void> promise;
     };
 
+    /**
+     * Arms epoll for a session which was just added to _sessions.
+     *
+     * Sessions are registered one-shot and edge-triggered. Once an event fires the fd stays in the
+     * epoll set, disarmed, so that waiting on the same session again only costs an EPOLL_CTL_MOD.
+     * The kernel drops an fd from the set when its socket is closed, which is why a failed MOD
+     * falls back to an ADD.
+     */
+    void _registerSession(int fd, Type type) {
+        const uint32_t events = (type == Type::In ? EPOLLIN : EPOLLOUT) | EPOLLET | EPOLLONESHOT;
+
+        const bool known = _registeredFds.count(fd);
+        int error = _epoll.control(known ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, events);
+        if (error == (known ? ENOENT : EEXIST)) {
+            error = _epoll.control(known ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, events);
+        }
+
+        if (error) {
+            LOG(2) << "Unable to watch fd " << fd << " in baton: " << errnoWithDescription(error);
+            _registeredFds.erase(fd);
+            _unwatchableSessions.push_back(fd);
+            return;
+        }
+
+        _registeredFds.insert(fd);
+    }
+
+    void _unregisterSession(int fd) {
+        if (_registeredFds.erase(fd)) {
+            // ENOENT and EBADF just mean the socket was closed, which already removed it
+            _epoll.control(EPOLL_CTL_DEL, fd, 0);
+        }
+    }
+
     template <typename Callback>
     void _safeExecute(Callback&& cb) {
         return _safeExecute(stdx::unique_lock<stdx::mutex>(_mutex), std::forward<Callback>(cb));
@@ -385,10 +454,20 @@ private:
 
     EventFDHolder _efd;
 
-    // This map stores the sessions we need to poll on. We unwind it into a pollset for every
-    // blocking call to run
+    EpollHolder _epoll;
+
+    // Filled in by epoll_wait. Only touched by the thread in run().
+    std::array<epoll_event, 64> _events;
+
+    // This map stores the sessions we're waiting on, each of which is armed in _epoll
     stdx::unordered_map<int, TransportSession> _sessions;
 
+    // Every fd this baton has added to _epoll and not removed, including disarmed ones
+    stdx::unordered_set<int> _registeredFds;
+
+    // Sessions which _epoll refused to watch, to be reported as ready by the next run()
+    std::vector<int> _unwatchableSessions;
+
     // The set is used to find the next timer which will fire.  The unordered_map looks up the
     // timers so we can remove them in O(1)
     std::set<Timer, Timer::LessThan> _timers;
@@ -0,0 +1,471 @@
+/**
+ * Copyright (C) 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+
+// We need the ring layout of linux 5.4 and a libc which knows the system call numbers. Anything
+// newer that we use is defined below, and the kernel is asked whether it supports it at runtime.
+#if defined(IORING_FEAT_SINGLE_MMAP) && defined(__NR_io_uring_setup)
+#define MONGO_TRANSPORT_HAS_IO_URING 1
+#endif
+#endif
+#endif
+
+#ifdef MONGO_TRANSPORT_HAS_IO_URING
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "mongo/base/data_range.h"
+#include "mongo/base/disallow_copying.h"
+#include "mongo/base/status_with.h"
+#include "mongo/util/assert_util.h"
+#include "mongo/util/errno_util.h"
+#include "mongo/util/mongoutils/str.h"
+
+// Added in linux 5.13 and 5.19
+#ifndef IORING_CQE_F_MORE
+#define IORING_CQE_F_MORE (1U << 1)
+#endif
+#ifndef IORING_ACCEPT_MULTISHOT
+#define IORING_ACCEPT_MULTISHOT (1U << 0)
+#endif
+
+namespace mongo {
+namespace transport {
+
+/**
+ * The io_uring opcodes we use. They are part of the kernel ABI, but headers older than the kernel
+ * that added an opcode don't name it, so we can't take them from <linux/io_uring.h>. Check that
+ * the kernel supports them with IOUring::supportsOps().
+ */
+namespace io_uring_op {
+constexpr uint8_t kPollAdd = 6;
+constexpr uint8_t kAccept = 13;
+constexpr uint8_t kAsyncCancel = 14;
+constexpr uint8_t kSend = 26;
+constexpr uint8_t kRecv = 27;
+}  // namespace io_uring_op
+
+/**
+ * A minimal io_uring instance, driven through the raw system calls so that we don't depend on
+ * liburing.
+ *
+ * One thread at a time may use an IOUring. Get submission queue entries with getSqe(), fill them
+ * in, and hand them to the kernel with submit(), then pass completions to a callback with
+ * reapCompletions().
+ */
+class IOUring {
+    MONGO_DISALLOW_COPYING(IOUring);
+
+public:
+    /**
+     * Sets up a ring with room for at least "entries" submissions, or returns an error if the
+     * kernel doesn't support io_uring or won't give us one.
+     */
+    static StatusWith<std::unique_ptr<IOUring>> make(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        const int fd = ::syscall(__NR_io_uring_setup, entries, &params);
+        if (fd < 0) {
+            return {ErrorCodes::OperationFailed,
+                    str::stream() << "io_uring_setup failed: " << errnoWithDescription(errno)};
+        }
+
+        std::unique_ptr<IOUring> ring(new IOUring(fd, params));
+        auto status = ring->_map();
+        if (!status.isOK()) {
+            return status;
+        }
+        return {std::move(ring)};
+    }
+
+    ~IOUring() {
+        if (_sqes) {
+            ::munmap(_sqes, _params.sq_entries * sizeof(io_uring_sqe));
+        }
+        if (_cqRing && _cqRing != _sqRing) {
+            ::munmap(_cqRing, _cqRingSize);
+        }
+        if (_sqRing) {
+            ::munmap(_sqRing, _sqRingSize);
+        }
+        ::close(_fd);
+    }
+
+    /**
+     * Returns true if the kernel supports every opcode in "ops".
+     */
+    bool supportsOps(std::initializer_list<uint8_t> ops) const {
+        // struct io_uring_probe and IORING_REGISTER_PROBE from linux 5.6. Older kernels fail the
+        // registration, and so support none of the opcodes we probe for.
+        struct ProbeOp {
+            uint8_t op;
+            uint8_t resv;
+            uint16_t flags;
+            uint32_t resv2;
+        };
+        struct Probe {
+            uint8_t lastOp;
+            uint8_t opsLen;
+            uint16_t resv;
+            uint32_t resv2[3];
+            ProbeOp ops[256];
+        };
+        constexpr unsigned kRegisterProbe = 8;
+        constexpr uint16_t kOpSupported = 1;
+
+        Probe probe;
+        std::memset(&probe, 0, sizeof(probe));
+        if (::syscall(__NR_io_uring_register, _fd, kRegisterProbe, &probe, 256) < 0) {
+            return false;
+        }
+
+        for (auto op : ops) {
+            if (op > probe.lastOp || !(probe.ops[op].flags & kOpSupported)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Returns a zeroed submission queue entry to fill in, or null if the submission queue is full.
+     * The entry goes to the kernel with the next call to submit().
+     */
+    io_uring_sqe* getSqe() {
+        const unsigned head = __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+        if (_sqeTail - head >= _params.sq_entries) {
+            return nullptr;
+        }
+
+        auto sqe = &_sqes[_sqeTail & *_sqMask];
+        std::memset(sqe, 0, sizeof(*sqe));
+        ++_sqeTail;
+        return sqe;
+    }
+
+    /**
+     * Submits every entry from getSqe() since the last call, and if "waitFor" is set, blocks until
+     * at least that many completions are ready. Returns 0, or the errno of a failed io_uring_enter;
+     * EINTR just means the wait was interrupted.
+     */
+    int submit(unsigned waitFor = 0) {
+        unsigned tail = *_sqTail;
+        for (; tail != _sqeTail; ++tail) {
+            _sqArray[tail & *_sqMask] = tail & *_sqMask;
+        }
+        __atomic_store_n(_sqTail, tail, __ATOMIC_RELEASE);
+
+        // Include anything an earlier call left unsubmitted
+        const unsigned toSubmit = tail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+
+        const unsigned flags = waitFor ? IORING_ENTER_GETEVENTS : 0;
+        if (::syscall(__NR_io_uring_enter, _fd, toSubmit, waitFor, flags, nullptr, 0) < 0) {
+            return errno;
+        }
+        return 0;
+    }
+
+    /**
+     * Calls "cb" with each ready completion queue entry, and returns how many there were.
+     */
+    template <typename Callback>
+    size_t reapCompletions(Callback&& cb) {
+        unsigned head = *_cqHead;
+        const unsigned tail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+        const size_t count = tail - head;
+        for (; head != tail; ++head) {
+            cb(_cqes[head & *_cqMask]);
+        }
+        __atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+        return count;
+    }
+
+private:
+    IOUring(int fd, const io_uring_params& params) : _fd(fd), _params(params) {}
+
+    Status _map() {
+        _sqRingSize = _params.sq_off.array + _params.sq_entries * sizeof(unsigned);
+        _cqRingSize = _params.cq_off.cqes + _params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMmap = _params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMmap) {
+            _sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+        }
+
+        auto map = [this](size_t size, off_t offset) -> char* {
+            void* ptr = ::mmap(
+                nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, offset);
+            return ptr == MAP_FAILED ? nullptr : static_cast<char*>(ptr);
+        };
+
+        _sqRing = map(_sqRingSize, IORING_OFF_SQ_RING);
+        if (!_sqRing) {
+            return _mapError();
+        }
+        _cqRing = singleMmap ? _sqRing : map(_cqRingSize, IORING_OFF_CQ_RING);
+        if (!_cqRing) {
+            return _mapError();
+        }
+        _sqes = reinterpret_cast<io_uring_sqe*>(
+            map(_params.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES));
+        if (!_sqes) {
+            return _mapError();
+        }
+
+        _sqHead = reinterpret_cast<unsigned*>(_sqRing + _params.sq_off.head);
+        _sqTail = reinterpret_cast<unsigned*>(_sqRing + _params.sq_off.tail);
+        _sqMask = reinterpret_cast<unsigned*>(_sqRing + _params.sq_off.ring_mask);
+        _sqArray = reinterpret_cast<unsigned*>(_sqRing + _params.sq_off.array);
+        _cqHead = reinterpret_cast<unsigned*>(_cqRing + _params.cq_off.head);
+        _cqTail = reinterpret_cast<unsigned*>(_cqRing + _params.cq_off.tail);
+        _cqMask = reinterpret_cast<unsigned*>(_cqRing + _params.cq_off.ring_mask);
+        _cqes = reinterpret_cast<io_uring_cqe*>(_cqRing + _params.cq_off.cqes);
+        _sqeTail = *_sqTail;
+        return Status::OK();
+    }
+
+    Status _mapError() {
+        return {ErrorCodes::OperationFailed,
+                str::stream() << "Failed to map io_uring: " << errnoWithDescription(errno)};
+    }
+
+    const int _fd;
+    const io_uring_params _params;
+
+    char* _sqRing = nullptr;
+    size_t _sqRingSize = 0;
+    char* _cqRing = nullptr;
+    size_t _cqRingSize = 0;
+    io_uring_sqe* _sqes = nullptr;
+
+    // Pointers into the rings shared with the kernel
+    unsigned* _sqHead = nullptr;
+    unsigned* _sqTail = nullptr;
+    unsigned* _sqMask = nullptr;
+    unsigned* _sqArray = nullptr;
+    unsigned* _cqHead = nullptr;
+    unsigned* _cqTail = nullptr;
+    unsigned* _cqMask = nullptr;
+    io_uring_cqe* _cqes = nullptr;
+
+    // One past the last entry handed out by getSqe(). Entries between *_sqTail and this haven't
+    // been submitted yet.
+    unsigned _sqeTail = 0;
+};
+
+/**
+ * Blocking socket I/O through an IOUring owned by the calling thread, for sessions in synchronous
+ * mode.
+ *
+ * recv() can carry a send on the same socket along with it. A thread which has a reply to write
+ * and then waits for the next request makes one io_uring_enter call, where it would otherwise make
+ * a send and a recv call. Nothing is left in flight when a call returns, so one instance can serve
+ * any number of sockets, one at a time.
+ */
+class IOUringSocketIO {
+    MONGO_DISALLOW_COPYING(IOUringSocketIO);
+
+public:
+    /**
+     * Returns the calling thread's instance, setting it up on first use, or null if the kernel
+     * can't send and receive through io_uring.
+     */
+    static IOUringSocketIO* forThisThread() {
+        thread_local bool tried = false;
+        thread_local std::unique_ptr<IOUringSocketIO> instance;
+        if (!tried) {
+            tried = true;
+            instance = make();
+        }
+        return instance.get();
+    }
+
+    /**
+     * Sets up an instance, or returns null if the kernel doesn't support what we need.
+     */
+    static std::unique_ptr<IOUringSocketIO> make() {
+        // At most a send, a recv and a cancellation are in flight at once
+        auto swRing = IOUring::make(4);
+        if (!swRing.isOK()) {
+            LOG(1) << "Not using io_uring for socket I/O: " << swRing.getStatus();
+            return nullptr;
+        }
+
+        auto& ring = swRing.getValue();
+        using namespace io_uring_op;
+        if (!ring->supportsOps({kSend, kRecv, kAsyncCancel})) {
+            LOG(1) << "Not using io_uring for socket I/O: the kernel does not support send/recv";
+            return nullptr;
+        }
+        return std::unique_ptr<IOUringSocketIO>(new IOUringSocketIO(std::move(ring)));
+    }
+
+    /**
+     * Receives at least one and at most "len" bytes from "fd" into "buf". If "toSend" isn't empty,
+     * it's written to "fd" in full at the same time, and if "sent" isn't null, it's set to how
+     * many bytes of it went out.
+     *
+     * Returns how many bytes were received, 0 at the end of the stream, or -errno if either the
+     * send or the receive failed. A failed send cancels the receive, and vice versa.
+     */
+    ssize_t recv(int fd,
+                 char* buf,
+                 size_t len,
+                 ConstDataRange toSend = ConstDataRange(nullptr, 0),
+                 size_t* sent = nullptr) {
+        const char* sendPtr = toSend.data();
+        size_t sendLeft = toSend.length();
+        bool sending = sendLeft > 0;
+        bool received = false;
+        int sendError = 0;
+        ssize_t result = 0;
+
+        // Which operation we cancelled after the other one failed, if any
+        uint64_t cancelled = 0;
+
+        if (sending) {
+            _prepSend(fd, sendPtr, sendLeft);
+        }
+        _prepRecv(fd, buf, len);
+
+        // Keep going until every entry we submitted has completed, even the cancellations, so
+        // that nothing is left in the ring for the next call.
+        while (_inFlight) {
+            const int error = _ring->submit(1);
+            if (error && error != EINTR) {
+                severe() << "error in io_uring_enter: " << errnoWithDescription(error);
+                fassertFailed(50839);
+            }
+
+            _ring->reapCompletions([&](const io_uring_cqe& cqe) {
+                --_inFlight;
+                switch (cqe.user_data) {
+                    case kSendId:
+                        if (cqe.res > 0 && size_t(cqe.res) < sendLeft) {
+                            sendPtr += cqe.res;
+                            sendLeft -= cqe.res;
+                            _prepSend(fd, sendPtr, sendLeft);
+                            return;
+                        }
+
+                        sending = false;
+                        if (cqe.res <= 0) {
+                            sendError = cqe.res < 0 ? -cqe.res : EPIPE;
+                            if (!received && !cancelled) {
+                                // The peer may be waiting for the reply before it sends anything
+                                cancelled = kRecvId;
+                                _prepCancel(kRecvId);
+                            }
+                        } else {
+                            sendPtr += cqe.res;
+                            sendLeft = 0;
+                        }
+                        return;
+                    case kRecvId:
+                        received = true;
+                        result = cqe.res;
+                        if (result <= 0 && sending && !cancelled) {
+                            cancelled = kSendId;
+                            _prepCancel(kSendId);
+                        }
+                        return;
+                    case kCancelId:
+                        // The kernel may not have picked up an operation we submitted together
+                        // with the cancellation yet, in which case we have to try again.
+                        if (cqe.res == -ENOENT &&
+                            ((cancelled == kSendId && sending) ||
+                             (cancelled == kRecvId && !received))) {
+                            _prepCancel(cancelled);
+                        }
+                        return;
+                }
+                MONGO_UNREACHABLE;
+            });
+        }
+
+        if (sent) {
+            *sent = sendPtr - toSend.data();
+        }
+
+        // Report whichever failed first, rather than the cancellation that followed
+        return (sendError && cancelled != kSendId) ? -sendError : result;
+    }
+
+private:
+    static constexpr uint64_t kSendId = 1;
+    static constexpr uint64_t kRecvId = 2;
+    static constexpr uint64_t kCancelId = 3;
+
+    explicit IOUringSocketIO(std::unique_ptr<IOUring> ring) : _ring(std::move(ring)) {}
+
+    io_uring_sqe* _getSqe() {
+        auto sqe = _ring->getSqe();
+        invariant(sqe);
+        ++_inFlight;
+        return sqe;
+    }
+
+    void _prepSend(int fd, const char* ptr, size_t len) {
+        auto sqe = _getSqe();
+        sqe->opcode = io_uring_op::kSend;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uintptr_t>(ptr);
+        sqe->len = len;
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->user_data = kSendId;
+    }
+
+    void _prepRecv(int fd, char* ptr, size_t len) {
+        auto sqe = _getSqe();
+        sqe->opcode = io_uring_op::kRecv;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uintptr_t>(ptr);
+        sqe->len = len;
+        sqe->user_data = kRecvId;
+    }
+
+    void _prepCancel(uint64_t id) {
+        auto sqe = _getSqe();
+        sqe->opcode = io_uring_op::kAsyncCancel;
+        sqe->fd = -1;
+        sqe->addr = id;
+        sqe->user_data = kCancelId;
+    }
+
+    const std::unique_ptr<IOUring> _ring;
+
+    // Entries submitted, or about to be, which haven't completed yet
+    unsigned _inFlight = 0;
+};
+
+}  // namespace transport
+}  // namespace mongo
+
+#endif  // MONGO_TRANSPORT_HAS_IO_URING
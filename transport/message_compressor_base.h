@@ -21,6 +21,7 @@
 #include "mongo/base/string_data.h"
 #include "mongo/platform/atomic_word.h"
 
+#include <memory>
 #include <type_traits>
 
 namespace mongo {
@@ -28,6 +29,8 @@ enum class MessageCompressor : uint8_t {
     kNoop = 0,
     kSnappy = 1,
     kZlib = 2,
+    kZstd = 3,
+    kLZ4 = 4,
     kExtended = 255,
 };
 
@@ -74,6 +77,71 @@ public:
      */
     virtual StatusWith<std::size_t> decompressData(ConstDataRange input, DataRange output) = 0;
 
+    /*
+     * State a compressor can keep between messages, such as a zlib stream or a zstd context, so
+     * that it isn't set up again for every message. Each session's MessageCompressorManager keeps
+     * its own contexts, but a session may compress a reply on one thread while the next request
+     * is decompressed on another, so a context must keep its compression and decompression state
+     * apart.
+     */
+    class Context {
+    public:
+        virtual ~Context() = default;
+    };
+
+    /*
+     * Returns a new Context for this compressor, or null if it has nothing worth keeping between
+     * messages.
+     */
+    virtual std::unique_ptr<Context> makeContext() {
+        return nullptr;
+    }
+
+    /*
+     * Compressors whose level can be tuned return true here and override the level methods below.
+     * Higher levels spend more CPU for smaller output. The level only matters when compressing;
+     * decompressData can decompress data compressed at any level.
+     */
+    virtual bool hasLevels() const {
+        return false;
+    }
+
+    /*
+     * Returns the level compressData compresses at.
+     */
+    virtual int getDefaultLevel() const {
+        return 0;
+    }
+
+    /*
+     * Returns the supported level closest to the input level.
+     */
+    virtual int clampLevel(int level) const {
+        return level;
+    }
+
+    /*
+     * This method compresses like compressData, but at the given level, which should have come
+     * from clampLevel, and reusing "context" if it isn't null. "context" must have come from this
+     * compressor's makeContext. Compressors without levels ignore the level.
+     */
+    virtual StatusWith<std::size_t> compressDataAtLevel(ConstDataRange input,
+                                                        DataRange output,
+                                                        int level,
+                                                        Context* context) {
+        return compressData(input, output);
+    }
+
+    /*
+     * This method decompresses like decompressData, reusing "context" if it isn't null.
+     * "context" must have come from this compressor's makeContext.
+     */
+    virtual StatusWith<std::size_t> decompressDataWithContext(ConstDataRange input,
+                                                              DataRange output,
+                                                              Context* context) {
+        return decompressData(input, output);
+    }
+
     /*
      * This returns the number of bytes passed in the input for compressData
      */
@@ -102,6 +170,49 @@ public:
         return _decompressBytesOut.loadRelaxed();
     }
 
+    /*
+     * This returns the time spent in compressData, in microseconds, as measured by the
+     * MessageCompressorManager
+     */
+    int64_t getCompressorMicros() const {
+        return _compressMicros.loadRelaxed();
+    }
+
+    /*
+     * This returns the time spent in decompressData, in microseconds, as measured by the
+     * MessageCompressorManager
+     */
+    int64_t getDecompressorMicros() const {
+        return _decompressMicros.loadRelaxed();
+    }
+
+    /*
+     * This returns the number of bytes sent uncompressed because this compressor hadn't been
+     * shrinking a session's recent messages
+     */
+    int64_t getCompressorBytesSkipped() const {
+        return _compressBytesSkipped.loadRelaxed();
+    }
+
+    /*
+     * Called by MessageCompressorManager, which times each call, to bump the time counters
+     */
+    void counterHitCompressTime(int64_t micros) {
+        _compressMicros.addAndFetch(micros);
+    }
+
+    void counterHitDecompressTime(int64_t micros) {
+        _decompressMicros.addAndFetch(micros);
+    }
+
+    /*
+     * Called by MessageCompressorManager when it sends a message uncompressed rather than spend
+     * time compressing it with this compressor
+     */
+    void counterHitSkipped(int64_t bytes) {
+        _compressBytesSkipped.addAndFetch(bytes);
+    }
+
 
 protected:
     /*
@@ -136,5 +247,9 @@ private:
 
     AtomicInt64 _decompressBytesIn;
     AtomicInt64 _decompressBytesOut;
+
+    AtomicInt64 _compressMicros;
+    AtomicInt64 _decompressMicros;
+    AtomicInt64 _compressBytesSkipped;
 };
 }  // namespace mongo
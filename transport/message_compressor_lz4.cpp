@@ -0,0 +1,94 @@
+/**
+ *    Copyright (C) 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kNetwork
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/base/init.h"
+#include "mongo/stdx/memory.h"
+#include "mongo/transport/message_compressor_lz4.h"
+#include "mongo/transport/message_compressor_registry.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <lz4.h>
+
+namespace mongo {
+
+LZ4MessageCompressor::LZ4MessageCompressor() : MessageCompressorBase(MessageCompressor::kLZ4) {}
+
+std::size_t LZ4MessageCompressor::getMaxCompressedSize(size_t inputSize) {
+    // LZ4 works on int sizes, and returns 0 for inputs too large for it
+    if (inputSize > LZ4_MAX_INPUT_SIZE) {
+        return 0;
+    }
+    return ::LZ4_compressBound(static_cast<int>(inputSize));
+}
+
+StatusWith<std::size_t> LZ4MessageCompressor::compressData(ConstDataRange input,
+                                                           DataRange output) {
+    if (input.length() > LZ4_MAX_INPUT_SIZE) {
+        return Status{ErrorCodes::BadValue, "Input too large to compress with lz4"};
+    }
+
+    const auto outputLength =
+        static_cast<int>(std::min<size_t>(output.length(), std::numeric_limits<int>::max()));
+    int ret = ::LZ4_compress_default(input.data(),
+                                     const_cast<char*>(output.data()),
+                                     static_cast<int>(input.length()),
+                                     outputLength);
+
+    // LZ4 returns 0 if the output buffer was too small
+    if (ret <= 0) {
+        return Status{ErrorCodes::BadValue, "Could not compress input"};
+    }
+    counterHitCompress(input.length(), ret);
+    return {static_cast<std::size_t>(ret)};
+}
+
+StatusWith<std::size_t> LZ4MessageCompressor::decompressData(ConstDataRange input,
+                                                             DataRange output) {
+    if (input.length() > static_cast<size_t>(std::numeric_limits<int>::max())) {
+        return Status{ErrorCodes::BadValue, "Compressed message was invalid or corrupted"};
+    }
+
+    const auto outputLength =
+        static_cast<int>(std::min<size_t>(output.length(), std::numeric_limits<int>::max()));
+    int ret = ::LZ4_decompress_safe(input.data(),
+                                    const_cast<char*>(output.data()),
+                                    static_cast<int>(input.length()),
+                                    outputLength);
+
+    if (ret < 0) {
+        return Status{ErrorCodes::BadValue, "Compressed message was invalid or corrupted"};
+    }
+
+    counterHitDecompress(input.length(), ret);
+    return {static_cast<std::size_t>(ret)};
+}
+
+
+MONGO_INITIALIZER_GENERAL(LZ4MessageCompressorInit,
+                          ("EndStartupOptionHandling"),
+                          ("AllCompressorsRegistered"))
+(InitializerContext* context) {
+    auto& compressorRegistry = MessageCompressorRegistry::get();
+    compressorRegistry.registerImplementation(stdx::make_unique<LZ4MessageCompressor>());
+    return Status::OK();
+}
+}  // namespace mongo
@@ -28,6 +28,9 @@
 #include "mongo/transport/message_compressor_registry.h"
 #include "mongo/transport/session.h"
 #include "mongo/util/log.h"
+#include "mongo/util/timer.h"
+
+#include <algorithm>
 
 namespace mongo {
 namespace {
@@ -69,6 +72,20 @@ private:
 
 const transport::Session::Decoration<MessageCompressorManager> getForSession =
     transport::Session::declareDecoration<MessageCompressorManager>();
+
+const auto kCompressionLevels = "compressionLevels"_sd;
+
+// In adaptive mode, every this many messages a session that picks its own compressor tries one
+// other than the one doing best, so that it notices when another would now do better.
+constexpr unsigned kAdaptiveProbeInterval = 32;
+
+// The weight of the latest message in a compressor's moving averages
+constexpr double kAdaptiveSampleWeight = 0.25;
+
+// Messages which compress to more than this fraction of their size count as incompressible. After
+// each one in a row, a session skips compressing twice as many messages, up to kMaxSkippedMessages.
+constexpr double kIncompressibleRatio = 0.9;
+constexpr unsigned kMaxSkippedMessages = 64;
 }  // namespace
 
 MessageCompressorManager::MessageCompressorManager()
@@ -90,6 +107,38 @@ StatusWith<Message> MessageCompressorManager::compressMessage(
         return {msg};
     }
 
+    const auto minMessageSize = _registry->getCompressorOptions().minMessageSizeBytes;
+    if (msg.size() < minMessageSize) {
+        LOG(3) << "Message is smaller than " << minMessageSize
+               << " bytes, returning original uncompressed message";
+        return {msg};
+    }
+
+    // In adaptive mode, a reply has to use the compressor its request came with, since that's
+    // the one the peer asked for, so only whether to compress it is up to us. Otherwise the peer
+    // can decompress with any compressor this session negotiated, so we pick whichever has been
+    // saving the most bytes per microsecond.
+    int sample = -1;
+    bool probing = false;
+    if (_registry->getCompressorOptions().adaptive) {
+        if (!compressorId && !_samples.empty()) {
+            sample = _chooseSample(&probing);
+            compressor = _negotiated[sample];
+        } else {
+            auto it = std::find(_negotiated.begin(), _negotiated.end(), compressor);
+            if (it != _negotiated.end()) {
+                sample = it - _negotiated.begin();
+            }
+        }
+
+        if (sample >= 0 && !probing && _skipCompression(sample)) {
+            LOG(3) << "Recent messages were incompressible, "
+                   << "returning original uncompressed message";
+            compressor->counterHitSkipped(msg.size());
+            return {msg};
+        }
+    }
+
     LOG(3) << "Compressing message with " << compressor->getName();
 
     auto inputHeader = msg.header();
@@ -105,7 +154,7 @@ StatusWith<Message> MessageCompressorManager::compressMessage(
         return {msg};
     }
 
-    auto outputMessageBuffer = SharedBuffer::allocate(bufferSize);
+    auto outputMessageBuffer = SharedBuffer::allocatePooled(bufferSize);
 
     MsgData::View outMessage(outputMessageBuffer.get());
     outMessage.setId(inputHeader.getId());
@@ -117,13 +166,33 @@ StatusWith<Message> MessageCompressorManager::compressMessage(
     compressionHeader.serialize(&output);
     ConstDataRange input(inputHeader.data(), inputHeader.data() + inputHeader.dataLen());
 
-    auto sws = compressor->compressData(input, output);
+    Timer timer;
+    auto sws = compressor->compressDataAtLevel(
+        input, output, _levelFor(compressor), _contextFor(compressor));
+    const auto micros = timer.micros();
+    compressor->counterHitCompressTime(micros);
 
     if (!sws.isOK())
         return sws.getStatus();
 
     auto realCompressedSize = sws.getValue();
-    outMessage.setLen(realCompressedSize + CompressionHeader::size() + MsgData::MsgDataHeaderSize);
+    if (sample >= 0) {
+        _recordSample(sample, probing, input.length(), realCompressedSize, micros);
+    }
+    const size_t messageSize =
+        realCompressedSize + CompressionHeader::size() + MsgData::MsgDataHeaderSize;
+    outMessage.setLen(messageSize);
+
+    // The buffer was sized for the worst case, but the message may sit in a send queue for a
+    // while, so give back what compression saved. Pooled buffers can only shrink by moving to a
+    // smaller block.
+    if (bufferSize > SharedBuffer::kMaxPooledBytes) {
+        outputMessageBuffer.realloc(messageSize);
+    } else if (messageSize <= outputMessageBuffer.capacity() / 2) {
+        auto smallerBuffer = SharedBuffer::allocatePooled(messageSize);
+        memcpy(smallerBuffer.get(), outputMessageBuffer.get(), messageSize);
+        outputMessageBuffer = std::move(smallerBuffer);
+    }
 
     return {Message(outputMessageBuffer)};
 }
@@ -155,7 +224,7 @@ StatusWith<Message> MessageCompressorManager::decompressMessage(const Message& m
                 "Decompressed message would be larger than maximum message size"};
     }
 
-    auto outputMessageBuffer = SharedBuffer::allocate(bufferSize);
+    auto outputMessageBuffer = SharedBuffer::allocatePooled(bufferSize);
     MsgData::View outMessage(outputMessageBuffer.get());
     outMessage.setId(inputHeader.getId());
     outMessage.setResponseToMsgId(inputHeader.getResponseToMsgId());
@@ -164,7 +233,9 @@ StatusWith<Message> MessageCompressorManager::decompressMessage(const Message& m
 
     DataRangeCursor output(outMessage.data(), outMessage.data() + outMessage.dataLen());
 
-    auto sws = compressor->decompressData(input, output);
+    Timer timer;
+    auto sws = compressor->decompressDataWithContext(input, output, _contextFor(compressor));
+    compressor->counterHitDecompressTime(timer.micros());
 
     if (!sws.isOK())
         return sws.getStatus();
@@ -183,6 +254,8 @@ void MessageCompressorManager::clientBegin(BSONObjBuilder* output) {
 
     // We're about to update the compressor list with the negotiation result from the server.
     _negotiated.clear();
+    _contexts.clear();
+    _samples.clear();
 
     auto& compressorList = _registry->getCompressorNames();
     if (compressorList.size() == 0)
@@ -194,6 +267,16 @@ void MessageCompressorManager::clientBegin(BSONObjBuilder* output) {
         sub.append(e);
     }
     sub.doneFast();
+
+    if (!_levels.empty()) {
+        BSONObjBuilder levels(output->subobjStart(kCompressionLevels));
+        for (const auto& level : _levels) {
+            auto compressor = _registry->getCompressor(level.first);
+            LOG(3) << "Requesting " << compressor->getName() << " level " << level.second;
+            levels.append(compressor->getName(), level.second);
+        }
+        levels.doneFast();
+    }
 }
 
 void MessageCompressorManager::clientFinish(const BSONObj& input) {
@@ -219,11 +302,35 @@ void MessageCompressorManager::clientFinish(const BSONObj& input) {
         LOG(3) << "Adding compressor " << ret->getName();
         _negotiated.push_back(ret);
     }
+    _prepareNegotiated();
+
+    // The server tells us which of our requested levels it went with, so both directions match.
+    // If it didn't, we keep using the levels we asked for.
+    auto levelsElem = input.getField(kCompressionLevels);
+    if (levelsElem.type() == Object) {
+        for (const auto& e : levelsElem.Obj()) {
+            auto compressor = _registry->getCompressor(e.fieldNameStringData());
+            if (compressor && e.isNumber()) {
+                setCompressionLevel(compressor->getName(), e.numberInt());
+            }
+        }
+    }
 }
 
 void MessageCompressorManager::serverNegotiate(const BSONObj& input, BSONObjBuilder* output) {
     LOG(3) << "Starting server-side compression negotiation";
 
+    const auto appendLevels = [&] {
+        if (_levels.empty()) {
+            return;
+        }
+        BSONObjBuilder levels(output->subobjStart(kCompressionLevels));
+        for (const auto& level : _levels) {
+            levels.append(_registry->getCompressor(level.first)->getName(), level.second);
+        }
+        levels.doneFast();
+    };
+
     auto elem = input.getField("compression");
     // If the "compression" field is missing, then this isMaster request is requesting information
     // rather than doing a negotiation
@@ -237,6 +344,7 @@ void MessageCompressorManager::serverNegotiate(const BSONObj& input, BSONObjBuil
                 sub.append(algo->getName());
             }
             sub.doneFast();
+            appendLevels();
         } else {
             LOG(3) << "Compression negotiation not requested by client";
         }
@@ -246,6 +354,9 @@ void MessageCompressorManager::serverNegotiate(const BSONObj& input, BSONObjBuil
     // If compression has already been negotiated, then this is a renegotiation, so we should
     // reset the state of the manager.
     _negotiated.clear();
+    _contexts.clear();
+    _samples.clear();
+    _levels.clear();
 
     // First we go through all the compressor names that the client has requested support for
     BSONObj theirObj = elem.Obj();
@@ -267,6 +378,25 @@ void MessageCompressorManager::serverNegotiate(const BSONObj& input, BSONObjBuil
             LOG(3) << curName << " is not supported";
         }
     }
+    _prepareNegotiated();
+
+    // Then we take the levels the client asked for, for any of those compressors that have
+    // levels, adjusted to ones we support. We compress our replies at those levels, so a client
+    // may pick a cheaper level than our default but never a costlier one.
+    auto levelsElem = input.getField(kCompressionLevels);
+    if (levelsElem.type() == Object) {
+        for (const auto& e : levelsElem.Obj()) {
+            auto it = std::find_if(_negotiated.begin(), _negotiated.end(), [&](auto algo) {
+                return algo->getName() == e.fieldNameStringData();
+            });
+            if (it == _negotiated.end() || !(*it)->hasLevels() || !e.isNumber()) {
+                LOG(3) << "Ignoring requested level for " << e.fieldNameStringData();
+                continue;
+            }
+            setCompressionLevel((*it)->getName(),
+                                std::min(e.numberInt(), (*it)->getDefaultLevel()));
+        }
+    }
 
     // If the number of compressors that were eventually negotiated is greater than 0, then
     // we should send that back to the client.
@@ -276,11 +406,133 @@ void MessageCompressorManager::serverNegotiate(const BSONObj& input, BSONObjBuil
             sub.append(algo->getName());
         }
         sub.doneFast();
+        appendLevels();
     } else {
         LOG(3) << "Could not agree on compressor to use";
     }
 }
 
+void MessageCompressorManager::setCompressionLevel(StringData compressorName, int level) {
+    auto compressor = _registry->getCompressor(compressorName);
+    if (!compressor || !compressor->hasLevels()) {
+        return;
+    }
+
+    level = compressor->clampLevel(level);
+    auto it = std::find_if(_levels.begin(), _levels.end(), [&](const auto& entry) {
+        return entry.first == compressor->getId();
+    });
+    if (it != _levels.end()) {
+        it->second = level;
+    } else {
+        _levels.emplace_back(compressor->getId(), level);
+    }
+}
+
+int MessageCompressorManager::_levelFor(MessageCompressorBase* compressor) const {
+    for (const auto& level : _levels) {
+        if (level.first == compressor->getId()) {
+            return level.second;
+        }
+    }
+    return compressor->getDefaultLevel();
+}
+
+MessageCompressorBase::Context* MessageCompressorManager::_contextFor(
+    MessageCompressorBase* compressor) const {
+    for (const auto& context : _contexts) {
+        if (context.first == compressor->getId()) {
+            return context.second.get();
+        }
+    }
+    return nullptr;
+}
+
+void MessageCompressorManager::_prepareNegotiated() {
+    invariant(_contexts.empty());
+    for (auto compressor : _negotiated) {
+        _contexts.emplace_back(compressor->getId(), compressor->makeContext());
+    }
+    _samples.assign(_negotiated.size(), CompressorSample{});
+    _bestSample = 0;
+    _messagesSinceProbe = 0;
+}
+
+size_t MessageCompressorManager::_chooseSample(bool* probing) {
+    // Try each compressor once before trusting the averages
+    for (size_t i = 0; i < _samples.size(); ++i) {
+        if (!_samples[i].sampled) {
+            *probing = (i != _bestSample);
+            return i;
+        }
+    }
+
+    if (_samples.size() > 1 && ++_messagesSinceProbe >= kAdaptiveProbeInterval) {
+        // Take turns trying each of the others
+        _messagesSinceProbe = 0;
+        *probing = true;
+        return (_bestSample + 1 + _nextProbe++ % (_samples.size() - 1)) % _samples.size();
+    }
+
+    *probing = false;
+    return _bestSample;
+}
+
+bool MessageCompressorManager::_skipCompression(size_t index) {
+    auto& sample = _samples[index];
+    if (sample.skipRemaining > 0) {
+        --sample.skipRemaining;
+        return true;
+    }
+    return false;
+}
+
+void MessageCompressorManager::_recordSample(
+    size_t index, bool probing, size_t inputBytes, size_t outputBytes, int64_t micros) {
+    if (inputBytes == 0) {
+        return;
+    }
+
+    const double ratio = static_cast<double>(outputBytes) / inputBytes;
+    const double savedBytesPerMicro = (static_cast<double>(inputBytes) - outputBytes) /
+        std::max<int64_t>(micros, 1);
+
+    auto& sample = _samples[index];
+    if (sample.sampled) {
+        sample.ratio += kAdaptiveSampleWeight * (ratio - sample.ratio);
+        sample.savedBytesPerMicro +=
+            kAdaptiveSampleWeight * (savedBytesPerMicro - sample.savedBytesPerMicro);
+    } else {
+        sample.ratio = ratio;
+        sample.savedBytesPerMicro = savedBytesPerMicro;
+        sample.sampled = true;
+    }
+
+    const auto previousBest = _bestSample;
+    for (size_t i = 0; i < _samples.size(); ++i) {
+        if (_samples[i].sampled &&
+            _samples[i].savedBytesPerMicro > _samples[_bestSample].savedBytesPerMicro) {
+            _bestSample = i;
+        }
+    }
+    if (_bestSample != previousBest) {
+        LOG(3) << "Switching from " << _negotiated[previousBest]->getName() << " to "
+               << _negotiated[_bestSample]->getName() << " compression";
+    }
+
+    // A message one compressor couldn't shrink may suit another, so a probe doesn't make the
+    // compressor it tried back off.
+    if (probing) {
+        return;
+    }
+    if (ratio > kIncompressibleRatio) {
+        sample.skipped = std::min(std::max(1u, sample.skipped * 2), kMaxSkippedMessages);
+        sample.skipRemaining = sample.skipped;
+    } else {
+        sample.skipped = 0;
+    }
+}
+
 MessageCompressorManager& MessageCompressorManager::forSession(
     const transport::SessionHandle& session) {
     return getForSession(session.get());
@@ -21,6 +21,8 @@
 #include "mongo/transport/message_compressor_base.h"
 #include "mongo/transport/session.h"
 
+#include <memory>
+#include <utility>
 #include <vector>
 
 namespace mongo {
@@ -77,6 +79,19 @@ public:
      */
     void serverNegotiate(const BSONObj& input, BSONObjBuilder* output);
 
+    /*
+     * Called by a client before clientBegin to ask that messages compressed with the named
+     * compressor on this session be compressed at the given level, rather than the compressor's
+     * default level.
+     *
+     * clientBegin sends the requested levels to the server in a "compressionLevels" document. The
+     * server uses the nearest level it supports for its replies, but no higher than its own default
+     * level, and sends back the levels it chose, which the client then uses too. Servers which
+     * don't know about levels ignore the request, in which case the client still uses the
+     * requested levels itself.
+     */
+    void setCompressionLevel(StringData compressorName, int level);
+
     /*
      * Returns a new Message containing the compressed contentx of 'msg'. If compressorId is null,
      * then it selects the first negotiated compressor. Otherwise, it uses the compressor with the
@@ -86,6 +101,12 @@ public:
      * If _negotiated is empty (meaning compression was not negotiated or is not supported), then
      * it will return a ref-count bumped copy of the input message.
      *
+     * If the registry's options enable adaptive compression, then messages are returned
+     * uncompressed for a while after ones that the same compressor couldn't shrink. If
+     * compressorId is null, the compressor is also chosen from _negotiated by how many bytes each
+     * has been saving per microsecond on this session. A given compressorId is always used, since
+     * the peer chose it.
+     *
      * If an error occurs in the compressor, it will return a Status error.
      */
     StatusWith<Message> compressMessage(const Message& msg,
@@ -114,7 +135,62 @@ public:
     static MessageCompressorManager& forSession(const transport::SessionHandle& session);
 
 private:
+    // Returns the level this session compresses at with the given compressor.
+    int _levelFor(MessageCompressorBase* compressor) const;
+
+    // Returns this session's context for the given compressor. Compressors with nothing to keep
+    // between messages, and ones this session didn't negotiate, get null.
+    MessageCompressorBase::Context* _contextFor(MessageCompressorBase* compressor) const;
+
+    // Sets up the contexts and adaptive compression state for the compressors just negotiated.
+    // Nothing is added to them afterwards, so compressing a reply on one thread while the next
+    // request is decompressed on another never changes them under either.
+    void _prepareNegotiated();
+
+    // Picks which of _negotiated adaptive compression should use for the next message when the
+    // caller leaves it to us. Sets "probing" if it isn't the compressor doing best.
+    size_t _chooseSample(bool* probing);
+
+    // Returns whether adaptive compression should send the next message uncompressed rather than
+    // compress it with _negotiated[index].
+    bool _skipCompression(size_t index);
+
+    // Adds the result of compressing a message with _negotiated[index] to its moving averages,
+    // and updates its backoff unless it was only being probed.
+    void _recordSample(
+        size_t index, bool probing, size_t inputBytes, size_t outputBytes, int64_t micros);
+
     std::vector<MessageCompressorBase*> _negotiated;
+
+    // Levels which differ from their compressor's default. There are only ever a few of these.
+    std::vector<std::pair<MessageCompressorId, int>> _levels;
+
+    // The contexts of the negotiated compressors, so that each message doesn't set one up from
+    // scratch. Made once negotiation finishes.
+    std::vector<std::pair<MessageCompressorId, std::unique_ptr<MessageCompressorBase::Context>>>
+        _contexts;
+
+    // What adaptive compression has learned about one of the negotiated compressors
+    struct CompressorSample {
+        // Moving averages of compressed size over original size, and of bytes saved per
+        // microsecond spent compressing
+        double ratio = 1;
+        double savedBytesPerMicro = 0;
+        bool sampled = false;
+
+        // How many messages were skipped after the last incompressible one, and how many of those
+        // are still to come
+        unsigned skipped = 0;
+        unsigned skipRemaining = 0;
+    };
+
+    // Adaptive compression's state, which is only used if the registry's options enable it.
+    // _samples lines up with _negotiated.
+    std::vector<CompressorSample> _samples;
+    size_t _bestSample = 0;
+    unsigned _messagesSinceProbe = 0;
+    unsigned _nextProbe = 0;
+
     MessageCompressorRegistry* _registry;
 };
 
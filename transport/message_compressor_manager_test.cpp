@@ -26,9 +26,15 @@
 #include "mongo/transport/message_compressor_registry.h"
 #include "mongo/transport/message_compressor_snappy.h"
 #include "mongo/transport/message_compressor_zlib.h"
+#ifdef MONGO_ZSTD_LZ4_COMPRESSION
+#include "mongo/transport/message_compressor_lz4.h"
+#include "mongo/transport/message_compressor_zstd.h"
+#endif
 #include "mongo/unittest/unittest.h"
 #include "mongo/util/log.h"
+#include "mongo/util/mongoutils/str.h"
 
+#include <array>
 #include <string>
 #include <vector>
 
@@ -154,6 +160,40 @@ void checkOverflow(std::unique_ptr<MessageCompressorBase> compressor) {
         compressor->decompressData(tooSmallRange, DataRange(scratch.data(), scratch.size())));
 }
 
+void checkContextReuse(std::unique_ptr<MessageCompressorBase> compressor) {
+    auto context = compressor->makeContext();
+    ASSERT(context);
+
+    std::array<char, 16> smallBuffer;
+    DataRange smallOutput(smallBuffer.data(), smallBuffer.size());
+
+    // Each message is compressed and decompressed with the same context, including after a
+    // failure has left it in the middle of a message.
+    for (int i = 0; i < 10; ++i) {
+        const std::string data = str::stream() << "Message " << i << " of ten. "
+                                               << std::string(100 * i, 'a' + i);
+        ConstDataRange input(data.data(), data.size());
+        ASSERT_NOT_OK(compressor->compressDataAtLevel(
+            input, smallOutput, compressor->getDefaultLevel(), context.get()));
+
+        std::vector<char> compressed(compressor->getMaxCompressedSize(data.size()));
+        auto compressedSize = assertOk(
+            compressor->compressDataAtLevel(input,
+                                            DataRange(compressed.data(), compressed.size()),
+                                            compressor->getDefaultLevel(),
+                                            context.get()));
+
+        std::vector<char> decompressed(data.size());
+        DataRange output(decompressed.data(), decompressed.size());
+        ASSERT_NOT_OK(compressor->decompressDataWithContext(
+            ConstDataRange(compressed.data(), compressedSize / 2), output, context.get()));
+        ASSERT_EQ(assertOk(compressor->decompressDataWithContext(
+                      ConstDataRange(compressed.data(), compressedSize), output, context.get())),
+                  data.size());
+        ASSERT_EQ(std::string(decompressed.data(), decompressed.size()), data);
+    }
+}
+
 Message buildMessage() {
     const auto data = std::string{"Hello, world!"};
     const auto bufferSize = MsgData::MsgDataHeaderSize + data.size();
@@ -221,6 +261,10 @@ TEST(ZlibMessageCompressor, Fidelity) {
     checkFidelity(testMessage, stdx::make_unique<ZlibMessageCompressor>());
 }
 
+TEST(ZlibMessageCompressor, ContextReuse) {
+    checkContextReuse(stdx::make_unique<ZlibMessageCompressor>());
+}
+
 TEST(SnappyMessageCompressor, Overflow) {
     checkOverflow(stdx::make_unique<SnappyMessageCompressor>());
 }
@@ -229,6 +273,321 @@ TEST(ZlibMessageCompressor, Overflow) {
     checkOverflow(stdx::make_unique<ZlibMessageCompressor>());
 }
 
+#ifdef MONGO_ZSTD_LZ4_COMPRESSION
+TEST(ZstdMessageCompressor, Fidelity) {
+    auto testMessage = buildMessage();
+    checkFidelity(testMessage, stdx::make_unique<ZstdMessageCompressor>());
+}
+
+TEST(ZstdMessageCompressor, FidelityWithDictionary) {
+    auto testMessage = buildMessage();
+    checkFidelity(testMessage,
+                  stdx::make_unique<ZstdMessageCompressor>(ZstdMessageCompressor::kDefaultLevel,
+                                                           "Hello, world! Hello, world!"));
+}
+
+TEST(ZstdMessageCompressor, DictionariesMustMatch) {
+    const std::string data = "Hello, world! Hello, world! Hello, world!";
+    ZstdMessageCompressor withDictionary(ZstdMessageCompressor::kDefaultLevel, data);
+    ZstdMessageCompressor withoutDictionary;
+
+    std::vector<char> compressed(withDictionary.getMaxCompressedSize(data.size()));
+    auto compressedSize = assertOk(withDictionary.compressData(
+        ConstDataRange(data.data(), data.size()), DataRange(compressed.data(), compressed.size())));
+
+    std::vector<char> decompressed(data.size());
+    ASSERT_NOT_OK(
+        withoutDictionary.decompressData(ConstDataRange(compressed.data(), compressedSize),
+                                         DataRange(decompressed.data(), decompressed.size())));
+    ASSERT_EQ(assertOk(withDictionary.decompressData(
+                  ConstDataRange(compressed.data(), compressedSize),
+                  DataRange(decompressed.data(), decompressed.size()))),
+              data.size());
+    ASSERT_EQ(std::string(decompressed.data(), decompressed.size()), data);
+}
+
+TEST(ZstdMessageCompressor, ContextReuse) {
+    checkContextReuse(stdx::make_unique<ZstdMessageCompressor>());
+}
+
+TEST(ZstdMessageCompressor, ContextReuseWithDictionary) {
+    checkContextReuse(stdx::make_unique<ZstdMessageCompressor>(
+        ZstdMessageCompressor::kDefaultLevel, "Message 1 of ten. Message 2 of ten."));
+}
+
+TEST(LZ4MessageCompressor, Fidelity) {
+    auto testMessage = buildMessage();
+    checkFidelity(testMessage, stdx::make_unique<LZ4MessageCompressor>());
+}
+
+TEST(ZstdMessageCompressor, Overflow) {
+    checkOverflow(stdx::make_unique<ZstdMessageCompressor>());
+}
+
+TEST(LZ4MessageCompressor, Overflow) {
+    checkOverflow(stdx::make_unique<LZ4MessageCompressor>());
+}
+#endif
+
+TEST(MessageCompressorManager, LevelNegotiation) {
+    MessageCompressorRegistry registry;
+    registry.setSupportedCompressors({"zlib", "snappy"});
+    registry.registerImplementation(stdx::make_unique<ZlibMessageCompressor>());
+    registry.registerImplementation(stdx::make_unique<SnappyMessageCompressor>());
+    ASSERT_OK(registry.finalizeSupportedCompressors());
+
+    // The server caps levels at its own default, and ignores levels for compressors without
+    // them.
+    MessageCompressorManager serverManager(&registry);
+    auto clientObj = BSON("isMaster" << 1 << "compression" << BSON_ARRAY("zlib"
+                                                                         << "snappy")
+                                     << "compressionLevels"
+                                     << BSON("zlib" << 42 << "snappy" << 3));
+    BSONObjBuilder serverOutput;
+    serverManager.serverNegotiate(clientObj, &serverOutput);
+    auto serverObj = serverOutput.obj();
+    checkNegotiationResult(serverObj, {"zlib", "snappy"});
+    ASSERT_BSONOBJ_EQ(serverObj["compressionLevels"].Obj(),
+                      BSON("zlib" << ZlibMessageCompressor::kDefaultLevel));
+
+    // A client asking for a level sends it, and takes whatever the server chose.
+    MessageCompressorManager clientManager(&registry);
+    clientManager.setCompressionLevel("zlib", 1);
+    BSONObjBuilder clientOutput;
+    clientManager.clientBegin(&clientOutput);
+    ASSERT_BSONOBJ_EQ(clientOutput.obj()["compressionLevels"].Obj(), BSON("zlib" << 1));
+    clientManager.clientFinish(serverObj);
+
+    // Messages compressed at the negotiated level still round trip.
+    auto toSend = assertOk(clientManager.compressMessage(buildMessage()));
+    auto recvd = assertOk(serverManager.decompressMessage(toSend));
+    toSend = assertOk(serverManager.compressMessage(recvd));
+    recvd = assertOk(clientManager.decompressMessage(toSend));
+    ASSERT_EQ(recvd.size(), buildMessage().size());
+
+    // Clients that don't ask for levels don't get any back.
+    MessageCompressorManager oldServerManager(&registry);
+    BSONObjBuilder oldServerOutput;
+    oldServerManager.serverNegotiate(
+        BSON("isMaster" << 1 << "compression" << BSON_ARRAY("zlib")), &oldServerOutput);
+    ASSERT_TRUE(oldServerOutput.obj()["compressionLevels"].eoo());
+}
+
+TEST(MessageCompressorManager, ClientsCannotRaiseLevels) {
+    MessageCompressorRegistry registry;
+    registry.setSupportedCompressors({"zlib"});
+    registry.registerImplementation(stdx::make_unique<ZlibMessageCompressor>(4));
+    ASSERT_OK(registry.finalizeSupportedCompressors());
+
+    const auto negotiateLevel = [&](int level) {
+        MessageCompressorManager serverManager(&registry);
+        BSONObjBuilder serverOutput;
+        serverManager.serverNegotiate(BSON("isMaster" << 1 << "compression" << BSON_ARRAY("zlib")
+                                                      << "compressionLevels"
+                                                      << BSON("zlib" << level)),
+                                      &serverOutput);
+        return serverOutput.obj()["compressionLevels"]["zlib"].numberInt();
+    };
+
+    // Levels above the server's are brought down to it, and levels below it are kept.
+    ASSERT_EQ(negotiateLevel(9), 4);
+    ASSERT_EQ(negotiateLevel(2), 2);
+}
+
+TEST(MessageCompressorManager, SmallMessagesAreNotCompressed) {
+    MessageCompressorRegistry registry;
+    registry.setSupportedCompressors({"zlib"});
+    registry.registerImplementation(stdx::make_unique<ZlibMessageCompressor>());
+    registry.finalizeSupportedCompressors().transitional_ignore();
+
+    MessageCompressorOptions options;
+    options.minMessageSizeBytes = 1024;
+    registry.setCompressorOptions(options);
+
+    MessageCompressorManager manager(&registry);
+    BSONObjBuilder negotiatorOut;
+    manager.serverNegotiate(BSON("isMaster" << 1 << "compression" << BSON_ARRAY("zlib")),
+                            &negotiatorOut);
+
+    auto smallMessage = buildMessage();
+    ASSERT_LT(smallMessage.size(), options.minMessageSizeBytes);
+    auto compressed = assertOk(manager.compressMessage(smallMessage));
+    ASSERT_EQ(compressed.singleData().getNetworkOp(), dbQuery);
+    ASSERT_EQ(compressed.buf(), smallMessage.buf());
+
+    const std::string data(options.minMessageSizeBytes, 'x');
+    const auto bufferSize = MsgData::MsgDataHeaderSize + data.size();
+    auto buf = SharedBuffer::allocate(bufferSize);
+    MsgData::View largeView(buf.get());
+    largeView.setId(1);
+    largeView.setResponseToMsgId(0);
+    largeView.setOperation(dbQuery);
+    largeView.setLen(bufferSize);
+    memcpy(largeView.data(), data.data(), data.size());
+
+    compressed = assertOk(manager.compressMessage(Message{buf}));
+    ASSERT_EQ(compressed.singleData().getNetworkOp(), dbCompressed);
+    ASSERT_LT(compressed.size(), static_cast<int>(bufferSize));
+
+    auto decompressed = assertOk(manager.decompressMessage(compressed));
+    ASSERT_EQ(decompressed.size(), static_cast<int>(bufferSize));
+    ASSERT_EQ(memcmp(decompressed.singleData().data(), data.data(), data.size()), 0);
+}
+
+Message buildMessage(const std::string& data) {
+    const auto bufferSize = MsgData::MsgDataHeaderSize + data.size();
+    auto buf = SharedBuffer::allocate(bufferSize);
+    MsgData::View view(buf.get());
+    view.setId(1);
+    view.setResponseToMsgId(0);
+    view.setOperation(dbQuery);
+    view.setLen(bufferSize);
+    memcpy(view.data(), data.data(), data.size());
+    return Message{buf};
+}
+
+MessageCompressorRegistry buildAdaptiveRegistry() {
+    MessageCompressorRegistry registry;
+    registry.setSupportedCompressors({"noop", "zlib"});
+    registry.registerImplementation(stdx::make_unique<NoopMessageCompressor>());
+    registry.registerImplementation(stdx::make_unique<ZlibMessageCompressor>());
+    registry.finalizeSupportedCompressors().transitional_ignore();
+
+    MessageCompressorOptions options;
+    options.adaptive = true;
+    registry.setCompressorOptions(options);
+    return registry;
+}
+
+TEST(MessageCompressorManager, AdaptiveSkipsIncompressibleMessages) {
+    auto registry = buildAdaptiveRegistry();
+    MessageCompressorManager manager(&registry);
+    BSONObjBuilder negotiatorOut;
+    manager.serverNegotiate(BSON("isMaster" << 1 << "compression" << BSON_ARRAY("zlib")),
+                            &negotiatorOut);
+
+    // Already compressed data, such as this, doesn't shrink
+    std::string incompressible(4096, 0);
+    uint32_t state = 12345;
+    for (auto& c : incompressible) {
+        state = state * 1103515245 + 12345;
+        c = static_cast<char>(state >> 24);
+    }
+    auto message = buildMessage(incompressible);
+
+    // Each incompressible message in a row doubles the number skipped after it
+    std::vector<bool> compressed;
+    for (int i = 0; i < 8; ++i) {
+        auto out = assertOk(manager.compressMessage(message));
+        compressed.push_back(out.singleData().getNetworkOp() == dbCompressed);
+    }
+    ASSERT(compressed == std::vector<bool>({true, false, true, false, false, true, false, false}));
+    ASSERT_EQ(registry.getCompressor("zlib")->getCompressorBytesSkipped(), 5 * message.size());
+
+    // Once the backoff has run out, a message that shrinks resets it
+    ASSERT_EQ(assertOk(manager.compressMessage(message)).singleData().getNetworkOp(), dbQuery);
+    ASSERT_EQ(assertOk(manager.compressMessage(message)).singleData().getNetworkOp(), dbQuery);
+    auto compressible = buildMessage(std::string(4096, 'x'));
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_EQ(assertOk(manager.compressMessage(compressible)).singleData().getNetworkOp(),
+                  dbCompressed);
+    }
+}
+
+TEST(MessageCompressorManager, AdaptiveSwitchesToBetterCompressor) {
+    auto registry = buildAdaptiveRegistry();
+    MessageCompressorManager manager(&registry);
+    BSONObjBuilder negotiatorOut;
+    manager.serverNegotiate(BSON("isMaster" << 1 << "compression" << BSON_ARRAY("noop"
+                                                                                 << "zlib")),
+                            &negotiatorOut);
+
+    // noop is negotiated first but saves nothing, so when no compressor is asked for, the
+    // session moves to zlib once it has tried it.
+    const auto noopId = registry.getCompressor("noop")->getId();
+    const auto zlibId = registry.getCompressor("zlib")->getId();
+    auto message = buildMessage(std::string(4096, 'x'));
+    std::vector<MessageCompressorId> used;
+    for (int i = 0; i < 10; ++i) {
+        auto out = assertOk(manager.compressMessage(message));
+        ASSERT_EQ(out.singleData().getNetworkOp(), dbCompressed);
+
+        MessageCompressorId id;
+        auto decompressed = assertOk(manager.decompressMessage(out, &id));
+        ASSERT_EQ(decompressed.size(), message.size());
+        used.push_back(id);
+    }
+
+    ASSERT_EQ(used.front(), noopId);
+    for (size_t i = 1; i < used.size(); ++i) {
+        ASSERT_EQ(used[i], zlibId);
+    }
+}
+
+TEST(MessageCompressorManager, AdaptiveKeepsRequestedCompressor) {
+    auto registry = buildAdaptiveRegistry();
+    MessageCompressorManager manager(&registry);
+    BSONObjBuilder negotiatorOut;
+    manager.serverNegotiate(BSON("isMaster" << 1 << "compression" << BSON_ARRAY("noop"
+                                                                                 << "zlib")),
+                            &negotiatorOut);
+
+    // noop never shrinks anything, but messages it does compress still use it rather than zlib,
+    // since that's what the peer asked for.
+    const auto noopId = registry.getCompressor("noop")->getId();
+    const auto zlibId = registry.getCompressor("zlib")->getId();
+    auto message = buildMessage(std::string(4096, 'x'));
+    int compressed = 0;
+    for (int i = 0; i < 10; ++i) {
+        auto out = assertOk(manager.compressMessage(message, &noopId));
+        if (out.singleData().getNetworkOp() != dbCompressed) {
+            continue;
+        }
+
+        MessageCompressorId id;
+        auto decompressed = assertOk(manager.decompressMessage(out, &id));
+        ASSERT_EQ(decompressed.size(), message.size());
+        ASSERT_EQ(id, noopId);
+        ++compressed;
+    }
+    ASSERT_GT(compressed, 0);
+    ASSERT_LT(compressed, 10);
+
+    // Backing off from noop doesn't hold back zlib
+    for (int i = 0; i < 4; ++i) {
+        auto out = assertOk(manager.compressMessage(message, &zlibId));
+        ASSERT_EQ(out.singleData().getNetworkOp(), dbCompressed);
+
+        MessageCompressorId id;
+        assertOk(manager.decompressMessage(out, &id));
+        ASSERT_EQ(id, zlibId);
+    }
+}
+
+TEST(MessageCompressorManager, CompressorsOutsideNegotiation) {
+    MessageCompressorRegistry registry;
+    registry.setSupportedCompressors({"noop", "zlib"});
+    registry.registerImplementation(stdx::make_unique<NoopMessageCompressor>());
+    registry.registerImplementation(stdx::make_unique<ZlibMessageCompressor>());
+    ASSERT_OK(registry.finalizeSupportedCompressors());
+
+    MessageCompressorManager manager(&registry);
+    BSONObjBuilder negotiatorOut;
+    manager.serverNegotiate(BSON("isMaster" << 1 << "compression" << BSON_ARRAY("noop")),
+                            &negotiatorOut);
+
+    // Contexts are only made for negotiated compressors, and others go without
+    const auto zlibId = registry.getCompressor("zlib")->getId();
+    auto message = buildMessage(std::string(4096, 'x'));
+    auto out = assertOk(manager.compressMessage(message, &zlibId));
+    ASSERT_EQ(out.singleData().getNetworkOp(), dbCompressed);
+
+    MessageCompressorId id;
+    auto decompressed = assertOk(manager.decompressMessage(out, &id));
+    ASSERT_EQ(id, zlibId);
+    ASSERT_EQ(decompressed.size(), message.size());
+}
+
 TEST(MessageCompressorManager, SERVER_28008) {
 
     // Create a client and server that will negotiate the same compressors,
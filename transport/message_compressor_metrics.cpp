@@ -23,6 +23,8 @@ namespace mongo {
 namespace {
 const auto kBytesIn = "bytesIn"_sd;
 const auto kBytesOut = "bytesOut"_sd;
+const auto kTimeMicros = "timeMicros"_sd;
+const auto kBytesSkipped = "bytesSkipped"_sd;
 }  // namespace
 
 void appendMessageCompressionStats(BSONObjBuilder* b) {
@@ -38,13 +40,16 @@ void appendMessageCompressionStats(BSONObjBuilder* b) {
         BSONObjBuilder base(compressionSection.subobjStart(name));
 
         BSONObjBuilder compressorSection(base.subobjStart("compressor"));
-        compressorSection << kBytesIn << compressor->getCompressorBytesIn() << kBytesOut
-                          << compressor->getCompressorBytesOut();
+        compressorSection << kBytesIn << compressor->getCompressorBytesIn()    //
+                          << kBytesOut << compressor->getCompressorBytesOut()  //
+                          << kTimeMicros << compressor->getCompressorMicros()  //
+                          << kBytesSkipped << compressor->getCompressorBytesSkipped();
         compressorSection.doneFast();
 
         BSONObjBuilder decompressorSection(base.subobjStart("decompressor"));
-        decompressorSection << kBytesIn << compressor->getDecompressorBytesIn() << kBytesOut
-                            << compressor->getDecompressorBytesOut();
+        decompressorSection << kBytesIn << compressor->getDecompressorBytesIn()    //
+                            << kBytesOut << compressor->getDecompressorBytesOut()  //
+                            << kTimeMicros << compressor->getDecompressorMicros();
         decompressorSection.doneFast();
         base.doneFast();
     }
@@ -25,6 +25,8 @@
 #include "mongo/transport/message_compressor_zlib.h"
 #include "mongo/util/options_parser/option_section.h"
 
+#include <limits>
+
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 
@@ -42,6 +44,10 @@ StringData getMessageCompressorName(MessageCompressor id) {
             return "snappy"_sd;
         case MessageCompressor::kZlib:
             return "zlib"_sd;
+        case MessageCompressor::kZstd:
+            return "zstd"_sd;
+        case MessageCompressor::kLZ4:
+            return "lz4"_sd;
         default:
             fassert(40269, "Invalid message compressor ID");
     }
@@ -99,6 +105,14 @@ void MessageCompressorRegistry::setSupportedCompressors(std::vector<std::string>
     _compressorNames = std::move(names);
 }
 
+void MessageCompressorRegistry::setCompressorOptions(MessageCompressorOptions options) {
+    _compressorOptions = std::move(options);
+}
+
+const MessageCompressorOptions& MessageCompressorRegistry::getCompressorOptions() const {
+    return _compressorOptions;
+}
+
 Status addMessageCompressionOptions(moe::OptionSection* options, bool forShell) {
     auto& ret =
         options
@@ -112,6 +126,40 @@ Status addMessageCompressionOptions(moe::OptionSection* options, bool forShell)
     } else {
         ret.setDefault(moe::Value(kDefaultConfigValue.toString()));
     }
+
+    const MessageCompressorOptions defaults;
+    options
+        ->addOptionChaining("net.compression.zlibCompressionLevel",
+                            "networkMessageZlibCompressionLevel",
+                            moe::Int,
+                            "Level to compress network messages at with zlib, from 1 to 9")
+        .setDefault(moe::Value(defaults.zlibLevel))
+        .validRange(1, 9);
+#ifdef MONGO_ZSTD_LZ4_COMPRESSION
+    options
+        ->addOptionChaining("net.compression.zstdCompressionLevel",
+                            "networkMessageZstdCompressionLevel",
+                            moe::Int,
+                            "Level to compress network messages at with zstd, from 1 to 22")
+        .setDefault(moe::Value(defaults.zstdLevel))
+        .validRange(1, 22);
+    options->addOptionChaining("net.compression.zstdDictionary",
+                               "networkMessageZstdDictionary",
+                               moe::String,
+                               "Dictionary file for compressing network messages with zstd");
+#endif
+    options
+        ->addOptionChaining("net.compression.minMessageSizeBytes",
+                            "networkMessageCompressionMinSizeBytes",
+                            moe::Int,
+                            "Network messages smaller than this many bytes are sent uncompressed")
+        .setDefault(moe::Value(defaults.minMessageSizeBytes))
+        .validRange(0, std::numeric_limits<int>::max());
+    options->addOptionChaining(
+        "net.compression.adaptive",
+        "networkMessageCompressionAdaptive",
+        moe::Switch,
+        "Choose between negotiated compressors by their savings and cost on each connection");
     return Status::OK();
 }
 
@@ -124,8 +172,30 @@ Status storeMessageCompressionOptions(const moe::Environment& params) {
         }
     }
 
+    MessageCompressorOptions compressorOptions;
+    if (params.count("net.compression.zlibCompressionLevel")) {
+        compressorOptions.zlibLevel = params["net.compression.zlibCompressionLevel"].as<int>();
+    }
+#ifdef MONGO_ZSTD_LZ4_COMPRESSION
+    if (params.count("net.compression.zstdCompressionLevel")) {
+        compressorOptions.zstdLevel = params["net.compression.zstdCompressionLevel"].as<int>();
+    }
+    if (params.count("net.compression.zstdDictionary")) {
+        compressorOptions.zstdDictionaryPath =
+            params["net.compression.zstdDictionary"].as<std::string>();
+    }
+#endif
+    if (params.count("net.compression.minMessageSizeBytes")) {
+        compressorOptions.minMessageSizeBytes =
+            params["net.compression.minMessageSizeBytes"].as<int>();
+    }
+    if (params.count("net.compression.adaptive")) {
+        compressorOptions.adaptive = params["net.compression.adaptive"].as<bool>();
+    }
+
     auto& compressorFactory = MessageCompressorRegistry::get();
     compressorFactory.setSupportedCompressors(std::move(restrict));
+    compressorFactory.setCompressorOptions(std::move(compressorOptions));
 
     return Status::OK();
 }
@@ -37,6 +37,27 @@ class Environment;
 
 namespace moe = mongo::optionenvironment;
 
+/*
+ * Settings for compression, which compressors read when they're registered at startup.
+ */
+struct MessageCompressorOptions {
+    int zlibLevel = 6;
+    int zstdLevel = 3;
+
+    // Path to a dictionary made with "zstd --train" from typical messages. Both ends of a
+    // connection must use the same dictionary to talk with zstd.
+    std::string zstdDictionaryPath;
+
+    // Messages smaller than this are sent uncompressed, since compressing them costs more than
+    // the few bytes it saves.
+    int minMessageSizeBytes = 0;
+
+    // Whether sessions stop compressing for a while when their messages aren't shrinking, and
+    // choose between their negotiated compressors by how many bytes each saves per microsecond.
+    // Replies still use the compressor their request came with.
+    bool adaptive = false;
+};
+
 /*
  * The MessageCompressorRegistry holds the global registrations of compressors for a process.
  */
@@ -97,12 +118,20 @@ public:
      */
     Status finalizeSupportedCompressors();
 
+    /*
+     * Sets or returns the settings compressors are constructed with. Should be set during option
+     * parsing, before any compressors are registered.
+     */
+    void setCompressorOptions(MessageCompressorOptions options);
+    const MessageCompressorOptions& getCompressorOptions() const;
+
 private:
     StringMap<MessageCompressorBase*> _compressorsByName;
     std::array<std::unique_ptr<MessageCompressorBase>,
                std::numeric_limits<MessageCompressorId>::max() + 1>
         _compressorsByIds;
     std::vector<std::string> _compressorNames;
+    MessageCompressorOptions _compressorOptions;
 };
 
 Status addMessageCompressionOptions(moe::OptionSection* options, bool forShell);
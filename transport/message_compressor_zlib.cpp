@@ -18,29 +18,137 @@
 
 #include "mongo/platform/basic.h"
 
+#include "mongo/base/checked_cast.h"
 #include "mongo/base/init.h"
 #include "mongo/stdx/memory.h"
 #include "mongo/transport/message_compressor_registry.h"
 #include "mongo/transport/message_compressor_zlib.h"
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
 #include <zlib.h>
 
 namespace mongo {
+namespace {
+
+/*
+ * Keeps a deflate and an inflate stream, which are reset for each message rather than set up
+ * from scratch. Setting up a deflate stream allocates and clears a few hundred KB, which costs
+ * more than compressing a small message.
+ */
+class ZlibContext final : public MessageCompressorBase::Context {
+public:
+    ZlibContext() {
+        std::memset(&_deflateStream, 0, sizeof(_deflateStream));
+        std::memset(&_inflateStream, 0, sizeof(_inflateStream));
+    }
+
+    ~ZlibContext() {
+        if (_deflateReady) {
+            ::deflateEnd(&_deflateStream);
+        }
+        if (_inflateReady) {
+            ::inflateEnd(&_inflateStream);
+        }
+    }
+
+    z_stream* deflateStream(int level) {
+        if (_deflateReady && level == _deflateLevel) {
+            return ::deflateReset(&_deflateStream) == Z_OK ? &_deflateStream : nullptr;
+        }
+
+        if (_deflateReady) {
+            ::deflateEnd(&_deflateStream);
+            _deflateReady = false;
+        }
+        if (::deflateInit(&_deflateStream, level) != Z_OK) {
+            return nullptr;
+        }
+        _deflateReady = true;
+        _deflateLevel = level;
+        return &_deflateStream;
+    }
 
-ZlibMessageCompressor::ZlibMessageCompressor() : MessageCompressorBase(MessageCompressor::kZlib) {}
+    z_stream* inflateStream() {
+        if (_inflateReady) {
+            return ::inflateReset(&_inflateStream) == Z_OK ? &_inflateStream : nullptr;
+        }
+
+        if (::inflateInit(&_inflateStream) != Z_OK) {
+            return nullptr;
+        }
+        _inflateReady = true;
+        return &_inflateStream;
+    }
+
+private:
+    z_stream _deflateStream;
+    bool _deflateReady = false;
+    int _deflateLevel = 0;
+
+    z_stream _inflateStream;
+    bool _inflateReady = false;
+};
+
+// Points "stream" at the input and output, or returns false if they're too large for zlib.
+bool setBuffers(z_stream* stream, ConstDataRange input, DataRange output) {
+    const auto maxLength = std::numeric_limits<uInt>::max();
+    if (input.length() > maxLength || output.length() > maxLength) {
+        return false;
+    }
+
+    stream->next_in = const_cast<Bytef*>(reinterpret_cast<const Bytef*>(input.data()));
+    stream->avail_in = static_cast<uInt>(input.length());
+    stream->next_out = const_cast<Bytef*>(reinterpret_cast<const Bytef*>(output.data()));
+    stream->avail_out = static_cast<uInt>(output.length());
+    return true;
+}
+
+}  // namespace
+
+ZlibMessageCompressor::ZlibMessageCompressor(int level)
+    : MessageCompressorBase(MessageCompressor::kZlib), _level(clampLevel(level)) {}
 
 std::size_t ZlibMessageCompressor::getMaxCompressedSize(size_t inputSize) {
     return ::compressBound(inputSize);
 }
 
+std::unique_ptr<MessageCompressorBase::Context> ZlibMessageCompressor::makeContext() {
+    return stdx::make_unique<ZlibContext>();
+}
+
 StatusWith<std::size_t> ZlibMessageCompressor::compressData(ConstDataRange input,
                                                             DataRange output) {
+    return compressDataAtLevel(input, output, _level, nullptr);
+}
+
+int ZlibMessageCompressor::clampLevel(int level) const {
+    return std::max(Z_BEST_SPEED, std::min(level, Z_BEST_COMPRESSION));
+}
+
+StatusWith<std::size_t> ZlibMessageCompressor::compressDataAtLevel(ConstDataRange input,
+                                                                   DataRange output,
+                                                                   int level,
+                                                                   Context* context) {
     size_t outLength = output.length();
-    int ret = ::compress2(const_cast<Bytef*>(reinterpret_cast<const Bytef*>(output.data())),
+    int ret;
+    if (context) {
+        // This produces the same zlib-wrapped stream as compress2()
+        auto stream = checked_cast<ZlibContext*>(context)->deflateStream(level);
+        if (!stream || !setBuffers(stream, input, output)) {
+            return Status{ErrorCodes::BadValue, "Could not compress input"};
+        }
+        ret = ::deflate(stream, Z_FINISH) == Z_STREAM_END ? Z_OK : Z_BUF_ERROR;
+        outLength = stream->total_out;
+    } else {
+        ret = ::compress2(const_cast<Bytef*>(reinterpret_cast<const Bytef*>(output.data())),
                           reinterpret_cast<uLongf*>(&outLength),
                           reinterpret_cast<const Bytef*>(input.data()),
                           input.length(),
-                          Z_DEFAULT_COMPRESSION);
+                          level);
+    }
 
     if (ret != Z_OK) {
         return Status{ErrorCodes::BadValue, "Could not compress input"};
@@ -65,13 +173,31 @@ StatusWith<std::size_t> ZlibMessageCompressor::decompressData(ConstDataRange inp
     return {output.length()};
 }
 
+StatusWith<std::size_t> ZlibMessageCompressor::decompressDataWithContext(ConstDataRange input,
+                                                                         DataRange output,
+                                                                         Context* context) {
+    if (!context) {
+        return decompressData(input, output);
+    }
+
+    auto stream = checked_cast<ZlibContext*>(context)->inflateStream();
+    if (!stream || !setBuffers(stream, input, output) ||
+        ::inflate(stream, Z_FINISH) != Z_STREAM_END) {
+        return Status{ErrorCodes::BadValue, "Compressed message was invalid or corrupted"};
+    }
+
+    counterHitDecompress(input.length(), stream->total_out);
+    return {static_cast<std::size_t>(stream->total_out)};
+}
+
 
 MONGO_INITIALIZER_GENERAL(ZlibMessageCompressorInit,
                           ("EndStartupOptionHandling"),
                           ("AllCompressorsRegistered"))
 (InitializerContext* context) {
     auto& compressorRegistry = MessageCompressorRegistry::get();
-    compressorRegistry.registerImplementation(stdx::make_unique<ZlibMessageCompressor>());
+    compressorRegistry.registerImplementation(stdx::make_unique<ZlibMessageCompressor>(
+        compressorRegistry.getCompressorOptions().zlibLevel));
     return Status::OK();
 }
 }  // namespace mongo
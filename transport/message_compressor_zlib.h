@@ -19,13 +19,39 @@
 namespace mongo {
 class ZlibMessageCompressor final : public MessageCompressorBase {
 public:
-    ZlibMessageCompressor();
+    static constexpr int kDefaultLevel = 6;
+
+    explicit ZlibMessageCompressor(int level = kDefaultLevel);
 
     std::size_t getMaxCompressedSize(size_t inputSize) override;
 
+    std::unique_ptr<Context> makeContext() override;
+
     StatusWith<std::size_t> compressData(ConstDataRange input, DataRange output) override;
 
     StatusWith<std::size_t> decompressData(ConstDataRange input, DataRange output) override;
+
+    bool hasLevels() const override {
+        return true;
+    }
+
+    int getDefaultLevel() const override {
+        return _level;
+    }
+
+    int clampLevel(int level) const override;
+
+    StatusWith<std::size_t> compressDataAtLevel(ConstDataRange input,
+                                                DataRange output,
+                                                int level,
+                                                Context* context) override;
+
+    StatusWith<std::size_t> decompressDataWithContext(ConstDataRange input,
+                                                      DataRange output,
+                                                      Context* context) override;
+
+private:
+    const int _level;
 };
 
 
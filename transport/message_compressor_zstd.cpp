@@ -0,0 +1,195 @@
+/**
+ *    Copyright (C) 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kNetwork
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/base/checked_cast.h"
+#include "mongo/base/init.h"
+#include "mongo/stdx/memory.h"
+#include "mongo/transport/message_compressor_registry.h"
+#include "mongo/transport/message_compressor_zstd.h"
+#include "mongo/util/mongoutils/str.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+#include <zstd.h>
+
+namespace mongo {
+namespace {
+
+/*
+ * Keeps a zstd compression and decompression context, each made the first time it's needed. zstd
+ * resets a context at the start of every frame but keeps its tables allocated, so reusing one
+ * saves allocating and clearing them for every message.
+ */
+class ZstdContext final : public MessageCompressorBase::Context {
+public:
+    ~ZstdContext() {
+        ZSTD_freeCCtx(_compressionContext);
+        ZSTD_freeDCtx(_decompressionContext);
+    }
+
+    ZSTD_CCtx* compressionContext() {
+        if (!_compressionContext) {
+            _compressionContext = ZSTD_createCCtx();
+        }
+        return _compressionContext;
+    }
+
+    ZSTD_DCtx* decompressionContext() {
+        if (!_decompressionContext) {
+            _decompressionContext = ZSTD_createDCtx();
+        }
+        return _decompressionContext;
+    }
+
+private:
+    ZSTD_CCtx* _compressionContext = nullptr;
+    ZSTD_DCtx* _decompressionContext = nullptr;
+};
+
+}  // namespace
+
+ZstdMessageCompressor::ZstdMessageCompressor(int level, std::string dictionary)
+    : MessageCompressorBase(MessageCompressor::kZstd),
+      _level(clampLevel(level)),
+      _dictionary(std::move(dictionary)) {
+    if (!_dictionary.empty()) {
+        _compressionDictionary = ZSTD_createCDict(_dictionary.data(), _dictionary.size(), _level);
+        _decompressionDictionary = ZSTD_createDDict(_dictionary.data(), _dictionary.size());
+        invariant(_compressionDictionary && _decompressionDictionary);
+    }
+}
+
+ZstdMessageCompressor::~ZstdMessageCompressor() {
+    ZSTD_freeCDict(_compressionDictionary);
+    ZSTD_freeDDict(_decompressionDictionary);
+}
+
+std::size_t ZstdMessageCompressor::getMaxCompressedSize(size_t inputSize) {
+    return ZSTD_compressBound(inputSize);
+}
+
+int ZstdMessageCompressor::clampLevel(int level) const {
+    return std::max(1, std::min(level, ZSTD_maxCLevel()));
+}
+
+std::unique_ptr<MessageCompressorBase::Context> ZstdMessageCompressor::makeContext() {
+    return stdx::make_unique<ZstdContext>();
+}
+
+StatusWith<std::size_t> ZstdMessageCompressor::compressData(ConstDataRange input,
+                                                            DataRange output) {
+    return compressDataAtLevel(input, output, _level, nullptr);
+}
+
+StatusWith<std::size_t> ZstdMessageCompressor::compressDataAtLevel(ConstDataRange input,
+                                                                   DataRange output,
+                                                                   int level,
+                                                                   Context* context) {
+    // Without a context, make one just for this message
+    ZstdContext ownContext;
+    auto cctx = checked_cast<ZstdContext*>(context ? context : &ownContext)->compressionContext();
+    if (!cctx) {
+        return Status{ErrorCodes::ExceededMemoryLimit, "Could not allocate zstd context"};
+    }
+
+    auto dst = const_cast<char*>(output.data());
+    size_t ret;
+    if (_compressionDictionary && level == _level) {
+        ret = ZSTD_compress_usingCDict(
+            cctx, dst, output.length(), input.data(), input.length(), _compressionDictionary);
+    } else if (!_dictionary.empty()) {
+        // The digested dictionary only works at the level it was made for
+        ret = ZSTD_compress_usingDict(cctx,
+                                      dst,
+                                      output.length(),
+                                      input.data(),
+                                      input.length(),
+                                      _dictionary.data(),
+                                      _dictionary.size(),
+                                      level);
+    } else {
+        ret = ZSTD_compressCCtx(cctx, dst, output.length(), input.data(), input.length(), level);
+    }
+
+    if (ZSTD_isError(ret)) {
+        return Status{ErrorCodes::BadValue,
+                      str::stream() << "Could not compress input: " << ZSTD_getErrorName(ret)};
+    }
+    counterHitCompress(input.length(), ret);
+    return {ret};
+}
+
+StatusWith<std::size_t> ZstdMessageCompressor::decompressData(ConstDataRange input,
+                                                              DataRange output) {
+    return decompressDataWithContext(input, output, nullptr);
+}
+
+StatusWith<std::size_t> ZstdMessageCompressor::decompressDataWithContext(ConstDataRange input,
+                                                                         DataRange output,
+                                                                         Context* context) {
+    ZstdContext ownContext;
+    auto dctx =
+        checked_cast<ZstdContext*>(context ? context : &ownContext)->decompressionContext();
+    if (!dctx) {
+        return Status{ErrorCodes::ExceededMemoryLimit, "Could not allocate zstd context"};
+    }
+
+    auto dst = const_cast<char*>(output.data());
+    size_t ret;
+    if (_decompressionDictionary) {
+        ret = ZSTD_decompress_usingDDict(
+            dctx, dst, output.length(), input.data(), input.length(), _decompressionDictionary);
+    } else {
+        ret = ZSTD_decompressDCtx(dctx, dst, output.length(), input.data(), input.length());
+    }
+
+    if (ZSTD_isError(ret)) {
+        return Status{ErrorCodes::BadValue, "Compressed message was invalid or corrupted"};
+    }
+
+    counterHitDecompress(input.length(), ret);
+    return {ret};
+}
+
+MONGO_INITIALIZER_GENERAL(ZstdMessageCompressorInit,
+                          ("EndStartupOptionHandling"),
+                          ("AllCompressorsRegistered"))
+(InitializerContext* context) {
+    auto& compressorRegistry = MessageCompressorRegistry::get();
+    const auto& options = compressorRegistry.getCompressorOptions();
+
+    std::string dictionary;
+    if (!options.zstdDictionaryPath.empty()) {
+        std::ifstream file(options.zstdDictionaryPath, std::ios::binary);
+        dictionary.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        if (!file || dictionary.empty()) {
+            return {ErrorCodes::BadValue,
+                    str::stream() << "Could not read zstd dictionary from "
+                                  << options.zstdDictionaryPath};
+        }
+    }
+
+    compressorRegistry.registerImplementation(
+        stdx::make_unique<ZstdMessageCompressor>(options.zstdLevel, std::move(dictionary)));
+    return Status::OK();
+}
+}  // namespace mongo
@@ -0,0 +1,75 @@
+/**
+ *    Copyright (C) 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <string>
+
+#include "mongo/transport/message_compressor_base.h"
+
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+
+namespace mongo {
+/*
+ * Compresses with zstd, optionally with a dictionary trained on typical messages. A dictionary
+ * mostly helps small messages, which don't have enough data of their own to find repetition in.
+ */
+class ZstdMessageCompressor final : public MessageCompressorBase {
+public:
+    static constexpr int kDefaultLevel = 3;
+
+    explicit ZstdMessageCompressor(int level = kDefaultLevel, std::string dictionary = {});
+    ~ZstdMessageCompressor();
+
+    std::size_t getMaxCompressedSize(size_t inputSize) override;
+
+    std::unique_ptr<Context> makeContext() override;
+
+    StatusWith<std::size_t> compressData(ConstDataRange input, DataRange output) override;
+
+    StatusWith<std::size_t> decompressData(ConstDataRange input, DataRange output) override;
+
+    bool hasLevels() const override {
+        return true;
+    }
+
+    int getDefaultLevel() const override {
+        return _level;
+    }
+
+    int clampLevel(int level) const override;
+
+    StatusWith<std::size_t> compressDataAtLevel(ConstDataRange input,
+                                                DataRange output,
+                                                int level,
+                                                Context* context) override;
+
+    StatusWith<std::size_t> decompressDataWithContext(ConstDataRange input,
+                                                      DataRange output,
+                                                      Context* context) override;
+
+private:
+    const int _level;
+    const std::string _dictionary;
+
+    // _dictionary digested for compressing at _level and for decompressing, or null if there's
+    // no dictionary
+    ZSTD_CDict_s* _compressionDictionary = nullptr;
+    ZSTD_DDict_s* _decompressionDictionary = nullptr;
+};
+
+
+}  // namespace mongo
@@ -22,10 +22,14 @@
 
 #include <vector>
 
+#include "mongo/bson/json.h"
 #include "mongo/db/auth/restriction_environment.h"
+#include "mongo/db/server_parameters.h"
+#include "mongo/transport/admission_controller_token_bucket.h"
 #include "mongo/transport/service_state_machine.h"
 #include "mongo/transport/session.h"
 #include "mongo/util/log.h"
+#include "mongo/util/mongoutils/str.h"
 #include "mongo/util/processinfo.h"
 #include "mongo/util/scopeguard.h"
 
@@ -34,6 +38,12 @@
 #endif
 
 namespace mongo {
+namespace {
+// A JSON array of the rules for limiting how quickly each client address may connect and run
+// operations. See AdmissionControllerTokenBucket::parseRules() for what a rule looks like.
+MONGO_EXPORT_STARTUP_SERVER_PARAMETER(admissionControlRules, std::string, "");
+}  // namespace
+
 ServiceEntryPointImpl::ServiceEntryPointImpl(ServiceContext* svcCtx) : _svcCtx(svcCtx) {
 
     const auto supportedMax = [] {
@@ -59,6 +69,17 @@ ServiceEntryPointImpl::ServiceEntryPointImpl(ServiceContext* svcCtx) : _svcCtx(s
     }
 
     _maxNumConnections = supportedMax;
+
+    if (!admissionControlRules.empty()) {
+        const auto obj = fromjson(str::stream() << "{rules: " << admissionControlRules << "}");
+        auto rules = uassertStatusOK(
+            transport::AdmissionControllerTokenBucket::parseRules(obj.firstElement()));
+        if (!rules.empty()) {
+            log() << "limiting clients by admission control rules " << admissionControlRules;
+            _admissionController = std::make_shared<transport::AdmissionControllerTokenBucket>(
+                svcCtx->getPreciseClockSource(), std::move(rules));
+        }
+    }
 }
 
 void ServiceEntryPointImpl::startSession(transport::SessionHandle session) {
@@ -73,45 +94,73 @@ void ServiceEntryPointImpl::startSession(transport::SessionHandle session) {
     SSMListIterator ssmIt;
 
     const bool quiet = serverGlobalParams.quiet.load();
-    size_t connectionCount;
-    auto transportMode = _svcCtx->getServiceExecutor()->transportMode();
 
-    auto ssm = ServiceStateMachine::create(_svcCtx, session, transportMode);
-    {
-        stdx::lock_guard<decltype(_sessionsMutex)> lk(_sessionsMutex);
-        connectionCount = _sessions.size() + 1;
-        if (connectionCount <= _maxNumConnections) {
-            ssmIt = _sessions.emplace(_sessions.begin(), ssm);
-            _currentConnections.store(connectionCount);
-            _createdConnections.addAndFetch(1);
+    // Turn away clients over their admission limits before spending anything on them
+    if (_admissionController) {
+        auto status = _admissionController->admitSession(session);
+        if (!status.isOK()) {
+            if (!quiet) {
+                log() << "connection refused from " << session->remote() << ": " << status;
+            }
+            return;
         }
     }
+    auto admissionGuard = MakeGuard([&] {
+        if (_admissionController) {
+            _admissionController->endSession(session);
+        }
+    });
+
+    auto transportMode = _svcCtx->getServiceExecutor()->transportMode();
+
+    auto ssm = ServiceStateMachine::create(_svcCtx, session, transportMode);
+    auto& shard = _shardFor(*session);
 
-    // Checking if we successfully added a connection above. Separated from the lock so we don't log
-    // while holding it.
+    // There's no lock over all the shards, so the slot is reserved before checking the total.
+    // Sessions started concurrently may then both see each other and both be refused, but never
+    // both see room for one more and go over the limit.
+    shard.numSessions.addAndFetch(1);
+    const auto connectionCount = numOpenSessions();
     if (connectionCount > _maxNumConnections) {
+        shard.numSessions.subtractAndFetch(1);
         if (!quiet) {
             log() << "connection refused because too many open connections: " << connectionCount;
         }
         return;
     }
 
+    {
+        stdx::lock_guard<stdx::mutex> lk(shard.mutex);
+        ssmIt = shard.sessions.emplace(shard.sessions.begin(), ssm);
+    }
+    _createdConnections.addAndFetch(1);
+    admissionGuard.Dismiss();
+
     if (!quiet) {
         const auto word = (connectionCount == 1 ? " connection"_sd : " connections"_sd);
         log() << "connection accepted from " << session->remote() << " #" << session->id() << " ("
               << connectionCount << word << " now open)";
     }
 
-    ssm->setCleanupHook([ this, ssmIt, session = std::move(session) ] {
-        size_t connectionCount;
+    ssm->setAdmissionController(_admissionController);
+    ssm->setCleanupHook([ this, &shard, ssmIt, session = std::move(session) ] {
         auto remote = session->remote();
+        if (_admissionController) {
+            _admissionController->endSession(session);
+        }
         {
-            stdx::lock_guard<decltype(_sessionsMutex)> lk(_sessionsMutex);
-            _sessions.erase(ssmIt);
-            connectionCount = _sessions.size();
-            _currentConnections.store(connectionCount);
+            stdx::lock_guard<stdx::mutex> lk(shard.mutex);
+            shard.sessions.erase(ssmIt);
+            shard.numSessions.subtractAndFetch(1);
+        }
+
+        // Every session decrements its shard's count before checking the total, so whichever
+        // session ends last is sure to see zero and wake up shutdown().
+        const auto connectionCount = numOpenSessions();
+        if (connectionCount == 0) {
+            stdx::lock_guard<stdx::mutex> lk(_shutdownMutex);
+            _shutdownCondition.notify_one();
         }
-        _shutdownCondition.notify_one();
         const auto word = (connectionCount == 1 ? " connection"_sd : " connections"_sd);
         log() << "end connection " << remote << " (" << connectionCount << word << " now open)";
 
@@ -125,11 +174,11 @@ void ServiceEntryPointImpl::startSession(transport::SessionHandle session) {
 }
 
 void ServiceEntryPointImpl::endAllSessions(transport::Session::TagMask tags) {
-    // While holding the _sesionsMutex, loop over all the current connections, and if their tags
-    // do not match the requested tags to skip, terminate the session.
-    {
-        stdx::unique_lock<decltype(_sessionsMutex)> lk(_sessionsMutex);
-        for (auto& ssm : _sessions) {
+    // While holding each shard's mutex, loop over its connections, and if their tags do not match
+    // the requested tags to skip, terminate the session.
+    for (auto& shard : _sessionShards) {
+        stdx::lock_guard<stdx::mutex> lk(shard.mutex);
+        for (auto& ssm : shard.sessions) {
             ssm->terminateIfTagsDontMatch(tags);
         }
     }
@@ -138,14 +187,17 @@ void ServiceEntryPointImpl::endAllSessions(transport::Session::TagMask tags) {
 bool ServiceEntryPointImpl::shutdown(Milliseconds timeout) {
     using logger::LogComponent;
 
-    stdx::unique_lock<decltype(_sessionsMutex)> lk(_sessionsMutex);
-
-    // Request that all sessions end, while holding the _sesionsMutex, loop over all the current
-    // connections and terminate them
-    for (auto& ssm : _sessions) {
-        ssm->terminate();
+    // Request that all sessions end, while holding each shard's mutex, loop over its connections
+    // and terminate them
+    for (auto& shard : _sessionShards) {
+        stdx::lock_guard<stdx::mutex> lk(shard.mutex);
+        for (auto& ssm : shard.sessions) {
+            ssm->terminate();
+        }
     }
 
+    stdx::unique_lock<stdx::mutex> lk(_shutdownMutex);
+
     // Close all sockets and then wait for the number of active connections to reach zero with a
     // condition_variable that notifies in the session cleanup hook. If we haven't closed drained
     // all active operations within the deadline, just keep going with shutdown: the OS will do it
@@ -171,14 +223,24 @@ bool ServiceEntryPointImpl::shutdown(Milliseconds timeout) {
     return result;
 }
 
+size_t ServiceEntryPointImpl::numOpenSessions() const {
+    size_t sessionCount = 0;
+    for (const auto& shard : _sessionShards) {
+        sessionCount += shard.numSessions.load();
+    }
+    return sessionCount;
+}
+
 ServiceEntryPoint::Stats ServiceEntryPointImpl::sessionStats() const {
 
-    size_t sessionCount = _currentConnections.load();
+    size_t sessionCount = numOpenSessions();
 
     ServiceEntryPoint::Stats ret;
     ret.numOpenSessions = sessionCount;
     ret.numCreatedSessions = _createdConnections.load();
-    ret.numAvailableSessions = _maxNumConnections - sessionCount;
+    // The limit can be overshot slightly; see startSession()
+    ret.numAvailableSessions =
+        sessionCount < _maxNumConnections ? _maxNumConnections - sessionCount : 0;
     return ret;
 }
 
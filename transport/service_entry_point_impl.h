@@ -16,14 +16,17 @@
 
 #pragma once
 
+#include <array>
 
 #include "mongo/base/disallow_copying.h"
 #include "mongo/platform/atomic_word.h"
 #include "mongo/stdx/condition_variable.h"
 #include "mongo/stdx/list.h"
 #include "mongo/stdx/mutex.h"
+#include "mongo/transport/admission_controller.h"
 #include "mongo/transport/service_entry_point.h"
 #include "mongo/transport/service_state_machine.h"
+#include "mongo/util/with_alignment.h"
 
 namespace mongo {
 class ServiceContext;
@@ -53,23 +56,39 @@ public:
 
     Stats sessionStats() const final;
 
-    size_t numOpenSessions() const final {
-        return _currentConnections.load();
-    }
+    size_t numOpenSessions() const final;
 
 private:
     using SSMList = stdx::list<std::shared_ptr<ServiceStateMachine>>;
     using SSMListIterator = SSMList::iterator;
 
+    // Sessions are spread across shards by id, so that connects and disconnects on different
+    // sessions rarely contend on the same mutex or counter.
+    struct SessionShard {
+        stdx::mutex mutex;
+        SSMList sessions;
+        AtomicWord<size_t> numSessions{0};
+    };
+    static constexpr size_t kNumSessionShards = 32;
+
+    SessionShard& _shardFor(const transport::Session& session) {
+        return _sessionShards[session.id() % kNumSessionShards];
+    }
+
     ServiceContext* const _svcCtx;
     AtomicWord<std::size_t> _nWorkers;
 
-    mutable stdx::mutex _sessionsMutex;
+    std::array<CacheAligned<SessionShard>, kNumSessionShards> _sessionShards;
+
+    // Only used to wait for the last session to end in shutdown()
+    stdx::mutex _shutdownMutex;
     stdx::condition_variable _shutdownCondition;
-    SSMList _sessions;
+
+    // Decides whether new sessions are started, and how quickly their operations run. Only set if
+    // the admissionControlRules parameter has any rules.
+    std::shared_ptr<transport::AdmissionController> _admissionController;
 
     size_t _maxNumConnections{DEFAULT_MAX_CONN};
-    AtomicWord<size_t> _currentConnections{0};
     AtomicWord<size_t> _createdConnections{0};
 };
 
@@ -20,6 +20,7 @@
 
 #include "mongo/transport/service_executor_adaptive.h"
 
+#include <algorithm>
 #include <array>
 #include <random>
 
@@ -81,6 +82,11 @@ constexpr auto kStuckDetection = "stuckThreadsDetected"_sd;
 constexpr auto kStarvation = "starvation"_sd;
 constexpr auto kReserveMinimum = "belowReserveMinimum"_sd;
 constexpr auto kThreadReasons = "threadCreationCauses"_sd;
+constexpr auto kReactors = "reactors"_sd;
+constexpr auto kThreads = "threads"_sd;
+constexpr auto kTasksQueued = "tasksQueued"_sd;
+constexpr auto kQueueLatencyUs = "queueLatencyMicros"_sd;
+constexpr auto kExecutionLatencyUs = "executionLatencyMicros"_sd;
 
 int64_t ticksToMicros(TickSource::Tick ticks, TickSource* tickSource) {
     invariant(tickSource->getTicksPerSecond() >= 1000000);
@@ -88,6 +94,20 @@ int64_t ticksToMicros(TickSource::Tick ticks, TickSource* tickSource) {
     return ticks / ticksPerMicro;
 }
 
+void appendPercentiles(BSONObjBuilder* bob,
+                       StringData name,
+                       const LogLinearHistogram& histogram,
+                       TickSource* tickSource) {
+    auto micros = [&](double pct) {
+        return ticksToMicros(static_cast<TickSource::Tick>(histogram.percentile(pct)), tickSource);
+    };
+
+    BSONObjBuilder section(bob->subobjStart(name));
+    section << "p50" << micros(50) << "p90" << micros(90) << "p99" << micros(99) << "p999"
+            << micros(99.9);
+    section.doneFast();
+}
+
 struct ServerParameterOptions : public ServiceExecutorAdaptive::Options {
     int reservedThreads() const final {
         int value = adaptiveServiceExecutorReservedThreads.load();
@@ -147,10 +167,25 @@ ServiceExecutorAdaptive::ServiceExecutorAdaptive(ServiceContext* ctx, ReactorHan
 ServiceExecutorAdaptive::ServiceExecutorAdaptive(ServiceContext* ctx,
                                                  ReactorHandle reactor,
                                                  std::unique_ptr<Options> config)
-    : _reactorHandle(reactor),
-      _config(std::move(config)),
+    : ServiceExecutorAdaptive(
+          ctx, std::vector<ReactorHandle>{std::move(reactor)}, std::move(config)) {}
+
+ServiceExecutorAdaptive::ServiceExecutorAdaptive(ServiceContext* ctx,
+                                                 std::vector<ReactorHandle> reactors)
+    : ServiceExecutorAdaptive(
+          ctx, std::move(reactors), stdx::make_unique<ServerParameterOptions>()) {}
+
+ServiceExecutorAdaptive::ServiceExecutorAdaptive(ServiceContext* ctx,
+                                                 std::vector<ReactorHandle> reactors,
+                                                 std::unique_ptr<Options> config)
+    : _config(std::move(config)),
       _tickSource(ctx->getTickSource()),
-      _lastScheduleTimer(_tickSource) {}
+      _lastScheduleTimer(_tickSource) {
+    invariant(!reactors.empty());
+    for (auto& reactor : reactors) {
+        _reactors.push_back(stdx::make_unique<ReactorState>(std::move(reactor)));
+    }
+}
 
 ServiceExecutorAdaptive::~ServiceExecutorAdaptive() {
     invariant(!_isRunning.load());
@@ -160,7 +195,7 @@ Status ServiceExecutorAdaptive::start() {
     invariant(!_isRunning.load());
     _isRunning.store(true);
     _controllerThread = stdx::thread(&ServiceExecutorAdaptive::_controllerThreadRoutine, this);
-    for (auto i = 0; i < _config->reservedThreads(); i++) {
+    for (auto i = 0; i < _reservedThreads(); i++) {
         _startWorkerThread(ThreadCreationReason::kReserveMinimum);
     }
 
@@ -177,7 +212,9 @@ Status ServiceExecutorAdaptive::shutdown(Milliseconds timeout) {
     _controllerThread.join();
 
     stdx::unique_lock<stdx::mutex> lk(_threadsMutex);
-    _reactorHandle->stop();
+    for (auto& reactor : _reactors) {
+        reactor->handle->stop();
+    }
     bool result =
         _deathCondition.wait_for(lk, timeout.toSystemDuration(), [&] { return _threads.empty(); });
 
@@ -198,33 +235,45 @@ Status ServiceExecutorAdaptive::schedule(ServiceExecutorAdaptive::Task task,
         return {ErrorCodes::ShutdownInProgress, "Executor is not running"};
     }
 
-    auto wrappedTask =
-        [ this, task = std::move(task), scheduleTime, pendingCounterPtr, taskName, flags ] {
+    // Keep work scheduled by a worker on that worker's reactor, which is where the session it's
+    // working for has its socket.
+    auto reactor = _localThreadState ? _localThreadState->reactor : _nextReactor();
+    reactor->tasksQueued.addAndFetch(1);
+
+    auto wrappedTask = [
+        this, task = std::move(task), scheduleTime, pendingCounterPtr, taskName, flags, reactor
+    ] {
         pendingCounterPtr->subtractAndFetch(1);
         auto start = _tickSource->getTicks();
         _totalSpentQueued.addAndFetch(start - scheduleTime);
 
-        _localThreadState->threadMetrics[static_cast<size_t>(taskName)]
-            ._totalSpentQueued.addAndFetch(start - scheduleTime);
+        reactor->tasksQueued.subtractAndFetch(1);
+        reactor->totalSpentQueued.addAndFetch(start - scheduleTime);
+
+        auto& taskMetrics = _localThreadState->threadMetrics[static_cast<size_t>(taskName)];
+        taskMetrics._totalSpentQueued.addAndFetch(start - scheduleTime);
+        taskMetrics._queuedTicks.record(start - scheduleTime);
 
         if (_localThreadState->recursionDepth++ == 0) {
             _localThreadState->executing.markRunning();
             _threadsInUse.addAndFetch(1);
         }
-        const auto guard = MakeGuard([this, taskName] {
+        const auto guard = MakeGuard([this, taskName, reactor] {
             if (--_localThreadState->recursionDepth == 0) {
                 _localThreadState->executingCurRun += _localThreadState->executing.markStopped();
                 _threadsInUse.subtractAndFetch(1);
             }
             _totalExecuted.addAndFetch(1);
+            reactor->totalExecuted.addAndFetch(1);
             _localThreadState->threadMetrics[static_cast<size_t>(taskName)]
                 ._totalExecuted.addAndFetch(1);
         });
 
         TickTimer _localTimer(_tickSource);
         task();
-        _localThreadState->threadMetrics[static_cast<size_t>(taskName)]
-            ._totalSpentExecuting.addAndFetch(_localTimer.sinceStartTicks());
+        const auto spentExecuting = _localTimer.sinceStartTicks();
+        taskMetrics._totalSpentExecuting.addAndFetch(spentExecuting);
+        taskMetrics._executingTicks.record(spentExecuting);
 
         if ((flags & ServiceExecutor::kMayYieldBeforeSchedule) &&
             (_localThreadState->markIdleCounter++ & 0xf)) {
@@ -241,9 +290,9 @@ Status ServiceExecutorAdaptive::schedule(ServiceExecutorAdaptive::Task task,
     // can be called immediately and recursively.
     if ((flags & kMayRecurse) &&
         (_localThreadState->recursionDepth + 1 < _config->recursionLimit())) {
-        _reactorHandle->schedule(Reactor::kDispatch, std::move(wrappedTask));
+        reactor->handle->schedule(Reactor::kDispatch, std::move(wrappedTask));
     } else {
-        _reactorHandle->schedule(Reactor::kPost, std::move(wrappedTask));
+        reactor->handle->schedule(Reactor::kPost, std::move(wrappedTask));
     }
 
     _lastScheduleTimer.reset();
@@ -279,6 +328,35 @@ bool ServiceExecutorAdaptive::_isStarved() const {
     return (tasksQueued > available);
 }
 
+int ServiceExecutorAdaptive::_reservedThreads() const {
+    return std::max(_config->reservedThreads(), static_cast<int>(_reactors.size()));
+}
+
+ServiceExecutorAdaptive::ReactorState* ServiceExecutorAdaptive::_nextReactor() {
+    return _reactors[_nextReactorIndex.fetchAndAdd(1) % _reactors.size()].get();
+}
+
+ServiceExecutorAdaptive::ReactorState* ServiceExecutorAdaptive::_pickReactorForNewThread(
+    ThreadCreationReason reason) const {
+    // Reserved threads are spread evenly. Threads started because the pool is stuck or starved go
+    // where the most tasks are waiting, falling back to the reactor with the fewest threads.
+    const bool byQueueDepth = reason != ThreadCreationReason::kReserveMinimum;
+
+    auto best = _reactors.front().get();
+    for (const auto& reactor : _reactors) {
+        const auto queued = reactor->tasksQueued.load();
+        const auto bestQueued = best->tasksQueued.load();
+        if (byQueueDepth && queued != bestQueued) {
+            if (queued > bestQueued) {
+                best = reactor.get();
+            }
+        } else if (reactor->threads.load() < best->threads.load()) {
+            best = reactor.get();
+        }
+    }
+    return best;
+}
+
 /*
  * The pool of worker threads can become unhealthy in several ways, and the controller thread
  * tries to keep the pool healthy by starting new threads when it is:
@@ -390,10 +468,10 @@ void ServiceExecutorAdaptive::_controllerThreadRoutine() {
         }
 
         auto threadsRunning = _threadsRunning.load();
-        if (threadsRunning < _config->reservedThreads()) {
-            log() << "Starting " << _config->reservedThreads() - threadsRunning
+        if (threadsRunning < _reservedThreads()) {
+            log() << "Starting " << _reservedThreads() - threadsRunning
                   << " to replenish reserved worker threads";
-            while (_threadsRunning.load() < _config->reservedThreads()) {
+            while (_threadsRunning.load() < _reservedThreads()) {
                 _startWorkerThread(ThreadCreationReason::kReserveMinimum);
             }
         }
@@ -448,7 +526,11 @@ void ServiceExecutorAdaptive::_controllerThreadRoutine() {
 
 void ServiceExecutorAdaptive::_startWorkerThread(ThreadCreationReason reason) {
     stdx::unique_lock<stdx::mutex> lk(_threadsMutex);
-    auto it = _threads.emplace(_threads.begin(), _tickSource);
+
+    auto reactor = _pickReactorForNewThread(reason);
+    reactor->threads.addAndFetch(1);
+
+    auto it = _threads.emplace(_threads.begin(), _tickSource, reactor);
     auto num = _threads.size();
 
     _threadsPending.addAndFetch(1);
@@ -466,6 +548,7 @@ void ServiceExecutorAdaptive::_startWorkerThread(ThreadCreationReason reason) {
         _threadsPending.subtractAndFetch(1);
         _threadsRunning.subtractAndFetch(1);
         _threadStartCounters[static_cast<size_t>(reason)] -= 1;
+        reactor->threads.subtractAndFetch(1);
         _threads.erase(it);
     }
 }
@@ -501,6 +584,8 @@ void ServiceExecutorAdaptive::_accumulateTaskMetrics(MetricsArray* outArray,
         output._totalSpentQueued.addAndFetch(it->_totalSpentQueued.load());
         output._totalExecuted.addAndFetch(it->_totalExecuted.load());
         output._totalQueued.addAndFetch(it->_totalQueued.load());
+        output._queuedTicks.add(it->_queuedTicks);
+        output._executingTicks.add(it->_executingTicks);
     }
 }
 
@@ -551,8 +636,10 @@ void ServiceExecutorAdaptive::_workerThreadRoutine(
 
     bool guardThreadsRunning = true;
     const auto guard = MakeGuard([this, &guardThreadsRunning, state] {
-        if (guardThreadsRunning)
+        if (guardThreadsRunning) {
             _threadsRunning.subtractAndFetch(1);
+            state->reactor->threads.subtractAndFetch(1);
+        }
         _pastThreadsSpentRunning.addAndFetch(state->running.totalTime());
         _pastThreadsSpentExecuting.addAndFetch(state->executing.totalTime());
 
@@ -578,7 +665,7 @@ void ServiceExecutorAdaptive::_workerThreadRoutine(
         // If we're still "pending" only try to run one task, that way the controller will
         // know that it's okay to start adding threads to avoid starvation again.
         state->running.markRunning();
-        _reactorHandle->runFor(runTime);
+        state->reactor->handle->runFor(runTime);
 
         auto spentRunning = state->running.markStopped();
 
@@ -612,7 +699,7 @@ void ServiceExecutorAdaptive::_workerThreadRoutine(
         do {
             runningThreads = _threadsRunning.load();
 
-            if (runningThreads <= _config->reservedThreads()) {
+            if (runningThreads <= _reservedThreads()) {
                 terminateThread = false;
                 break;  // keep thread
             }
@@ -624,6 +711,14 @@ void ServiceExecutorAdaptive::_workerThreadRoutine(
         } while (terminateThread &&
                  _threadsRunning.compareAndSwap(runningThreads, runningThreads - 1) !=
                      runningThreads);
+
+        // Never leave our reactor without a thread to run it. If another of its threads is
+        // exiting at the same time, whichever gets here second stays.
+        if (terminateThread && state->reactor->threads.subtractAndFetch(1) == 0) {
+            state->reactor->threads.addAndFetch(1);
+            _threadsRunning.addAndFetch(1);
+            terminateThread = false;
+        }
         if (terminateThread) {
             log() << "Thread was only executing tasks " << pctExecuting << "% over the last "
                   << runTime << ". Exiting thread.";
@@ -687,10 +782,23 @@ void ServiceExecutorAdaptive::appendStats(BSONObjBuilder* bob) const {
                    << ticksToMicros(it->_totalSpentExecuting.load(), _tickSource)
                    << kTotalTimeQueuedUs
                    << ticksToMicros(it->_totalSpentQueued.load(), _tickSource);
+        appendPercentiles(&subSection, kQueueLatencyUs, it->_queuedTicks, _tickSource);
+        appendPercentiles(&subSection, kExecutionLatencyUs, it->_executingTicks, _tickSource);
 
         subSection.doneFast();
     }
     metricsByTask.doneFast();
+
+    BSONArrayBuilder reactors(section.subarrayStart(kReactors));
+    for (const auto& reactor : _reactors) {
+        BSONObjBuilder subSection(reactors.subobjStart());
+        subSection << kThreads << reactor->threads.load() << kTasksQueued
+                   << reactor->tasksQueued.load() << kTotalExecuted
+                   << reactor->totalExecuted.load() << kTotalTimeQueuedUs
+                   << ticksToMicros(reactor->totalSpentQueued.load(), _tickSource);
+        subSection.doneFast();
+    }
+    reactors.doneFast();
     section.doneFast();
 }
 
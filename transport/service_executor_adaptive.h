@@ -17,6 +17,7 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <vector>
 
 #include "mongo/db/service_context.h"
@@ -27,6 +28,7 @@
 #include "mongo/transport/service_executor.h"
 #include "mongo/transport/service_executor_task_names.h"
 #include "mongo/transport/transport_layer.h"
+#include "mongo/util/log_linear_histogram.h"
 #include "mongo/util/tick_source.h"
 
 namespace mongo {
@@ -74,6 +76,16 @@ public:
                                      ReactorHandle reactor,
                                      std::unique_ptr<Options> config);
 
+    /**
+     * Runs tasks on several reactors, giving each its own worker threads. A task scheduled from a
+     * worker thread runs on that thread's reactor, so a session's work stays with the threads
+     * that handle its socket. There's always at least one thread per reactor.
+     */
+    explicit ServiceExecutorAdaptive(ServiceContext* ctx, std::vector<ReactorHandle> reactors);
+    explicit ServiceExecutorAdaptive(ServiceContext* ctx,
+                                     std::vector<ReactorHandle> reactors,
+                                     std::unique_ptr<Options> config);
+
     ServiceExecutorAdaptive(ServiceExecutorAdaptive&&) = default;
     ServiceExecutorAdaptive& operator=(ServiceExecutorAdaptive&&) = default;
     virtual ~ServiceExecutorAdaptive();
@@ -120,38 +132,77 @@ private:
         AtomicWord<TickSource::Tick> _start;
     };
 
+    /**
+     * Accumulates the ticks spent between calls to markRunning() and markStopped().
+     *
+     * Only the thread which owns the timer may mark it running or stopped, and it never waits to
+     * do so. Other threads read the total through a seqlock: the owner bumps _sequence to an odd
+     * number while it updates the timer, and readers retry until they've read the timer between
+     * two matching even sequence numbers.
+     */
     class CumulativeTickTimer {
     public:
-        CumulativeTickTimer(TickSource* ts) : _timer(ts) {}
+        CumulativeTickTimer(TickSource* ts) : _tickSource(ts) {}
 
         TickSource::Tick markStopped() {
-            stdx::lock_guard<stdx::mutex> lk(_mutex);
-            invariant(_running);
-            _running = false;
-            auto curTime = _timer.sinceStartTicks();
-            _accumulator += curTime;
+            invariant(_running.load(std::memory_order_relaxed));
+
+            _beginWrite();
+            auto curTime = _tickSource->getTicks() - _start.load(std::memory_order_relaxed);
+            _accumulator.store(_accumulator.load(std::memory_order_relaxed) + curTime,
+                               std::memory_order_relaxed);
+            _running.store(false, std::memory_order_relaxed);
+            _endWrite();
             return curTime;
         }
 
         void markRunning() {
-            stdx::lock_guard<stdx::mutex> lk(_mutex);
-            invariant(!_running);
-            _timer.reset();
-            _running = true;
+            invariant(!_running.load(std::memory_order_relaxed));
+
+            _beginWrite();
+            _start.store(_tickSource->getTicks(), std::memory_order_relaxed);
+            _running.store(true, std::memory_order_relaxed);
+            _endWrite();
         }
 
         TickSource::Tick totalTime() const {
-            stdx::lock_guard<stdx::mutex> lk(_mutex);
-            if (!_running)
-                return _accumulator;
-            return _timer.sinceStartTicks() + _accumulator;
+            TickSource::Tick now, start, accumulator;
+            bool running;
+            uint64_t sequence;
+            do {
+                sequence = _sequence.load(std::memory_order_acquire);
+                start = _start.load(std::memory_order_relaxed);
+                accumulator = _accumulator.load(std::memory_order_relaxed);
+                running = _running.load(std::memory_order_relaxed);
+
+                // Read the clock before validating, so the timer can't have been stopped earlier
+                // than "now" without us noticing and overcounting
+                now = running ? _tickSource->getTicks() : 0;
+                std::atomic_thread_fence(std::memory_order_acquire);  // NOLINT
+            } while ((sequence & 1) || sequence != _sequence.load(std::memory_order_relaxed));
+
+            if (!running)
+                return accumulator;
+            return now - start + accumulator;
         }
 
     private:
-        TickTimer _timer;
-        mutable stdx::mutex _mutex;
-        TickSource::Tick _accumulator = 0;
-        bool _running = false;
+        void _beginWrite() {
+            _sequence.store(_sequence.load(std::memory_order_relaxed) + 1,
+                            std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);  // NOLINT
+        }
+
+        void _endWrite() {
+            _sequence.store(_sequence.load(std::memory_order_relaxed) + 1,
+                            std::memory_order_release);
+        }
+
+        TickSource* const _tickSource;
+        std::atomic<uint64_t> _sequence{0};             // NOLINT
+        std::atomic<TickSource::Tick> _start{0};        // NOLINT
+        std::atomic<TickSource::Tick> _accumulator{0};  // NOLINT
+        std::atomic<bool> _running{false};              // NOLINT
     };
 
     struct Metrics {
@@ -159,6 +210,10 @@ private:
         AtomicWord<int64_t> _totalExecuted{0};
         AtomicWord<TickSource::Tick> _totalSpentQueued{0};
         AtomicWord<TickSource::Tick> _totalSpentExecuting{0};
+
+        // Distributions of the ticks each task spent queued and executing
+        LogLinearHistogram _queuedTicks;
+        LogLinearHistogram _executingTicks;
     };
 
     using MetricsArray =
@@ -167,8 +222,22 @@ private:
     enum class ThreadCreationReason { kStuckDetection, kStarvation, kReserveMinimum, kMax };
     enum class ThreadTimer { kRunning, kExecuting };
 
+    struct ReactorState {
+        explicit ReactorState(ReactorHandle h) : handle(std::move(h)) {}
+
+        const ReactorHandle handle;
+
+        // The number of worker threads running this reactor
+        AtomicWord<int> threads{0};
+
+        // These are only used for reporting in serverStatus.
+        AtomicWord<int> tasksQueued{0};
+        AtomicWord<int64_t> totalExecuted{0};
+        AtomicWord<TickSource::Tick> totalSpentQueued{0};
+    };
+
     struct ThreadState {
-        ThreadState(TickSource* ts) : running(ts), executing(ts) {}
+        ThreadState(TickSource* ts, ReactorState* r) : running(ts), executing(ts), reactor(r) {}
 
         CumulativeTickTimer running;
         TickSource::Tick executingCurRun;
@@ -176,6 +245,9 @@ private:
         MetricsArray threadMetrics;
         std::int64_t markIdleCounter = 0;
         int recursionDepth = 0;
+
+        // The reactor this thread runs, and posts the tasks it schedules to.
+        ReactorState* const reactor;
     };
 
     using ThreadList = stdx::list<ThreadState>;
@@ -187,13 +259,23 @@ private:
     bool _isStarved() const;
     Milliseconds _getThreadJitter() const;
 
+    // The configured reserved threads, but at least one per reactor
+    int _reservedThreads() const;
+
+    // Picks the reactor for a task scheduled from a thread that isn't one of our workers.
+    ReactorState* _nextReactor();
+
+    // Picks the reactor a new worker thread will run. Must be called with _threadsMutex held.
+    ReactorState* _pickReactorForNewThread(ThreadCreationReason reason) const;
+
     void _accumulateTaskMetrics(MetricsArray* outArray, const MetricsArray& inputArray) const;
     void _accumulateAllTaskMetrics(MetricsArray* outputMetricsArray,
                                    const stdx::unique_lock<stdx::mutex>& lk) const;
     TickSource::Tick _getThreadTimerTotal(ThreadTimer which,
                                           const stdx::unique_lock<stdx::mutex>& lk) const;
 
-    ReactorHandle _reactorHandle;
+    std::vector<std::unique_ptr<ReactorState>> _reactors;
+    AtomicWord<unsigned> _nextReactorIndex{0};
 
     std::unique_ptr<Options> _config;
 
@@ -23,10 +23,12 @@
 #include "mongo/db/service_context_noop.h"
 #include "mongo/transport/service_executor_adaptive.h"
 #include "mongo/transport/service_executor_synchronous.h"
+#include "mongo/transport/service_executor_thread_per_core.h"
 #include "mongo/transport/service_executor_task_names.h"
 #include "mongo/unittest/unittest.h"
 #include "mongo/util/log.h"
 #include "mongo/util/scopeguard.h"
+#include "mongo/util/time_support.h"
 
 #include <asio.hpp>
 
@@ -64,6 +66,20 @@ struct TestOptions : public ServiceExecutorAdaptive::Options {
     }
 };
 
+struct ThreadPerCoreTestOptions : public ServiceExecutorThreadPerCore::Options {
+    Milliseconds workerThreadRunTime() const final {
+        return Milliseconds{1000};
+    }
+
+    int stealThreshold() const final {
+        return 0;
+    }
+
+    int recursionLimit() const final {
+        return 0;
+    }
+};
+
 /* This implements the portions of the transport::Reactor based on ASIO, but leaves out
  * the methods not needed by ServiceExecutors.
  *
@@ -137,6 +153,31 @@ protected:
     std::shared_ptr<asio::io_context> asioIOCtx;
 };
 
+class ServiceExecutorAdaptiveMultiReactorFixture : public unittest::Test {
+protected:
+    void setUp() override {
+        auto scOwned = stdx::make_unique<ServiceContextNoop>();
+        setGlobalServiceContext(std::move(scOwned));
+
+        std::vector<ReactorHandle> reactors{std::make_shared<ASIOReactor>(),
+                                            std::make_shared<ASIOReactor>()};
+        executor = stdx::make_unique<ServiceExecutorAdaptive>(
+            getGlobalServiceContext(), std::move(reactors), stdx::make_unique<TestOptions>());
+    }
+
+    std::vector<BSONObj> reactorStats() {
+        BSONObjBuilder bob;
+        executor->appendStats(&bob);
+        std::vector<BSONObj> stats;
+        for (const auto& reactor : bob.obj()["serviceExecutorTaskStats"]["reactors"].Array()) {
+            stats.push_back(reactor.Obj().getOwned());
+        }
+        return stats;
+    }
+
+    std::unique_ptr<ServiceExecutorAdaptive> executor;
+};
+
 class ServiceExecutorSynchronousFixture : public unittest::Test {
 protected:
     void setUp() override {
@@ -149,6 +190,23 @@ protected:
     std::unique_ptr<ServiceExecutorSynchronous> executor;
 };
 
+class ServiceExecutorThreadPerCoreFixture : public unittest::Test {
+protected:
+    void setUp() override {
+        auto scOwned = stdx::make_unique<ServiceContextNoop>();
+        setGlobalServiceContext(std::move(scOwned));
+
+        std::vector<ReactorHandle> reactors{std::make_shared<ASIOReactor>(),
+                                            std::make_shared<ASIOReactor>()};
+        executor = stdx::make_unique<ServiceExecutorThreadPerCore>(
+            getGlobalServiceContext(),
+            std::move(reactors),
+            stdx::make_unique<ThreadPerCoreTestOptions>());
+    }
+
+    std::unique_ptr<ServiceExecutorThreadPerCore> executor;
+};
+
 void scheduleBasicTask(ServiceExecutor* exec, bool expectSuccess) {
     stdx::condition_variable cond;
     stdx::mutex mutex;
@@ -179,6 +237,69 @@ TEST_F(ServiceExecutorAdaptiveFixture, ScheduleFailsBeforeStartup) {
     scheduleBasicTask(executor.get(), false);
 }
 
+TEST_F(ServiceExecutorAdaptiveMultiReactorFixture, BasicTaskRuns) {
+    ASSERT_OK(executor->start());
+    auto guard = MakeGuard([this] { ASSERT_OK(executor->shutdown(Milliseconds{500})); });
+
+    scheduleBasicTask(executor.get(), true);
+}
+
+TEST_F(ServiceExecutorAdaptiveMultiReactorFixture, EveryReactorGetsAThread) {
+    ASSERT_OK(executor->start());
+    auto guard = MakeGuard([this] { ASSERT_OK(executor->shutdown(Milliseconds{500})); });
+
+    // There's only one reserved thread, but each reactor needs one of its own
+    auto stats = reactorStats();
+    ASSERT_EQ(stats.size(), 2U);
+    for (const auto& reactor : stats) {
+        ASSERT_GTE(reactor["threads"].numberLong(), 1);
+    }
+}
+
+TEST_F(ServiceExecutorAdaptiveMultiReactorFixture, TasksScheduledByWorkersStayOnTheirReactor) {
+    ASSERT_OK(executor->start());
+    auto guard = MakeGuard([this] { ASSERT_OK(executor->shutdown(Milliseconds{500})); });
+
+    constexpr int kSubTasks = 4;
+    stdx::mutex mutex;
+    stdx::condition_variable cond;
+    int subTasksRun = 0;
+
+    // Tasks scheduled from outside the executor take turns between reactors, starting with the
+    // first, and the tasks a worker schedules run on that worker's reactor.
+    auto task = [&] {
+        for (int i = 0; i < kSubTasks; ++i) {
+            ASSERT_OK(executor->schedule(
+                [&] {
+                    stdx::lock_guard<stdx::mutex> lk(mutex);
+                    if (++subTasksRun == kSubTasks) {
+                        cond.notify_all();
+                    }
+                },
+                ServiceExecutor::kEmptyFlags,
+                ServiceExecutorTaskName::kSSMProcessMessage));
+        }
+    };
+
+    ASSERT_OK(executor->schedule(
+        std::move(task), ServiceExecutor::kEmptyFlags, ServiceExecutorTaskName::kSSMStartSession));
+    {
+        stdx::unique_lock<stdx::mutex> lk(mutex);
+        ASSERT_TRUE(cond.wait_for(
+            lk, Seconds{10}.toSystemDuration(), [&] { return subTasksRun == kSubTasks; }));
+    }
+
+    // A task is only counted once it returns, which may be just after it signalled us
+    const auto deadline = Date_t::now() + Seconds{10};
+    auto stats = reactorStats();
+    while (stats[0]["totalExecuted"].numberLong() < kSubTasks + 1 && Date_t::now() < deadline) {
+        sleepmillis(10);
+        stats = reactorStats();
+    }
+    ASSERT_EQ(stats[0]["totalExecuted"].numberLong(), kSubTasks + 1);
+    ASSERT_EQ(stats[1]["totalExecuted"].numberLong(), 0);
+}
+
 TEST_F(ServiceExecutorSynchronousFixture, BasicTaskRuns) {
     ASSERT_OK(executor->start());
     auto guard = MakeGuard([this] { ASSERT_OK(executor->shutdown(Milliseconds{500})); });
@@ -190,6 +311,58 @@ TEST_F(ServiceExecutorSynchronousFixture, ScheduleFailsBeforeStartup) {
     scheduleBasicTask(executor.get(), false);
 }
 
+TEST_F(ServiceExecutorThreadPerCoreFixture, BasicTaskRuns) {
+    ASSERT_OK(executor->start());
+    auto guard = MakeGuard([this] { ASSERT_OK(executor->shutdown(Milliseconds{500})); });
+
+    scheduleBasicTask(executor.get(), true);
+}
+
+TEST_F(ServiceExecutorThreadPerCoreFixture, ScheduleFailsBeforeStartup) {
+    scheduleBasicTask(executor.get(), false);
+}
+
+TEST_F(ServiceExecutorThreadPerCoreFixture, IdleWorkerStealsFromBlockedWorker) {
+    ASSERT_OK(executor->start());
+    auto guard = MakeGuard([this] { ASSERT_OK(executor->shutdown(Milliseconds{500})); });
+
+    constexpr int kSubTasks = 4;
+    stdx::mutex mutex;
+    stdx::condition_variable cond;
+    int subTasksRun = 0;
+    bool allRan = false;
+
+    // The outer task blocks its worker until its sub-tasks have run, so they can only run if the
+    // other worker steals them.
+    auto task = [&] {
+        for (int i = 0; i < kSubTasks; ++i) {
+            ASSERT_OK(executor->schedule(
+                [&] {
+                    stdx::lock_guard<stdx::mutex> lk(mutex);
+                    if (++subTasksRun == kSubTasks) {
+                        cond.notify_all();
+                    }
+                },
+                ServiceExecutor::kEmptyFlags,
+                ServiceExecutorTaskName::kSSMProcessMessage));
+        }
+
+        stdx::unique_lock<stdx::mutex> lk(mutex);
+        allRan = cond.wait_for(lk, Seconds{10}.toSystemDuration(), [&] {
+            return subTasksRun == kSubTasks;
+        });
+        cond.notify_all();
+    };
+
+    stdx::unique_lock<stdx::mutex> lk(mutex);
+    ASSERT_OK(executor->schedule(
+        std::move(task), ServiceExecutor::kEmptyFlags, ServiceExecutorTaskName::kSSMStartSession));
+    ASSERT_TRUE(cond.wait_for(lk, Seconds{20}.toSystemDuration(), [&] { return allRan; }));
+
+    BSONObjBuilder bob;
+    executor->appendStats(&bob);
+    ASSERT_EQ(bob.obj()["serviceExecutorTaskStats"].Obj()["totalStolen"].numberLong(), kSubTasks);
+}
 
 }  // namespace
 }  // namespace mongo
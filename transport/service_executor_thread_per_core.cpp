@@ -0,0 +1,320 @@
+/**
+ *    Copyright (C) 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kExecutor;
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/transport/service_executor_thread_per_core.h"
+
+#include "mongo/db/server_parameters.h"
+#include "mongo/stdx/memory.h"
+#include "mongo/transport/service_entry_point_utils.h"
+#include "mongo/transport/thread_idle_callback.h"
+#include "mongo/util/concurrency/thread_name.h"
+#include "mongo/util/log.h"
+#include "mongo/util/mongoutils/str.h"
+#include "mongo/util/scopeguard.h"
+
+namespace mongo {
+namespace transport {
+namespace {
+
+// Each worker thread will allow ASIO to run for this many milliseconds before checking whether
+// the executor is shutting down
+MONGO_EXPORT_SERVER_PARAMETER(threadPerCoreServiceExecutorRunTimeMillis, int, 5000);
+
+// Idle workers steal from a worker once more than this many tasks are waiting on its queue
+MONGO_EXPORT_SERVER_PARAMETER(threadPerCoreServiceExecutorStealThreshold, int, 2);
+
+// Tasks scheduled with MayRecurse may be called recursively if the recursion depth is below this
+// value.
+MONGO_EXPORT_SERVER_PARAMETER(threadPerCoreServiceExecutorRecursionLimit, int, 8);
+
+constexpr auto kTotalQueued = "totalQueued"_sd;
+constexpr auto kTotalExecuted = "totalExecuted"_sd;
+constexpr auto kTotalStolen = "totalStolen"_sd;
+constexpr auto kTotalTimeQueuedUs = "totalTimeQueuedMicros"_sd;
+constexpr auto kThreadsInUse = "threadsInUse"_sd;
+constexpr auto kThreadsRunning = "threadsRunning"_sd;
+constexpr auto kTasksQueued = "tasksQueued"_sd;
+constexpr auto kWorkers = "workers"_sd;
+constexpr auto kExecutorLabel = "executor"_sd;
+constexpr auto kExecutorName = "threadPerCore"_sd;
+
+struct ServerParameterOptions : public ServiceExecutorThreadPerCore::Options {
+    Milliseconds workerThreadRunTime() const final {
+        return Milliseconds{threadPerCoreServiceExecutorRunTimeMillis.load()};
+    }
+
+    int stealThreshold() const final {
+        return threadPerCoreServiceExecutorStealThreshold.load();
+    }
+
+    int recursionLimit() const final {
+        return threadPerCoreServiceExecutorRecursionLimit.load();
+    }
+};
+
+}  // namespace
+
+thread_local ServiceExecutorThreadPerCore::Worker* ServiceExecutorThreadPerCore::_localWorker =
+    nullptr;
+
+ServiceExecutorThreadPerCore::ServiceExecutorThreadPerCore(ServiceContext* ctx,
+                                                           std::vector<ReactorHandle> reactors)
+    : ServiceExecutorThreadPerCore(
+          ctx, std::move(reactors), stdx::make_unique<ServerParameterOptions>()) {}
+
+ServiceExecutorThreadPerCore::ServiceExecutorThreadPerCore(ServiceContext* ctx,
+                                                           std::vector<ReactorHandle> reactors,
+                                                           std::unique_ptr<Options> config)
+    : _config(std::move(config)), _tickSource(ctx->getTickSource()) {
+    invariant(!reactors.empty());
+    for (auto& reactor : reactors) {
+        _workers.push_back(stdx::make_unique<Worker>(std::move(reactor)));
+    }
+}
+
+ServiceExecutorThreadPerCore::~ServiceExecutorThreadPerCore() {
+    invariant(!_isRunning.load());
+
+    // Free whatever was still queued when the workers stopped
+    for (auto& worker : _workers) {
+        while (auto task = worker->tasks.steal()) {
+            delete *task;
+        }
+    }
+}
+
+Status ServiceExecutorThreadPerCore::start() {
+    invariant(!_isRunning.load());
+    _isRunning.store(true);
+
+    for (size_t i = 0; i < _workers.size(); ++i) {
+        auto worker = _workers[i].get();
+        _threadsRunning.addAndFetch(1);
+        auto status = launchServiceWorkerThread([this, i, worker] {
+            _workerThreadRoutine(static_cast<int>(i), worker);
+        });
+
+        if (!status.isOK()) {
+            _threadsRunning.subtractAndFetch(1);
+            return status;
+        }
+    }
+
+    return Status::OK();
+}
+
+Status ServiceExecutorThreadPerCore::shutdown(Milliseconds timeout) {
+    if (!_isRunning.load())
+        return Status::OK();
+
+    _isRunning.store(false);
+
+    stdx::unique_lock<stdx::mutex> lk(_deathMutex);
+    for (auto& worker : _workers) {
+        worker->reactor->stop();
+    }
+    bool result = _deathCondition.wait_for(
+        lk, timeout.toSystemDuration(), [&] { return _threadsRunning.load() == 0; });
+
+    return result
+        ? Status::OK()
+        : Status(ErrorCodes::Error::ExceededTimeLimit,
+                 "thread-per-core executor couldn't shutdown all worker threads within time "
+                 "limit.");
+}
+
+Status ServiceExecutorThreadPerCore::schedule(Task task,
+                                              ScheduleFlags flags,
+                                              ServiceExecutorTaskName taskName) {
+    if (!_isRunning.load()) {
+        return {ErrorCodes::ShutdownInProgress, "Executor is not running"};
+    }
+
+    _totalQueued.addAndFetch(1);
+    QueuedTask queued{std::move(task), flags, _tickSource->getTicks()};
+
+    auto worker = _localWorker;
+    if (!worker) {
+        // Sessions are started from the listener thread. Once a session's first task is waiting
+        // on its socket, the rest of its work is scheduled by the worker running that socket's
+        // reactor.
+        worker = _nextWorker();
+        worker->reactor->schedule(Reactor::kPost,
+                                  [ this, worker, queued = std::move(queued) ]() mutable {
+                                      _runTask(worker, &queued);
+                                  });
+        return Status::OK();
+    }
+
+    // Run to completion: if the caller allows it, finish this session's work now rather than
+    // going back through the reactor.
+    if ((flags & kMayRecurse) && (worker->recursionDepth + 1 < _config->recursionLimit())) {
+        _runTask(worker, &queued);
+        return Status::OK();
+    }
+
+    // Each task on the queue gets its own turn on the reactor, so it runs in between network
+    // events rather than holding them up.
+    worker->tasks.push(new QueuedTask(std::move(queued)));
+    worker->reactor->schedule(Reactor::kPost, [this, worker] { _runQueuedTask(worker); });
+
+    if (worker->tasks.sizeHint() > _config->stealThreshold()) {
+        _requestSteal(worker);
+    }
+
+    return Status::OK();
+}
+
+void ServiceExecutorThreadPerCore::_runTask(Worker* worker, QueuedTask* task) {
+    const auto start = _tickSource->getTicks();
+    _totalSpentQueued.addAndFetch(start - task->scheduleTime);
+
+    if (worker->recursionDepth++ == 0) {
+        worker->busy.store(true);
+        _threadsInUse.addAndFetch(1);
+    }
+    const auto guard = MakeGuard([this, worker] {
+        if (--worker->recursionDepth == 0) {
+            worker->busy.store(false);
+            _threadsInUse.subtractAndFetch(1);
+        }
+        worker->totalExecuted.addAndFetch(1);
+    });
+
+    task->task();
+
+    if ((task->flags & kMayYieldBeforeSchedule) && (worker->markIdleCounter++ & 0xf) == 0) {
+        markThreadIdle();
+    }
+}
+
+void ServiceExecutorThreadPerCore::_runQueuedTask(Worker* worker) {
+    // There's one of these posted for every task pushed, so if a thief took a task, one of them
+    // finds nothing to do.
+    if (auto task = worker->tasks.steal()) {
+        std::unique_ptr<QueuedTask> owned(*task);
+        _runTask(worker, owned.get());
+    }
+}
+
+void ServiceExecutorThreadPerCore::_requestSteal(Worker* victim) {
+    const auto first = _nextWorkerIndex.fetchAndAdd(1);
+    for (size_t i = 0; i < _workers.size(); ++i) {
+        auto thief = _workers[(first + i) % _workers.size()].get();
+        if (thief == victim || thief->busy.load() || thief->tasks.sizeHint() > 0) {
+            continue;
+        }
+
+        if (thief->stealRequested.swap(true)) {
+            continue;
+        }
+
+        thief->reactor->schedule(Reactor::kPost,
+                                 [this, thief, victim] { _stealFrom(thief, victim); });
+        return;
+    }
+}
+
+void ServiceExecutorThreadPerCore::_stealFrom(Worker* thief, Worker* victim) {
+    if (auto task = victim->tasks.steal()) {
+        std::unique_ptr<QueuedTask> owned(*task);
+        thief->totalStolen.addAndFetch(1);
+        _runTask(thief, owned.get());
+    }
+
+    // Keep helping while the victim is behind and we have nothing of our own to do. Going back
+    // through our reactor between steals keeps our own sessions' network events moving.
+    const auto shouldContinue = [&] {
+        return _isRunning.load() && thief->tasks.sizeHint() == 0 &&
+            victim->tasks.sizeHint() > _config->stealThreshold();
+    };
+
+    if (!shouldContinue()) {
+        thief->stealRequested.store(false);
+
+        // The victim may have asked us for help again just before we said we were done, and seen
+        // that we were still busy with its last request.
+        if (!shouldContinue() || thief->stealRequested.swap(true)) {
+            return;
+        }
+    }
+
+    thief->reactor->schedule(Reactor::kPost, [this, thief, victim] { _stealFrom(thief, victim); });
+}
+
+ServiceExecutorThreadPerCore::Worker* ServiceExecutorThreadPerCore::_nextWorker() {
+    return _workers[_nextWorkerIndex.fetchAndAdd(1) % _workers.size()].get();
+}
+
+void ServiceExecutorThreadPerCore::_workerThreadRoutine(int threadId, Worker* worker) {
+    _localWorker = worker;
+    {
+        std::string threadName = str::stream() << "worker-" << threadId;
+        setThreadName(threadName);
+    }
+
+    log() << "Started new database worker thread " << threadId;
+
+    const auto guard = MakeGuard([this] {
+        stdx::lock_guard<stdx::mutex> lk(_deathMutex);
+        if (_threadsRunning.subtractAndFetch(1) == 0) {
+            _deathCondition.notify_one();
+        }
+    });
+
+    while (_isRunning.load()) {
+        worker->reactor->runFor(_config->workerThreadRunTime());
+    }
+}
+
+void ServiceExecutorThreadPerCore::appendStats(BSONObjBuilder* bob) const {
+    invariant(_tickSource->getTicksPerSecond() >= 1000000);
+    const auto ticksPerMicro = _tickSource->getTicksPerSecond() / 1000000;
+
+    int64_t totalExecuted = 0;
+    int64_t totalStolen = 0;
+    for (const auto& worker : _workers) {
+        totalExecuted += worker->totalExecuted.load();
+        totalStolen += worker->totalStolen.load();
+    }
+
+    BSONObjBuilder section(bob->subobjStart("serviceExecutorTaskStats"));
+    section << kExecutorLabel << kExecutorName                                 //
+            << kTotalQueued << _totalQueued.load()                             //
+            << kTotalExecuted << totalExecuted                                 //
+            << kTotalStolen << totalStolen                                     //
+            << kThreadsInUse << _threadsInUse.load()                           //
+            << kTotalTimeQueuedUs << _totalSpentQueued.load() / ticksPerMicro  //
+            << kThreadsRunning << _threadsRunning.load();
+
+    BSONArrayBuilder workers(section.subarrayStart(kWorkers));
+    for (const auto& worker : _workers) {
+        BSONObjBuilder workerSection(workers.subobjStart());
+        workerSection << kTasksQueued << worker->tasks.sizeHint()        //
+                      << kTotalExecuted << worker->totalExecuted.load()  //
+                      << kTotalStolen << worker->totalStolen.load();
+        workerSection.doneFast();
+    }
+    workers.doneFast();
+    section.doneFast();
+}
+
+}  // namespace transport
+}  // namespace mongo
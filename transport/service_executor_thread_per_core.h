@@ -0,0 +1,161 @@
+/**
+ *    Copyright (C) 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "mongo/db/service_context.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/stdx/condition_variable.h"
+#include "mongo/stdx/mutex.h"
+#include "mongo/transport/service_executor.h"
+#include "mongo/transport/service_executor_task_names.h"
+#include "mongo/transport/transport_layer.h"
+#include "mongo/util/concurrency/work_stealing_deque.h"
+#include "mongo/util/tick_source.h"
+
+namespace mongo {
+namespace transport {
+
+/**
+ * This is an ASIO-based ServiceExecutor which runs exactly one worker thread per reactor, and is
+ * meant to be given one reactor per core.
+ *
+ * Each worker owns the sessions whose sockets are on its reactor. Tasks a worker schedules go on
+ * its own queue and run to completion on that thread, in the order they were scheduled, between
+ * the reactor's network events. The number of threads never changes, so unlike the adaptive
+ * executor there's no controller thread and no starting and stopping of threads under load.
+ *
+ * When more than stealThreshold() tasks are waiting on a worker's queue, an idle worker is woken
+ * up to steal from it. Nothing else relieves a worker whose task blocks, so tasks run by this
+ * executor shouldn't block for long.
+ */
+class ServiceExecutorThreadPerCore final : public ServiceExecutor {
+public:
+    struct Options {
+        virtual ~Options() = default;
+
+        // The amount of time each worker thread runs its reactor before checking whether the
+        // executor is shutting down.
+        virtual Milliseconds workerThreadRunTime() const = 0;
+
+        // Idle workers steal from a worker once more than this many tasks are waiting on its
+        // queue.
+        virtual int stealThreshold() const = 0;
+
+        // The maximum allowable depth of recursion for tasks scheduled with the MayRecurse flag
+        // before stack unwinding is forced.
+        virtual int recursionLimit() const = 0;
+    };
+
+    explicit ServiceExecutorThreadPerCore(ServiceContext* ctx,
+                                          std::vector<ReactorHandle> reactors);
+    explicit ServiceExecutorThreadPerCore(ServiceContext* ctx,
+                                          std::vector<ReactorHandle> reactors,
+                                          std::unique_ptr<Options> config);
+    ~ServiceExecutorThreadPerCore();
+
+    Status start() final;
+    Status shutdown(Milliseconds timeout) final;
+    Status schedule(Task task, ScheduleFlags flags, ServiceExecutorTaskName taskName) final;
+
+    Mode transportMode() const final {
+        return Mode::kAsynchronous;
+    }
+
+    void appendStats(BSONObjBuilder* bob) const final;
+
+    int threadsRunning() {
+        return _threadsRunning.load();
+    }
+
+private:
+    struct QueuedTask {
+        Task task;
+        ScheduleFlags flags;
+        TickSource::Tick scheduleTime;
+    };
+
+    struct Worker {
+        explicit Worker(ReactorHandle r) : reactor(std::move(r)) {}
+
+        // The reactor this worker runs. Nothing else runs it, so everything posted to it runs on
+        // the worker's thread.
+        const ReactorHandle reactor;
+
+        // Tasks scheduled by this worker. Both the worker and thieves take tasks from the top, so
+        // they run in the order they were scheduled. Owned by whichever thread takes them out.
+        WorkStealingDeque<QueuedTask*> tasks;
+
+        // Whether the worker is in the middle of a task. Only idle workers are asked to steal.
+        AtomicWord<bool> busy{false};
+
+        // Whether the worker has been asked to steal and hasn't finished yet, so that it isn't
+        // asked again in the meantime.
+        AtomicWord<bool> stealRequested{false};
+
+        // These are only touched by the worker's thread.
+        int recursionDepth = 0;
+        int64_t markIdleCounter = 0;
+
+        // These are only used for reporting in serverStatus.
+        AtomicWord<int64_t> totalExecuted{0};
+        AtomicWord<int64_t> totalStolen{0};
+    };
+
+    void _workerThreadRoutine(int threadId, Worker* worker);
+
+    // Runs a task on the current thread, which must be worker's.
+    void _runTask(Worker* worker, QueuedTask* task);
+
+    // Takes the oldest task off worker's own queue and runs it, unless a thief got there first.
+    void _runQueuedTask(Worker* worker);
+
+    // Wakes up an idle worker to steal from victim, if there is one.
+    void _requestSteal(Worker* victim);
+
+    // Steals a task from victim and runs it on thief's thread, then goes back through thief's
+    // reactor to steal again if victim is still behind.
+    void _stealFrom(Worker* thief, Worker* victim);
+
+    // Picks the worker for a task scheduled from a thread that isn't one of our workers.
+    Worker* _nextWorker();
+
+    std::unique_ptr<Options> _config;
+    TickSource* const _tickSource;
+
+    std::vector<std::unique_ptr<Worker>> _workers;
+    AtomicWord<unsigned> _nextWorkerIndex{0};
+    static thread_local Worker* _localWorker;
+
+    AtomicWord<bool> _isRunning{false};
+    AtomicWord<int> _threadsRunning{0};
+    AtomicWord<int> _threadsInUse{0};
+
+    // Threads signal this condition variable when they exit so we can gracefully shutdown
+    // the executor.
+    stdx::mutex _deathMutex;
+    stdx::condition_variable _deathCondition;
+
+    // These counters are only used for reporting in serverStatus.
+    AtomicWord<int64_t> _totalQueued{0};
+    AtomicWord<TickSource::Tick> _totalSpentQueued{0};
+};
+
+}  // namespace transport
+}  // namespace mongo
@@ -37,8 +37,10 @@
 #include "mongo/util/debug_util.h"
 #include "mongo/util/exit.h"
 #include "mongo/util/log.h"
+#include "mongo/util/net/op_msg.h"
 #include "mongo/util/net/socket_exception.h"
 #include "mongo/util/quick_exit.h"
+#include "mongo/util/time_support.h"
 
 namespace mongo {
 namespace {
@@ -281,6 +283,11 @@ void ServiceStateMachine::_sourceCallback(Status status) {
     if (status.isOK()) {
         _state.store(State::Process);
 
+        // Hold back clients which are running more operations than they're allowed to
+        if (!_waitForAdmission(guard)) {
+            return;
+        }
+
         // Since we know that we're going to process a message, call scheduleNext() immediately
         // to schedule the call to processMessage() on the serviceExecutor (or just unwind the
         // stack)
@@ -369,6 +376,11 @@ void ServiceStateMachine::_processMessage(ThreadGuard guard) {
     // up in currentOp results after the response reaches the client
     opCtx.reset();
 
+    // If the session fails before getting here, ending it ends the operation too
+    if (_admissionController) {
+        _admissionController->endOperation(_session());
+    }
+
     // Format our response, if we have one
     Message& toSink = dbresponse.response;
     if (!toSink.empty()) {
@@ -376,6 +388,12 @@ void ServiceStateMachine::_processMessage(ThreadGuard guard) {
         toSink.header().setId(nextMessageId());
         toSink.header().setResponseToMsgId(_inMessage.header().getId());
 
+        // Clients that checksum their requests get checksummed replies. This has to come after
+        // the ids are set, since the checksum covers the header.
+        if (toSink.operation() == dbMsg && OpMsg::isFlagSet(_inMessage, OpMsg::kChecksumPresent)) {
+            OpMsg::appendChecksum(&toSink);
+        }
+
         // If this is an exhaust cursor, don't source more Messages
         if (dbresponse.exhaustNS.size() > 0 && setExhaustMessage(&_inMessage, dbresponse)) {
             _inExhaust = true;
@@ -402,6 +420,50 @@ void ServiceStateMachine::_processMessage(ThreadGuard guard) {
     }
 }
 
+bool ServiceStateMachine::_waitForAdmission(ThreadGuard& guard) {
+    if (!_admissionController) {
+        return true;
+    }
+
+    Milliseconds delay;
+    while ((delay = _admissionController->admitOperation(_session())) > Milliseconds{0}) {
+        if (_transportMode == transport::Mode::kAsynchronous) {
+            _delayProcessMessage(std::move(guard), delay);
+            return false;
+        }
+
+        // This thread serves only this session, so it can wait here
+        sleepFor(delay);
+    }
+    return true;
+}
+
+void ServiceStateMachine::_delayProcessMessage(ThreadGuard guard, Milliseconds delay) {
+    invariant(_transportMode == transport::Mode::kAsynchronous);
+    if (!_admissionTimer) {
+        // The timer's callback schedules the message to be processed, and executors keep work
+        // scheduled from a reactor's thread on that reactor, so use our session's own.
+        auto reactor = _session()->getReactor();
+        if (!reactor) {
+            reactor = _session()->getTransportLayer()->getReactor(TransportLayer::kIngress);
+        }
+        _admissionTimer = reactor->makeTimer();
+    }
+
+    guard.release();
+    _admissionTimer->waitFor(delay).getAsync([ssm = shared_from_this()](Status) {
+        // The timer can only be cancelled by destroying it, which can't happen while we hold a
+        // reference to the SSM, so there's nothing to do but go ahead.
+        ThreadGuard guard(ssm.get());
+        if (!ssm->_waitForAdmission(guard)) {
+            return;
+        }
+        ssm->_scheduleNextWithGuard(std::move(guard),
+                                    ServiceExecutor::kEmptyFlags,
+                                    transport::ServiceExecutorTaskName::kSSMProcessMessage);
+    });
+}
+
 void ServiceStateMachine::runNext() {
     return _runNextInGuard(ThreadGuard(this));
 }
@@ -510,6 +572,12 @@ void ServiceStateMachine::setCleanupHook(stdx::function<void()> hook) {
     _cleanupHook = std::move(hook);
 }
 
+void ServiceStateMachine::setAdmissionController(
+    std::shared_ptr<transport::AdmissionController> controller) {
+    invariant(state() == State::Created);
+    _admissionController = std::move(controller);
+}
+
 ServiceStateMachine::State ServiceStateMachine::state() {
     return _state.load();
 }
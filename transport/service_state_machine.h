@@ -26,11 +26,13 @@
 #include "mongo/stdx/memory.h"
 #include "mongo/stdx/mutex.h"
 #include "mongo/stdx/thread.h"
+#include "mongo/transport/admission_controller.h"
 #include "mongo/transport/message_compressor_base.h"
 #include "mongo/transport/service_entry_point.h"
 #include "mongo/transport/service_executor.h"
 #include "mongo/transport/service_executor_task_names.h"
 #include "mongo/transport/session.h"
+#include "mongo/transport/transport_layer.h"
 #include "mongo/transport/transport_mode.h"
 
 namespace mongo {
@@ -139,6 +141,12 @@ public:
      */
     void setCleanupHook(stdx::function<void()> hook);
 
+    /*
+     * Sets the AdmissionController that decides how long each operation waits before it runs.
+     * Must be called before start().
+     */
+    void setAdmissionController(std::shared_ptr<transport::AdmissionController> controller);
+
 private:
     /*
      * A class that wraps up lifetime management of the _dbClient and _threadName for runNext();
@@ -183,6 +191,20 @@ private:
      */
     inline void _processMessage(ThreadGuard guard);
 
+    /*
+     * Asks the AdmissionController, if there is one, whether the message just sourced may be
+     * processed now. Returns true if it may. Otherwise, in synchronous mode this sleeps until it
+     * may, and in asynchronous mode this gives up "guard" to _delayProcessMessage() and returns
+     * false.
+     */
+    bool _waitForAdmission(ThreadGuard& guard);
+
+    /*
+     * Waits for "delay" without holding up an executor thread, and then asks for admission again,
+     * scheduling processMessage() once it's granted. Only used in asynchronous mode.
+     */
+    void _delayProcessMessage(ThreadGuard guard, Milliseconds delay);
+
     /*
      * These get called by the TransportLayer when requested network I/O has completed.
      */
@@ -214,6 +236,9 @@ private:
     const Client* _dbClientPtr;
     stdx::function<void()> _cleanupHook;
 
+    std::shared_ptr<transport::AdmissionController> _admissionController;
+    std::unique_ptr<transport::ReactorTimer> _admissionTimer;
+
     bool _inExhaust = false;
     boost::optional<MessageCompressorId> _compressorId;
     Message _inMessage;
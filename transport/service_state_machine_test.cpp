@@ -26,6 +26,7 @@
 #include "mongo/db/service_context_noop.h"
 #include "mongo/rpc/op_msg.h"
 #include "mongo/stdx/memory.h"
+#include "mongo/transport/admission_controller.h"
 #include "mongo/transport/mock_session.h"
 #include "mongo/transport/service_entry_point.h"
 #include "mongo/transport/service_executor.h"
@@ -130,6 +131,10 @@ public:
             return out;
         }
 
+        ReactorHandle getReactor() const override {
+            return checked_cast<MockTL*>(getTransportLayer())->_sessionReactor;
+        }
+
         Status sinkMessage(Message message) override {
             auto tl = checked_cast<MockTL*>(getTransportLayer());
             ASSERT_EQ(tl->_ssm->state(), ServiceStateMachine::State::SinkWait);
@@ -183,6 +188,10 @@ public:
         _waitHook = std::move(hook);
     }
 
+    void setSessionReactor(ReactorHandle reactor) {
+        _sessionReactor = std::move(reactor);
+    }
+
 private:
     bool _lastTicketSource = true;
     bool _ranSink = false;
@@ -191,6 +200,117 @@ private:
     Message _lastSunk;
     ServiceStateMachine* _ssm;
     stdx::function<void()> _waitHook;
+    ReactorHandle _sessionReactor;
+};
+
+/* A reactor whose timers only fire when fireTimers() is called */
+class ManualReactor : public Reactor {
+public:
+    class Timer : public ReactorTimer {
+    public:
+        explicit Timer(ManualReactor* reactor) : _reactor(reactor) {}
+
+        void cancel(const BatonHandle& baton = nullptr) override {}
+
+        Future<void> waitFor(Milliseconds timeout, const BatonHandle& baton = nullptr) override {
+            return waitUntil(_reactor->now() + timeout, baton);
+        }
+
+        Future<void> waitUntil(Date_t timeout, const BatonHandle& baton = nullptr) override {
+            auto pf = makePromiseFuture<void>();
+            _reactor->_waiting.push_back(std::move(pf.promise));
+            return std::move(pf.future);
+        }
+
+    private:
+        ManualReactor* const _reactor;
+    };
+
+    void run() noexcept override {
+        MONGO_UNREACHABLE;
+    }
+
+    void runFor(Milliseconds time) noexcept override {
+        MONGO_UNREACHABLE;
+    }
+
+    void stop() override {}
+
+    void schedule(ScheduleMode mode, Task task) override {
+        MONGO_UNREACHABLE;
+    }
+
+    bool onReactorThread() const override {
+        return false;
+    }
+
+    std::unique_ptr<ReactorTimer> makeTimer() override {
+        ++_timersMade;
+        return stdx::make_unique<Timer>(this);
+    }
+
+    Date_t now() override {
+        return Date_t::now();
+    }
+
+    void fireTimers() {
+        auto waiting = std::move(_waiting);
+        for (auto& promise : waiting) {
+            promise.emplaceValue();
+        }
+    }
+
+    size_t timersMade() const {
+        return _timersMade;
+    }
+
+    size_t timersWaiting() const {
+        return _waiting.size();
+    }
+
+private:
+    size_t _timersMade = 0;
+    std::vector<Promise<void>> _waiting;
+};
+
+/* Holds back every operation once, for the same amount of time */
+class FixedDelayAdmissionController : public AdmissionController {
+public:
+    explicit FixedDelayAdmissionController(Milliseconds delay) : _delay(delay) {}
+
+    Status admitSession(const SessionHandle& session) override {
+        return Status::OK();
+    }
+
+    void endSession(const SessionHandle& session) override {}
+
+    Milliseconds admitOperation(const SessionHandle& session) override {
+        _admitCalls.addAndFetch(1);
+        if (!_delayed.swap(true)) {
+            return _delay;
+        }
+        _delayed.store(false);
+        _operationsRunning.addAndFetch(1);
+        return Milliseconds{0};
+    }
+
+    void endOperation(const SessionHandle& session) override {
+        _operationsRunning.subtractAndFetch(1);
+    }
+
+    int admitCalls() const {
+        return _admitCalls.load();
+    }
+
+    int operationsRunning() const {
+        return _operationsRunning.load();
+    }
+
+private:
+    const Milliseconds _delay;
+    AtomicWord<bool> _delayed{false};
+    AtomicWord<int> _admitCalls{0};
+    AtomicWord<int> _operationsRunning{0};
 };
 
 Message buildRequest(BSONObj input) {
@@ -354,6 +474,55 @@ TEST_F(ServiceStateMachineFixture, TestSinkError) {
     ASSERT_TRUE(_tl->ranSink());
 }
 
+TEST_F(ServiceStateMachineFixture, TestAdmissionDelaySynchronous) {
+    auto controller = std::make_shared<FixedDelayAdmissionController>(Milliseconds{10});
+    _ssm->setAdmissionController(controller);
+
+    // The session's own thread waits out the delay and asks again, then runs the operation
+    runPingTest(State::Process, State::Source);
+    checkPingOk();
+    ASSERT_EQ(controller->admitCalls(), 2);
+    ASSERT_EQ(controller->operationsRunning(), 0);
+}
+
+TEST_F(ServiceStateMachineFixture, TestAdmissionDelayWaitsOnSessionReactor) {
+    auto reactor = std::make_shared<ManualReactor>();
+    _tl->setSessionReactor(reactor);
+    _ssm = ServiceStateMachine::create(
+        getGlobalServiceContext(), _tl->createSession(), transport::Mode::kAsynchronous);
+    _tl->setSSM(_ssm.get());
+
+    auto controller = std::make_shared<FixedDelayAdmissionController>(Milliseconds{10});
+    _ssm->setAdmissionController(controller);
+
+    std::vector<ServiceExecutor::Task> scheduled;
+    _sexec->setScheduleHook([&scheduled](ServiceExecutor::Task task) {
+        scheduled.push_back(std::move(task));
+        return true;
+    });
+
+    // The operation waits on a timer from the session's own reactor, without holding a thread
+    _ssm->runNext();
+    ASSERT_EQ(_ssm->state(), State::Process);
+    ASSERT_EQ(controller->admitCalls(), 1);
+    ASSERT_EQ(reactor->timersMade(), 1U);
+    ASSERT_EQ(reactor->timersWaiting(), 1U);
+    ASSERT_TRUE(scheduled.empty());
+    ASSERT_FALSE(_sep->ranHandler());
+
+    // Once the timer fires, the operation asks again, and is scheduled and runs normally
+    reactor->fireTimers();
+    ASSERT_EQ(controller->admitCalls(), 2);
+    ASSERT_EQ(controller->operationsRunning(), 1);
+    ASSERT_EQ(scheduled.size(), 1U);
+    auto task = std::move(scheduled.front());
+    scheduled.clear();
+    task();
+    ASSERT_TRUE(_sep->ranHandler());
+    ASSERT_EQ(controller->operationsRunning(), 0);
+    checkPingOk();
+}
+
 // This test checks that after the SSM has been cleaned up, the SessionHandle that it passed
 // into the Client doesn't have any dangling shared_ptr copies.
 TEST_F(ServiceStateMachineFixture, TestSessionCleanupOnDestroy) {
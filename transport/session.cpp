@@ -18,6 +18,8 @@
 
 #include "mongo/transport/session.h"
 
+#include <cstring>
+
 #include "mongo/platform/atomic_word.h"
 #include "mongo/transport/transport_layer.h"
 #include "mongo/util/net/ssl_types.h"
@@ -29,6 +31,21 @@ namespace {
 
 AtomicUInt64 sessionIdCounter(0);
 
+Message flattenBuffers(const std::vector<ConstDataRange>& buffers) {
+    size_t size = 0;
+    for (const auto& buffer : buffers) {
+        size += buffer.length();
+    }
+
+    auto flattened = SharedBuffer::allocate(size);
+    auto ptr = flattened.get();
+    for (const auto& buffer : buffers) {
+        std::memcpy(ptr, buffer.data(), buffer.length());
+        ptr += buffer.length();
+    }
+    return Message(std::move(flattened));
+}
+
 }  // namespace
 
 Session::Session() : _id(sessionIdCounter.addAndFetch(1)), _tags(kPending) {}
@@ -56,5 +73,22 @@ Session::TagMask Session::getTags() const {
     return _tags.load();
 }
 
+ReactorHandle Session::getReactor() const {
+    return nullptr;
+}
+
+Status Session::sinkMessageBeforeSource(Message message) {
+    return sinkMessage(std::move(message));
+}
+
+Status Session::sinkBuffers(const std::vector<ConstDataRange>& buffers) {
+    return sinkMessage(flattenBuffers(buffers));
+}
+
+Future<void> Session::asyncSinkBuffers(std::vector<ConstDataRange> buffers,
+                                       const transport::BatonHandle& handle) {
+    return asyncSinkMessage(flattenBuffers(buffers), handle);
+}
+
 }  // namespace transport
 }  // namespace mongo
@@ -17,7 +17,9 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
+#include "mongo/base/data_range.h"
 #include "mongo/base/disallow_copying.h"
 #include "mongo/platform/atomic_word.h"
 #include "mongo/rpc/message.h"
@@ -34,6 +36,8 @@ class TransportLayer;
 class Session;
 class Baton;
 using BatonHandle = std::shared_ptr<Baton>;
+class Reactor;
+using ReactorHandle = std::shared_ptr<Reactor>;
 
 using SessionHandle = std::shared_ptr<Session>;
 using ConstSessionHandle = std::shared_ptr<const Session>;
@@ -73,6 +77,14 @@ public:
 
     virtual TransportLayer* getTransportLayer() const = 0;
 
+    /**
+     * Returns the reactor this Session's asynchronous operations complete on, if it has one of its
+     * own rather than sharing its TransportLayer's ingress reactor. Work done later on behalf of
+     * this Session, such as a timer, should be scheduled there so that it runs on the same threads
+     * as its I/O. The default implementation returns nullptr.
+     */
+    virtual ReactorHandle getReactor() const;
+
     /**
      * Ends this Session.
      *
@@ -104,6 +116,28 @@ public:
     virtual Future<void> asyncSinkMessage(Message message,
                                           const transport::BatonHandle& handle = nullptr) = 0;
 
+    /**
+     * Sink (send) a Message which the caller is about to follow with sourceMessage(), such as a
+     * reply to a request.
+     *
+     * Implementations may hold on to the Message and send it together with the next receive, in
+     * which case an error sending it is returned by that sourceMessage(). If end() is called
+     * first, it sends as much of the Message as it can without blocking, and the peer may get it
+     * truncated. The default implementation calls sinkMessage().
+     */
+    virtual Status sinkMessageBeforeSource(Message message);
+
+    /**
+     * Sink (send) a single message whose bytes are spread, in order, across "buffers", such as a
+     * header, a body and its document sequences, without first copying them into one Message.
+     *
+     * The buffers must stay valid until the call returns, or until the async version's Future
+     * completes. The default implementation copies them into a Message and calls sinkMessage().
+     */
+    virtual Status sinkBuffers(const std::vector<ConstDataRange>& buffers);
+    virtual Future<void> asyncSinkBuffers(std::vector<ConstDataRange> buffers,
+                                          const transport::BatonHandle& handle = nullptr);
+
     /**
      * Cancel any outstanding async operations. There is no way to cancel synchronous calls.
      * Futures will finish with an ErrorCodes::CallbackCancelled error if they haven't already
@@ -16,14 +16,21 @@
 
 #pragma once
 
+#include <deque>
 #include <utility>
+#include <vector>
 
 #include "mongo/base/system_error.h"
 #include "mongo/config.h"
 #include "mongo/db/stats/counters.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/stdx/memory.h"
+#include "mongo/stdx/mutex.h"
 #include "mongo/transport/asio_utils.h"
 #include "mongo/transport/baton.h"
+#include "mongo/transport/io_uring_linux.h"
 #include "mongo/transport/transport_layer_asio.h"
+#include "mongo/transport/zero_copy_send_linux.h"
 #include "mongo/util/fail_point.h"
 #include "mongo/util/net/socket_utils.h"
 #ifdef MONGO_CONFIG_SSL
@@ -66,10 +73,20 @@ class TransportLayerASIO::ASIOSession final : public Session {
 public:
     // If the socket is disconnected while any of these options are being set, this constructor
     // may throw, but it is guaranteed to throw a mongo DBException.
-    ASIOSession(TransportLayerASIO* tl, GenericSocket socket, bool isIngressSession) try
-        : _socket(std::move(socket)),
+    //
+    // Ingress sessions are counted towards the load of "ingressShard", whose reactor must be the
+    // one "socket" belongs to.
+    ASIOSession(TransportLayerASIO* tl,
+                GenericSocket socket,
+                bool isIngressSession,
+                IngressShardHandle ingressShard = nullptr) try
+        : _ingressShard(std::move(ingressShard)),
+          _socket(std::move(socket)),
           _tl(tl),
-          _isIngressSession(isIngressSession) {
+          _isIngressSession(isIngressSession),
+          _useIOUring(isIngressSession && tl->_listenerOptions.useIOUring),
+          _coalesceWrites(tl->_listenerOptions.coalesceWrites),
+          _zeroCopySendThreshold(tl->_listenerOptions.zeroCopySendThresholdBytes) {
         auto family = endpointToSockAddr(_socket.local_endpoint()).getType();
         if (family == AF_INET || family == AF_INET6) {
             _socket.set_option(asio::ip::tcp::no_delay(true));
@@ -79,6 +96,10 @@ public:
 
         _local = endpointToHostAndPort(_socket.local_endpoint());
         _remote = endpointToHostAndPort(_socket.remote_endpoint());
+
+        if (_ingressShard) {
+            _ingressShard->sessions.addAndFetch(1);
+        }
     } catch (const DBException&) {
         throw;
     } catch (const asio::system_error& error) {
@@ -88,13 +109,21 @@ public:
     }
 
     ~ASIOSession() {
+        reapZeroCopyCompletions();
         end();
+        handOffZeroCopySends();
+        if (_ingressShard) {
+            _ingressShard->sessions.subtractAndFetch(1);
+        }
     }
 
     TransportLayer* getTransportLayer() const override {
         return _tl;
     }
 
+    // Defined in transport_layer_asio.cpp, which is where ASIOReactor is.
+    ReactorHandle getReactor() const override;
+
     const HostAndPort& remote() const override {
         return _remote;
     }
@@ -105,6 +134,8 @@ public:
 
     void end() override {
         if (getSocket().is_open()) {
+            sendDeferredWithoutBlocking();
+
             std::error_code ec;
             cancelAsyncOperations();
             getSocket().shutdown(GenericSocket::shutdown_both, ec);
@@ -116,6 +147,15 @@ public:
 
     StatusWith<Message> sourceMessage() override {
         ensureSync();
+#ifdef MONGO_TRANSPORT_HAS_IO_URING
+        // Only reads through io_uring can send a deferred reply along with them
+        if (!syncIOUring()) {
+            auto status = flushDeferredSend();
+            if (!status.isOK()) {
+                return status;
+            }
+        }
+#endif
         return sourceMessageImpl().getNoThrow();
     }
 
@@ -127,7 +167,7 @@ public:
     Status sinkMessage(Message message) override {
         ensureSync();
 
-        return write(asio::buffer(message.buf(), message.size()))
+        return writeMessage(message)
             .then([this, &message] {
                 if (_isIngressSession) {
                     networkCounter.hitPhysicalOut(message.size());
@@ -136,10 +176,34 @@ public:
             .getNoThrow();
     }
 
+    Status sinkMessageBeforeSource(Message message) override {
+        ensureSync();
+
+#ifdef MONGO_TRANSPORT_HAS_IO_URING
+        if (syncIOUring()) {
+            // Leave the message for the next read to send, so that writing a reply and waiting for
+            // the next request take one system call. If the send fails, the read reports it.
+            auto status = flushDeferredSend();
+            if (!status.isOK()) {
+                return status;
+            }
+
+            stdx::lock_guard<stdx::mutex> lk(_deferredSendMutex);
+            _deferredSend = std::move(message);
+            return Status::OK();
+        }
+#endif
+        return sinkMessage(std::move(message));
+    }
+
     Future<void> asyncSinkMessage(Message message,
                                   const transport::BatonHandle& baton = nullptr) override {
         ensureAsync();
-        return write(asio::buffer(message.buf(), message.size()), baton)
+        if (_coalesceWrites) {
+            return sinkCoalesced(std::move(message), baton);
+        }
+
+        return writeMessage(message, baton)
             .then([this, message /*keep the buffer alive*/]() {
                 if (_isIngressSession) {
                     networkCounter.hitPhysicalOut(message.size());
@@ -147,6 +211,33 @@ public:
             });
     }
 
+    Status sinkBuffers(const std::vector<ConstDataRange>& buffers) override {
+        ensureSync();
+
+        size_t size = 0;
+        const auto asioBuffers = toAsioBuffers(buffers, &size);
+        return write(asioBuffers)
+            .then([this, size] {
+                if (_isIngressSession) {
+                    networkCounter.hitPhysicalOut(size);
+                }
+            })
+            .getNoThrow();
+    }
+
+    Future<void> asyncSinkBuffers(std::vector<ConstDataRange> buffers,
+                                  const transport::BatonHandle& baton = nullptr) override {
+        ensureAsync();
+
+        size_t size = 0;
+        const auto asioBuffers = toAsioBuffers(buffers, &size);
+        return write(asioBuffers, baton).then([this, size] {
+            if (_isIngressSession) {
+                networkCounter.hitPhysicalOut(size);
+            }
+        });
+    }
+
     void cancelAsyncOperations(const transport::BatonHandle& baton = nullptr) override {
         LOG(3) << "Cancelling outstanding I/O operations on connection to " << _remote;
         if (baton) {
@@ -154,6 +245,7 @@ public:
         } else {
             getSocket().cancel();
         }
+        cancelQueuedWrites();
     }
 
     void setTimeout(boost::optional<Milliseconds> timeout) override {
@@ -167,6 +259,11 @@ public:
         if (!getSocket().is_open())
             return false;
 
+        // We've already read some of the next message
+        if (_readAheadBytes) {
+            return true;
+        }
+
         auto swPollEvents = pollASIOSocket(getSocket(), POLLIN, Milliseconds{0});
         if (!swPollEvents.isOK()) {
             if (swPollEvents != ErrorCodes::NetworkTimeout) {
@@ -178,6 +275,12 @@ public:
         }
 
         auto revents = swPollEvents.getValue();
+        if ((revents & POLLERR) && !(revents & (POLLIN | POLLHUP)) && _sentZeroCopy.load()) {
+            // Zero-copy completions waiting in the error queue look like a socket error, but a
+            // disconnected socket would also be readable or hung up
+            return true;
+        }
+
         if (revents & POLLIN) {
             char testByte;
             int size = ::recv(getSocket().native_handle(), &testByte, sizeof(testByte), MSG_PEEK);
@@ -259,6 +362,9 @@ protected:
         // expecting a socket timeout when they do an async operation.
         invariant(!_configuredTimeout);
 
+        // The deferred send has to go out while the socket is still blocking
+        uassertStatusOK(flushDeferredSend());
+
         asio::error_code ec;
         getSocket().non_blocking(true, ec);
         fassert(50706, errorCodeToStatus(ec));
@@ -320,45 +426,491 @@ private:
     Future<Message> sourceMessageImpl(const transport::BatonHandle& baton = nullptr) {
         static constexpr auto kHeaderSize = sizeof(MSGHEADER::Value);
 
-        auto headerBuffer = SharedBuffer::allocate(kHeaderSize);
-        auto ptr = headerBuffer.get();
-        return read(asio::buffer(ptr, kHeaderSize), baton)
-            .then([ headerBuffer = std::move(headerBuffer), this, baton ]() mutable {
-                if (checkForHTTPRequest(asio::buffer(headerBuffer.get(), kHeaderSize))) {
-                    return sendHTTPResponse(baton);
-                }
+        // Start with whatever the last read-ahead picked up past the end of the previous message.
+        // Otherwise read into a pooled buffer which is big enough for most messages, so that they
+        // don't need a second allocation and copy once we know their length.
+        auto buffer = std::move(_readAheadBuffer);
+        const size_t readAhead = std::exchange(_readAheadBytes, 0);
+        if (!buffer) {
+            buffer = SharedBuffer::allocatePooled(kMessageBufferBytes);
+        }
+
+        auto headerRead = readMessageHeader(buffer.get(), buffer.capacity(), readAhead, baton);
+        return std::move(headerRead).then([ buffer = std::move(buffer), this, baton ](
+            size_t filled) mutable {
+            if (checkForHTTPRequest(asio::buffer(buffer.get(), kHeaderSize))) {
+                return sendHTTPResponse(baton);
+            }
+
+            const auto msgLen = size_t(MSGHEADER::View(buffer.get()).getMessageLength());
+            if (msgLen < kHeaderSize || msgLen > MaxMessageSizeBytes) {
+                StringBuilder sb;
+                sb << "recv(): message msgLen " << msgLen << " is invalid. "
+                   << "Min " << kHeaderSize << " Max: " << MaxMessageSizeBytes;
+                const auto str = sb.str();
+                LOG(0) << str;
 
-                const auto msgLen = size_t(MSGHEADER::View(headerBuffer.get()).getMessageLength());
-                if (msgLen < kHeaderSize || msgLen > MaxMessageSizeBytes) {
-                    StringBuilder sb;
-                    sb << "recv(): message msgLen " << msgLen << " is invalid. "
-                       << "Min " << kHeaderSize << " Max: " << MaxMessageSizeBytes;
-                    const auto str = sb.str();
-                    LOG(0) << str;
+                return Future<Message>::makeReady(Status(ErrorCodes::ProtocolError, str));
+            }
+
+            if (msgLen > buffer.capacity()) {
+                auto largerBuffer = SharedBuffer::allocatePooled(msgLen);
+                memcpy(largerBuffer.get(), buffer.get(), filled);
+                buffer = std::move(largerBuffer);
+            } else if (filled > msgLen) {
+                // The read-ahead took in the start of the next message, so hold on to it until
+                // the next call.
+                _readAheadBytes = filled - msgLen;
+                _readAheadBuffer = SharedBuffer::allocatePooled(kMessageBufferBytes);
+                memcpy(_readAheadBuffer.get(), buffer.get() + msgLen, _readAheadBytes);
+                filled = msgLen;
+            }
 
-                    return Future<Message>::makeReady(Status(ErrorCodes::ProtocolError, str));
+            if (filled == msgLen) {
+                if (_isIngressSession) {
+                    networkCounter.hitPhysicalIn(msgLen);
                 }
+                return Future<Message>::makeReady(Message(std::move(buffer)));
+            }
 
-                if (msgLen == kHeaderSize) {
-                    // This probably isn't a real case since all (current) messages have bodies.
+            auto ptr = buffer.get();
+            return read(asio::buffer(ptr + filled, msgLen - filled), baton)
+                .then([ this, buffer = std::move(buffer), msgLen ]() mutable {
                     if (_isIngressSession) {
                         networkCounter.hitPhysicalIn(msgLen);
                     }
-                    return Future<Message>::makeReady(Message(std::move(headerBuffer)));
+                    return Message(std::move(buffer));
+                });
+        });
+    }
+
+    /**
+     * Reads until the "capacity" bytes at "ptr", of which the first "filled" are already read,
+     * hold at least a message header. Returns how many bytes were read in all.
+     *
+     * Where we can, this starts with a single speculative read of everything the socket has
+     * available, which usually takes in the whole message. That may also take in the start of the
+     * next message, which the caller has to keep for the next sourceMessageImpl().
+     */
+    Future<size_t> readMessageHeader(char* ptr,
+                                     size_t capacity,
+                                     size_t filled,
+                                     const transport::BatonHandle& baton) {
+        static constexpr auto kHeaderSize = sizeof(MSGHEADER::Value);
+
+        auto readRestOfHeader = [this, ptr, baton](size_t filled) {
+            if (filled >= kHeaderSize) {
+                return Future<size_t>::makeReady(filled);
+            }
+            return read(asio::buffer(ptr + filled, kHeaderSize - filled), baton).then([] {
+                return size_t(kHeaderSize);
+            });
+        };
+
+        if (filled >= kHeaderSize || !canReadAhead()) {
+            return readRestOfHeader(filled);
+        }
+
+        return readSome(asio::buffer(ptr + filled, capacity - filled), baton)
+            .then([readRestOfHeader, filled](size_t size) {
+                return readRestOfHeader(filled + size);
+            });
+    }
+
+    /**
+     * Returns true if we can read past the end of a message. The first read on an ingress session
+     * has to take in exactly one message header, so that it can be checked for a TLS handshake.
+     */
+    bool canReadAhead() const {
+#ifdef MONGO_CONFIG_SSL
+        return _ranHandshake;
+#else
+        return true;
+#endif
+    }
+
+    Future<size_t> readSome(const asio::mutable_buffer& buffer,
+                            const transport::BatonHandle& baton = nullptr) {
+#ifdef MONGO_CONFIG_SSL
+        if (_sslSocket) {
+            return opportunisticReadSome(*_sslSocket, buffer, baton);
+        }
+#endif
+#ifdef MONGO_TRANSPORT_HAS_IO_URING
+        if (auto ioUring = syncIOUring()) {
+            return Future<size_t>::makeReady(
+                readSomeWithIOUring(ioUring, static_cast<char*>(buffer.data()), buffer.size()));
+        }
+#endif
+        return opportunisticReadSome(_socket, buffer, baton);
+    }
+
+    /**
+     * Writes out "message", which the caller keeps alive until the returned Future completes.
+     */
+    Future<void> writeMessage(const Message& message,
+                              const transport::BatonHandle& baton = nullptr) {
+        auto status = flushDeferredSend();
+        if (!status.isOK()) {
+            return status;
+        }
+
+#ifdef MONGO_TRANSPORT_HAS_ZERO_COPY_SEND
+        if (shouldSendZeroCopy(message)) {
+            return writeZeroCopy(message, 0, baton);
+        }
+#endif
+        return write(asio::buffer(message.buf(), message.size()), baton);
+    }
+
+#ifdef MONGO_TRANSPORT_HAS_IO_URING
+    /**
+     * Returns the calling thread's IOUringSocketIO if this session's reads and writes should go
+     * through it: io_uring was asked for, and this is a synchronous session on a plain socket with
+     * no timeout, since io_uring doesn't honor socket timeouts.
+     */
+    IOUringSocketIO* syncIOUring() {
+        if (!_useIOUring || _blockingMode != Sync || _configuredTimeout) {
+            return nullptr;
+        }
+#ifdef MONGO_CONFIG_SSL
+        if (_sslSocket || !_ranHandshake) {
+            return nullptr;
+        }
+#endif
+        return IOUringSocketIO::forThisThread();
+    }
+
+    /**
+     * Receives at most "size" bytes into "ptr" through "ioUring", sending the deferred message
+     * from sinkMessageBeforeSource() along with it.
+     */
+    StatusWith<size_t> readSomeWithIOUring(IOUringSocketIO* ioUring, char* ptr, size_t size) {
+        auto toSend = takeDeferredSend();
+        size_t sent = 0;
+        const auto result = ioUring->recv(_socket.native_handle(),
+                                          ptr,
+                                          size,
+                                          ConstDataRange(toSend.buf(), toSend.size()),
+                                          &sent);
+        if (sent && _isIngressSession) {
+            networkCounter.hitPhysicalOut(sent);
+        }
+        if (result > 0) {
+            return size_t(result);
+        } else if (result == 0) {
+            return errorCodeToStatus(asio::error::eof);
+        }
+        return errorCodeToStatus(std::error_code(-result, std::system_category()));
+    }
+
+    template <typename MutableBufferSequence>
+    Future<void> readWithIOUring(IOUringSocketIO* ioUring, const MutableBufferSequence& buffers) {
+        const auto end = asio::buffer_sequence_end(buffers);
+        for (auto it = asio::buffer_sequence_begin(buffers); it != end; ++it) {
+            asio::mutable_buffer buffer(*it);
+            while (buffer.size()) {
+                auto swSize =
+                    readSomeWithIOUring(ioUring, static_cast<char*>(buffer.data()), buffer.size());
+                if (!swSize.isOK()) {
+                    return swSize.getStatus();
                 }
+                buffer += swSize.getValue();
+            }
+        }
+        return Future<void>::makeReady();
+    }
+
+    Message takeDeferredSend() {
+        stdx::lock_guard<stdx::mutex> lk(_deferredSendMutex);
+        return std::exchange(_deferredSend, Message());
+    }
+#endif
+
+    /**
+     * Sends the message sinkMessageBeforeSource() left for the next read, before writing anything
+     * else.
+     */
+    Status flushDeferredSend() {
+#ifdef MONGO_TRANSPORT_HAS_IO_URING
+        auto message = takeDeferredSend();
+        if (!message.empty()) {
+            std::error_code ec;
+            const auto sent =
+                asio::write(_socket, asio::buffer(message.buf(), message.size()), ec);
+            if (sent && _isIngressSession) {
+                networkCounter.hitPhysicalOut(sent);
+            }
+            return errorCodeToStatus(ec);
+        }
+#endif
+        return Status::OK();
+    }
+
+    /**
+     * Sends the message sinkMessageBeforeSource() left for the next read, if end() comes first.
+     * end() can be called from any thread, and waiting for the peer to read could block it
+     * forever, so this only sends what fits in the socket's send buffer. If that isn't all of it,
+     * the peer gets a truncated message before the connection closes, and we log how much was
+     * lost.
+     */
+    void sendDeferredWithoutBlocking() {
+#ifdef MONGO_TRANSPORT_HAS_IO_URING
+        auto message = takeDeferredSend();
+        if (message.empty()) {
+            return;
+        }
 
-                auto buffer = SharedBuffer::allocate(msgLen);
-                memcpy(buffer.get(), headerBuffer.get(), kHeaderSize);
+        size_t sent = 0;
+        int error = 0;
+        while (sent < size_t(message.size())) {
+            const auto result = ::send(_socket.native_handle(),
+                                       message.buf() + sent,
+                                       message.size() - sent,
+                                       MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (result > 0) {
+                sent += result;
+            } else if (result < 0 && errno == EINTR) {
+                continue;
+            } else {
+                error = result < 0 ? errno : EPIPE;
+                break;
+            }
+        }
 
-                MsgData::View msgView(buffer.get());
-                return read(asio::buffer(msgView.data(), msgView.dataLen()), baton)
-                    .then([ this, buffer = std::move(buffer), msgLen ]() mutable {
-                        if (_isIngressSession) {
-                            networkCounter.hitPhysicalIn(msgLen);
+        if (sent && _isIngressSession) {
+            networkCounter.hitPhysicalOut(sent);
+        }
+        if (sent < size_t(message.size())) {
+            warning() << "Session to " << _remote << " ended with " << message.size() - sent
+                      << " of the " << message.size()
+                      << " bytes of its last reply unsent: " << errnoWithDescription(error);
+        }
+#endif
+    }
+
+    void reapZeroCopyCompletions() {
+#ifdef MONGO_TRANSPORT_HAS_ZERO_COPY_SEND
+        if (_zeroCopySender) {
+            _zeroCopySender->reapCompletions(getSocket().native_handle());
+        }
+#endif
+    }
+
+    /**
+     * The kernel may still be sending out of messages we sent with MSG_ZEROCOPY, so any that are
+     * pending when we're destroyed go to the transport layer's reaper, to be held until it's done.
+     */
+    void handOffZeroCopySends() {
+#ifdef MONGO_TRANSPORT_HAS_ZERO_COPY_SEND
+        if (_zeroCopySender && _zeroCopySender->numPending()) {
+            _tl->_zeroCopyReaper.add(std::move(_zeroCopySender), _socket.native_handle());
+        }
+#endif
+    }
+
+#ifdef MONGO_TRANSPORT_HAS_ZERO_COPY_SEND
+    /**
+     * Large messages on plain sockets go out with MSG_ZEROCOPY. Small ones aren't worth waiting
+     * on a completion for, and TLS has to encrypt into its own buffers anyway.
+     */
+    bool shouldSendZeroCopy(const Message& message) {
+        if (!_zeroCopySendThreshold || size_t(message.size()) < _zeroCopySendThreshold) {
+            return false;
+        }
+#ifdef MONGO_CONFIG_SSL
+        if (_sslSocket) {
+            return false;
+        }
+#endif
+
+        const int fd = _socket.native_handle();
+        if (!_zeroCopySender) {
+            _zeroCopySender = stdx::make_unique<ZeroCopySender>();
+            if (_zeroCopySender->enable(fd)) {
+                _sentZeroCopy.store(true);
+            }
+        }
+        return _zeroCopySender->enable(fd);
+    }
+
+    /**
+     * Sends "message" from "offset" onwards with MSG_ZEROCOPY. The ZeroCopySender holds on to the
+     * message until the kernel is done with it, so the returned Future completes as soon as
+     * everything has been handed to the kernel, just like a normal write.
+     */
+    Future<void> writeZeroCopy(const Message& message,
+                               size_t offset,
+                               const transport::BatonHandle& baton) {
+#ifdef MONGO_CONFIG_SSL
+        _ranHandshake = true;
+#endif
+        const int fd = _socket.native_handle();
+        _zeroCopySender->reapCompletions(fd);
+
+        const size_t size = message.size();
+        while (offset < size) {
+            const auto sent =
+                _zeroCopySender->send(fd, message.buf() + offset, size - offset, message);
+            if (sent >= 0) {
+                offset += sent;
+                continue;
+            }
+
+            const int error = errno;
+            if (error == EINTR) {
+                continue;
+            } else if (error == ENOBUFS) {
+                // Too many sends are waiting on completions, so let the kernel copy the rest
+                return write(asio::buffer(message.buf() + offset, size - offset), baton);
+            } else if ((error == EAGAIN || error == EWOULDBLOCK) && (_blockingMode == Async)) {
+                auto retry = [this, message, offset, baton] {
+                    return writeZeroCopy(message, offset, baton);
+                };
+
+                if (baton) {
+                    return baton->addSession(*this, Baton::Type::Out).then(std::move(retry));
+                }
+                return _socket.async_wait(GenericSocket::wait_write, UseFuture{})
+                    .then(std::move(retry));
+            }
+
+            return futurize(std::error_code(error, std::system_category()));
+        }
+
+        return Future<void>::makeReady();
+    }
+#endif
+
+    static std::vector<asio::const_buffer> toAsioBuffers(const std::vector<ConstDataRange>& buffers,
+                                                         size_t* size) {
+        std::vector<asio::const_buffer> asioBuffers;
+        asioBuffers.reserve(buffers.size());
+        for (const auto& buffer : buffers) {
+            asioBuffers.emplace_back(buffer.data(), buffer.length());
+            *size += buffer.length();
+        }
+        return asioBuffers;
+    }
+
+    /**
+     * Sinks "message" through the write coalescer. If no write is in flight, it goes out right
+     * away. Otherwise it's queued, and when the write in flight finishes everything queued behind
+     * it goes out together in one gather write. Since that write copies, messages sunk here are
+     * never sent with MSG_ZEROCOPY.
+     */
+    Future<void> sinkCoalesced(Message message, const transport::BatonHandle& baton) {
+        auto pf = makePromiseFuture<void>();
+        {
+            stdx::lock_guard<stdx::mutex> lk(_coalescerMutex);
+            _queuedWrites.push_back(QueuedWrite{std::move(message), baton, std::move(pf.promise)});
+            if (_writeInFlight) {
+                return std::move(pf.future);
+            }
+            _writeInFlight = true;
+        }
+
+        writeQueuedBatches();
+        return std::move(pf.future);
+    }
+
+    /**
+     * Writes out queued messages, one gather write per batch, until the queue is empty. Only the
+     * thread which set _writeInFlight runs this, or the completion of a write it started.
+     *
+     * Writes which complete right away are handled in this loop rather than in their callbacks,
+     * so a steady stream of sinks can't grow the stack.
+     */
+    void writeQueuedBatches() {
+        while (true) {
+            std::vector<QueuedWrite> batch;
+            {
+                stdx::lock_guard<stdx::mutex> lk(_coalescerMutex);
+                if (_queuedWrites.empty()) {
+                    _writeInFlight = false;
+                    return;
+                }
+
+                // A batch is the longest run of queued messages that were sunk with the same
+                // baton, so that the write can wait on the baton its callers gave us.
+                const auto baton = _queuedWrites.front().baton;
+                while (!_queuedWrites.empty() && _queuedWrites.front().baton == baton) {
+                    batch.push_back(std::move(_queuedWrites.front()));
+                    _queuedWrites.pop_front();
+                }
+            }
+
+            std::vector<asio::const_buffer> buffers;
+            buffers.reserve(batch.size());
+            size_t size = 0;
+            for (const auto& queuedWrite : batch) {
+                buffers.emplace_back(queuedWrite.message.buf(), queuedWrite.message.size());
+                size += queuedWrite.message.size();
+            }
+
+            auto written = write(buffers, batch.front().baton);
+            if (!written.isReady()) {
+                std::move(written).getAsync(
+                    [ this, batch = std::move(batch), size ](Status status) mutable {
+                        if (finishBatch(&batch, size, status)) {
+                            writeQueuedBatches();
                         }
-                        return Message(std::move(buffer));
                     });
-            });
+                return;
+            }
+
+            if (!finishBatch(&batch, size, std::move(written).getNoThrow())) {
+                return;
+            }
+        }
+    }
+
+    /**
+     * Completes the callers in "batch" with the result of writing it. Returns whether to carry on
+     * writing. After a failed write nothing more can go out on this socket without corrupting the
+     * stream, so everything still queued fails too.
+     */
+    bool finishBatch(std::vector<QueuedWrite>* batch, size_t size, const Status& status) {
+        if (status.isOK()) {
+            if (_isIngressSession) {
+                networkCounter.hitPhysicalOut(size);
+            }
+            for (auto& queuedWrite : *batch) {
+                queuedWrite.promise.emplaceValue();
+            }
+            return true;
+        }
+
+        std::deque<QueuedWrite> queued;
+        {
+            stdx::lock_guard<stdx::mutex> lk(_coalescerMutex);
+            queued = std::exchange(_queuedWrites, {});
+            _writeInFlight = false;
+        }
+
+        for (auto& queuedWrite : *batch) {
+            queuedWrite.promise.setError(status);
+        }
+        for (auto& queuedWrite : queued) {
+            queuedWrite.promise.setError(status);
+        }
+        return false;
+    }
+
+    /**
+     * Fails every write queued behind the one in flight, which the caller has cancelled.
+     */
+    void cancelQueuedWrites() {
+        std::deque<QueuedWrite> queued;
+        {
+            stdx::lock_guard<stdx::mutex> lk(_coalescerMutex);
+            queued = std::exchange(_queuedWrites, {});
+        }
+
+        for (auto& queuedWrite : queued) {
+            queuedWrite.promise.setError(
+                {ErrorCodes::CallbackCanceled, "Queued write was canceled"});
+        }
     }
 
     template <typename MutableBufferSequence>
@@ -383,6 +935,11 @@ private:
                     }
                 });
         }
+#endif
+#ifdef MONGO_TRANSPORT_HAS_IO_URING
+        if (auto ioUring = syncIOUring()) {
+            return readWithIOUring(ioUring, buffers);
+        }
 #endif
         return opportunisticRead(_socket, buffers, baton);
     }
@@ -390,6 +947,11 @@ private:
     template <typename ConstBufferSequence>
     Future<void> write(const ConstBufferSequence& buffers,
                        const transport::BatonHandle& baton = nullptr) {
+        auto status = flushDeferredSend();
+        if (!status.isOK()) {
+            return status;
+        }
+
 #ifdef MONGO_CONFIG_SSL
         _ranHandshake = true;
         if (_sslSocket) {
@@ -420,14 +982,8 @@ private:
 
         if (MONGO_FAIL_POINT(transportLayerASIOshortOpportunisticReadWrite) &&
             _blockingMode == Async) {
-            asio::mutable_buffer localBuffer = buffers;
-
-            if (buffers.size()) {
-                localBuffer = asio::mutable_buffer(buffers.data(), 1);
-            }
-
-            size = asio::read(stream, localBuffer, ec);
-            if (!ec && buffers.size() > 1) {
+            size = asio::read(stream, firstByteOf(buffers), ec);
+            if (!ec && asio::buffer_size(buffers) > 1) {
                 ec = asio::error::would_block;
             }
         } else {
@@ -436,12 +992,15 @@ private:
 
         if (((ec == asio::error::would_block) || (ec == asio::error::try_again)) &&
             (_blockingMode == Async)) {
+            // Otherwise pending zero-copy completions would wake us right back up
+            reapZeroCopyCompletions();
+
             // asio::read is a loop internally, so some of buffers may have been read into already.
             // So we need to adjust the buffers passed into async_read to be offset by size, if
             // size is > 0.
             MutableBufferSequence asyncBuffers(buffers);
             if (size > 0) {
-                asyncBuffers += size;
+                consumeBuffers(asyncBuffers, size);
             }
 
             if (baton) {
@@ -457,6 +1016,39 @@ private:
         }
     }
 
+    /**
+     * Like opportunisticRead, but completes as soon as anything has been read into "buffer", and
+     * returns how much that was.
+     */
+    template <typename Stream>
+    Future<size_t> opportunisticReadSome(Stream& stream,
+                                         asio::mutable_buffer buffer,
+                                         const transport::BatonHandle& baton = nullptr) {
+        if (MONGO_FAIL_POINT(transportLayerASIOshortOpportunisticReadWrite) &&
+            _blockingMode == Async && buffer.size()) {
+            buffer = asio::mutable_buffer(buffer.data(), 1);
+        }
+
+        std::error_code ec;
+        const auto size = stream.read_some(buffer, ec);
+
+        if (((ec == asio::error::would_block) || (ec == asio::error::try_again)) &&
+            (_blockingMode == Async)) {
+            reapZeroCopyCompletions();
+
+            if (baton) {
+                return baton->addSession(*this, Baton::Type::In)
+                    .then([&stream, buffer, baton, this] {
+                        return opportunisticReadSome(stream, buffer, baton);
+                    });
+            }
+
+            return stream.async_read_some(buffer, UseFuture{});
+        } else {
+            return futurize(ec, size);
+        }
+    }
+
     /**
      * moreToSend checks the ssl socket after an opportunisticWrite.  If there are still bytes to
      * send, we manually send them off the underlying socket.  Then we hook that up with a future
@@ -498,14 +1090,8 @@ private:
 
         if (MONGO_FAIL_POINT(transportLayerASIOshortOpportunisticReadWrite) &&
             _blockingMode == Async) {
-            asio::const_buffer localBuffer = buffers;
-
-            if (buffers.size()) {
-                localBuffer = asio::const_buffer(buffers.data(), 1);
-            }
-
-            size = asio::write(stream, localBuffer, ec);
-            if (!ec && buffers.size() > 1) {
+            size = asio::write(stream, firstByteOf(buffers), ec);
+            if (!ec && asio::buffer_size(buffers) > 1) {
                 ec = asio::error::would_block;
             }
         } else {
@@ -520,7 +1106,7 @@ private:
             // size is > 0.
             ConstBufferSequence asyncBuffers(buffers);
             if (size > 0) {
-                asyncBuffers += size;
+                consumeBuffers(asyncBuffers, size);
             }
 
             if (auto more = moreToSend(stream, asyncBuffers, baton)) {
@@ -678,6 +1264,10 @@ private:
     boost::optional<Milliseconds> _configuredTimeout;
     boost::optional<Milliseconds> _socketTimeout;
 
+    // Declared before _socket so that the socket is closed before we drop our reference to its
+    // reactor.
+    const IngressShardHandle _ingressShard;
+
     GenericSocket _socket;
 #ifdef MONGO_CONFIG_SSL
     boost::optional<asio::ssl::stream<decltype(_socket)>> _sslSocket;
@@ -686,6 +1276,45 @@ private:
 
     TransportLayerASIO* const _tl;
     bool _isIngressSession;
+
+    // Whether synchronous reads and writes should go through io_uring. See syncIOUring().
+    const bool _useIOUring;
+#ifdef MONGO_TRANSPORT_HAS_IO_URING
+    // A message sinkMessageBeforeSource() left for the next read to send. Guarded by a mutex
+    // because end() may send it from another thread.
+    stdx::mutex _deferredSendMutex;
+    Message _deferredSend;
+#endif
+
+    // Only used by asyncSinkMessage when _coalesceWrites is set. See sinkCoalesced().
+    struct QueuedWrite {
+        Message message;
+        transport::BatonHandle baton;
+        Promise<void> promise;
+    };
+
+    const bool _coalesceWrites;
+    stdx::mutex _coalescerMutex;
+    bool _writeInFlight = false;
+    std::deque<QueuedWrite> _queuedWrites;
+
+    // Messages at least this large are sent with MSG_ZEROCOPY where we can; 0 turns that off.
+    // Writes through the coalescer never are, since they gather several messages into one write.
+    const size_t _zeroCopySendThreshold;
+#ifdef MONGO_TRANSPORT_HAS_ZERO_COPY_SEND
+    // Created by the first message large enough to be sent with MSG_ZEROCOPY. Handed to the
+    // transport layer's ZeroCopyReaper if we're destroyed with sends still pending.
+    std::unique_ptr<ZeroCopySender> _zeroCopySender;
+#endif
+    // Set once zero-copy sends are turned on for the socket. Read by isConnected().
+    AtomicWord<bool> _sentZeroCopy{false};
+
+    // Most messages fit in a pooled buffer of this size (rounded up to the pool's size class).
+    static constexpr size_t kMessageBufferBytes = 4000;
+
+    // The start of the next message, when a read-ahead took in more than one message.
+    SharedBuffer _readAheadBuffer;
+    size_t _readAheadBytes = 0;
 };
 
 }  // namespace transport
@@ -23,6 +23,14 @@
 #include <asio.hpp>
 #include <asio/system_timer.hpp>
 #include <boost/algorithm/string.hpp>
+#include <limits>
+
+#ifdef __linux__
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#endif
 
 #include "mongo/config.h"
 
@@ -44,12 +52,42 @@
 // session_asio.h has some header dependencies that require it to be the last header.
 #ifdef __linux__
 #include "mongo/transport/baton_asio_linux.h"
+#include "mongo/transport/io_uring_linux.h"
 #endif
 #include "mongo/transport/session_asio.h"
 
 namespace mongo {
 namespace transport {
 
+namespace {
+
+#ifdef SO_REUSEPORT
+using ReusePortOption = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+
+/**
+ * Pins the calling listener thread to a CPU chosen by "index". This is best effort, so failures
+ * are only logged.
+ */
+void pinListenerThread(size_t index) {
+#ifdef __linux__
+    const auto numCpus = stdx::thread::hardware_concurrency();
+    if (!numCpus) {
+        return;
+    }
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(index % numCpus, &cpus);
+    if (int error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus)) {
+        warning() << "Unable to pin listener thread to cpu " << (index % numCpus) << ": "
+                  << errnoWithDescription(error);
+    }
+#endif
+}
+
+}  // namespace
+
 class ASIOReactorTimer final : public ReactorTimer {
 public:
     explicit ASIOReactorTimer(asio::io_context& ctx)
@@ -256,6 +294,174 @@ private:
 thread_local TransportLayerASIO::ASIOReactor* TransportLayerASIO::ASIOReactor::_reactorForThread =
     nullptr;
 
+ReactorHandle TransportLayerASIO::ASIOSession::getReactor() const {
+    if (_ingressShard) {
+        return _ingressShard->reactor;
+    }
+    return nullptr;
+}
+
+#ifdef MONGO_TRANSPORT_HAS_IO_URING
+/**
+ * Accepts connections on all of a TransportLayerASIO's acceptors with io_uring.
+ *
+ * Each acceptor gets a multishot accept, so that a burst of connections costs one io_uring_enter
+ * call rather than an accept and an epoll round trip per connection. Kernels which predate
+ * multishot accept reject it with EINVAL, after which we go back to one accept per connection.
+ * Accepted sockets are handed to the ingress reactor exactly like the ones asio accepts.
+ */
+class TransportLayerASIO::IOUringListener {
+public:
+    IOUringListener(TransportLayerASIO* tl, std::unique_ptr<IOUring> ring)
+        : _tl(tl), _ring(std::move(ring)), _wakeupFd(::eventfd(0, EFD_CLOEXEC)) {
+        if (_wakeupFd < 0) {
+            severe() << "error in eventfd: " << errnoWithDescription(errno);
+            fassertFailed(50837);
+        }
+
+        for (auto& acceptor : _tl->_acceptors) {
+            _protocols.push_back(acceptor.second.local_endpoint().protocol());
+        }
+    }
+
+    ~IOUringListener() {
+        ::close(_wakeupFd);
+    }
+
+    /**
+     * Accepts connections until stop() is called. Runs on the listener thread.
+     */
+    void run() {
+        _armWakeup();
+        for (size_t i = 0; i < _protocols.size(); ++i) {
+            _armAccept(i);
+        }
+
+        bool stopping = false;
+        std::vector<size_t> toRearm;
+        while (!stopping) {
+            const int error = _ring->submit(1);
+            if (error && error != EINTR) {
+                severe() << "error in io_uring_enter: " << errnoWithDescription(error);
+                fassertFailed(50838);
+            }
+
+            _ring->reapCompletions([&](const io_uring_cqe& cqe) {
+                if (cqe.user_data == kWakeupId) {
+                    stopping = true;
+                    return;
+                }
+
+                const size_t index = cqe.user_data;
+                if (!(cqe.flags & IORING_CQE_F_MORE)) {
+                    toRearm.push_back(index);
+                }
+
+                if (cqe.res >= 0) {
+                    if (stopping || !_tl->_running.load()) {
+                        ::close(cqe.res);
+                    } else {
+                        _startSession(index, cqe.res);
+                    }
+                    return;
+                }
+
+                if (cqe.res == -EINVAL && _multishot) {
+                    log() << "Multishot accept is not supported, accepting one connection per "
+                             "io_uring submission";
+                    _multishot = false;
+                    return;
+                }
+
+                auto& acceptor = _tl->_acceptors[index].second;
+                log() << "Error accepting new connection on "
+                      << endpointToHostAndPort(acceptor.local_endpoint()) << ": "
+                      << errnoWithDescription(-cqe.res);
+            });
+
+            for (auto index : toRearm) {
+                _armAccept(index);
+            }
+            toRearm.clear();
+        }
+
+        // Close any connections which were accepted but not yet reaped. Outstanding accepts are
+        // cancelled when the ring is destroyed.
+        _ring->submit();
+        _ring->reapCompletions([](const io_uring_cqe& cqe) {
+            if (cqe.user_data != kWakeupId && cqe.res >= 0) {
+                ::close(cqe.res);
+            }
+        });
+    }
+
+    /**
+     * Makes run() return. May be called from any thread.
+     */
+    void stop() {
+        while (::eventfd_write(_wakeupFd, 1) != 0) {
+            invariant(errno == EINTR);
+        }
+    }
+
+private:
+    static constexpr uint64_t kWakeupId = std::numeric_limits<uint64_t>::max();
+
+    void _armWakeup() {
+        auto sqe = _ring->getSqe();
+        invariant(sqe);
+        sqe->opcode = io_uring_op::kPollAdd;
+        sqe->fd = _wakeupFd;
+        sqe->poll_events = POLLIN;
+        sqe->user_data = kWakeupId;
+    }
+
+    void _armAccept(size_t index) {
+        auto sqe = _ring->getSqe();
+        invariant(sqe);
+        sqe->opcode = io_uring_op::kAccept;
+        sqe->fd = _tl->_acceptors[index].second.native_handle();
+        // accept_flags shares a union with msg_flags, and headers older than 5.5 only have the
+        // latter.
+        sqe->msg_flags = SOCK_CLOEXEC;
+        sqe->ioprio = _multishot ? IORING_ACCEPT_MULTISHOT : 0;
+        sqe->user_data = index;
+    }
+
+    void _startSession(size_t index, int fd) {
+        auto shard = _tl->_pickIngressShard();
+        GenericSocket peerSocket(*shard->reactor);
+        std::error_code ec;
+        peerSocket.assign(_protocols[index], fd, ec);
+        if (ec) {
+            ::close(fd);
+            warning() << "Error accepting new connection " << ec.message();
+            return;
+        }
+
+        try {
+            std::shared_ptr<ASIOSession> session(
+                new ASIOSession(_tl, std::move(peerSocket), true, std::move(shard)));
+            _tl->_sep->startSession(std::move(session));
+        } catch (const DBException& e) {
+            warning() << "Error accepting new connection " << e;
+        }
+    }
+
+    TransportLayerASIO* const _tl;
+    const std::unique_ptr<IOUring> _ring;
+    const int _wakeupFd;
+
+    // Indexed like _tl->_acceptors
+    std::vector<asio::generic::stream_protocol> _protocols;
+
+    bool _multishot = true;
+};
+#else
+// io_uring isn't available on this platform, so _ioUringListener is never set.
+class TransportLayerASIO::IOUringListener {};
+#endif
+
 TransportLayerASIO::Options::Options(const ServerGlobalParams* params)
     : port(params->port),
       ipList(params->bind_ip),
@@ -277,6 +483,10 @@ TransportLayerASIO::TransportLayerASIO(const TransportLayerASIO::Options& opts,
 #endif
       _sep(sep),
       _listenerOptions(opts) {
+    _ingressShards.push_back(std::make_shared<IngressShard>(_ingressReactor));
+    for (size_t i = 1; i < _listenerOptions.ingressReactors; ++i) {
+        _ingressShards.push_back(std::make_shared<IngressShard>(std::make_shared<ASIOReactor>()));
+    }
 }
 
 TransportLayerASIO::~TransportLayerASIO() = default;
@@ -617,9 +827,26 @@ Status TransportLayerASIO::setup() {
                 "Cannot bind to listening sockets with ingress networking is disabled"};
     }
 
+    if (_listenerOptions.coalesceWrites && _listenerOptions.zeroCopySendThresholdBytes) {
+        log() << "Write coalescing is on, so messages sunk asynchronously are never sent with "
+              << "MSG_ZEROCOPY";
+    }
+
     _listenerPort = _listenerOptions.port;
     WrappedResolver resolver(*_acceptorReactor);
 
+    if (_listenerOptions.acceptorThreads > 1) {
+#ifdef SO_REUSEPORT
+        for (size_t i = 1; i < _listenerOptions.acceptorThreads; ++i) {
+            _acceptorShards.push_back(stdx::make_unique<AcceptorShard>());
+            _acceptorShards.back()->reactor = std::make_shared<ASIOReactor>();
+        }
+#else
+        warning() << "Accepting connections on one thread, since SO_REUSEPORT is not supported "
+                     "on this platform";
+#endif
+    }
+
     for (auto& ip : listenAddrs) {
         std::error_code ec;
         if (ip.empty()) {
@@ -650,21 +877,12 @@ Status TransportLayerASIO::setup() {
                 fassertFailedNoTrace(40488);
             }
 
-            GenericAcceptor acceptor(*_acceptorReactor);
-            acceptor.open(addr->protocol());
-            acceptor.set_option(GenericAcceptor::reuse_address(true));
-            if (addr.family() == AF_INET6) {
-                acceptor.set_option(asio::ip::v6_only(true));
-            }
-
-            acceptor.non_blocking(true, ec);
-            if (ec) {
-                return errorCodeToStatus(ec);
-            }
+            const bool isTCP = addr.family() == AF_INET || addr.family() == AF_INET6;
 
-            acceptor.bind(*addr, ec);
-            if (ec) {
-                return errorCodeToStatus(ec);
+            GenericAcceptor acceptor(*_acceptorReactor);
+            auto status = _openAcceptor(acceptor, *addr, isTCP && !_acceptorShards.empty());
+            if (!status.isOK()) {
+                return status;
             }
 
 #ifndef _WIN32
@@ -692,6 +910,22 @@ Status TransportLayerASIO::setup() {
                 _listenerPort = endpointToHostAndPort(endpoint).port();
             }
 
+            if (isTCP && !_acceptorShards.empty()) {
+                // Bind to the primary acceptor's address, which has the real port if it was 0
+                auto endpoint = acceptor.local_endpoint(ec);
+                if (ec) {
+                    return errorCodeToStatus(ec);
+                }
+
+                for (auto& shard : _acceptorShards) {
+                    shard->acceptors.emplace_back(*shard->reactor);
+                    status = _openAcceptor(shard->acceptors.back(), endpoint, true);
+                    if (!status.isOK()) {
+                        return status;
+                    }
+                }
+            }
+
             sockaddr_storage sa;
             memcpy(&sa, addr->data(), addr->size());
             _acceptors.emplace_back(SockAddr(sa, addr->size()), std::move(acceptor));
@@ -702,6 +936,11 @@ Status TransportLayerASIO::setup() {
         return Status(ErrorCodes::SocketException, "No available addresses/ports to bind to");
     }
 
+    // There's no point to shards if there were no TCP addresses to listen on
+    if (!_acceptorShards.empty() && _acceptorShards.front()->acceptors.empty()) {
+        _acceptorShards.clear();
+    }
+
 #ifdef MONGO_CONFIG_SSL
     const auto& sslParams = getSSLGlobalParams();
     auto sslManager = getSSLManager();
@@ -740,15 +979,39 @@ Status TransportLayerASIO::start() {
     if (_listenerOptions.isIngress()) {
         for (auto& acceptor : _acceptors) {
             acceptor.second.listen(serverGlobalParams.listenBacklog);
-            _acceptConnection(acceptor.second);
         }
 
-        _listenerThread = stdx::thread([this] {
-            setThreadName("listener");
-            while (_running.load()) {
-                _acceptorReactor->run();
+        if (!(_listenerOptions.useIOUring && _startIOUringListener())) {
+            for (auto& acceptor : _acceptors) {
+                _acceptConnection(acceptor.second);
             }
-        });
+
+            _listenerThread = stdx::thread([this] {
+                setThreadName("listener");
+                if (!_acceptorShards.empty()) {
+                    pinListenerThread(0);
+                }
+                while (_running.load()) {
+                    _acceptorReactor->run();
+                }
+            });
+        }
+
+        for (size_t i = 0; i < _acceptorShards.size(); ++i) {
+            auto shard = _acceptorShards[i].get();
+            for (auto& acceptor : shard->acceptors) {
+                acceptor.listen(serverGlobalParams.listenBacklog);
+                _acceptConnection(acceptor);
+            }
+
+            shard->thread = stdx::thread([this, shard, i] {
+                setThreadName(str::stream() << "listener-" << (i + 1));
+                pinListenerThread(i + 1);
+                while (_running.load()) {
+                    shard->reactor->run();
+                }
+            });
+        }
 
         const char* ssl = "";
 #ifdef MONGO_CONFIG_SSL
@@ -790,9 +1053,25 @@ void TransportLayerASIO::shutdown() {
     // Otherwise the ServiceExecutor may need to continue running the io_context to drain running
     // connections, so we just cancel the acceptors and return.
     if (_listenerThread.joinable()) {
+#ifdef MONGO_TRANSPORT_HAS_IO_URING
+        if (_ioUringListener) {
+            _ioUringListener->stop();
+        }
+#endif
         _acceptorReactor->stop();
         _listenerThread.join();
     }
+
+    for (auto& shard : _acceptorShards) {
+        for (auto& acceptor : shard->acceptors) {
+            acceptor.cancel();
+        }
+
+        if (shard->thread.joinable()) {
+            shard->reactor->stop();
+            shard->thread.join();
+        }
+    }
 }
 
 ReactorHandle TransportLayerASIO::getReactor(WhichReactor which) {
@@ -808,8 +1087,100 @@ ReactorHandle TransportLayerASIO::getReactor(WhichReactor which) {
     MONGO_UNREACHABLE;
 }
 
+std::vector<ReactorHandle> TransportLayerASIO::getIngressReactors() {
+    std::vector<ReactorHandle> reactors;
+    for (const auto& shard : _ingressShards) {
+        reactors.push_back(shard->reactor);
+    }
+    return reactors;
+}
+
+std::vector<int64_t> TransportLayerASIO::getIngressReactorSessions() const {
+    std::vector<int64_t> sessions;
+    for (const auto& shard : _ingressShards) {
+        sessions.push_back(shard->sessions.load());
+    }
+    return sessions;
+}
+
+TransportLayerASIO::IngressShardHandle TransportLayerASIO::_pickIngressShard() {
+    // Start the search somewhere different each time, so that ties are broken round-robin
+    const size_t numShards = _ingressShards.size();
+    const size_t start = _nextIngressShard.fetchAndAdd(1) % numShards;
+
+    auto best = _ingressShards[start];
+    for (size_t i = 1; i < numShards; ++i) {
+        const auto& shard = _ingressShards[(start + i) % numShards];
+        if (shard->sessions.load() < best->sessions.load()) {
+            best = shard;
+        }
+    }
+    return best;
+}
+
+bool TransportLayerASIO::_startIOUringListener() {
+#ifdef MONGO_TRANSPORT_HAS_IO_URING
+    // One entry for each acceptor's accept, plus one for the wakeup
+    auto swRing = IOUring::make(_acceptors.size() + 1);
+    if (!swRing.isOK()) {
+        log() << "Not accepting connections with io_uring: " << swRing.getStatus();
+        return false;
+    }
+
+    auto& ring = swRing.getValue();
+    if (!ring->supportsOps({io_uring_op::kAccept, io_uring_op::kPollAdd})) {
+        log() << "Not accepting connections with io_uring: the kernel does not support accept";
+        return false;
+    }
+
+    _ioUringListener = stdx::make_unique<IOUringListener>(this, std::move(ring));
+    _listenerThread = stdx::thread([this] {
+        setThreadName("listener");
+        if (!_acceptorShards.empty()) {
+            pinListenerThread(0);
+        }
+        _ioUringListener->run();
+    });
+    return true;
+#else
+    log() << "Not accepting connections with io_uring: it is not supported on this platform";
+    return false;
+#endif
+}
+
+Status TransportLayerASIO::_openAcceptor(GenericAcceptor& acceptor,
+                                         const asio::generic::stream_protocol::endpoint& endpoint,
+                                         bool reusePort) {
+    std::error_code ec;
+    acceptor.open(endpoint.protocol());
+    acceptor.set_option(GenericAcceptor::reuse_address(true));
+#ifdef SO_REUSEPORT
+    if (reusePort) {
+        acceptor.set_option(ReusePortOption(true));
+    }
+#endif
+    if (endpoint.protocol().family() == AF_INET6) {
+        acceptor.set_option(asio::ip::v6_only(true));
+    }
+
+    acceptor.non_blocking(true, ec);
+    if (ec) {
+        return errorCodeToStatus(ec);
+    }
+
+    acceptor.bind(endpoint, ec);
+    if (ec) {
+        return errorCodeToStatus(ec);
+    }
+
+    return Status::OK();
+}
+
 void TransportLayerASIO::_acceptConnection(GenericAcceptor& acceptor) {
-    auto acceptCb = [this, &acceptor](const std::error_code& ec, GenericSocket peerSocket) mutable {
+    // Wait for a connection before accepting it, rather than accepting it onto a reactor picked
+    // now. A shard's load can change a lot while we wait, so it's only picked once there's a
+    // connection to give it.
+    auto acceptCb = [this, &acceptor](const std::error_code& ec) {
         if (!_running.load())
             return;
 
@@ -820,9 +1191,32 @@ void TransportLayerASIO::_acceptConnection(GenericAcceptor& acceptor) {
             return;
         }
 
+        // The accepted socket belongs to whichever reactor it's accepted onto
+        auto shard = _pickIngressShard();
+        std::error_code acceptEc;
+        if (!acceptor.non_blocking()) {
+            acceptor.non_blocking(true, acceptEc);
+        }
+        GenericSocket peerSocket(*shard->reactor);
+        if (!acceptEc) {
+            acceptor.accept(peerSocket, acceptEc);
+        }
+
+        if ((acceptEc == asio::error::would_block) || (acceptEc == asio::error::try_again)) {
+            // The connection went away, or someone else accepted it, before we got to it
+            _acceptConnection(acceptor);
+            return;
+        } else if (acceptEc) {
+            log() << "Error accepting new connection on "
+                  << endpointToHostAndPort(acceptor.local_endpoint()) << ": "
+                  << acceptEc.message();
+            _acceptConnection(acceptor);
+            return;
+        }
+
         try {
             std::shared_ptr<ASIOSession> session(
-                new ASIOSession(this, std::move(peerSocket), true));
+                new ASIOSession(this, std::move(peerSocket), true, std::move(shard)));
             _sep->startSession(std::move(session));
         } catch (const DBException& e) {
             warning() << "Error accepting new connection " << e;
@@ -831,7 +1225,7 @@ void TransportLayerASIO::_acceptConnection(GenericAcceptor& acceptor) {
         _acceptConnection(acceptor);
     };
 
-    acceptor.async_accept(*_ingressReactor, std::move(acceptCb));
+    acceptor.async_wait(GenericAcceptor::wait_read, std::move(acceptCb));
 }
 
 #ifdef MONGO_CONFIG_SSL
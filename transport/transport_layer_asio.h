@@ -28,6 +28,7 @@
 #include "mongo/stdx/thread.h"
 #include "mongo/transport/transport_layer.h"
 #include "mongo/transport/transport_mode.h"
+#include "mongo/transport/zero_copy_send_linux.h"
 #include "mongo/util/fail_point_service.h"
 #include "mongo/util/net/hostandport.h"
 #include "mongo/util/net/ssl_options.h"
@@ -91,6 +92,33 @@ public:
         Mode transportMode = Mode::kSynchronous;  // whether accepted sockets should be put into
                                                   // non-blocking mode after they're accepted
         size_t maxConns = DEFAULT_MAX_CONN;       // maximum number of active connections
+
+        // Whether to use io_uring where the kernel supports it, falling back to asio otherwise:
+        //  - The listener thread accepts connections with one multishot accept per listening
+        //    socket.
+        //  - Synchronous ingress sessions on plain sockets read through a ring owned by their
+        //    thread. A reply sunk with sinkMessageBeforeSource() goes out with the next read.
+        // Asynchronous sessions still do their I/O through asio's reactor.
+        bool useIOUring = false;
+
+        // Whether a session's asyncSinkMessage should queue up messages sunk while an earlier
+        // write is still in flight, and send everything queued in one gather write when it's done.
+        bool coalesceWrites = false;
+
+        // Messages at least this large are sent with MSG_ZEROCOPY on plain (non-TLS) sockets
+        // where the kernel supports it. 0 turns zero-copy sends off. Messages sunk through the
+        // write coalescer (see coalesceWrites) are always copied.
+        size_t zeroCopySendThresholdBytes = 0;
+
+        // How many threads accept connections. With more than one, each TCP address gets an
+        // SO_REUSEPORT listener per thread, each with its own reactor and pinned to its own core,
+        // and the kernel spreads new connections across them. Unix sockets only get one listener.
+        size_t acceptorThreads = 1;
+
+        // How many reactors accepted sockets are spread across. Each new session goes to the
+        // reactor with the fewest sessions. Only useful in asynchronous mode, where the service
+        // executor gives each reactor its own worker threads; see getIngressReactors().
+        size_t ingressReactors = 1;
     };
 
     TransportLayerASIO(const Options& opts, ServiceEntryPoint* sep);
@@ -109,6 +137,18 @@ public:
 
     ReactorHandle getReactor(WhichReactor which) final;
 
+    /**
+     * Returns every reactor that accepted sockets are assigned to. The first is the one returned
+     * by getReactor(kIngress).
+     */
+    std::vector<ReactorHandle> getIngressReactors();
+
+    /**
+     * Returns how many sessions each of the reactors returned by getIngressReactors() has, in the
+     * same order.
+     */
+    std::vector<int64_t> getIngressReactorSessions() const;
+
     Status start() final;
 
     void shutdown() final;
@@ -123,13 +163,35 @@ private:
     class BatonASIO;
     class ASIOSession;
     class ASIOReactor;
+    class IOUringListener;
 
     using ASIOSessionHandle = std::shared_ptr<ASIOSession>;
     using ConstASIOSessionHandle = std::shared_ptr<const ASIOSession>;
     using GenericAcceptor = asio::basic_socket_acceptor<asio::generic::stream_protocol>;
 
+    struct IngressShard;
+    using IngressShardHandle = std::shared_ptr<IngressShard>;
+
     void _acceptConnection(GenericAcceptor& acceptor);
 
+    /**
+     * Returns the ingress shard with the fewest sessions, for a newly accepted socket.
+     */
+    IngressShardHandle _pickIngressShard();
+
+    /**
+     * Opens "acceptor", configures it for listening and binds it to "endpoint".
+     */
+    Status _openAcceptor(GenericAcceptor& acceptor,
+                         const asio::generic::stream_protocol::endpoint& endpoint,
+                         bool reusePort);
+
+    /**
+     * Starts _listenerThread accepting connections through an IOUringListener. Returns false,
+     * leaving the caller to accept connections with asio, if io_uring isn't available.
+     */
+    bool _startIOUringListener();
+
     template <typename Endpoint>
     StatusWith<ASIOSessionHandle> _doSyncConnect(Endpoint endpoint,
                                                  const HostAndPort& peer,
@@ -167,6 +229,18 @@ private:
     std::shared_ptr<ASIOReactor> _egressReactor;
     std::shared_ptr<ASIOReactor> _acceptorReactor;
 
+    // The reactors accepted sockets are spread across; the first holds _ingressReactor. Each
+    // ingress session keeps a reference to its shard, which counts towards the shard's load and
+    // keeps the reactor alive for as long as the session's socket.
+    struct IngressShard {
+        explicit IngressShard(std::shared_ptr<ASIOReactor> r) : reactor(std::move(r)) {}
+
+        const std::shared_ptr<ASIOReactor> reactor;
+        AtomicWord<int64_t> sessions{0};
+    };
+    std::vector<IngressShardHandle> _ingressShards;
+    AtomicWord<unsigned> _nextIngressShard{0};
+
 #ifdef MONGO_CONFIG_SSL
     std::unique_ptr<asio::ssl::context> _ingressSSLContext;
     std::unique_ptr<asio::ssl::context> _egressSSLContext;
@@ -174,9 +248,28 @@ private:
 
     std::vector<std::pair<SockAddr, GenericAcceptor>> _acceptors;
 
+    // Listeners beyond the first when _listenerOptions.acceptorThreads is more than one. Each
+    // shard has its own SO_REUSEPORT acceptor for every TCP address in _acceptors, and its own
+    // reactor and thread to accept on them. As above, the reactor is declared before the
+    // acceptors which use it.
+    struct AcceptorShard {
+        std::shared_ptr<ASIOReactor> reactor;
+        std::vector<GenericAcceptor> acceptors;
+        stdx::thread thread;
+    };
+    std::vector<std::unique_ptr<AcceptorShard>> _acceptorShards;
+
     // Only used if _listenerOptions.async is false.
     stdx::thread _listenerThread;
 
+    // Set if _listenerThread is accepting connections with io_uring.
+    std::unique_ptr<IOUringListener> _ioUringListener;
+
+#ifdef MONGO_TRANSPORT_HAS_ZERO_COPY_SEND
+    // Reaps zero-copy completions for sessions destroyed with sends still pending.
+    ZeroCopyReaper _zeroCopyReaper;
+#endif
+
     ServiceEntryPoint* const _sep = nullptr;
     AtomicWord<bool> _running{false};
     Options _listenerOptions;
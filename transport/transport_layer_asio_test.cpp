@@ -21,14 +21,22 @@
 
 #include "mongo/db/server_options.h"
 #include "mongo/rpc/op_msg.h"
+#include "mongo/stdx/functional.h"
 #include "mongo/transport/service_entry_point.h"
+#include "mongo/transport/zero_copy_send_linux.h"
 #include "mongo/unittest/unittest.h"
 #include "mongo/util/assert_util.h"
 #include "mongo/util/log.h"
 #include "mongo/util/net/sock.h"
+#include "mongo/util/time_support.h"
 
 #include "asio.hpp"
 
+// io_uring_linux.h logs, so it needs log.h included before it.
+#ifdef __linux__
+#include "mongo/transport/io_uring_linux.h"
+#endif
+
 namespace mongo {
 namespace {
 
@@ -72,9 +80,9 @@ public:
         _transport = tl;
     }
 
-    void waitForConnect() {
+    void waitForConnect(size_t numSessions = 1) {
         stdx::unique_lock<stdx::mutex> lock(_mutex);
-        _cv.wait(lock, [&] { return !_sessions.empty(); });
+        _cv.wait(lock, [&] { return _sessions.size() >= numSessions; });
     }
 
 private:
@@ -147,6 +155,83 @@ TEST(TransportLayerASIO, PortZeroConnect) {
     tla.shutdown();
 }
 
+TEST(TransportLayerASIO, ReusePortAcceptorThreadsConnect) {
+    ServiceEntryPointUtil sepu;
+
+    auto options = [] {
+        ServerGlobalParams params;
+        params.noUnixSocket = true;
+        transport::TransportLayerASIO::Options opts(&params);
+        opts.port = 0;
+        opts.acceptorThreads = 4;
+        return opts;
+    }();
+
+    transport::TransportLayerASIO tla(options, &sepu);
+    sepu.setTransportLayer(&tla);
+
+    ASSERT_OK(tla.setup());
+    ASSERT_OK(tla.start());
+    int port = tla.listenerPort();
+    ASSERT_GT(port, 0);
+
+    const size_t kConnections = 16;
+    std::vector<std::unique_ptr<SimpleConnectionThread>> connectThreads;
+    for (size_t i = 0; i < kConnections; ++i) {
+        connectThreads.push_back(stdx::make_unique<SimpleConnectionThread>(port));
+    }
+
+    sepu.waitForConnect(kConnections);
+    for (auto& connectThread : connectThreads) {
+        connectThread->stop();
+    }
+    sepu.endAllSessions({});
+    tla.shutdown();
+}
+
+TEST(TransportLayerASIO, IngressReactorsConnect) {
+    ServiceEntryPointUtil sepu;
+
+    auto options = [] {
+        ServerGlobalParams params;
+        params.noUnixSocket = true;
+        transport::TransportLayerASIO::Options opts(&params);
+        opts.port = 0;
+        opts.ingressReactors = 3;
+        return opts;
+    }();
+
+    transport::TransportLayerASIO tla(options, &sepu);
+    sepu.setTransportLayer(&tla);
+
+    auto reactors = tla.getIngressReactors();
+    ASSERT_EQ(reactors.size(), 3U);
+    ASSERT(reactors.front() == tla.getReactor(transport::TransportLayer::kIngress));
+
+    ASSERT_OK(tla.setup());
+    ASSERT_OK(tla.start());
+    int port = tla.listenerPort();
+    ASSERT_GT(port, 0);
+
+    const size_t kConnections = 6;
+    std::vector<std::unique_ptr<SimpleConnectionThread>> connectThreads;
+    for (size_t i = 0; i < kConnections; ++i) {
+        connectThreads.push_back(stdx::make_unique<SimpleConnectionThread>(port));
+    }
+
+    sepu.waitForConnect(kConnections);
+
+    // Each connection goes to the reactor with the fewest sessions when it's accepted
+    ASSERT(tla.getIngressReactorSessions() == std::vector<int64_t>(3, kConnections / 3));
+
+    for (auto& connectThread : connectThreads) {
+        connectThread->stop();
+    }
+    sepu.endAllSessions({});
+    ASSERT(tla.getIngressReactorSessions() == std::vector<int64_t>(3, 0));
+    tla.shutdown();
+}
+
 class TimeoutSEP : public ServiceEntryPoint {
 public:
     void endAllSessions(transport::Session::TagMask tags) override {
@@ -248,18 +333,52 @@ public:
         ASSERT_FALSE(ec);
     }
 
+    Message receiveMessage() {
+        const auto headerSize = sizeof(MSGHEADER::Value);
+        std::error_code ec;
+        char header[headerSize];
+        asio::read(_sock, asio::buffer(header, headerSize), ec);
+        ASSERT_FALSE(ec);
+
+        const auto size = size_t(MSGHEADER::ConstView(header).getMessageLength());
+        auto buffer = SharedBuffer::allocate(size);
+        memcpy(buffer.get(), header, headerSize);
+        asio::read(_sock, asio::buffer(buffer.get() + headerSize, size - headerSize), ec);
+        ASSERT_FALSE(ec);
+        return Message(std::move(buffer));
+    }
+
+    // Reads whatever arrives until the server closes the connection, and returns how many bytes
+    // that was.
+    size_t receiveUntilClosed() {
+        std::vector<char> buffer(64 * 1024);
+        size_t received = 0;
+        std::error_code ec;
+        while (!ec) {
+            received += _sock.read_some(asio::buffer(buffer), ec);
+        }
+        ASSERT_EQ(ec, asio::error::eof);
+        return received;
+    }
+
 private:
     asio::io_context _ctx;
     asio::ip::tcp::socket _sock;
     asio::ip::tcp::endpoint _endpoint;
 };
 
-std::unique_ptr<transport::TransportLayerASIO> makeAndStartTL(ServiceEntryPoint* sep) {
-    auto options = [] {
+using OptionsMutator = stdx::function<void(transport::TransportLayerASIO::Options*)>;
+
+std::unique_ptr<transport::TransportLayerASIO> makeAndStartTL(
+    ServiceEntryPoint* sep, const OptionsMutator& mutateOptions = nullptr) {
+    auto options = [&] {
         ServerGlobalParams params;
         params.noUnixSocket = true;
         transport::TransportLayerASIO::Options opts(&params);
         opts.port = 0;
+        if (mutateOptions) {
+            mutateOptions(&opts);
+        }
         return opts;
     }();
 
@@ -346,5 +465,388 @@ TEST(TransportLayerASIO, SwitchTimeoutModes) {
     tla->shutdown();
 }
 
+/* check that messages sunk as several buffers arrive whole, and that pipelined messages are each
+ * sourced whole */
+class EchoBuffersSEP : public TimeoutSEP {
+public:
+    void startSession(transport::SessionHandle session) override {
+        stdx::thread([ this, session = std::move(session) ]() mutable {
+            const auto headerSize = sizeof(MSGHEADER::Value);
+            for (int i = 0; i < 2; ++i) {
+                auto swMessage = session->sourceMessage();
+                ASSERT_OK(swMessage.getStatus());
+
+                const auto& message = swMessage.getValue();
+                std::vector<ConstDataRange> buffers{
+                    ConstDataRange(message.buf(), headerSize),
+                    ConstDataRange(message.buf() + headerSize, message.size() - headerSize)};
+                ASSERT_OK(session->sinkBuffers(buffers));
+            }
+
+            session.reset();
+            notifyComplete();
+        }).detach();
+    }
+};
+
+TEST(TransportLayerASIO, SinkBuffersEchoesPipelinedMessages) {
+    EchoBuffersSEP sep;
+    auto tla = makeAndStartTL(&sep);
+
+    TimeoutConnector connector(tla->listenerPort(), false);
+    connector.sendMessage();
+    connector.sendMessage();
+
+    for (int i = 0; i < 2; ++i) {
+        auto echoed = OpMsg::parse(connector.receiveMessage());
+        ASSERT_BSONOBJ_EQ(echoed.body, BSON("ping" << 1));
+    }
+
+    ASSERT_TRUE(sep.waitForTimeout());
+    tla->shutdown();
+}
+
+/* check that replies left for the next read by sinkMessageBeforeSource() reach the client, whether
+ * or not io_uring is available to send them */
+class EchoBeforeSourceSEP : public TimeoutSEP {
+public:
+    void startSession(transport::SessionHandle session) override {
+        stdx::thread([ this, session = std::move(session) ]() mutable {
+            for (int i = 0; i < 3; ++i) {
+                auto swMessage = session->sourceMessage();
+                ASSERT_OK(swMessage.getStatus());
+                ASSERT_OK(session->sinkMessageBeforeSource(swMessage.getValue()));
+            }
+
+            // The client hangs up once it has all three replies
+            ASSERT_NOT_OK(session->sourceMessage().getStatus());
+
+            session.reset();
+            notifyComplete();
+        }).detach();
+    }
+};
+
+TEST(TransportLayerASIO, IOUringSessionSendsRepliesWithNextRead) {
+    EchoBeforeSourceSEP sep;
+    auto tla = makeAndStartTL(&sep, [](transport::TransportLayerASIO::Options* opts) {
+        opts->useIOUring = true;
+    });
+
+    {
+        TimeoutConnector connector(tla->listenerPort(), false);
+        connector.sendMessage();
+        connector.sendMessage();
+        for (int i = 0; i < 2; ++i) {
+            auto echoed = OpMsg::parse(connector.receiveMessage());
+            ASSERT_BSONOBJ_EQ(echoed.body, BSON("ping" << 1));
+        }
+
+        connector.sendMessage();
+        auto echoed = OpMsg::parse(connector.receiveMessage());
+        ASSERT_BSONOBJ_EQ(echoed.body, BSON("ping" << 1));
+    }
+
+    ASSERT_TRUE(sep.waitForTimeout());
+    tla->shutdown();
+}
+
+/* hands each session to the test, which drives it from its own thread */
+class SessionHolderSEP : public TimeoutSEP {
+public:
+    void startSession(transport::SessionHandle session) override {
+        {
+            stdx::lock_guard<stdx::mutex> lk(_mutex);
+            _session = std::move(session);
+        }
+        notifyComplete();
+    }
+
+    transport::SessionHandle waitForSession() {
+        ASSERT_TRUE(waitForTimeout());
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        return std::move(_session);
+    }
+
+private:
+    stdx::mutex _mutex;
+    transport::SessionHandle _session;
+};
+
+Message makeSequencedMessage(int seq, size_t payloadBytes) {
+    OpMsgBuilder builder;
+    builder.setBody(BSON("seq" << seq << "payload" << std::string(payloadBytes, 'x')));
+    Message msg = builder.finish();
+    msg.header().setResponseToMsgId(0);
+    msg.header().setId(0);
+    return msg;
+}
+
+// Too big to fit in the socket buffers of a loopback connection whose client isn't reading, so
+// that writes sunk after it have to queue up
+const size_t kLargePayloadBytes = 12 * 1024 * 1024;
+
+#ifdef MONGO_TRANSPORT_HAS_IO_URING
+/* check that a reply left for the next read still goes out if the session ends first, as much of
+ * it as fits in the socket's send buffer, since end() mustn't block */
+TEST(TransportLayerASIO, IOUringSessionEndSendsDeferredReply) {
+    if (!transport::IOUringSocketIO::make()) {
+        log() << "Skipping test since the kernel can't send and receive through io_uring";
+        return;
+    }
+
+    SessionHolderSEP sep;
+    auto tla = makeAndStartTL(&sep, [](transport::TransportLayerASIO::Options* opts) {
+        opts->useIOUring = true;
+    });
+
+    for (auto payloadBytes : {size_t(16), kLargePayloadBytes}) {
+        TimeoutConnector connector(tla->listenerPort(), true);
+        auto session = sep.waitForSession();
+        ASSERT_OK(session->sourceMessage().getStatus());
+
+        const auto reply = makeSequencedMessage(0, payloadBytes);
+        ASSERT_OK(session->sinkMessageBeforeSource(reply));
+        session->end();
+
+        const auto received = connector.receiveUntilClosed();
+        if (payloadBytes < kLargePayloadBytes) {
+            ASSERT_EQ(received, size_t(reply.size()));
+        } else {
+            // The client isn't reading, so the rest is dropped rather than waited for
+            ASSERT_GT(received, 0UL);
+            ASSERT_LT(received, size_t(reply.size()));
+        }
+        session.reset();
+    }
+
+    tla->shutdown();
+}
+#endif
+
+/* runs the ingress reactor, which completes async session operations, for as long as it lives */
+class ReactorThread {
+public:
+    explicit ReactorThread(transport::TransportLayer* tl)
+        : _reactor(tl->getReactor(transport::TransportLayer::kIngress)),
+          _thread([this] { _reactor->run(); }) {}
+
+    ~ReactorThread() {
+        _reactor->stop();
+        _thread.join();
+    }
+
+private:
+    transport::ReactorHandle _reactor;
+    stdx::thread _thread;
+};
+
+void enableCoalescing(transport::TransportLayerASIO::Options* opts) {
+    opts->coalesceWrites = true;
+}
+
+/* check that messages sunk while a write is in flight go out whole and in order */
+TEST(TransportLayerASIO, CoalescedWritesArriveInOrder) {
+    SessionHolderSEP sep;
+    auto tla = makeAndStartTL(&sep, enableCoalescing);
+    ReactorThread reactorThread(tla.get());
+
+    TimeoutConnector connector(tla->listenerPort(), false);
+    auto session = sep.waitForSession();
+
+    std::vector<Future<void>> sunk;
+    sunk.push_back(session->asyncSinkMessage(makeSequencedMessage(0, kLargePayloadBytes)));
+    for (int i = 1; i < 4; ++i) {
+        sunk.push_back(session->asyncSinkMessage(makeSequencedMessage(i, 16)));
+    }
+    ASSERT_FALSE(sunk.back().isReady());
+
+    for (int i = 0; i < 4; ++i) {
+        auto received = OpMsg::parse(connector.receiveMessage());
+        ASSERT_EQ(received.body["seq"].Int(), i);
+    }
+    for (auto& future : sunk) {
+        ASSERT_OK(std::move(future).getNoThrow());
+    }
+
+    session.reset();
+    tla->shutdown();
+}
+
+/* check that when a write fails, the writes queued behind it fail rather than go out after it */
+TEST(TransportLayerASIO, CoalescedWriteErrorFailsQueuedWrites) {
+    SessionHolderSEP sep;
+    auto tla = makeAndStartTL(&sep, enableCoalescing);
+    ReactorThread reactorThread(tla.get());
+
+    std::vector<Future<void>> sunk;
+    transport::SessionHandle session;
+    {
+        TimeoutConnector connector(tla->listenerPort(), false);
+        session = sep.waitForSession();
+
+        sunk.push_back(session->asyncSinkMessage(makeSequencedMessage(0, kLargePayloadBytes)));
+        for (int i = 1; i < 4; ++i) {
+            sunk.push_back(session->asyncSinkMessage(makeSequencedMessage(i, 16)));
+        }
+        ASSERT_FALSE(sunk.front().isReady());
+
+        // Closing the connection with unread data resets it, which fails the write in flight
+    }
+
+    for (auto& future : sunk) {
+        ASSERT_NOT_OK(std::move(future).getNoThrow());
+    }
+
+    session.reset();
+    tla->shutdown();
+}
+
+/* check that cancelling a session's operations also fails the writes queued behind the one in
+ * flight */
+TEST(TransportLayerASIO, CancelFailsQueuedWrites) {
+    SessionHolderSEP sep;
+    auto tla = makeAndStartTL(&sep, enableCoalescing);
+    ReactorThread reactorThread(tla.get());
+
+    TimeoutConnector connector(tla->listenerPort(), false);
+    auto session = sep.waitForSession();
+
+    auto inFlight = session->asyncSinkMessage(makeSequencedMessage(0, kLargePayloadBytes));
+    auto queued = session->asyncSinkMessage(makeSequencedMessage(1, 16));
+    session->cancelAsyncOperations();
+
+    ASSERT_NOT_OK(std::move(inFlight).getNoThrow());
+    ASSERT_EQ(std::move(queued).getNoThrow(), ErrorCodes::CallbackCanceled);
+
+    session.reset();
+    tla->shutdown();
+}
+
+#ifdef MONGO_TRANSPORT_HAS_ZERO_COPY_SEND
+/* a connected pair of loopback TCP sockets */
+class LoopbackConnection {
+public:
+    LoopbackConnection()
+        : _acceptor(_context, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0)),
+          _sender(_context),
+          _receiver(_context) {
+        _sender.connect(_acceptor.local_endpoint());
+        _acceptor.accept(_receiver);
+    }
+
+    int senderFd() {
+        return _sender.native_handle();
+    }
+
+    void closeSender() {
+        _sender.shutdown(asio::ip::tcp::socket::shutdown_both);
+        _sender.close();
+    }
+
+    std::string receive(size_t bytes) {
+        std::string data(bytes, '\0');
+        asio::read(_receiver, asio::buffer(&data[0], bytes));
+        return data;
+    }
+
+private:
+    asio::io_context _context;
+    asio::ip::tcp::acceptor _acceptor;
+    asio::ip::tcp::socket _sender;
+    asio::ip::tcp::socket _receiver;
+};
+
+template <typename Condition>
+bool waitUntil(Condition condition) {
+    const auto deadline = Date_t::now() + Seconds{10};
+    while (!condition()) {
+        if (Date_t::now() > deadline) {
+            return false;
+        }
+        sleepmillis(10);
+    }
+    return true;
+}
+
+/* check that each zero-copy send holds its message until its completion is reaped */
+TEST(TransportLayerASIO, ZeroCopySenderHoldsMessagesUntilReaped) {
+    LoopbackConnection connection;
+    transport::ZeroCopySender sender;
+    if (!sender.enable(connection.senderFd())) {
+        log() << "Skipping test since the kernel doesn't support zero-copy sends";
+        return;
+    }
+
+    std::vector<Message> messages;
+    for (int i = 0; i < 3; ++i) {
+        messages.push_back(makeSequencedMessage(i, 4096));
+        const auto& message = messages.back();
+        ASSERT_EQ(sender.send(connection.senderFd(), message.buf(), message.size(), message),
+                  message.size());
+    }
+    ASSERT_EQ(sender.numPending(), 3UL);
+    for (const auto& message : messages) {
+        ASSERT_TRUE(message.sharedBuffer().isShared());
+    }
+
+    for (const auto& message : messages) {
+        ASSERT_EQ(connection.receive(message.size()), std::string(message.buf(), message.size()));
+    }
+
+    ASSERT_TRUE(waitUntil([&] {
+        sender.reapCompletions(connection.senderFd());
+        return sender.numPending() == 0;
+    }));
+    for (const auto& message : messages) {
+        ASSERT_FALSE(message.sharedBuffer().isShared());
+    }
+}
+
+/* check that the reaper keeps a sender's messages after its socket is closed, until the kernel is
+ * done with them */
+TEST(TransportLayerASIO, ZeroCopyReaperReapsClosedSockets) {
+    LoopbackConnection connection;
+    transport::ZeroCopyReaper reaper;
+    auto sender = stdx::make_unique<transport::ZeroCopySender>();
+    if (!sender->enable(connection.senderFd())) {
+        log() << "Skipping test since the kernel doesn't support zero-copy sends";
+        return;
+    }
+
+    auto message = makeSequencedMessage(0, 4096);
+    ASSERT_EQ(sender->send(connection.senderFd(), message.buf(), message.size(), message),
+              message.size());
+    reaper.add(std::move(sender), connection.senderFd());
+    connection.closeSender();
+
+    ASSERT_EQ(connection.receive(message.size()), std::string(message.buf(), message.size()));
+    ASSERT_TRUE(waitUntil([&] { return reaper.numSenders() == 0; }));
+    ASSERT_FALSE(message.sharedBuffer().isShared());
+}
+
+/* check that a message sent with MSG_ZEROCOPY arrives intact after its session is destroyed */
+TEST(TransportLayerASIO, ZeroCopySendOutlivesSession) {
+    SessionHolderSEP sep;
+    auto tla = makeAndStartTL(&sep, [](transport::TransportLayerASIO::Options* opts) {
+        opts->zeroCopySendThresholdBytes = 1;
+    });
+
+    TimeoutConnector connector(tla->listenerPort(), false);
+    auto session = sep.waitForSession();
+
+    // Nothing else holds the message, so it's only kept alive for the kernel by the reaper
+    ASSERT_OK(session->sinkMessage(makeSequencedMessage(0, 64 * 1024)));
+    session->end();
+    session.reset();
+
+    auto received = OpMsg::parse(connector.receiveMessage());
+    ASSERT_EQ(received.body["seq"].Int(), 0);
+    ASSERT_EQ(received.body["payload"].String(), std::string(64 * 1024, 'x'));
+
+    tla->shutdown();
+}
+#endif
+
 }  // namespace
 }  // namespace mongo
@@ -24,10 +24,13 @@
 #include "mongo/stdx/memory.h"
 #include "mongo/transport/service_executor_adaptive.h"
 #include "mongo/transport/service_executor_synchronous.h"
+#include "mongo/transport/service_executor_thread_per_core.h"
 #include "mongo/transport/session.h"
 #include "mongo/transport/transport_layer_asio.h"
 #include "mongo/util/net/ssl_types.h"
+#include "mongo/util/processinfo.h"
 #include "mongo/util/time_support.h"
+#include <algorithm>
 #include <limits>
 
 #include <iostream>
@@ -121,6 +124,10 @@ std::unique_ptr<TransportLayer> TransportLayerManager::createWithConfig(
     transport::TransportLayerASIO::Options opts(config);
     if (config->serviceExecutor == "adaptive") {
         opts.transportMode = transport::Mode::kAsynchronous;
+    } else if (config->serviceExecutor == "threadPerCore") {
+        // The executor runs one thread per ingress reactor, so give it one reactor per core
+        opts.transportMode = transport::Mode::kAsynchronous;
+        opts.ingressReactors = std::max<size_t>(ProcessInfo::getNumAvailableCores(), 1);
     } else if (config->serviceExecutor == "synchronous") {
         opts.transportMode = transport::Mode::kSynchronous;
     } else {
@@ -130,9 +137,13 @@ std::unique_ptr<TransportLayer> TransportLayerManager::createWithConfig(
     auto transportLayerASIO = stdx::make_unique<transport::TransportLayerASIO>(opts, sep);
 
     if (config->serviceExecutor == "adaptive") {
-        auto reactor = transportLayerASIO->getReactor(TransportLayer::kIngress);
+        auto reactors = transportLayerASIO->getIngressReactors();
+        ctx->setServiceExecutor(
+            stdx::make_unique<ServiceExecutorAdaptive>(ctx, std::move(reactors)));
+    } else if (config->serviceExecutor == "threadPerCore") {
+        auto reactors = transportLayerASIO->getIngressReactors();
         ctx->setServiceExecutor(
-            stdx::make_unique<ServiceExecutorAdaptive>(ctx, std::move(reactor)));
+            stdx::make_unique<ServiceExecutorThreadPerCore>(ctx, std::move(reactors)));
     } else if (config->serviceExecutor == "synchronous") {
         ctx->setServiceExecutor(stdx::make_unique<ServiceExecutorSynchronous>(ctx));
     }
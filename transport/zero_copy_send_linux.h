@@ -0,0 +1,292 @@
+/**
+ * Copyright (C) 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#ifdef __linux__
+#include <sys/socket.h>
+
+#if defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY) && defined(__has_include)
+#if __has_include(<linux/errqueue.h>)
+#define MONGO_TRANSPORT_HAS_ZERO_COPY_SEND 1
+#endif
+#endif
+#endif
+
+#ifdef MONGO_TRANSPORT_HAS_ZERO_COPY_SEND
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/stdx/condition_variable.h"
+#include "mongo/stdx/mutex.h"
+#include "mongo/stdx/thread.h"
+#include "mongo/util/duration.h"
+#include "mongo/util/net/message.h"
+
+namespace mongo {
+namespace transport {
+
+/**
+ * Sends on a socket with MSG_ZEROCOPY, so that the kernel transmits straight out of our buffers
+ * rather than copying them first.
+ *
+ * Since the kernel keeps reading from a buffer after send() returns, each Message sent here is held
+ * until the socket's error queue reports that the kernel is done with it. Completions are only
+ * picked up by reapCompletions(), so callers should call it whenever they're about to send or
+ * block on the socket, and hand the sender to a ZeroCopyReaper if they're done with the socket
+ * while sends are still pending. Pending completions also mark the socket with POLLERR.
+ *
+ * A ZeroCopySender may be used from several threads. send() holds its lock for as long as the
+ * send blocks.
+ */
+class ZeroCopySender {
+    MONGO_DISALLOW_COPYING(ZeroCopySender);
+
+public:
+    ZeroCopySender() = default;
+
+    /**
+     * Turns on SO_ZEROCOPY for "fd" the first time it's called. Returns false if zero-copy sends
+     * can't be used on this socket, either because the kernel refused or because it reported that
+     * it had to copy our buffers anyway, in which case plain sends are cheaper.
+     */
+    bool enable(int fd) {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        if (_state == State::kUnknown) {
+            const int one = 1;
+            const bool ok = ::setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+            _state = ok ? State::kEnabled : State::kDisabled;
+        }
+        return _state == State::kEnabled;
+    }
+
+    /**
+     * Does one send() of up to "len" bytes from "data", which must lie within "message". Returns
+     * the number of bytes sent, or -1 with errno set. ENOBUFS means too many sends are waiting on
+     * completions, and the caller should send some other way.
+     */
+    ssize_t send(int fd, const char* data, size_t len, const Message& message) {
+        // Held across the send, so that no completion for it can be reaped before it's pending
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        const auto sent = ::send(fd, data, len, MSG_ZEROCOPY | MSG_NOSIGNAL);
+        if (sent >= 0) {
+            // The kernel numbers each successful send, and reports completions by those numbers
+            _pending.push_back({_nextId++, message, false});
+        }
+        return sent;
+    }
+
+    /**
+     * Reads every completion waiting in "fd"'s error queue, releasing the Messages they cover.
+     */
+    void reapCompletions(int fd) {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        _reapCompletions(fd);
+    }
+
+    size_t numPending() const {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        return _pending.size();
+    }
+
+private:
+    enum class State { kUnknown, kEnabled, kDisabled };
+
+    struct PendingSend {
+        uint32_t id;
+        Message message;
+        bool completed = false;
+    };
+
+    void _reapCompletions(int fd) {
+        while (!_pending.empty()) {
+            char control[128];
+            msghdr msg;
+            std::memset(&msg, 0, sizeof(msg));
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+
+            if (::recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+                // EAGAIN means there's nothing more to read
+                return;
+            }
+
+            for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+                const bool isIPv4Err = cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR;
+                const bool isIPv6Err =
+                    cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR;
+                if (!isIPv4Err && !isIPv6Err) {
+                    continue;
+                }
+
+                sock_extended_err err;
+                std::memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+                if (err.ee_errno != 0 || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                    continue;
+                }
+
+                // The kernel copied the data after all, which costs more than a plain send
+                if (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                    _state = State::kDisabled;
+                }
+
+                // ee_info through ee_data is the range of sends which completed
+                _complete(err.ee_info, err.ee_data);
+            }
+        }
+    }
+
+    void _complete(uint32_t firstId, uint32_t lastId) {
+        // A completion for sends we've already released has nothing left to do
+        if (_pending.empty()) {
+            return;
+        }
+
+        // Ids wrap around, so index everything relative to the oldest pending send
+        const uint32_t oldestId = _pending.front().id;
+        for (uint32_t id = firstId;; ++id) {
+            const uint32_t index = id - oldestId;
+            if (index < _pending.size()) {
+                _pending[index].completed = true;
+            }
+            if (id == lastId) {
+                break;
+            }
+        }
+
+        // Completions usually arrive in order, but aren't guaranteed to
+        while (!_pending.empty() && _pending.front().completed) {
+            _pending.pop_front();
+        }
+    }
+
+    mutable stdx::mutex _mutex;
+    State _state = State::kUnknown;
+    uint32_t _nextId = 0;
+    std::deque<PendingSend> _pending;
+};
+
+/**
+ * Takes the ZeroCopySenders of sessions which are destroyed with sends still pending, and keeps
+ * their Messages until the kernel is done with them.
+ *
+ * Each sender is reaped in the background through its own duplicate of its socket, which keeps the
+ * socket's error queue readable after the session closes it. A sender is dropped, and its duplicate
+ * closed, once none of its sends are pending.
+ */
+class ZeroCopyReaper {
+    MONGO_DISALLOW_COPYING(ZeroCopyReaper);
+
+public:
+    ZeroCopyReaper() = default;
+
+    ~ZeroCopyReaper() {
+        {
+            stdx::lock_guard<stdx::mutex> lk(_mutex);
+            _inShutdown = true;
+        }
+        _cv.notify_all();
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+
+        for (auto& entry : _senders) {
+            if (entry.sender->numPending()) {
+                _abort(entry.fd);
+            }
+            ::close(entry.fd);
+        }
+    }
+
+    /**
+     * Takes "sender", which sends on "fd", and reaps it until none of its sends are pending. "fd"
+     * may be closed once this returns.
+     */
+    void add(std::unique_ptr<ZeroCopySender> sender, int fd) {
+        const int dupFd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (dupFd < 0) {
+            _abort(fd);
+            return;
+        }
+
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        _senders.push_back({std::move(sender), dupFd});
+        if (!_thread.joinable()) {
+            _thread = stdx::thread([this] { _run(); });
+        }
+    }
+
+    size_t numSenders() const {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        return _senders.size();
+    }
+
+private:
+    struct Entry {
+        std::unique_ptr<ZeroCopySender> sender;
+        int fd;
+    };
+
+    // Nothing will read the completions for "fd" now, so reset the connection to stop the kernel
+    // from sending out of buffers that are about to be freed
+    static void _abort(int fd) {
+        const linger abort{1, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+    }
+
+    void _run() {
+        const auto kReapInterval = Milliseconds{100};
+
+        stdx::unique_lock<stdx::mutex> lk(_mutex);
+        while (!_inShutdown) {
+            for (auto it = _senders.begin(); it != _senders.end();) {
+                if (it->sender->numPending()) {
+                    it->sender->reapCompletions(it->fd);
+                }
+                if (it->sender->numPending()) {
+                    ++it;
+                    continue;
+                }
+
+                ::close(it->fd);
+                it = _senders.erase(it);
+            }
+
+            _cv.wait_for(lk, kReapInterval.toSystemDuration(), [&] { return _inShutdown; });
+        }
+    }
+
+    mutable stdx::mutex _mutex;
+    stdx::condition_variable _cv;
+    bool _inShutdown = false;
+    std::vector<Entry> _senders;
+    stdx::thread _thread;
+};
+
+}  // namespace transport
+}  // namespace mongo
+
+#endif  // MONGO_TRANSPORT_HAS_ZERO_COPY_SEND
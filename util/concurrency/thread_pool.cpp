@@ -20,13 +20,19 @@
 
 #include "mongo/util/concurrency/thread_pool.h"
 
+#include <algorithm>
+#include <boost/optional.hpp>
+
 #include "mongo/base/status.h"
 #include "mongo/platform/atomic_word.h"
+#include "mongo/stdx/memory.h"
 #include "mongo/util/assert_util.h"
 #include "mongo/util/concurrency/idle_thread_block.h"
 #include "mongo/util/concurrency/thread_name.h"
 #include "mongo/util/log.h"
 #include "mongo/util/mongoutils/str.h"
+#include "mongo/util/scopeguard.h"
+#include "mongo/util/system_tick_source.h"
 
 namespace mongo {
 
@@ -35,6 +41,28 @@ namespace {
 // Counter used to assign unique names to otherwise-unnamed thread pools.
 AtomicInt32 nextUnnamedThreadPoolId{1};
 
+// Maximum number of tasks a thread runs from worker deques per acquisition of the pool's mutex.
+// This amortizes the mutex, while still having threads regularly check the shared queue and the
+// pool's lifecycle state.
+const int kMaxLocalTasksPerBatch = 64;
+
+Microseconds ticksToMicros(TickSource::Tick ticks, TickSource* tickSource) {
+    const auto ticksPerSecond = tickSource->getTicksPerSecond();
+    if (ticksPerSecond >= 1000000) {
+        return Microseconds{ticks / (ticksPerSecond / 1000000)};
+    }
+    return Microseconds{ticks * (1000000 / ticksPerSecond)};
+}
+
+Milliseconds ticksToMillis(TickSource::Tick ticks, TickSource* tickSource) {
+    return Milliseconds{ticks * 1000 / tickSource->getTicksPerSecond()};
+}
+
+Status shutdownInProgressStatus(const std::string& poolName) {
+    return Status(ErrorCodes::ShutdownInProgress,
+                  str::stream() << "Shutdown of thread pool " << poolName << " in progress");
+}
+
 /**
  * Sets defaults and checks bounds limits on "options", and returns it.
  *
@@ -63,7 +91,20 @@ ThreadPool::Options cleanUpOptions(ThreadPool::Options&& options) {
 
 }  // namespace
 
-ThreadPool::ThreadPool(Options options) : _options(cleanUpOptions(std::move(options))) {}
+thread_local ThreadPool::WorkerSlot* ThreadPool::_currentWorkerSlot = nullptr;
+
+ThreadPool::ThreadPool(Options options)
+    : _options(cleanUpOptions(std::move(options))),
+      _tickSource(_options.tickSource ? _options.tickSource : SystemTickSource::get()),
+      _workerSlots([this] {
+          std::vector<std::unique_ptr<WorkerSlot>> slots;
+          if (_options.workStealing) {
+              for (size_t i = 0; i < _options.maxThreads; ++i) {
+                  slots.emplace_back(stdx::make_unique<WorkerSlot>(this, i));
+              }
+          }
+          return slots;
+      }()) {}
 
 ThreadPool::~ThreadPool() {
     stdx::unique_lock<stdx::mutex> lk(_mutex);
@@ -77,7 +118,8 @@ ThreadPool::~ThreadPool() {
         fassertFailed(28704);
     }
     invariant(_threads.empty());
-    invariant(_pendingTasks.empty());
+    invariant(!_numPendingTasks);
+    invariant(!_numQueuedLocalTasks.load());
 }
 
 void ThreadPool::startup() {
@@ -90,7 +132,7 @@ void ThreadPool::startup() {
     _setState_inlock(running);
     invariant(_threads.empty());
     const size_t numToStart =
-        std::min(_options.maxThreads, std::max(_options.minThreads, _pendingTasks.size()));
+        std::min(_options.maxThreads, std::max(_options.minThreads, _numPendingTasks));
     for (size_t i = 0; i < numToStart; ++i) {
         _startWorkerThread_inlock();
     }
@@ -106,6 +148,7 @@ void ThreadPool::_shutdown_inlock() {
         case preStart:
         case running:
             _setState_inlock(joinRequired);
+            _shutdownStarted.store(true);
             _workAvailable.notify_all();
             return;
         case joinRequired:
@@ -145,7 +188,7 @@ void ThreadPool::_join_inlock(stdx::unique_lock<stdx::mutex>* lk) {
     });
     _setState_inlock(joining);
     ++_numIdleThreads;
-    if (!_pendingTasks.empty()) {
+    if (_numPendingTasks) {
         lk->unlock();
         _drainPendingTasks();
         lk->lock();
@@ -153,6 +196,7 @@ void ThreadPool::_join_inlock(stdx::unique_lock<stdx::mutex>* lk) {
     --_numIdleThreads;
     ThreadList threadsToJoin;
     swap(threadsToJoin, _threads);
+    _numThreads.store(0);
     lk->unlock();
     for (auto& t : threadsToJoin) {
         t.join();
@@ -171,7 +215,7 @@ void ThreadPool::_drainPendingTasks() {
         setThreadName(threadName);
         _options.onCreateThread(threadName);
         stdx::unique_lock<stdx::mutex> lock(_mutex);
-        while (!_pendingTasks.empty()) {
+        while (_numPendingTasks) {
             _doOneTask(&lock);
         }
     });
@@ -179,60 +223,122 @@ void ThreadPool::_drainPendingTasks() {
 }
 
 Status ThreadPool::schedule(Task task) {
+    const auto slot = _currentWorkerSlot;
+    if (slot && slot->pool == this) {
+        return _scheduleLocal(slot, std::move(task));
+    }
+    return schedule(std::move(task), Priority::kNormal);
+}
+
+Status ThreadPool::schedule(Task task, Priority priority, Date_t deadline) {
+    invariant(priority < Priority::kMax);
+    const auto laneIndex = static_cast<size_t>(priority);
+
     stdx::lock_guard<stdx::mutex> lk(_mutex);
     switch (_state) {
         case joinRequired:
         case joining:
         case shutdownComplete:
-            return Status(ErrorCodes::ShutdownInProgress,
-                          str::stream() << "Shutdown of thread pool " << _options.poolName
-                                        << " in progress");
+            return shutdownInProgressStatus(_options.poolName);
         case preStart:
         case running:
             break;
         default:
             MONGO_UNREACHABLE;
     }
-    _pendingTasks.emplace_back(std::move(task));
+
+    // Keep the lane ordered by deadline. Tasks without one have the maximum deadline, so the
+    // common case is an append.
+    auto& lane = _pendingTasks[laneIndex];
+    const auto pos =
+        std::upper_bound(lane.begin(), lane.end(), deadline, [](Date_t d, const QueuedTask& t) {
+            return d < t.deadline;
+        });
+    lane.insert(pos, QueuedTask{std::move(task), deadline, _tickSource->getTicks()});
+    ++_numPendingTasks;
+    ++_laneMetrics[laneIndex].totalQueued;
+
     if (_state == preStart) {
         return Status::OK();
     }
-    if (_numIdleThreads < _pendingTasks.size()) {
+    if (_numIdleThreads < _numPendingTasks) {
         _startWorkerThread_inlock();
     }
-    if (_numIdleThreads <= _pendingTasks.size()) {
+    if (_numIdleThreads <= _numPendingTasks) {
         _lastFullUtilizationDate = Date_t::now();
     }
     _workAvailable.notify_one();
     return Status::OK();
 }
 
+Status ThreadPool::_scheduleLocal(WorkerSlot* slot, Task task) {
+    if (_shutdownStarted.load()) {
+        return shutdownInProgressStatus(_options.poolName);
+    }
+
+    // Count the task before pushing it, so that the counts never go negative when a thief takes it
+    // straight away. Counting it before looking for sleeping threads pairs with _consumeTasks(),
+    // which registers as sleeping before checking for tasks one last time.
+    _numUnfinishedLocalTasks.fetchAndAdd(1);
+    _numQueuedLocalTasks.fetchAndAdd(1);
+    slot->tasks.push(new Task(std::move(task)));
+
+    if (_numSleepingThreads.load()) {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        _workAvailable.notify_one();
+    } else if (_numThreads.load() < static_cast<long long>(_options.maxThreads)) {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        if (_numIdleThreads == 0) {
+            _startWorkerThread_inlock();
+        }
+    }
+    return Status::OK();
+}
+
 void ThreadPool::waitForIdle() {
     stdx::unique_lock<stdx::mutex> lk(_mutex);
     // If there are any pending tasks, or non-idle threads, the pool is not idle.
-    while (!_pendingTasks.empty() || _numIdleThreads < _threads.size()) {
+    while (!_isIdle_inlock()) {
         _poolIsIdle.wait(lk);
     }
 }
 
+bool ThreadPool::_isIdle_inlock() const {
+    return !_numPendingTasks && _numIdleThreads >= _threads.size() &&
+        !_numUnfinishedLocalTasks.load();
+}
+
 ThreadPool::Stats ThreadPool::getStats() const {
     stdx::lock_guard<stdx::mutex> lk(_mutex);
     Stats result;
     result.options = _options;
     result.numThreads = _threads.size();
     result.numIdleThreads = _numIdleThreads;
-    result.numPendingTasks = _pendingTasks.size();
+    result.numPendingTasks = _numPendingTasks + _numQueuedLocalTasks.load();
     result.lastFullUtilizationDate = _lastFullUtilizationDate;
+    for (size_t i = 0; i < result.lanes.size(); ++i) {
+        const auto& metrics = _laneMetrics[i];
+        auto& lane = result.lanes[i];
+        lane.numPendingTasks = _pendingTasks[i].size();
+        lane.totalQueued = metrics.totalQueued;
+        lane.totalExecuted = metrics.totalExecuted;
+        lane.totalDeadlinesMissed = metrics.totalDeadlinesMissed;
+        lane.totalTimeQueued = ticksToMicros(metrics.totalSpentQueued, _tickSource);
+        lane.totalTimeExecuting = ticksToMicros(metrics.totalSpentExecuting, _tickSource);
+    }
     return result;
 }
 
-void ThreadPool::_workerThreadBody(ThreadPool* pool, const std::string& threadName) {
+void ThreadPool::_workerThreadBody(ThreadPool* pool,
+                                   const std::string& threadName,
+                                   WorkerSlot* slot) {
     setThreadName(threadName);
     pool->_options.onCreateThread(threadName);
     const auto poolName = pool->_options.poolName;
     LOG(1) << "starting thread in pool " << poolName;
+    _currentWorkerSlot = slot;
     try {
-        pool->_consumeTasks();
+        pool->_consumeTasks(slot);
     } catch (...) {
         severe() << "Exception reached top of stack in thread pool " << poolName << ": "
                  << exceptionToStatus();
@@ -246,13 +352,29 @@ void ThreadPool::_workerThreadBody(ThreadPool* pool, const std::string& threadNa
     // This can happen if this thread decided to retire, got descheduled after removing itself
     // from _threads and calling detach(), and then the pool was deleted. When this thread resumes,
     // it is no longer safe to access "pool".
+    _currentWorkerSlot = nullptr;
     LOG(1) << "shutting down thread in pool " << poolName;
 }
 
-void ThreadPool::_consumeTasks() {
+void ThreadPool::_consumeTasks(WorkerSlot* slot) {
     stdx::unique_lock<stdx::mutex> lk(_mutex);
     while (_state == running) {
-        if (_pendingTasks.empty()) {
+        if (slot && _numQueuedLocalTasks.load() > 0) {
+            _doLocalTasks(slot, &lk);
+            if (!_numPendingTasks) {
+                continue;
+            }
+        }
+
+        if (!_numPendingTasks) {
+            // Registering as sleeping before checking the worker deques one last time pairs with
+            // _scheduleLocal(), which counts its task before looking for sleeping threads to wake.
+            _numSleepingThreads.fetchAndAdd(1);
+            const auto sleepingGuard = MakeGuard([&] { _numSleepingThreads.fetchAndSubtract(1); });
+            if (_numQueuedLocalTasks.load() > 0) {
+                continue;
+            }
+
             if (_threads.size() > _options.minThreads) {
                 // Since there are more than minThreads threads, this thread may be eligible for
                 // retirement. If it isn't now, it may be later, so it must put a time limit on how
@@ -292,9 +414,16 @@ void ThreadPool::_consumeTasks() {
     // falls through to the detach code, below.
 
     if (_state == joinRequired || _state == joining) {
-        // Drain the leftover pending tasks.
-        while (!_pendingTasks.empty()) {
-            _doOneTask(&lk);
+        // Drain the leftover pending tasks, including those in worker deques.
+        while (_numPendingTasks || (slot && _numQueuedLocalTasks.load() > 0)) {
+            if (_numPendingTasks) {
+                _doOneTask(&lk);
+            } else {
+                _doLocalTasks(slot, &lk);
+            }
+        }
+        if (slot) {
+            slot->inUse = false;
         }
         --_numIdleThreads;
         return;
@@ -317,6 +446,11 @@ void ThreadPool::_consumeTasks() {
         t.detach();
         t.swap(_threads.back());
         _threads.pop_back();
+        _numThreads.store(_threads.size());
+        if (slot) {
+            // This thread only retires once every worker deque is empty, including its own.
+            slot->inUse = false;
+        }
         return;
     }
     severe().stream() << "Could not find this thread, with id " << stdx::this_thread::get_id()
@@ -325,17 +459,65 @@ void ThreadPool::_consumeTasks() {
 }
 
 void ThreadPool::_doOneTask(stdx::unique_lock<stdx::mutex>* lk) {
-    invariant(!_pendingTasks.empty());
+    invariant(_numPendingTasks);
     try {
         LOG(3) << "Executing a task on behalf of pool " << _options.poolName;
-        Task task = std::move(_pendingTasks.front());
-        _pendingTasks.pop_front();
+        const size_t laneIndex = _pickLane_inlock();
+        auto& lane = _pendingTasks[laneIndex];
+        Task task = std::move(lane.front().task);
+        const auto deadline = lane.front().deadline;
+        const auto queuedTicks = lane.front().queuedTicks;
+        lane.pop_front();
+        --_numPendingTasks;
+
+        auto& metrics = _laneMetrics[laneIndex];
+        const auto startTicks = _tickSource->getTicks();
+        metrics.totalSpentQueued += startTicks - queuedTicks;
+        if (deadline != Date_t::max() && Date_t::now() > deadline) {
+            ++metrics.totalDeadlinesMissed;
+        }
+
         --_numIdleThreads;
         lk->unlock();
         task();
+        // Destroy the task before taking the lock, like the tasks run from worker deques.
+        task = nullptr;
+        const auto endTicks = _tickSource->getTicks();
+        lk->lock();
+        ++metrics.totalExecuted;
+        metrics.totalSpentExecuting += endTicks - startTicks;
+        ++_numIdleThreads;
+        if (_isIdle_inlock()) {
+            _poolIsIdle.notify_all();
+        }
+    } catch (...) {
+        severe() << "Exception escaped task in thread pool " << _options.poolName << ": "
+                 << exceptionToStatus();
+        std::terminate();
+    }
+}
+
+void ThreadPool::_doLocalTasks(WorkerSlot* slot, stdx::unique_lock<stdx::mutex>* lk) {
+    try {
+        --_numIdleThreads;
+        lk->unlock();
+        for (int i = 0; i < kMaxLocalTasksPerBatch; ++i) {
+            std::unique_ptr<Task> task(_popOrStealTask(slot));
+            if (!task) {
+                break;
+            }
+            _numQueuedLocalTasks.fetchAndSubtract(1);
+
+            LOG(3) << "Executing a task on behalf of pool " << _options.poolName;
+            (*task)();
+            // Destroy the task before counting it as finished, so that whatever it captured is gone
+            // by the time waitForIdle() returns.
+            task.reset();
+            _numUnfinishedLocalTasks.fetchAndSubtract(1);
+        }
         lk->lock();
         ++_numIdleThreads;
-        if (_pendingTasks.empty() && _threads.size() == _numIdleThreads) {
+        if (_isIdle_inlock()) {
             _poolIsIdle.notify_all();
         }
     } catch (...) {
@@ -345,6 +527,68 @@ void ThreadPool::_doOneTask(stdx::unique_lock<stdx::mutex>* lk) {
     }
 }
 
+size_t ThreadPool::_pickLane_inlock() const {
+    size_t highestNonEmpty = _pendingTasks.size();
+    size_t oldestOverdue = _pendingTasks.size();
+    boost::optional<Date_t> now;
+    boost::optional<TickSource::Tick> nowTicks;
+
+    for (size_t i = 0; i < _pendingTasks.size(); ++i) {
+        const auto& lane = _pendingTasks[i];
+        if (lane.empty()) {
+            continue;
+        }
+        if (highestNonEmpty == _pendingTasks.size()) {
+            highestNonEmpty = i;
+        }
+
+        // Only read the clocks once there is a decision to make.
+        const auto& head = lane.front();
+        bool overdue = false;
+        if (head.deadline != Date_t::max()) {
+            if (!now) {
+                now = Date_t::now();
+            }
+            overdue = *now > head.deadline;
+        }
+        if (!overdue && i != highestNonEmpty) {
+            if (!nowTicks) {
+                nowTicks = _tickSource->getTicks();
+            }
+            overdue = ticksToMillis(*nowTicks - head.queuedTicks, _tickSource) >=
+                _options.maxStarvationDelay;
+        }
+        if (overdue &&
+            (oldestOverdue == _pendingTasks.size() ||
+             head.queuedTicks < _pendingTasks[oldestOverdue].front().queuedTicks)) {
+            oldestOverdue = i;
+        }
+    }
+
+    invariant(highestNonEmpty < _pendingTasks.size());
+    return oldestOverdue < _pendingTasks.size() ? oldestOverdue : highestNonEmpty;
+}
+
+ThreadPool::Task* ThreadPool::_popOrStealTask(WorkerSlot* slot) {
+    if (auto task = slot->tasks.pop()) {
+        return *task;
+    }
+
+    // Start from a random victim, so that thieves spread out over the busy threads.
+    const size_t numSlots = _workerSlots.size();
+    const size_t start = slot->random.nextInt64(numSlots);
+    for (size_t i = 0; i < numSlots && _numQueuedLocalTasks.load() > 0; ++i) {
+        const auto& victim = _workerSlots[(start + i) % numSlots];
+        if (victim.get() == slot) {
+            continue;
+        }
+        if (auto task = victim->tasks.steal()) {
+            return *task;
+        }
+    }
+    return nullptr;
+}
+
 void ThreadPool::_startWorkerThread_inlock() {
     switch (_state) {
         case preStart:
@@ -368,10 +612,23 @@ void ThreadPool::_startWorkerThread_inlock() {
         return;
     }
     invariant(_threads.size() < _options.maxThreads);
+    WorkerSlot* slot = nullptr;
+    for (const auto& candidate : _workerSlots) {
+        if (!candidate->inUse) {
+            slot = candidate.get();
+            break;
+        }
+    }
+    invariant(slot || _workerSlots.empty());
     const std::string threadName = str::stream() << _options.threadNamePrefix << _nextThreadId++;
     try {
-        _threads.emplace_back([this, threadName] { _workerThreadBody(this, threadName); });
+        _threads.emplace_back(
+            [this, threadName, slot] { _workerThreadBody(this, threadName, slot); });
+        if (slot) {
+            slot->inUse = true;
+        }
         ++_numIdleThreads;
+        _numThreads.store(_threads.size());
     } catch (const std::exception& ex) {
         error() << "Failed to start " << threadName << "; " << _threads.size()
                 << " other thread(s) still running in pool " << _options.poolName
@@ -16,16 +16,22 @@
 
 #pragma once
 
+#include <array>
 #include <deque>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "mongo/base/disallow_copying.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/platform/random.h"
 #include "mongo/stdx/condition_variable.h"
 #include "mongo/stdx/functional.h"
 #include "mongo/stdx/mutex.h"
 #include "mongo/stdx/thread.h"
 #include "mongo/util/concurrency/thread_pool_interface.h"
+#include "mongo/util/concurrency/work_stealing_deque.h"
+#include "mongo/util/tick_source.h"
 #include "mongo/util/time_support.h"
 
 namespace mongo {
@@ -41,6 +47,13 @@ class ThreadPool final : public ThreadPoolInterface {
     MONGO_DISALLOW_COPYING(ThreadPool);
 
 public:
+    /**
+     * Priority classes for scheduled tasks. Each has its own queue, or lane, and threads take tasks
+     * from the highest priority lane which has any, subject to the starvation and deadline rules
+     * described on schedule().
+     */
+    enum class Priority { kHigh, kNormal, kLow, kMax };
+
     /**
      * Structure used to configure an instance of ThreadPool.
      */
@@ -73,8 +86,45 @@ public:
         // This function is run before each worker thread begins consuming tasks.
         using OnCreateThreadFn = stdx::function<void(const std::string& threadName)>;
         OnCreateThreadFn onCreateThread = [](const std::string&) {};
+
+        // If true, each worker thread gets its own deque of tasks. Tasks scheduled by a task that
+        // is running in the pool go onto that thread's deque, where it finds them again without
+        // taking the pool's mutex, and threads which run out of work steal from the deques of
+        // randomly chosen busy threads. Tasks scheduled from outside the pool still go through the
+        // shared queue. Suits workloads which fan out into many sub-tasks from inside the pool.
+        bool workStealing = false;
+
+        // A task which has waited this long at the head of its lane runs ahead of tasks in higher
+        // priority lanes, so that a steady stream of high priority work can't starve lower lanes.
+        Milliseconds maxStarvationDelay = Milliseconds{100};
+
+        // Source of ticks for measuring how long tasks wait and run. If null, the pool uses the
+        // SystemTickSource.
+        TickSource* tickSource = nullptr;
+    };
+
+    /**
+     * Counters for the tasks scheduled into one priority lane, reported by getStats(). Tasks run
+     * from worker deques in work stealing mode are not included.
+     */
+    struct LaneStats {
+        // The number of tasks waiting in this lane.
+        size_t numPendingTasks = 0;
+
+        // The number of tasks ever scheduled into, and taken out of, this lane.
+        int64_t totalQueued = 0;
+        int64_t totalExecuted = 0;
+
+        // The number of tasks which only started after their deadline had passed.
+        int64_t totalDeadlinesMissed = 0;
+
+        // Total time tasks from this lane spent waiting to run, and running.
+        Microseconds totalTimeQueued{0};
+        Microseconds totalTimeExecuting{0};
     };
 
+    using LaneStatsArray = std::array<LaneStats, static_cast<size_t>(Priority::kMax)>;
+
     /**
      * Structure used to return information about the thread pool via getStats().
      */
@@ -93,6 +143,9 @@ public:
 
         // The last time that no threads in the pool were idle.
         Date_t lastFullUtilizationDate;
+
+        // Counters for each priority lane, indexed by Priority.
+        LaneStatsArray lanes;
     };
 
     /**
@@ -107,6 +160,23 @@ public:
     void join() override;
     Status schedule(Task task) override;
 
+    /**
+     * Schedules "task" to run in the lane for "priority", returning the same errors as
+     * schedule(Task).
+     *
+     * Within a lane, tasks run in order of "deadline", and in the order they were scheduled when
+     * their deadlines are the same. Tasks run from the highest priority lane first, except that a
+     * lane whose first task has missed its deadline, or has waited for at least
+     * Options::maxStarvationDelay, is served ahead of the others; if several lanes are in that
+     * state, the one whose first task was scheduled earliest goes first. Missing a deadline does
+     * not cancel a task.
+     *
+     * schedule(Task) is equivalent to scheduling with Priority::kNormal and no deadline, except
+     * that in work stealing mode, tasks it schedules from inside the pool go onto the calling
+     * thread's deque. Tasks scheduled with this function always go through the lanes.
+     */
+    Status schedule(Task task, Priority priority, Date_t deadline = Date_t::max());
+
     /**
      * Blocks the caller until there are no pending tasks on this pool.
      *
@@ -125,9 +195,54 @@ public:
     Stats getStats() const;
 
 private:
-    using TaskList = std::deque<Task>;
+    /**
+     * A task waiting in one of the priority lanes.
+     */
+    struct QueuedTask {
+        Task task;
+        Date_t deadline;
+        TickSource::Tick queuedTicks;
+    };
+
+    /**
+     * Running totals behind LaneStats. Guarded by _mutex.
+     */
+    struct LaneMetrics {
+        int64_t totalQueued = 0;
+        int64_t totalExecuted = 0;
+        int64_t totalDeadlinesMissed = 0;
+        TickSource::Tick totalSpentQueued = 0;
+        TickSource::Tick totalSpentExecuting = 0;
+    };
+
+    using TaskList = std::deque<QueuedTask>;
+    using TaskLanes = std::array<TaskList, static_cast<size_t>(Priority::kMax)>;
+    using LaneMetricsArray = std::array<LaneMetrics, static_cast<size_t>(Priority::kMax)>;
     using ThreadList = std::vector<stdx::thread>;
 
+    /**
+     * The deque and related state of one worker thread, when _options.workStealing is set.
+     *
+     * There is one slot per potential thread, created with the pool. A thread takes over a free
+     * slot when it starts, and gives it back when it exits with its deque empty, so that other
+     * threads can safely try to steal from any slot at any time.
+     */
+    struct WorkerSlot {
+        WorkerSlot(ThreadPool* pool, size_t index) : pool(pool), random(int64_t(index)) {}
+
+        ThreadPool* const pool;
+
+        // Pointers to tasks scheduled by the thread using this slot. Owned by whichever thread
+        // takes them out of the deque.
+        WorkStealingDeque<Task*> tasks;
+
+        // Used to pick victims to steal from. Only used by the thread using this slot.
+        PseudoRandom random;
+
+        // Whether a thread is using this slot. Guarded by _mutex.
+        bool inUse = false;
+    };
+
     /**
      * Representation of the stage of life of a thread pool.
      *
@@ -150,7 +265,9 @@ private:
      * As such, it is advisable to pass the pool pointer as an explicit argument, rather
      * than as the implicit "this" argument.
      */
-    static void _workerThreadBody(ThreadPool* pool, const std::string& threadName);
+    static void _workerThreadBody(ThreadPool* pool,
+                                  const std::string& threadName,
+                                  WorkerSlot* slot);
 
     /**
      * Starts a worker thread, unless _options.maxThreads threads are already running or
@@ -159,9 +276,10 @@ private:
     void _startWorkerThread_inlock();
 
     /**
-     * This is the run loop of a worker thread, invoked by _workerThreadBody.
+     * This is the run loop of a worker thread, invoked by _workerThreadBody. "slot" is null unless
+     * _options.workStealing is set.
      */
-    void _consumeTasks();
+    void _consumeTasks(WorkerSlot* slot);
 
     /**
      * Implementation of shutdown once _mutex is locked.
@@ -185,6 +303,36 @@ private:
      */
     void _doOneTask(stdx::unique_lock<stdx::mutex>* lk);
 
+    /**
+     * Returns the lane in _pendingTasks which the next task should come from, following the rules
+     * described on schedule(). _pendingTasks must have at least one entry.
+     */
+    size_t _pickLane_inlock() const;
+
+    /**
+     * Pushes "task" onto the deque of the worker thread calling this, and wakes or starts another
+     * thread to steal it if none are looking for work. Does not take _mutex unless it has to.
+     */
+    Status _scheduleLocal(WorkerSlot* slot, Task task);
+
+    /**
+     * Runs a batch of tasks from the deque in "slot", or stolen from other threads' deques, until
+     * there are none left or the batch is full. "lk" must own _mutex, and is released while the
+     * tasks run.
+     */
+    void _doLocalTasks(WorkerSlot* slot, stdx::unique_lock<stdx::mutex>* lk);
+
+    /**
+     * Returns a task from the deque in "slot", or failing that, from the deque of another thread.
+     * Returns null if it finds nothing.
+     */
+    Task* _popOrStealTask(WorkerSlot* slot);
+
+    /**
+     * Returns true if no tasks are pending or running.
+     */
+    bool _isIdle_inlock() const;
+
     /**
      * Changes the lifecycle state (_state) of the pool and wakes up any threads waiting for a state
      * change. Has no effect if _state == newState.
@@ -213,8 +361,16 @@ private:
     // Condition variable signaled whenever _state changes.
     stdx::condition_variable _stateChange;
 
-    // Queue of yet-to-be-executed tasks.
-    TaskList _pendingTasks;
+    // Queues of yet-to-be-executed tasks, one per Priority, each ordered by deadline.
+    TaskLanes _pendingTasks;
+
+    // Total number of tasks in _pendingTasks.
+    size_t _numPendingTasks = 0;
+
+    // Counters for each lane of _pendingTasks.
+    LaneMetricsArray _laneMetrics;
+
+    TickSource* const _tickSource;
 
     // List of threads serving as the worker pool.
     ThreadList _threads;
@@ -225,8 +381,31 @@ private:
     // Id counter for assigning thread names
     size_t _nextThreadId = 0;
 
-    // The last time that _pendingTasks.size() grew to be at least _threads.size().
+    // The last time that _numPendingTasks grew to be at least _threads.size().
     Date_t _lastFullUtilizationDate;
+
+    // One slot per potential worker thread if _options.workStealing is set, otherwise empty.
+    const std::vector<std::unique_ptr<WorkerSlot>> _workerSlots;
+
+    // The slot of the worker thread running on this thread, if any.
+    static thread_local WorkerSlot* _currentWorkerSlot;
+
+    // The fields below are atomic so that tasks scheduled onto worker deques can avoid _mutex.
+
+    // Number of tasks sitting in worker deques.
+    AtomicWord<long long> _numQueuedLocalTasks{0};
+
+    // Number of tasks scheduled onto worker deques which have not finished running.
+    AtomicWord<long long> _numUnfinishedLocalTasks{0};
+
+    // Number of threads waiting on _workAvailable.
+    AtomicWord<long long> _numSleepingThreads{0};
+
+    // Mirrors _threads.size().
+    AtomicWord<long long> _numThreads{0};
+
+    // Set once shutdown() has been called.
+    AtomicWord<bool> _shutdownStarted{false};
 };
 
 }  // namespace mongo
@@ -19,9 +19,12 @@
 #include "mongo/platform/basic.h"
 
 #include <boost/optional.hpp>
+#include <vector>
 
 #include "mongo/base/init.h"
+#include "mongo/platform/atomic_word.h"
 #include "mongo/stdx/condition_variable.h"
+#include "mongo/stdx/functional.h"
 #include "mongo/stdx/mutex.h"
 #include "mongo/stdx/thread.h"
 #include "mongo/unittest/barrier.h"
@@ -31,6 +34,7 @@
 #include "mongo/util/concurrency/thread_pool_test_common.h"
 #include "mongo/util/concurrency/thread_pool_test_fixture.h"
 #include "mongo/util/log.h"
+#include "mongo/util/tick_source_mock.h"
 #include "mongo/util/time_support.h"
 #include "mongo/util/timer.h"
 
@@ -40,6 +44,11 @@ using namespace mongo;
 MONGO_INITIALIZER(ThreadPoolCommonTests)(InitializerContext*) {
     addTestsForThreadPool("ThreadPoolCommon",
                           []() { return stdx::make_unique<ThreadPool>(ThreadPool::Options()); });
+    addTestsForThreadPool("ThreadPoolWorkStealingCommon", []() {
+        ThreadPool::Options options;
+        options.workStealing = true;
+        return stdx::make_unique<ThreadPool>(options);
+    });
     return Status::OK();
 }
 
@@ -251,4 +260,126 @@ TEST_F(ThreadPoolTest, ThreadPoolRunsOnCreateThreadFunctionBeforeConsumingTasks)
     ASSERT_EQUALS(options.threadNamePrefix + "0", taskThreadName);
 }
 
+TEST(ThreadPoolTest, TasksRunInPriorityAndDeadlineOrder) {
+    ThreadPool::Options options;
+    options.maxThreads = 1;
+    ThreadPool pool(options);
+
+    // Queue everything before startup, so that the single thread sees all of it at once.
+    std::vector<int> order;
+    const auto now = Date_t::now();
+    ASSERT_OK(pool.schedule([&] { order.push_back(5); }, ThreadPool::Priority::kLow));
+    ASSERT_OK(pool.schedule([&] { order.push_back(4); }));
+    ASSERT_OK(pool.schedule(
+        [&] { order.push_back(3); }, ThreadPool::Priority::kNormal, now + Seconds(200)));
+    ASSERT_OK(pool.schedule(
+        [&] { order.push_back(2); }, ThreadPool::Priority::kNormal, now + Seconds(100)));
+    ASSERT_OK(pool.schedule([&] { order.push_back(1); }, ThreadPool::Priority::kHigh));
+    pool.startup();
+    pool.waitForIdle();
+
+    ASSERT_TRUE(order == std::vector<int>({1, 2, 3, 4, 5}));
+
+    const auto stats = pool.getStats();
+    const auto& normal = stats.lanes[static_cast<size_t>(ThreadPool::Priority::kNormal)];
+    ASSERT_EQ(0U, normal.numPendingTasks);
+    ASSERT_EQ(3, normal.totalQueued);
+    ASSERT_EQ(3, normal.totalExecuted);
+    ASSERT_EQ(0, normal.totalDeadlinesMissed);
+    ASSERT_EQ(1, stats.lanes[static_cast<size_t>(ThreadPool::Priority::kHigh)].totalExecuted);
+    ASSERT_EQ(1, stats.lanes[static_cast<size_t>(ThreadPool::Priority::kLow)].totalExecuted);
+}
+
+TEST(ThreadPoolTest, StarvedAndOverdueTasksRunFirst) {
+    TickSourceMock tickSource;
+    ThreadPool::Options options;
+    options.maxThreads = 1;
+    options.maxStarvationDelay = Milliseconds(100);
+    options.tickSource = &tickSource;
+    ThreadPool pool(options);
+
+    std::vector<int> order;
+    ASSERT_OK(pool.schedule([&] { order.push_back(1); }, ThreadPool::Priority::kLow));
+    tickSource.advance(Milliseconds(100));
+    ASSERT_OK(pool.schedule([&] { order.push_back(3); }, ThreadPool::Priority::kHigh));
+    ASSERT_OK(pool.schedule([&] { order.push_back(2); },
+                            ThreadPool::Priority::kNormal,
+                            Date_t::now() - Milliseconds(1)));
+    pool.startup();
+    pool.waitForIdle();
+
+    // The low priority task has starved for long enough to go first, and the overdue normal
+    // priority task goes ahead of the high priority one.
+    ASSERT_TRUE(order == std::vector<int>({1, 2, 3}));
+
+    const auto stats = pool.getStats();
+    const auto& low = stats.lanes[static_cast<size_t>(ThreadPool::Priority::kLow)];
+    ASSERT_EQ(Microseconds(100 * 1000), low.totalTimeQueued);
+    ASSERT_EQ(
+        1, stats.lanes[static_cast<size_t>(ThreadPool::Priority::kNormal)].totalDeadlinesMissed);
+}
+
+TEST(ThreadPoolTest, WorkStealingWaitForIdleCoversSubTasks) {
+    ThreadPool::Options options;
+    options.workStealing = true;
+    options.maxThreads = 4;
+    ThreadPool pool(options);
+    pool.startup();
+
+    // Each task fans out into four more, down to a depth of five.
+    AtomicWord<int> executed{0};
+    stdx::function<void(int)> fanOut;
+    fanOut = [&](int depth) {
+        executed.fetchAndAdd(1);
+        if (depth == 0) {
+            return;
+        }
+        for (int i = 0; i < 4; ++i) {
+            ASSERT_OK(pool.schedule([&fanOut, depth] { fanOut(depth - 1); }));
+        }
+    };
+    ASSERT_OK(pool.schedule([&fanOut] { fanOut(5); }));
+
+    pool.waitForIdle();
+    ASSERT_EQ(1365, executed.load());
+    ASSERT_EQ(0U, pool.getStats().numPendingTasks);
+}
+
+TEST(ThreadPoolTest, WorkStealingIdleThreadStealsFromBlockedThread) {
+    ThreadPool::Options options;
+    options.workStealing = true;
+    options.minThreads = 2;
+    options.maxThreads = 2;
+    ThreadPool pool(options);
+    pool.startup();
+
+    // The child lands on the parent's own deque, so it only runs if the other thread steals it.
+    unittest::Barrier barrier(2U);
+    ASSERT_OK(pool.schedule([&] {
+        ASSERT_OK(pool.schedule([&barrier] { barrier.countDownAndWait(); }));
+        barrier.countDownAndWait();
+    }));
+
+    pool.waitForIdle();
+}
+
+TEST(ThreadPoolTest, WorkStealingRejectsSubTasksAfterShutdown) {
+    ThreadPool::Options options;
+    options.workStealing = true;
+    ThreadPool pool(options);
+    pool.startup();
+
+    unittest::Barrier barrier(2U);
+    Status status = Status::OK();
+    ASSERT_OK(pool.schedule([&] {
+        barrier.countDownAndWait();
+        status = pool.schedule([] {});
+    }));
+    pool.shutdown();
+    barrier.countDownAndWait();
+    pool.join();
+
+    ASSERT_EQ(ErrorCodes::ShutdownInProgress, status);
+}
+
 }  // namespace
@@ -0,0 +1,184 @@
+/**
+ *    Copyright (C) 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/stdx/new.h"
+#include "mongo/util/assert_util.h"
+
+namespace mongo {
+
+/**
+ * A Chase-Lev work stealing deque.
+ *
+ * One thread, the owner, pushes and pops values at the bottom of the deque, in LIFO order. Any
+ * number of other threads may concurrently steal values from the top, in FIFO order. The owner's
+ * operations only synchronize with thieves when the deque is down to its last value, so a thread
+ * working through its own deque doesn't contend with anyone.
+ *
+ * The deque grows as needed and never shrinks. T must be trivially copyable, since values are read
+ * by thieves before they know whether they won the race for them; store pointers to anything
+ * larger.
+ *
+ * See "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al, PPoPP 2013).
+ */
+template <typename T>
+class WorkStealingDeque {
+    MONGO_DISALLOW_COPYING(WorkStealingDeque);
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "WorkStealingDeque values must be trivially copyable");
+
+public:
+    static constexpr int64_t kDefaultInitialCapacity = 64;
+
+    explicit WorkStealingDeque(int64_t initialCapacity = kDefaultInitialCapacity) {
+        invariant(initialCapacity > 0 && (initialCapacity & (initialCapacity - 1)) == 0);
+        _buffers.emplace_back(new Buffer(initialCapacity));
+        _buffer.store(_buffers.back().get(), std::memory_order_relaxed);
+    }
+
+    /**
+     * Adds a value at the bottom of the deque. Only the owner may call this.
+     */
+    void push(T value) {
+        const int64_t bottom = _bottom.load(std::memory_order_relaxed);
+        const int64_t top = _top.load(std::memory_order_acquire);
+        Buffer* buffer = _buffer.load(std::memory_order_relaxed);
+
+        if (bottom - top > buffer->capacity - 1) {
+            buffer = _grow(buffer, top, bottom);
+        }
+
+        buffer->put(bottom, value);
+        _bottom.store(bottom + 1, std::memory_order_release);
+    }
+
+    /**
+     * Removes and returns the value at the bottom of the deque, which is the one most recently
+     * pushed. Returns boost::none if the deque is empty. Only the owner may call this.
+     */
+    boost::optional<T> pop() {
+        const int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+        Buffer* buffer = _buffer.load(std::memory_order_relaxed);
+        // Claim the bottom value before looking at the top, so that a thief which reads the top
+        // after this will see that the value is taken.
+        _bottom.store(bottom, std::memory_order_seq_cst);
+        int64_t top = _top.load(std::memory_order_seq_cst);
+
+        if (top > bottom) {
+            // The deque was already empty.
+            _bottom.store(bottom + 1, std::memory_order_relaxed);
+            return boost::none;
+        }
+
+        boost::optional<T> out(buffer->get(bottom));
+        if (top == bottom) {
+            // This is the last value, so we have to race thieves for it.
+            if (!_top.compare_exchange_strong(
+                    top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                out = boost::none;
+            }
+            _bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+
+        return out;
+    }
+
+    /**
+     * Removes and returns the value at the top of the deque, which is the oldest one. May be called
+     * from any thread.
+     *
+     * Returns boost::none if the deque is empty, or if another thread took the top value first. In
+     * the latter case the deque may not be empty, so callers looking for work should move on to
+     * another deque rather than retry this one in a tight loop.
+     */
+    boost::optional<T> steal() {
+        int64_t top = _top.load(std::memory_order_seq_cst);
+        const int64_t bottom = _bottom.load(std::memory_order_seq_cst);
+
+        if (top >= bottom) {
+            return boost::none;
+        }
+
+        Buffer* buffer = _buffer.load(std::memory_order_acquire);
+        const T value = buffer->get(top);
+        if (!_top.compare_exchange_strong(
+                top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return boost::none;
+        }
+
+        return value;
+    }
+
+    /**
+     * Returns the number of values in the deque. This is only a hint when other threads are using
+     * the deque.
+     */
+    int64_t sizeHint() const {
+        const int64_t bottom = _bottom.load(std::memory_order_relaxed);
+        const int64_t top = _top.load(std::memory_order_relaxed);
+        return bottom > top ? bottom - top : 0;
+    }
+
+private:
+    struct Buffer {
+        explicit Buffer(int64_t capacity)
+            : capacity(capacity), mask(capacity - 1), slots(new std::atomic<T>[capacity]) {}
+
+        T get(int64_t index) const {
+            return slots[index & mask].load(std::memory_order_relaxed);
+        }
+
+        void put(int64_t index, T value) {
+            slots[index & mask].store(value, std::memory_order_relaxed);
+        }
+
+        const int64_t capacity;
+        const int64_t mask;
+        const std::unique_ptr<std::atomic<T>[]> slots;  // NOLINT
+    };
+
+    Buffer* _grow(Buffer* old, int64_t top, int64_t bottom) {
+        _buffers.emplace_back(new Buffer(old->capacity * 2));
+        Buffer* buffer = _buffers.back().get();
+        for (int64_t i = top; i < bottom; ++i) {
+            buffer->put(i, old->get(i));
+        }
+        _buffer.store(buffer, std::memory_order_release);
+        return buffer;
+    }
+
+    alignas(stdx::hardware_destructive_interference_size) std::atomic<int64_t> _top{0};  // NOLINT
+    alignas(stdx::hardware_destructive_interference_size)
+        std::atomic<int64_t> _bottom{0};  // NOLINT
+
+    std::atomic<Buffer*> _buffer{nullptr};  // NOLINT
+
+    // Every buffer the deque has used, including the current one. Buffers replaced by _grow() are
+    // kept until the deque is destroyed, since a thief may still be reading from one. Only touched
+    // by the owner.
+    std::vector<std::unique_ptr<Buffer>> _buffers;
+};
+
+}  // namespace mongo
@@ -0,0 +1,116 @@
+/**
+ *    Copyright (C) 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include <vector>
+
+#include "mongo/platform/atomic_word.h"
+#include "mongo/stdx/thread.h"
+#include "mongo/unittest/unittest.h"
+#include "mongo/util/concurrency/work_stealing_deque.h"
+
+namespace mongo {
+namespace {
+
+TEST(WorkStealingDequeTest, OwnerPopsInLifoOrder) {
+    WorkStealingDeque<int> deque;
+    ASSERT_FALSE(deque.pop());
+
+    deque.push(1);
+    deque.push(2);
+    deque.push(3);
+    ASSERT_EQ(deque.sizeHint(), 3);
+
+    ASSERT_EQ(*deque.pop(), 3);
+    ASSERT_EQ(*deque.pop(), 2);
+    ASSERT_EQ(*deque.pop(), 1);
+    ASSERT_FALSE(deque.pop());
+    ASSERT_EQ(deque.sizeHint(), 0);
+}
+
+TEST(WorkStealingDequeTest, ThievesStealInFifoOrder) {
+    WorkStealingDeque<int> deque;
+    ASSERT_FALSE(deque.steal());
+
+    deque.push(1);
+    deque.push(2);
+    deque.push(3);
+
+    ASSERT_EQ(*deque.steal(), 1);
+    ASSERT_EQ(*deque.pop(), 3);
+    ASSERT_EQ(*deque.steal(), 2);
+    ASSERT_FALSE(deque.steal());
+    ASSERT_FALSE(deque.pop());
+}
+
+TEST(WorkStealingDequeTest, GrowsPastInitialCapacity) {
+    WorkStealingDeque<int> deque(2);
+
+    for (int i = 0; i < 100; ++i) {
+        deque.push(i);
+    }
+    ASSERT_EQ(*deque.steal(), 0);
+    for (int i = 99; i > 0; --i) {
+        ASSERT_EQ(*deque.pop(), i);
+    }
+    ASSERT_FALSE(deque.pop());
+}
+
+TEST(WorkStealingDequeTest, EveryValueIsTakenExactlyOnce) {
+    const int kValues = 100000;
+    const int kThieves = 4;
+
+    WorkStealingDeque<int> deque(8);
+    std::vector<AtomicWord<int>> taken(kValues);
+    AtomicWord<bool> done{false};
+
+    std::vector<stdx::thread> thieves;
+    for (int i = 0; i < kThieves; ++i) {
+        thieves.emplace_back([&] {
+            while (!done.load()) {
+                if (auto value = deque.steal()) {
+                    taken[*value].fetchAndAdd(1);
+                }
+            }
+        });
+    }
+
+    // Interleave pushes and pops so that the owner regularly races thieves for the last value.
+    for (int i = 0; i < kValues; ++i) {
+        deque.push(i);
+        if (i % 3 == 0) {
+            if (auto value = deque.pop()) {
+                taken[*value].fetchAndAdd(1);
+            }
+        }
+    }
+    while (auto value = deque.pop()) {
+        taken[*value].fetchAndAdd(1);
+    }
+
+    done.store(true);
+    for (auto& thief : thieves) {
+        thief.join();
+    }
+
+    for (int i = 0; i < kValues; ++i) {
+        ASSERT_EQ(taken[i].load(), 1);
+    }
+}
+
+}  // namespace
+}  // namespace mongo
@@ -0,0 +1,293 @@
+/**
+ *    Copyright (C) 2018 MongoDB, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/stdx/mutex.h"
+#include "mongo/stdx/unordered_map.h"
+#include "mongo/util/assert_util.h"
+#include "mongo/util/with_alignment.h"
+
+namespace mongo {
+
+/**
+ * A thread safe cache with an approximate least recently used replacement policy, for caches that
+ * are read from many threads at once.
+ *
+ * Entries are spread by hash across a number of shards, each guarded by its own mutex, so threads
+ * working on different keys rarely contend. Within a shard, entries are evicted with the CLOCK
+ * (second chance) algorithm: a hit only sets a flag on the entry instead of reordering a list, and
+ * the eviction hand skips over, and clears, flagged entries. This approximates LRU closely for
+ * typical access patterns.
+ *
+ * The maximum size is split evenly between the shards, so a badly skewed key distribution can
+ * cause evictions before the cache as a whole is full.
+ *
+ * Since entries may be evicted by other threads at any time, lookups return copies of values
+ * rather than iterators. Caches of large objects should store them through a shared_ptr.
+ */
+template <typename K,
+          typename V,
+          typename Hash = typename stdx::unordered_map<K, V>::hasher,
+          typename KeyEqual = typename stdx::unordered_map<K, V, Hash>::key_equal>
+class ConcurrentLRUCache {
+    MONGO_DISALLOW_COPYING(ConcurrentLRUCache);
+
+public:
+    static constexpr std::size_t kDefaultNumShards = 16;
+
+    explicit ConcurrentLRUCache(std::size_t maxSize, std::size_t numShards = kDefaultNumShards)
+        : _shards(numShards) {
+        invariant(maxSize > 0);
+        invariant(numShards > 0);
+        const std::size_t maxSizePerShard = (maxSize + numShards - 1) / numShards;
+        for (auto&& shard : _shards) {
+            shard.setMaxSize(maxSizePerShard);
+        }
+    }
+
+    /**
+     * Inserts a new entry into the cache, replacing the entry for the same key if there is one.
+     *
+     * If the key's shard is full, an entry from that shard is evicted and its value returned.
+     */
+    boost::optional<V> add(const K& key, V value) {
+        auto& shard = _shardFor(key);
+        stdx::lock_guard<stdx::mutex> lk(shard.mutex);
+        return shard.add(key, std::move(value));
+    }
+
+    /**
+     * Returns a copy of the value stored for the key and marks the entry as recently used, or
+     * boost::none if the key is not in the cache.
+     */
+    boost::optional<V> get(const K& key) {
+        auto& shard = _shardFor(key);
+        stdx::lock_guard<stdx::mutex> lk(shard.mutex);
+        return shard.get(key);
+    }
+
+    /**
+     * Removes the entry stored for the key, if there is one. Returns the number of entries erased.
+     */
+    std::size_t erase(const K& key) {
+        auto& shard = _shardFor(key);
+        stdx::lock_guard<stdx::mutex> lk(shard.mutex);
+        return shard.erase(key);
+    }
+
+    /**
+     * Returns true if the key is in the cache, without marking it as recently used.
+     */
+    bool hasKey(const K& key) const {
+        auto& shard = _shardFor(key);
+        stdx::lock_guard<stdx::mutex> lk(shard.mutex);
+        return shard.map.count(key) != 0;
+    }
+
+    /**
+     * Removes all entries from the cache. The statistics are not reset.
+     */
+    void clear() {
+        for (auto&& shard : _shards) {
+            stdx::lock_guard<stdx::mutex> lk(shard.mutex);
+            shard.clear();
+        }
+    }
+
+    /**
+     * Returns the number of entries in the cache. This is only a snapshot if other threads are
+     * modifying the cache concurrently.
+     */
+    std::size_t size() const {
+        std::size_t total = 0;
+        for (auto&& shard : _shards) {
+            stdx::lock_guard<stdx::mutex> lk(shard.mutex);
+            total += shard.map.size();
+        }
+        return total;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    /**
+     * Appends the number of entries, hits, misses and evictions summed over all shards.
+     */
+    void appendStats(BSONObjBuilder* bob) const {
+        long long entries = 0, hits = 0, misses = 0, evictions = 0;
+        for (auto&& shard : _shards) {
+            stdx::lock_guard<stdx::mutex> lk(shard.mutex);
+            entries += shard.map.size();
+            hits += shard.hits;
+            misses += shard.misses;
+            evictions += shard.evictions;
+        }
+        bob->append("entries", entries);
+        bob->append("hits", hits);
+        bob->append("misses", misses);
+        bob->append("evictions", evictions);
+    }
+
+private:
+    struct Slot {
+        // Unset while the slot is free.
+        boost::optional<std::pair<K, V>> entry;
+        bool referenced = false;
+    };
+
+    struct Shard {
+        void setMaxSize(std::size_t size) {
+            maxSize = size;
+            slots.reserve(maxSize);
+            map.reserve(maxSize);
+        }
+
+        boost::optional<V> add(const K& key, V value) {
+            auto it = map.find(key);
+            if (it != map.end()) {
+                auto& slot = slots[it->second];
+                slot.entry->second = std::move(value);
+                slot.referenced = true;
+                return boost::none;
+            }
+
+            boost::optional<V> evicted;
+            std::size_t index;
+            if (!freeSlots.empty()) {
+                index = freeSlots.back();
+                freeSlots.pop_back();
+            } else if (slots.size() < maxSize) {
+                index = slots.size();
+                slots.emplace_back();
+            } else {
+                index = _evict();
+                evicted = std::move(slots[index].entry->second);
+            }
+
+            auto& slot = slots[index];
+            slot.entry.emplace(key, std::move(value));
+            // New entries start unreferenced, so an entry that is never read again is the first to
+            // go once the hand reaches it.
+            slot.referenced = false;
+            map.emplace(key, index);
+            return evicted;
+        }
+
+        boost::optional<V> get(const K& key) {
+            auto it = map.find(key);
+            if (it == map.end()) {
+                ++misses;
+                return boost::none;
+            }
+
+            ++hits;
+            auto& slot = slots[it->second];
+            slot.referenced = true;
+            return slot.entry->second;
+        }
+
+        std::size_t erase(const K& key) {
+            auto it = map.find(key);
+            if (it == map.end())
+                return 0;
+
+            _release(it->second);
+            map.erase(it);
+            return 1;
+        }
+
+        void clear() {
+            map.clear();
+            slots.clear();
+            freeSlots.clear();
+            hand = 0;
+        }
+
+        // Advances the hand to the first unreferenced entry, giving each referenced entry it passes
+        // a second chance, and removes it from the map. Returns the index of its slot, which the
+        // caller takes over. Only called when every slot is in use.
+        std::size_t _evict() {
+            while (true) {
+                auto& slot = slots[hand];
+                const std::size_t index = hand;
+                hand = (hand + 1) % slots.size();
+
+                dassert(slot.entry);
+                if (slot.referenced) {
+                    slot.referenced = false;
+                    continue;
+                }
+
+                ++evictions;
+                invariant(map.erase(slot.entry->first) == 1);
+                return index;
+            }
+        }
+
+        void _release(std::size_t index) {
+            auto& slot = slots[index];
+            // Destroy the entry now so that the cache doesn't keep whatever it refers to alive.
+            slot.entry = boost::none;
+            slot.referenced = false;
+            freeSlots.push_back(index);
+        }
+
+        mutable stdx::mutex mutex;
+
+        std::size_t maxSize = 0;
+
+        // Entries live at fixed positions in this vector, which is what the CLOCK hand walks.
+        std::vector<Slot> slots;
+
+        // Slots that have been erased and can be reused without evicting anything.
+        std::vector<std::size_t> freeSlots;
+
+        // Maps from a key to the index of its slot.
+        stdx::unordered_map<K, std::size_t, Hash, KeyEqual> map;
+
+        std::size_t hand = 0;
+
+        long long hits = 0;
+        long long misses = 0;
+        long long evictions = 0;
+    };
+
+    const CacheAligned<Shard>& _shardFor(const K& key) const {
+        // Mix the hash so that keys whose hashes only differ in the high bits, or hashes that are
+        // the identity on small integers, still spread over every shard.
+        const uint64_t hash = static_cast<uint64_t>(Hash()(key)) * 0x9E3779B97F4A7C15ull;
+        return _shards[(hash >> 32) % _shards.size()];
+    }
+
+    CacheAligned<Shard>& _shardFor(const K& key) {
+        return const_cast<CacheAligned<Shard>&>(
+            static_cast<const ConcurrentLRUCache*>(this)->_shardFor(key));
+    }
+
+    std::vector<CacheAligned<Shard>> _shards;
+};
+
+}  // namespace mongo
@@ -0,0 +1,140 @@
+/**
+ *    Copyright (C) 2018 MongoDB, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include <string>
+#include <vector>
+
+#include "mongo/stdx/thread.h"
+#include "mongo/unittest/unittest.h"
+#include "mongo/util/concurrent_lru_cache.h"
+
+namespace mongo {
+namespace {
+
+TEST(ConcurrentLRUCacheTest, AddGetErase) {
+    ConcurrentLRUCache<int, std::string> cache(100);
+    ASSERT_TRUE(cache.empty());
+    ASSERT_FALSE(cache.get(1));
+
+    ASSERT_FALSE(cache.add(1, "one"));
+    ASSERT_FALSE(cache.add(2, "two"));
+    ASSERT_EQ(cache.size(), 2u);
+    ASSERT_TRUE(cache.hasKey(1));
+    ASSERT_EQ(*cache.get(1), "one");
+    ASSERT_EQ(*cache.get(2), "two");
+
+    // Replacing an existing key never evicts.
+    ASSERT_FALSE(cache.add(1, "uno"));
+    ASSERT_EQ(*cache.get(1), "uno");
+    ASSERT_EQ(cache.size(), 2u);
+
+    ASSERT_EQ(cache.erase(1), 1u);
+    ASSERT_EQ(cache.erase(1), 0u);
+    ASSERT_FALSE(cache.hasKey(1));
+    ASSERT_FALSE(cache.get(1));
+    ASSERT_EQ(cache.size(), 1u);
+
+    cache.clear();
+    ASSERT_TRUE(cache.empty());
+    ASSERT_FALSE(cache.get(2));
+}
+
+TEST(ConcurrentLRUCacheTest, NeverExceedsMaxSize) {
+    const size_t maxSize = 64;
+    ConcurrentLRUCache<int, int> cache(maxSize, 4);
+
+    size_t evictions = 0;
+    for (int i = 0; i < 1000; i++) {
+        if (cache.add(i, i))
+            evictions++;
+        ASSERT_LTE(cache.size(), maxSize);
+    }
+    ASSERT_EQ(cache.size() + evictions, 1000u);
+}
+
+TEST(ConcurrentLRUCacheTest, EvictsUnreferencedEntriesFirst) {
+    // A single shard makes the eviction order fully deterministic.
+    ConcurrentLRUCache<int, int> cache(3, 1);
+    cache.add(1, 10);
+    cache.add(2, 20);
+    cache.add(3, 30);
+
+    // Entry 1 gets a second chance, so 2 is the first unreferenced entry the hand reaches.
+    ASSERT_EQ(*cache.get(1), 10);
+    auto evicted = cache.add(4, 40);
+    ASSERT_TRUE(evicted);
+    ASSERT_EQ(*evicted, 20);
+    ASSERT_TRUE(cache.hasKey(1));
+    ASSERT_TRUE(cache.hasKey(3));
+    ASSERT_TRUE(cache.hasKey(4));
+
+    // The hand cleared entry 1's reference bit on its way past, so 3 and then 1 go next.
+    ASSERT_EQ(*cache.add(5, 50), 30);
+    ASSERT_EQ(*cache.add(6, 60), 10);
+}
+
+TEST(ConcurrentLRUCacheTest, ErasedSlotsAreReusedWithoutEviction) {
+    ConcurrentLRUCache<int, int> cache(2, 1);
+    cache.add(1, 1);
+    cache.add(2, 2);
+    cache.erase(1);
+    ASSERT_FALSE(cache.add(3, 3));
+    ASSERT_TRUE(cache.hasKey(2));
+    ASSERT_TRUE(cache.hasKey(3));
+}
+
+TEST(ConcurrentLRUCacheTest, AppendStats) {
+    ConcurrentLRUCache<int, int> cache(1, 1);
+    cache.add(1, 1);
+    cache.get(1);
+    cache.get(1);
+    cache.get(2);
+    cache.add(2, 2);
+
+    BSONObjBuilder bob;
+    cache.appendStats(&bob);
+    ASSERT_BSONOBJ_EQ(bob.obj(), BSON("entries" << 1LL << "hits" << 2LL << "misses" << 1LL
+                                                << "evictions" << 1LL));
+}
+
+TEST(ConcurrentLRUCacheTest, ConcurrentAccess) {
+    const int kThreads = 8;
+    const int kKeysPerThread = 1000;
+    ConcurrentLRUCache<int, int> cache(kThreads * kKeysPerThread / 2);
+
+    std::vector<stdx::thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+        threads.emplace_back([&cache, t] {
+            for (int i = 0; i < kKeysPerThread; i++) {
+                const int key = t * kKeysPerThread + i;
+                cache.add(key, key);
+                auto value = cache.get(key - kKeysPerThread / 2);
+                if (value)
+                    ASSERT_EQ(*value, key - kKeysPerThread / 2);
+            }
+        });
+    }
+    for (auto&& thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_LTE(cache.size(), size_t(kThreads * kKeysPerThread / 2));
+}
+
+}  // namespace
+}  // namespace mongo
@@ -0,0 +1,243 @@
+/*    Copyright 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/util/crc32c.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define MONGO_CRC32C_SSE42
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define MONGO_CRC32C_ARMV8
+#endif
+
+namespace mongo {
+namespace {
+
+// Reflected form of the Castagnoli polynomial 0x1EDC6F41.
+const uint32_t kPolynomial = 0x82F63B78;
+
+/**
+ * Tables for the slicing-by-8 algorithm. Row 0 is the classic byte-at-a-time table and row k
+ * advances a byte's contribution through k further zero bytes, which lets the main loop fold in
+ * eight bytes with eight independent lookups.
+ */
+struct SlicingTables {
+    SlicingTables() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ (kPolynomial & (0 - (crc & 1)));
+            }
+            table[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (int k = 1; k < 8; k++) {
+                table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+            }
+        }
+    }
+
+    uint32_t table[8][256];
+};
+
+const SlicingTables& slicingTables() {
+    static const SlicingTables tables;
+    return tables;
+}
+
+uint32_t loadLE32(const uint8_t* p) {
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+uint32_t crc32cSlicingBy8(uint32_t crc, const uint8_t* p, size_t length) {
+    const auto& t = slicingTables().table;
+
+    while (length >= 8) {
+        const uint32_t lo = loadLE32(p) ^ crc;
+        const uint32_t hi = loadLE32(p + 4);
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+            t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        p += 8;
+        length -= 8;
+    }
+
+    while (length--) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+    }
+    return crc;
+}
+
+#if defined(MONGO_CRC32C_SSE42) || defined(MONGO_CRC32C_ARMV8)
+
+/**
+ * The CRC instructions take a few cycles to produce their result but can start a new one every
+ * cycle, so a single chain of them leaves most of the unit idle. Long inputs are instead done in
+ * rounds of three adjacent stripes of kStripeBytes, each with its own chain, which are combined at
+ * the end of the round.
+ */
+const size_t kStripeBytes = 256;
+
+/**
+ * Advancing a CRC past kStripeBytes zero bytes is linear in the CRC, so it can be done with one
+ * table lookup per byte of the CRC. This is what joins the CRC of one stripe onto the next.
+ */
+struct StripeShiftTables {
+    StripeShiftTables() {
+        const auto& t = slicingTables().table;
+        uint32_t bitShifted[32];
+        for (int bit = 0; bit < 32; bit++) {
+            uint32_t crc = uint32_t(1) << bit;
+            for (size_t i = 0; i < kStripeBytes; i++) {
+                crc = (crc >> 8) ^ t[0][crc & 0xFF];
+            }
+            bitShifted[bit] = crc;
+        }
+        for (int k = 0; k < 4; k++) {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t crc = 0;
+                for (int bit = 0; bit < 8; bit++) {
+                    if (i & (1 << bit)) {
+                        crc ^= bitShifted[8 * k + bit];
+                    }
+                }
+                table[k][i] = crc;
+            }
+        }
+    }
+
+    uint32_t shift(uint32_t crc) const {
+        return table[0][crc & 0xFF] ^ table[1][(crc >> 8) & 0xFF] ^ table[2][(crc >> 16) & 0xFF] ^
+            table[3][crc >> 24];
+    }
+
+    uint32_t table[4][256];
+};
+
+const StripeShiftTables& stripeShiftTables() {
+    static const StripeShiftTables tables;
+    return tables;
+}
+
+#endif
+
+#if defined(MONGO_CRC32C_SSE42)
+
+#define MONGO_CRC32C_TARGET __attribute__((target("sse4.2")))
+
+MONGO_CRC32C_TARGET inline uint32_t crc32cWord(uint32_t crc, const uint8_t* p) {
+    uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+    return static_cast<uint32_t>(_mm_crc32_u64(crc, word));
+}
+
+MONGO_CRC32C_TARGET inline uint32_t crc32cByte(uint32_t crc, uint8_t byte) {
+    return _mm_crc32_u8(crc, byte);
+}
+
+bool detectHardwareSupport() {
+    return __builtin_cpu_supports("sse4.2");
+}
+
+#elif defined(MONGO_CRC32C_ARMV8)
+
+#define MONGO_CRC32C_TARGET
+
+inline uint32_t crc32cWord(uint32_t crc, const uint8_t* p) {
+    uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+    return __crc32cd(crc, word);
+}
+
+inline uint32_t crc32cByte(uint32_t crc, uint8_t byte) {
+    return __crc32cb(crc, byte);
+}
+
+bool detectHardwareSupport() {
+    // Compiling with the CRC extension enabled means every CPU we can run on has it.
+    return true;
+}
+
+#endif
+
+#if defined(MONGO_CRC32C_TARGET)
+
+MONGO_CRC32C_TARGET uint32_t crc32cHardware(uint32_t crc, const uint8_t* p, size_t length) {
+    if (length >= 3 * kStripeBytes) {
+        const auto& shiftTables = stripeShiftTables();
+        do {
+            uint32_t crc1 = 0;
+            uint32_t crc2 = 0;
+            for (size_t i = 0; i < kStripeBytes; i += 8) {
+                crc = crc32cWord(crc, p + i);
+                crc1 = crc32cWord(crc1, p + kStripeBytes + i);
+                crc2 = crc32cWord(crc2, p + 2 * kStripeBytes + i);
+            }
+            crc = shiftTables.shift(shiftTables.shift(crc) ^ crc1) ^ crc2;
+            p += 3 * kStripeBytes;
+            length -= 3 * kStripeBytes;
+        } while (length >= 3 * kStripeBytes);
+    }
+
+    while (length >= 8) {
+        crc = crc32cWord(crc, p);
+        p += 8;
+        length -= 8;
+    }
+
+    while (length--) {
+        crc = crc32cByte(crc, *p++);
+    }
+    return crc;
+}
+
+#undef MONGO_CRC32C_TARGET
+
+#else
+
+uint32_t crc32cHardware(uint32_t crc, const uint8_t* p, size_t length) {
+    return crc32cSlicingBy8(crc, p, length);
+}
+
+bool detectHardwareSupport() {
+    return false;
+}
+
+#endif
+
+}  // namespace
+
+bool crc32cIsHardwareAccelerated() {
+    // Function-local so that this is safe to use from other static initializers.
+    static const bool hasHardwareSupport = detectHardwareSupport();
+    return hasHardwareSupport;
+}
+
+uint32_t crc32c(uint32_t crc, const void* data, size_t length) {
+    const auto p = static_cast<const uint8_t*>(data);
+    if (crc32cIsHardwareAccelerated())
+        return ~crc32cHardware(~crc, p, length);
+    return ~crc32cSlicingBy8(~crc, p, length);
+}
+
+uint32_t crc32cPortable(uint32_t crc, const void* data, size_t length) {
+    return ~crc32cSlicingBy8(~crc, static_cast<const uint8_t*>(data), length);
+}
+
+}  // namespace mongo
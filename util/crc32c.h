@@ -0,0 +1,44 @@
+/*    Copyright 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mongo {
+
+/**
+ * Computes the CRC-32C (Castagnoli) checksum of 'length' bytes at 'data'.
+ *
+ * Pass 0 as 'crc' to start a new checksum, or the result of a previous call to continue it, so that
+ * crc32c(crc32c(0, a, n), b, m) equals the checksum of a followed by b.
+ *
+ * Uses the SSE4.2 crc32 instruction on x86-64 when the CPU supports it, the ARMv8 CRC instructions
+ * when compiled for them, and a portable slicing-by-8 implementation otherwise.
+ */
+uint32_t crc32c(uint32_t crc, const void* data, size_t length);
+
+/**
+ * Same as crc32c() but always uses the portable implementation. Exposed for tests and benchmarks.
+ */
+uint32_t crc32cPortable(uint32_t crc, const void* data, size_t length);
+
+/**
+ * Returns true if crc32c() uses dedicated CPU instructions on this machine.
+ */
+bool crc32cIsHardwareAccelerated();
+
+}  // namespace mongo
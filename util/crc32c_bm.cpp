@@ -0,0 +1,53 @@
+/**
+ *    Copyright (C) 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include <benchmark/benchmark.h>
+#include <vector>
+
+#include "mongo/util/crc32c.h"
+
+namespace mongo {
+namespace {
+
+using ChecksumFunction = uint32_t (*)(uint32_t, const void*, size_t);
+
+/**
+ * Reports throughput in bytes per second, so the results can be compared directly with memory
+ * bandwidth.
+ */
+template <ChecksumFunction checksum>
+void BM_crc32c(benchmark::State& state) {
+    std::vector<char> data(state.range(0));
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<char>(i * 131 + 17);
+    }
+
+    uint32_t crc = 0;
+    for (auto _ : state) {
+        crc = checksum(crc, data.data(), data.size());
+        benchmark::DoNotOptimize(crc);
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+    state.SetLabel(checksum == crc32c && crc32cIsHardwareAccelerated() ? "hardware" : "portable");
+}
+
+BENCHMARK_TEMPLATE(BM_crc32c, crc32c)->RangeMultiplier(8)->Range(64, 1 << 24);
+BENCHMARK_TEMPLATE(BM_crc32c, crc32cPortable)->RangeMultiplier(8)->Range(64, 1 << 24);
+
+}  // namespace
+}  // namespace mongo
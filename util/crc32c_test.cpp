@@ -0,0 +1,90 @@
+/*    Copyright 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include <cstring>
+#include <vector>
+
+#include "mongo/unittest/unittest.h"
+#include "mongo/util/crc32c.h"
+
+namespace mongo {
+namespace {
+
+using ChecksumFunction = uint32_t (*)(uint32_t, const void*, size_t);
+
+void checkKnownValues(ChecksumFunction checksum) {
+    ASSERT_EQ(checksum(0, "", 0), 0u);
+    ASSERT_EQ(checksum(0, "123456789", 9), 0xE3069283u);
+
+    // Test vectors from RFC 3720, appendix B.4.
+    unsigned char buf[32];
+    std::memset(buf, 0, sizeof(buf));
+    ASSERT_EQ(checksum(0, buf, sizeof(buf)), 0x8A9136AAu);
+
+    std::memset(buf, 0xFF, sizeof(buf));
+    ASSERT_EQ(checksum(0, buf, sizeof(buf)), 0x62A8AB43u);
+
+    for (size_t i = 0; i < sizeof(buf); i++) {
+        buf[i] = i;
+    }
+    ASSERT_EQ(checksum(0, buf, sizeof(buf)), 0x46DD794Eu);
+
+    for (size_t i = 0; i < sizeof(buf); i++) {
+        buf[i] = 31 - i;
+    }
+    ASSERT_EQ(checksum(0, buf, sizeof(buf)), 0x113FDB5Cu);
+}
+
+TEST(Crc32cTest, KnownValues) {
+    checkKnownValues(crc32c);
+}
+
+TEST(Crc32cTest, KnownValuesPortable) {
+    checkKnownValues(crc32cPortable);
+}
+
+TEST(Crc32cTest, IncrementalMatchesOneShot) {
+    std::vector<char> data(1000);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<char>(i * 7 + 3);
+    }
+
+    const uint32_t expected = crc32c(0, data.data(), data.size());
+    for (size_t split = 0; split <= data.size(); split += 37) {
+        const uint32_t first = crc32c(0, data.data(), split);
+        ASSERT_EQ(crc32c(first, data.data() + split, data.size() - split), expected);
+    }
+}
+
+TEST(Crc32cTest, HardwareMatchesPortable) {
+    std::vector<char> data(2000);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<char>(i * 131 + 17);
+    }
+
+    // Cover every alignment and tail length of the eight-byte main loops, and inputs long enough
+    // for the hardware version to split into stripes.
+    for (size_t offset = 0; offset < 8; offset++) {
+        for (size_t length = 0; length + offset <= data.size(); length += 5) {
+            ASSERT_EQ(crc32c(0, data.data() + offset, length),
+                      crc32cPortable(0, data.data() + offset, length));
+        }
+    }
+}
+
+}  // namespace
+}  // namespace mongo
@@ -0,0 +1,135 @@
+/**
+ *    Copyright (C) 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+#include "mongo/platform/atomic_word.h"
+#include "mongo/platform/bits.h"
+
+namespace mongo {
+
+/**
+ * A histogram of non-negative integers, with buckets that get wider as the values they hold get
+ * larger, in the style of HdrHistogram. Each power of two is split into kSubBuckets equal
+ * buckets, so a value's bucket bounds it to within 1/kSubBuckets of the value, no matter how
+ * large it is. Values of kMaxValue and above all go into the last bucket.
+ *
+ * record() is lock-free, and may run concurrently with reads on other threads. Reads taken while
+ * values are being recorded see some, but not necessarily all, of those values.
+ */
+class LogLinearHistogram {
+public:
+    static constexpr int kSubBucketBits = 3;
+    static constexpr uint64_t kSubBuckets = 1 << kSubBucketBits;
+    static constexpr int kMaxValueBits = 48;
+    static constexpr uint64_t kMaxValue = (1ULL << kMaxValueBits) - 1;
+    static constexpr size_t kNumBuckets = (kMaxValueBits - kSubBucketBits + 1) * kSubBuckets;
+
+    void record(uint64_t value) {
+        _counts[bucketFor(value)].fetchAndAdd(1);
+    }
+
+    /**
+     * Adds every value recorded in "other" to this histogram.
+     */
+    void add(const LogLinearHistogram& other) {
+        for (size_t i = 0; i < kNumBuckets; ++i) {
+            const auto count = other._counts[i].loadRelaxed();
+            if (count) {
+                _counts[i].fetchAndAdd(count);
+            }
+        }
+    }
+
+    uint64_t count() const {
+        uint64_t total = 0;
+        for (const auto& count : _counts) {
+            total += count.loadRelaxed();
+        }
+        return total;
+    }
+
+    /**
+     * Returns an upper bound on the value that "pct" percent of the recorded values are at or
+     * below, or 0 if nothing has been recorded.
+     */
+    uint64_t percentile(double pct) const {
+        std::array<uint64_t, kNumBuckets> counts;
+        uint64_t total = 0;
+        for (size_t i = 0; i < kNumBuckets; ++i) {
+            counts[i] = _counts[i].loadRelaxed();
+            total += counts[i];
+        }
+        if (total == 0) {
+            return 0;
+        }
+
+        const auto rank =
+            std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(total * (pct / 100))));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kNumBuckets; ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return bucketUpperBound(i);
+            }
+        }
+        return kMaxValue;
+    }
+
+    static size_t bucketFor(uint64_t value) {
+        if (value < 2 * kSubBuckets) {
+            return value;
+        }
+        if (value > kMaxValue) {
+            value = kMaxValue;
+        }
+
+        // The top bit picks the power of two, and the kSubBucketBits below it pick the bucket
+        // within it
+        const int topBit = 63 - countLeadingZeros64(value);
+        const int shift = topBit - kSubBucketBits;
+        const auto subBucket = (value >> shift) & (kSubBuckets - 1);
+        return (shift + 1) * kSubBuckets + subBucket;
+    }
+
+    static uint64_t bucketLowerBound(size_t bucket) {
+        if (bucket < 2 * kSubBuckets) {
+            return bucket;
+        }
+
+        const int shift = bucket / kSubBuckets - 1;
+        return (kSubBuckets + bucket % kSubBuckets) << shift;
+    }
+
+    static uint64_t bucketUpperBound(size_t bucket) {
+        if (bucket < 2 * kSubBuckets) {
+            return bucket;
+        }
+
+        const int shift = bucket / kSubBuckets - 1;
+        return bucketLowerBound(bucket) + (1ULL << shift) - 1;
+    }
+
+private:
+    std::array<AtomicWord<uint64_t>, kNumBuckets> _counts;
+};
+
+}  // namespace mongo
@@ -0,0 +1,99 @@
+/**
+ *    Copyright (C) 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include <vector>
+
+#include "mongo/stdx/thread.h"
+#include "mongo/unittest/unittest.h"
+#include "mongo/util/log_linear_histogram.h"
+
+namespace mongo {
+namespace {
+
+TEST(LogLinearHistogramTest, BucketsCoverEveryValue) {
+    uint64_t expectedLowerBound = 0;
+    for (size_t bucket = 0; bucket < LogLinearHistogram::kNumBuckets; ++bucket) {
+        const auto lower = LogLinearHistogram::bucketLowerBound(bucket);
+        const auto upper = LogLinearHistogram::bucketUpperBound(bucket);
+        ASSERT_EQ(lower, expectedLowerBound);
+        ASSERT_GTE(upper, lower);
+        ASSERT_EQ(LogLinearHistogram::bucketFor(lower), bucket);
+        ASSERT_EQ(LogLinearHistogram::bucketFor(upper), bucket);
+
+        // Each bucket is narrow relative to the values in it
+        ASSERT_LTE(upper - lower, lower / LogLinearHistogram::kSubBuckets);
+        expectedLowerBound = upper + 1;
+    }
+    ASSERT_EQ(expectedLowerBound - 1, LogLinearHistogram::kMaxValue);
+}
+
+TEST(LogLinearHistogramTest, LargeValuesGoInTheLastBucket) {
+    const auto lastBucket = LogLinearHistogram::kNumBuckets - 1;
+    ASSERT_EQ(LogLinearHistogram::bucketFor(LogLinearHistogram::kMaxValue + 1), lastBucket);
+    ASSERT_EQ(LogLinearHistogram::bucketFor(~0ULL), lastBucket);
+}
+
+TEST(LogLinearHistogramTest, Percentiles) {
+    LogLinearHistogram histogram;
+    ASSERT_EQ(histogram.percentile(50), 0U);
+
+    for (uint64_t i = 1; i <= 1000; ++i) {
+        histogram.record(i);
+    }
+    ASSERT_EQ(histogram.count(), 1000U);
+
+    // Each percentile is an upper bound within one bucket width of the exact value
+    for (auto pct : {50.0, 90.0, 99.0, 99.9, 100.0}) {
+        const auto exact = static_cast<uint64_t>(pct * 10);
+        const auto reported = histogram.percentile(pct);
+        ASSERT_GTE(reported, exact);
+        ASSERT_LTE(reported, exact + exact / LogLinearHistogram::kSubBuckets);
+    }
+}
+
+TEST(LogLinearHistogramTest, AddMergesCounts) {
+    LogLinearHistogram a;
+    LogLinearHistogram b;
+    a.record(10);
+    b.record(10);
+    b.record(1000000);
+
+    a.add(b);
+    ASSERT_EQ(a.count(), 3U);
+    ASSERT_EQ(a.percentile(50), 10U);
+    ASSERT_GTE(a.percentile(100), 1000000U);
+}
+
+TEST(LogLinearHistogramTest, ConcurrentRecords) {
+    LogLinearHistogram histogram;
+    std::vector<stdx::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&] {
+            for (uint64_t value = 0; value < 10000; ++value) {
+                histogram.record(value);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQ(histogram.count(), 40000U);
+}
+
+}  // namespace
+}  // namespace mongo
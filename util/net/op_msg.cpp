@@ -27,6 +27,7 @@
 #include "mongo/db/bson/dotted_path_support.h"
 #include "mongo/rpc/object_check.h"
 #include "mongo/util/bufreader.h"
+#include "mongo/util/crc32c.h"
 #include "mongo/util/hex.h"
 #include "mongo/util/log.h"
 
@@ -45,6 +46,13 @@ enum class Section : uint8_t {
     kDocSequence = 1,
 };
 
+constexpr int kCrc32Size = 4;
+
+// The checksum covers every byte of the message before it, including the header.
+uint32_t calculateChecksum(const Message& message) {
+    return crc32c(0, message.buf(), message.size() - kCrc32Size);
+}
+
 }  // namespace
 
 uint32_t OpMsg::flags(const Message& message) {
@@ -63,35 +71,112 @@ void OpMsg::replaceFlags(Message* message, uint32_t flags) {
     DataView(message->singleData().data()).write<LittleEndian<uint32_t>>(flags);
 }
 
+void OpMsg::appendChecksum(Message* message) {
+    invariant(!message->empty());
+    invariant(message->operation() == dbMsg);
+    invariant(message->dataSize() >= static_cast<int>(sizeof(uint32_t)));
+
+    if (!isFlagSet(*message, kChecksumPresent)) {
+        // Take the buffer out of the message so that it can be grown in place if nothing else is
+        // sharing it.
+        const int size = message->size();
+        auto buffer = message->sharedBuffer();
+        message->reset();
+        if (buffer.isShared()) {
+            auto copy = SharedBuffer::allocate(size + kCrc32Size);
+            memcpy(copy.get(), buffer.get(), size);
+            buffer = std::move(copy);
+        } else {
+            buffer.realloc(size + kCrc32Size);
+        }
+        message->setData(std::move(buffer));
+
+        message->header().setLen(size + kCrc32Size);
+        setFlag(message, kChecksumPresent);
+    }
+
+    invariant(message->dataSize() >= static_cast<int>(sizeof(uint32_t)) + kCrc32Size);
+    DataView(message->buf() + message->size() - kCrc32Size)
+        .write<LittleEndian<uint32_t>>(calculateChecksum(*message));
+}
+
 OpMsg OpMsg::parse(const Message& message) try {
+    return OpMsgView::parse(message).toOpMsg();
+} catch (const DBException& ex) {
+    LOG(1) << "invalid message: " << ex.code() << " " << redact(ex) << " -- "
+           << redact(hexdump(message.singleData().view2ptr(), message.size()));
+    throw;
+}
+
+Message OpMsg::serialize() const {
+    OpMsgBuilder builder;
+    for (auto&& seq : sequences) {
+        auto docSeq = builder.beginDocSequence(seq.name);
+        for (auto&& obj : seq.objs) {
+            docSeq.append(obj);
+        }
+    }
+    builder.beginBody().appendElements(body);
+    return builder.finish();
+}
+
+void OpMsg::shareOwnershipWith(const ConstSharedBuffer& buffer) {
+    if (!body.isOwned()) {
+        body.shareOwnershipWith(buffer);
+    }
+    for (auto&& seq : sequences) {
+        for (auto&& obj : seq.objs) {
+            if (!obj.isOwned()) {
+                obj.shareOwnershipWith(buffer);
+            }
+        }
+    }
+}
+
+BSONObj OpMsgView::DocumentSequence::iterator::operator*() const {
+    return uassertStatusOK(ConstDataRange(_pos, _end).read<Validated<BSONObj>>()).val;
+}
+
+OpMsgView OpMsgView::parse(const Message& message) {
     // It is the caller's responsibility to call the correct parser for a given message type.
     invariant(!message.empty());
     invariant(message.operation() == dbMsg);
 
+    OpMsgView view;
     const uint32_t flags = OpMsg::flags(message);
+    view._flags = flags;
     uassert(ErrorCodes::IllegalOpMsgFlag,
             str::stream() << "Message contains illegal flags value: Ob"
                           << std::bitset<32>(flags).to_string(),
             !containsUnknownRequiredFlags(flags));
 
-    constexpr int kCrc32Size = 4;
-    const bool haveChecksum = flags & kChecksumPresent;
+    const bool haveChecksum = flags & OpMsg::kChecksumPresent;
     const int checksumSize = haveChecksum ? kCrc32Size : 0;
 
+    if (haveChecksum) {
+        uassert(ErrorCodes::ChecksumMismatch,
+                "OP_MSG message is too small to hold a checksum",
+                message.dataSize() >= static_cast<int>(sizeof(flags)) + kCrc32Size);
+        const auto checksum = ConstDataView(message.buf() + message.size() - kCrc32Size)
+                                  .read<LittleEndian<uint32_t>>();
+        uassert(ErrorCodes::ChecksumMismatch,
+                "OP_MSG checksum does not match contents",
+                checksum == calculateChecksum(message));
+    }
+
     // The sections begin after the flags and before the checksum (if present).
     BufReader sectionsBuf(message.singleData().data() + sizeof(flags),
                           message.dataSize() - sizeof(flags) - checksumSize);
 
     // TODO some validation may make more sense in the IDL parser. I've tagged them with comments.
     bool haveBody = false;
-    OpMsg msg;
     while (!sectionsBuf.atEof()) {
         const auto sectionKind = sectionsBuf.read<Section>();
         switch (sectionKind) {
             case Section::kBody: {
                 uassert(40430, "Multiple body sections in message", !haveBody);
                 haveBody = true;
-                msg.body = sectionsBuf.read<Validated<BSONObj>>();
+                view._body = sectionsBuf.read<Validated<BSONObj>>();
                 break;
             }
 
@@ -101,7 +186,7 @@ OpMsg OpMsg::parse(const Message& message) try {
                 // If we need more document sequences, raise the limit and use a better algorithm.
                 uassert(ErrorCodes::TooManyDocumentSequences,
                         "Too many document sequences in OP_MSG",
-                        msg.sequences.size() < 2);  // Limit is <=2 since we are about to add one.
+                        view._sequences.size() < 2);  // Limit is <=2 since we are about to add one.
 
                 // The first 4 bytes are the total size, including themselves.
                 const auto remainingSize =
@@ -110,12 +195,27 @@ OpMsg OpMsg::parse(const Message& message) try {
                 const auto name = seqBuf.readCStr();
                 uassert(40431,
                         str::stream() << "Duplicate document sequence: " << name,
-                        !msg.getSequence(name));  // TODO IDL
-
-                msg.sequences.push_back({name.toString()});
-                while (!seqBuf.atEof()) {
-                    msg.sequences.back().objs.push_back(seqBuf.read<Validated<BSONObj>>());
+                        !view.getSequence(name));  // TODO IDL
+
+                DocumentSequence seq;
+                seq._name = name;
+                seq._begin = static_cast<const char*>(seqBuf.pos());
+                seq._end = seq._begin + seqBuf.remaining();
+
+                // Only find where each document begins. They're validated as they're read.
+                for (auto pos = seq._begin; pos != seq._end; ++seq._count) {
+                    const auto remaining = seq._end - pos;
+                    const auto size = remaining >= static_cast<std::ptrdiff_t>(sizeof(int32_t))
+                        ? ConstDataView(pos).read<LittleEndian<int32_t>>()
+                        : 0;
+                    uassert(ErrorCodes::InvalidBSON,
+                            str::stream() << "Invalid document size in document sequence "
+                                          << name,
+                            size >= BSONObj::kMinBSONLength && size <= remaining);
+                    pos += size;
                 }
+
+                view._sequences.push_back(seq);
                 break;
             }
 
@@ -129,46 +229,34 @@ OpMsg OpMsg::parse(const Message& message) try {
 
     // Detect duplicates between doc sequences and body. TODO IDL
     // Technically this is O(N*M) but N is at most 2.
-    for (const auto& docSeq : msg.sequences) {
-        const char* name = docSeq.name.c_str();  // Pointer is redirected by next call.
-        auto inBody =
-            !dotted_path_support::extractElementAtPathOrArrayAlongPath(msg.body, name).eoo();
+    for (const auto& docSeq : view._sequences) {
+        // Names are rarely dotted paths, and the rest only need a lookup of the top-level field.
+        const char* name = docSeq.name().rawData();  // Pointer is redirected by next call.
+        auto inBody = docSeq.name().find('.') == std::string::npos
+            ? view._body.hasField(docSeq.name())
+            : !dotted_path_support::extractElementAtPathOrArrayAlongPath(view._body, name).eoo();
         uassert(40433,
                 str::stream() << "Duplicate field between body and document sequence "
-                              << docSeq.name,
+                              << docSeq.name(),
                 !inBody);
     }
 
-    return msg;
-} catch (const DBException& ex) {
-    LOG(1) << "invalid message: " << ex.code() << " " << redact(ex) << " -- "
-           << redact(hexdump(message.singleData().view2ptr(), message.size()));
-    throw;
+    return view;
 }
 
-Message OpMsg::serialize() const {
-    OpMsgBuilder builder;
-    for (auto&& seq : sequences) {
-        auto docSeq = builder.beginDocSequence(seq.name);
-        for (auto&& obj : seq.objs) {
-            docSeq.append(obj);
-        }
-    }
-    builder.beginBody().appendElements(body);
-    return builder.finish();
-}
-
-void OpMsg::shareOwnershipWith(const ConstSharedBuffer& buffer) {
-    if (!body.isOwned()) {
-        body.shareOwnershipWith(buffer);
-    }
-    for (auto&& seq : sequences) {
-        for (auto&& obj : seq.objs) {
-            if (!obj.isOwned()) {
-                obj.shareOwnershipWith(buffer);
-            }
+OpMsg OpMsgView::toOpMsg() const {
+    OpMsg msg;
+    msg.body = _body;
+    msg.sequences.reserve(_sequences.size());
+    for (const auto& seq : _sequences) {
+        msg.sequences.push_back({seq.name().toString()});
+        auto& objs = msg.sequences.back().objs;
+        objs.reserve(seq.size());
+        for (auto&& obj : seq) {
+            objs.push_back(obj);
         }
     }
+    return msg;
 }
 
 auto OpMsgBuilder::beginDocSequence(StringData name) -> DocSequenceBuilder {
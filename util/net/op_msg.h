@@ -17,9 +17,13 @@
 #pragma once
 
 #include <algorithm>
+#include <cstddef>
+#include <iterator>
 #include <string>
 #include <vector>
 
+#include "mongo/base/data_type_endian.h"
+#include "mongo/base/data_view.h"
 #include "mongo/base/string_data.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/util/net/message.h"
@@ -47,7 +51,8 @@ struct OpMsg {
 
     /**
      * Replaces the flags in message with the supplied flags.
-     * Only legal on an otherwise valid OP_MSG message.
+     * Only legal on an otherwise valid OP_MSG message. This doesn't update the checksum, so call
+     * appendChecksum() again afterwards if the message has one.
      */
     static void replaceFlags(Message* message, uint32_t flags);
 
@@ -60,7 +65,17 @@ struct OpMsg {
     }
 
     /**
-     * Parses and returns an OpMsg containing unowned BSON.
+     * Appends a CRC-32C checksum of the whole message to an OP_MSG message and sets
+     * kChecksumPresent, or recomputes the checksum if the flag is already set. The checksum
+     * covers the header, so this must be called again after anything changes the message,
+     * including its request and response ids.
+     */
+    static void appendChecksum(Message* message);
+
+    /**
+     * Parses and returns an OpMsg containing unowned BSON. If the message has a checksum, it is
+     * verified before anything else is read. See OpMsgView to read a message without copying or
+     * validating every document up front.
      */
     static OpMsg parse(const Message& message);
 
@@ -137,6 +152,132 @@ struct OpMsgRequest : public OpMsg {
     // without issues like slicing.
 };
 
+/**
+ * A read-only view of an OP_MSG message, which reads it in place rather than copying it into an
+ * OpMsg.
+ *
+ * parse() makes a single pass over the message. It checks the flags, the checksum and the layout
+ * of the sections, and validates the body, but only finds where each document in a document
+ * sequence begins. Each document is validated when it is read through its sequence's iterator,
+ * so a caller that stops early never pays for the rest. Everything here points into the message's
+ * buffer, so the message must outlive the view and any BSONObjs read through it.
+ */
+class OpMsgView {
+public:
+    class DocumentSequence {
+    public:
+        /**
+         * Iterates over the documents in a sequence, validating each one as it's read.
+         * Dereferencing throws if the document isn't valid BSON.
+         */
+        class iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = BSONObj;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = BSONObj;
+
+            iterator() = default;
+
+            BSONObj operator*() const;
+
+            iterator& operator++() {
+                // parse() has already checked that each document's size fits in the sequence.
+                _pos += ConstDataView(_pos).read<LittleEndian<int32_t>>();
+                return *this;
+            }
+
+            iterator operator++(int) {
+                auto old = *this;
+                ++*this;
+                return old;
+            }
+
+            bool operator==(const iterator& other) const {
+                return _pos == other._pos;
+            }
+
+            bool operator!=(const iterator& other) const {
+                return _pos != other._pos;
+            }
+
+        private:
+            friend class DocumentSequence;
+
+            iterator(const char* pos, const char* end) : _pos(pos), _end(end) {}
+
+            const char* _pos = nullptr;
+            const char* _end = nullptr;
+        };
+
+        StringData name() const {
+            return _name;
+        }
+
+        /**
+         * Returns the number of documents in the sequence, without validating any of them.
+         */
+        size_t size() const {
+            return _count;
+        }
+
+        iterator begin() const {
+            return {_begin, _end};
+        }
+
+        iterator end() const {
+            return {_end, _end};
+        }
+
+    private:
+        friend class OpMsgView;
+
+        StringData _name;
+        const char* _begin = nullptr;
+        const char* _end = nullptr;
+        size_t _count = 0;
+    };
+
+    /**
+     * Indexes the sections of an OP_MSG message. Throws if the flags, checksum, body or layout of
+     * the sections are invalid, but not if a document in a document sequence is.
+     */
+    static OpMsgView parse(const Message& message);
+
+    uint32_t flags() const {
+        return _flags;
+    }
+
+    const BSONObj& body() const {
+        return _body;
+    }
+
+    const std::vector<DocumentSequence>& sequences() const {
+        return _sequences;
+    }
+
+    /**
+     * Returns a pointer to the sequence with the given name or nullptr if there are none.
+     */
+    const DocumentSequence* getSequence(StringData name) const {
+        auto it = std::find_if(_sequences.begin(), _sequences.end(), [&](const auto& seq) {
+            return seq.name() == name;
+        });
+        return it == _sequences.end() ? nullptr : &*it;
+    }
+
+    /**
+     * Validates every document and returns an OpMsg containing unowned BSON.
+     */
+    OpMsg toOpMsg() const;
+
+private:
+    uint32_t _flags = 0;
+    BSONObj _body;
+    std::vector<DocumentSequence> _sequences;
+};
+
 /**
  * Builds an OP_MSG message in-place in a Message buffer.
  *
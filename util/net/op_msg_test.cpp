@@ -106,7 +106,14 @@ public:
         // Copy the message to an exact-sized allocation so ASAN can detect out-of-bounds accesses.
         auto copy = SharedBuffer::allocate(orig.size());
         memcpy(copy.get(), orig.buf(), orig.size());
-        return Message(std::move(copy));
+        auto msg = Message(std::move(copy));
+
+        // Fill in the checksum placeholder, if there's room for one after the flags.
+        if (msg.dataSize() >= static_cast<int>(2 * sizeof(uint32_t)) &&
+            OpMsg::isFlagSet(msg, OpMsg::kChecksumPresent)) {
+            OpMsg::appendChecksum(&msg);
+        }
+        return msg;
     }
 
     OpMsg parse() {
@@ -145,8 +152,8 @@ const char kDocSequenceSection = 1;
 const uint32_t kNoFlags = 0;
 const uint32_t kHaveChecksum = 1;
 
-// CRC filler value
-const uint32_t kFakeCRC = 0;  // TODO will need to compute real crc when SERVER-28679 is done.
+// CRC placeholder, which OpMsgBytes::done() replaces with the real checksum
+const uint32_t kFakeCRC = 0;
 
 TEST_F(OpMsgParser, SucceedsWithJustBody) {
     auto msg = OpMsgBytes{
@@ -159,18 +166,45 @@ TEST_F(OpMsgParser, SucceedsWithJustBody) {
     ASSERT_EQ(msg.sequences.size(), 0u);
 }
 
-TEST_F(OpMsgParser, IgnoresCrcIfPresent) {  // Until SERVER-28679 is done.
+TEST_F(OpMsgParser, SucceedsWithChecksum) {
     auto msg = OpMsgBytes{
         kHaveChecksum,  //
         kBodySection,
         fromjson("{ping: 1}"),
-        kFakeCRC,  // If not ignored, this would be read as a second body.
+        kFakeCRC,  // If not skipped, this would be read as a second body.
     }.parse();
 
     ASSERT_BSONOBJ_EQ(msg.body, fromjson("{ping: 1}"));
     ASSERT_EQ(msg.sequences.size(), 0u);
 }
 
+TEST_F(OpMsgParser, FailsIfChecksumDoesNotMatch) {
+    auto msg = OpMsgBytes{
+        kHaveChecksum,  //
+        kBodySection,
+        fromjson("{ping: 1}"),
+        kFakeCRC,
+    }.done();
+
+    // Flip a bit in the body, which is still valid BSON afterwards
+    auto body = msg.singleData().data() + sizeof(uint32_t) + 1;
+    body[sizeof(int32_t) + 1] ^= 0x1;
+
+    ASSERT_THROWS_WITH_CHECK(OpMsg::parse(msg), AssertionException, [](const DBException& ex) {
+        ASSERT_EQ(ex.toStatus().code(), ErrorCodes::ChecksumMismatch);
+        ASSERT(ErrorCodes::isConnectionFatalMessageParseError(ex.toStatus().code()));
+    });
+}
+
+TEST_F(OpMsgParser, FailsIfTooSmallForChecksum) {
+    auto msg = OpMsgBytes{
+        kHaveChecksum,  //
+        kBodySection,
+    };
+
+    ASSERT_THROWS_CODE(msg.parse(), AssertionException, ErrorCodes::ChecksumMismatch);
+}
+
 TEST_F(OpMsgParser, SucceedsWithBodyThenSequence) {
     auto msg = OpMsgBytes{
         kNoFlags,  //
@@ -520,6 +554,83 @@ TEST_F(OpMsgParser, FailsIfTooManyDocumentSequences) {
         });
 }
 
+TEST_F(OpMsgParser, ViewMatchesParse) {
+    auto msg = OpMsgBytes{
+        kHaveChecksum,  //
+        kDocSequenceSection,
+        Sized{
+            "docs",  //
+            fromjson("{a: 1}"),
+            fromjson("{a: 2}"),
+            fromjson("{a: 3}"),
+        },
+
+        kBodySection,
+        fromjson("{ping: 1}"),
+
+        kDocSequenceSection,
+        Sized{
+            "empty",  //
+        },
+
+        kFakeCRC,
+    }.done();
+
+    const auto view = OpMsgView::parse(msg);
+    const auto parsed = OpMsg::parse(msg);
+    ASSERT_EQ(view.flags(), kHaveChecksum);
+    ASSERT_BSONOBJ_EQ(view.body(), parsed.body);
+    ASSERT_EQ(view.sequences().size(), parsed.sequences.size());
+    for (size_t i = 0; i < parsed.sequences.size(); i++) {
+        const auto& viewSeq = view.sequences()[i];
+        const auto& parsedSeq = parsed.sequences[i];
+        ASSERT_EQ(viewSeq.name(), parsedSeq.name);
+        ASSERT_EQ(viewSeq.size(), parsedSeq.objs.size());
+
+        size_t j = 0;
+        for (auto&& obj : viewSeq) {
+            ASSERT_BSONOBJ_EQ(obj, parsedSeq.objs[j++]);
+        }
+        ASSERT_EQ(j, parsedSeq.objs.size());
+    }
+    ASSERT_EQ(view.getSequence("docs"), &view.sequences()[0]);
+    ASSERT(!view.getSequence("other"));
+
+    // The documents are read in place rather than copied
+    ASSERT_GT(view.body().objdata(), msg.buf());
+    ASSERT_LT(view.body().objdata(), msg.buf() + msg.size());
+}
+
+TEST_F(OpMsgParser, ViewDefersDocumentValidation) {
+    auto msg = OpMsgBytes{
+        kNoFlags,  //
+        kBodySection,
+        fromjson("{ping: 1}"),
+
+        kDocSequenceSection,
+        Sized{
+            "docs",  //
+            fromjson("{a: 1}"),
+            Sized{'\x20', "a", '\0'},  // An element of an unknown type
+        },
+    }.done();
+
+    const auto view = OpMsgView::parse(msg);
+    const auto docs = view.getSequence("docs");
+    ASSERT(docs);
+    ASSERT_EQ(docs->size(), 2u);
+
+    auto it = docs->begin();
+    ASSERT_BSONOBJ_EQ(*it, fromjson("{a: 1}"));
+    ++it;
+    ASSERT(it != docs->end());
+    ASSERT_THROWS_CODE(*it, AssertionException, ErrorCodes::InvalidBSON);
+    ++it;
+    ASSERT(it == docs->end());
+
+    ASSERT_THROWS_CODE(OpMsg::parse(msg), AssertionException, ErrorCodes::InvalidBSON);
+}
+
 TEST_F(OpMsgParser, FailsIfNoRoomForFlags) {
     // Flags are 4 bytes. Try 0-3 bytes.
     ASSERT_THROWS_CODE(OpMsgBytes{}.parse(), AssertionException, ErrorCodes::Overflow);
@@ -812,6 +923,39 @@ TEST(OpMsgSerializer, SetFlagWorks) {
     }
 }
 
+TEST(OpMsgSerializer, AppendChecksumWorks) {
+    OpMsg msg;
+    msg.body = fromjson("{ping: 1}");
+    auto serialized = msg.serialize();
+    const auto sizeWithoutChecksum = serialized.size();
+
+    OpMsg::appendChecksum(&serialized);
+    ASSERT(OpMsg::isFlagSet(serialized, OpMsg::kChecksumPresent));
+    ASSERT_EQ(serialized.size(), sizeWithoutChecksum + 4);
+    ASSERT_BSONOBJ_EQ(OpMsg::parse(serialized).body, msg.body);
+
+    // The checksum covers the header, so changing the ids invalidates it until it's recomputed.
+    serialized.header().setId(12345);
+    ASSERT_THROWS_CODE(OpMsg::parse(serialized), AssertionException, ErrorCodes::ChecksumMismatch);
+
+    OpMsg::appendChecksum(&serialized);
+    ASSERT_EQ(serialized.size(), sizeWithoutChecksum + 4);
+    ASSERT_BSONOBJ_EQ(OpMsg::parse(serialized).body, msg.body);
+}
+
+TEST(OpMsgSerializer, AppendChecksumCopiesSharedBuffer) {
+    OpMsg msg;
+    msg.body = fromjson("{ping: 1}");
+    const auto original = msg.serialize();
+    auto withChecksum = original;
+
+    OpMsg::appendChecksum(&withChecksum);
+    ASSERT(!OpMsg::isFlagSet(original, OpMsg::kChecksumPresent));
+    ASSERT(OpMsg::isFlagSet(withChecksum, OpMsg::kChecksumPresent));
+    ASSERT_EQ(withChecksum.size(), original.size() + 4);
+    ASSERT_BSONOBJ_EQ(OpMsg::parse(original).body, OpMsg::parse(withChecksum).body);
+}
+
 TEST(OpMsgRequest, GetDatabaseWorks) {
     OpMsgRequest msg;
     msg.body = fromjson("{$db: 'foo'}");
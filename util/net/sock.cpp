@@ -22,6 +22,7 @@
 #include "mongo/util/net/sock.h"
 
 #include <algorithm>
+#include <memory>
 
 #if !defined(_WIN32)
 #include <arpa/inet.h>
@@ -406,6 +407,26 @@ void Socket::send(const char* data, int len, const char* context) {
 }
 
 void Socket::_send(const vector<pair<char*, int>>& data, const char* context) {
+    // Without a gather API every buffer costs a send(), and with SSL its own record too, so copy
+    // small sets of buffers into one and send them together.
+    const size_t kMaxCoalescedBytes = 64 * 1024;
+
+    size_t total = 0;
+    for (const auto& buffer : data) {
+        total += buffer.second;
+    }
+
+    if (data.size() > 1 && total <= kMaxCoalescedBytes) {
+        std::unique_ptr<char[]> coalesced(new char[total]);
+        char* ptr = coalesced.get();
+        for (const auto& buffer : data) {
+            memcpy(ptr, buffer.first, buffer.second);
+            ptr += buffer.second;
+        }
+        send(coalesced.get(), static_cast<int>(total), context);
+        return;
+    }
+
     for (vector<pair<char*, int>>::const_iterator i = data.begin(); i != data.end(); ++i) {
         char* data = i->first;
         int len = i->second;
@@ -441,7 +462,7 @@ void Socket::send(const vector<pair<char*, int>>& data, const char* context) {
     struct msghdr meta;
     memset(&meta, 0, sizeof(meta));
     meta.msg_iov = &d[0];
-    meta.msg_iovlen = d.size();
+    meta.msg_iovlen = i;  // Empty buffers were skipped above
 
     while (meta.msg_iovlen > 0) {
         int ret = -1;
@@ -201,7 +201,7 @@ public:
 private:
     void _init();
 
-    /** sends dumbly, just each buffer at a time */
+    /** sends without a gather API, copying small sets of buffers into one send */
     void _send(const std::vector<std::pair<char*, int>>& data, const char* context);
 
     /** raw send, same semantics as ::send with an additional context parameter */
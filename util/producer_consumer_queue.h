@@ -16,8 +16,10 @@
 
 #pragma once
 
+#include <algorithm>
 #include <boost/optional.hpp>
 #include <deque>
+#include <limits>
 #include <list>
 #include <queue>
 #include <stack>
@@ -81,6 +83,65 @@ constexpr std::true_type areInterruptionArgs() {
     return {};
 }
 
+// Blocks on condvar until pred returns true, honoring whichever interruption args were passed.
+// Throws ErrorCodes::ExceededTimeLimit if a deadline or duration elapses first.
+template <typename Callback>
+void waitFor(stdx::unique_lock<stdx::mutex>& lk,
+             stdx::condition_variable& condvar,
+             Callback&& pred,
+             OperationContext* opCtx) {
+    opCtx->waitForConditionOrInterrupt(condvar, lk, pred);
+}
+
+template <typename Callback>
+void waitFor(stdx::unique_lock<stdx::mutex>& lk,
+             stdx::condition_variable& condvar,
+             Callback&& pred) {
+    condvar.wait(lk, pred);
+}
+
+template <typename Callback>
+void waitFor(stdx::unique_lock<stdx::mutex>& lk,
+             stdx::condition_variable& condvar,
+             Callback&& pred,
+             OperationContext* opCtx,
+             Date_t deadline) {
+    uassert(ErrorCodes::ExceededTimeLimit,
+            "exceeded timeout",
+            opCtx->waitForConditionOrInterruptUntil(condvar, lk, deadline, pred));
+}
+
+template <typename Callback>
+void waitFor(stdx::unique_lock<stdx::mutex>& lk,
+             stdx::condition_variable& condvar,
+             Callback&& pred,
+             Date_t deadline) {
+    uassert(ErrorCodes::ExceededTimeLimit,
+            "exceeded timeout",
+            condvar.wait_until(lk, deadline.toSystemTimePoint(), pred));
+}
+
+template <typename Callback>
+void waitFor(stdx::unique_lock<stdx::mutex>& lk,
+             stdx::condition_variable& condvar,
+             Callback&& pred,
+             OperationContext* opCtx,
+             Milliseconds duration) {
+    uassert(ErrorCodes::ExceededTimeLimit,
+            "exceeded timeout",
+            opCtx->waitForConditionOrInterruptFor(condvar, lk, duration, pred));
+}
+
+template <typename Callback>
+void waitFor(stdx::unique_lock<stdx::mutex>& lk,
+             stdx::condition_variable& condvar,
+             Callback&& pred,
+             Milliseconds duration) {
+    uassert(ErrorCodes::ExceededTimeLimit,
+            "exceeded timeout",
+            condvar.wait_for(lk, duration.toSystemDuration(), pred));
+}
+
 }  // namespace producer_consumer_queue_detail
 
 /**
@@ -205,9 +266,13 @@ public:
 
             _waitForSpace(lk, cost, std::forward<InterruptionArgs>(interruptionArgs)...);
 
+            size_t count = 0;
             for (auto iter = start; iter != last; ++iter) {
                 _push(lk, std::move(*iter));
+                ++count;
             }
+
+            _notifyConsumersForBatch(lk, count);
         });
     }
 
@@ -263,8 +328,36 @@ public:
     std::pair<size_t, OutputIterator> popManyUpTo(size_t budget,
                                                   OutputIterator iterator,
                                                   InterruptionArgs&&... interruptionArgs) {
+        return popManyUpTo(budget,
+                           std::numeric_limits<size_t>::max(),
+                           iterator,
+                           std::forward<InterruptionArgs>(interruptionArgs)...);
+    }
+
+    // Waits for at least one item in the queue, then pops items out of the queue until it would
+    // block, we've popped maxCount items, or we've exceeded our budget
+    //
+    // The whole batch is taken under one acquisition of the queue's lock, and waiting producers are
+    // woken once for all of the space it frees
+    //
+    // OutputIterator must not throw on move assignment to *iter or popped values may be lost
+    // TODO: add sfinae to check to enforce
+    //
+    // Returns the cost value of the items extracted, along with the updated output iterator
+    template <
+        typename OutputIterator,
+        typename... InterruptionArgs,
+        typename = std::enable_if_t<decltype(producer_consumer_queue_detail::areInterruptionArgs(
+            std::declval<InterruptionArgs>()...))::value>>
+    std::pair<size_t, OutputIterator> popManyUpTo(size_t budget,
+                                                  size_t maxCount,
+                                                  OutputIterator iterator,
+                                                  InterruptionArgs&&... interruptionArgs) {
+        invariant(maxCount);
+
         return _popRunner([&](stdx::unique_lock<stdx::mutex>& lk) {
             size_t cost = 0;
+            size_t count = 0;
 
             _waitForNonEmpty(lk, std::forward<InterruptionArgs>(interruptionArgs)...);
 
@@ -273,7 +366,7 @@ public:
                 *iterator = std::move(*out);
                 ++iterator;
 
-                if (cost >= budget) {
+                if (cost >= budget || ++count == maxCount) {
                     break;
                 }
             }
@@ -373,6 +466,15 @@ private:
         }
     }
 
+    // Wakes one consumer per item in a freshly pushed batch, so that a batch is picked up in
+    // parallel rather than by each consumer waking the next as it pops. _notifyIfNecessary() wakes
+    // the first.
+    void _notifyConsumersForBatch(WithLock, size_t count) {
+        for (size_t i = 1; i < std::min(count, _consumers); ++i) {
+            _condvarConsumer.notify_one();
+        }
+    }
+
     template <typename Callback>
     auto _pushRunner(Callback&& cb) {
         stdx::unique_lock<stdx::mutex> lk(_mutex);
@@ -446,13 +548,14 @@ private:
         _producerWants = cost;
         const auto guard = MakeGuard([&] { _producerWants = 0; });
 
-        _waitFor(lk,
-                 _condvarProducer,
-                 [&] {
-                     _checkProducerClosed(lk);
-                     return _current + cost <= _max;
-                 },
-                 std::forward<InterruptionArgs>(interruptionArgs)...);
+        producer_consumer_queue_detail::waitFor(
+            lk,
+            _condvarProducer,
+            [&] {
+                _checkProducerClosed(lk);
+                return _current + cost <= _max;
+            },
+            std::forward<InterruptionArgs>(interruptionArgs)...);
     }
 
     template <typename... InterruptionArgs>
@@ -462,70 +565,14 @@ private:
         _consumers++;
         const auto guard = MakeGuard([&] { _consumers--; });
 
-        _waitFor(lk,
-                 _condvarConsumer,
-                 [&] {
-                     _checkConsumerClosed(lk);
-                     return _queue.size();
-                 },
-                 std::forward<InterruptionArgs>(interruptionArgs)...);
-    }
-
-    template <typename Callback>
-    void _waitFor(stdx::unique_lock<stdx::mutex>& lk,
-                  stdx::condition_variable& condvar,
-                  Callback&& pred,
-                  OperationContext* opCtx) {
-        opCtx->waitForConditionOrInterrupt(condvar, lk, pred);
-    }
-
-    template <typename Callback>
-    void _waitFor(stdx::unique_lock<stdx::mutex>& lk,
-                  stdx::condition_variable& condvar,
-                  Callback&& pred) {
-        condvar.wait(lk, pred);
-    }
-
-    template <typename Callback>
-    void _waitFor(stdx::unique_lock<stdx::mutex>& lk,
-                  stdx::condition_variable& condvar,
-                  Callback&& pred,
-                  OperationContext* opCtx,
-                  Date_t deadline) {
-        uassert(ErrorCodes::ExceededTimeLimit,
-                "exceeded timeout",
-                opCtx->waitForConditionOrInterruptUntil(condvar, lk, deadline, pred));
-    }
-
-    template <typename Callback>
-    void _waitFor(stdx::unique_lock<stdx::mutex>& lk,
-                  stdx::condition_variable& condvar,
-                  Callback&& pred,
-                  Date_t deadline) {
-        uassert(ErrorCodes::ExceededTimeLimit,
-                "exceeded timeout",
-                condvar.wait_until(lk, deadline.toSystemTimePoint(), pred));
-    }
-
-    template <typename Callback>
-    void _waitFor(stdx::unique_lock<stdx::mutex>& lk,
-                  stdx::condition_variable& condvar,
-                  Callback&& pred,
-                  OperationContext* opCtx,
-                  Milliseconds duration) {
-        uassert(ErrorCodes::ExceededTimeLimit,
-                "exceeded timeout",
-                opCtx->waitForConditionOrInterruptFor(condvar, lk, duration, pred));
-    }
-
-    template <typename Callback>
-    void _waitFor(stdx::unique_lock<stdx::mutex>& lk,
-                  stdx::condition_variable& condvar,
-                  Callback&& pred,
-                  Milliseconds duration) {
-        uassert(ErrorCodes::ExceededTimeLimit,
-                "exceeded timeout",
-                condvar.wait_for(lk, duration.toSystemDuration(), pred));
+        producer_consumer_queue_detail::waitFor(
+            lk,
+            _condvarConsumer,
+            [&] {
+                _checkConsumerClosed(lk);
+                return _queue.size();
+            },
+            std::forward<InterruptionArgs>(interruptionArgs)...);
     }
 
     mutable stdx::mutex _mutex;
@@ -0,0 +1,132 @@
+/**
+ * Copyright (C) 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include <benchmark/benchmark.h>
+#include <iterator>
+#include <vector>
+
+#include "mongo/stdx/thread.h"
+#include "mongo/util/assert_util.h"
+#include "mongo/util/producer_consumer_queue.h"
+#include "mongo/util/producer_consumer_ring_queue.h"
+
+namespace mongo {
+namespace {
+
+// Items moved through the queue per benchmark iteration, split evenly between the producers
+constexpr int kItemsPerIteration = 1 << 16;
+constexpr size_t kQueueSize = 1024;
+
+/**
+ * Moves kItemsPerIteration items from state.range(0) producers to state.range(1) consumers. When
+ * state.range(2) is more than one, producers push and consumers pop batches of that many items.
+ */
+template <typename Queue>
+void runPipeline(benchmark::State& state, Queue& queue) {
+    const int producers = state.range(0);
+    const int consumers = state.range(1);
+    const size_t batchSize = state.range(2);
+    const int itemsPerProducer = kItemsPerIteration / producers;
+
+    std::vector<stdx::thread> consumerThreads;
+
+    for (int i = 0; i < consumers; ++i) {
+        consumerThreads.emplace_back([&] {
+            std::vector<int> batch;
+            try {
+                while (true) {
+                    if (batchSize == 1) {
+                        benchmark::DoNotOptimize(queue.pop());
+                    } else {
+                        batch.clear();
+                        queue.popManyUpTo(kQueueSize, batchSize, std::back_inserter(batch));
+                        benchmark::DoNotOptimize(batch.data());
+                    }
+                }
+            } catch (const ExceptionFor<ErrorCodes::ProducerConsumerQueueEndClosed>&) {
+            }
+        });
+    }
+
+    std::vector<stdx::thread> producerThreads;
+    for (int i = 0; i < producers; ++i) {
+        producerThreads.emplace_back([&] {
+            std::vector<int> batch;
+            for (int pushed = 0; pushed < itemsPerProducer;) {
+                if (batchSize == 1) {
+                    queue.push(int(pushed++));
+                } else {
+                    batch.clear();
+                    for (size_t j = 0; j < batchSize && pushed < itemsPerProducer; ++j) {
+                        batch.push_back(pushed++);
+                    }
+                    queue.pushMany(batch.begin(), batch.end());
+                }
+            }
+        });
+    }
+
+    for (auto& thread : producerThreads) {
+        thread.join();
+    }
+    queue.closeProducerEnd();
+    for (auto& thread : consumerThreads) {
+        thread.join();
+    }
+}
+
+void BM_producerConsumerQueue(benchmark::State& state) {
+    for (auto _ : state) {
+        ProducerConsumerQueue<int> queue(kQueueSize);
+        runPipeline(state, queue);
+    }
+    state.SetItemsProcessed(state.iterations() * kItemsPerIteration);
+}
+
+void BM_producerConsumerRingQueue(benchmark::State& state) {
+    for (auto _ : state) {
+        ProducerConsumerRingQueue<int> queue(kQueueSize);
+        runPipeline(state, queue);
+    }
+    state.SetItemsProcessed(state.iterations() * kItemsPerIteration);
+}
+
+// ProducerConsumerQueue only allows a single producer
+void singleProducerArgs(benchmark::internal::Benchmark* bm) {
+    for (int consumers = 1; consumers <= 64; consumers *= 2) {
+        for (int batchSize : {1, 64}) {
+            bm->Args({1, consumers, batchSize});
+        }
+    }
+}
+
+void multiProducerArgs(benchmark::internal::Benchmark* bm) {
+    for (int producers = 1; producers <= 64; producers *= 2) {
+        for (int consumers = 1; consumers <= 64; consumers *= 2) {
+            for (int batchSize : {1, 64}) {
+                bm->Args({producers, consumers, batchSize});
+            }
+        }
+    }
+}
+
+BENCHMARK(BM_producerConsumerQueue)->Apply(singleProducerArgs)->UseRealTime();
+BENCHMARK(BM_producerConsumerRingQueue)->Apply(multiProducerArgs)->UseRealTime();
+
+}  // namespace
+}  // namespace mongo
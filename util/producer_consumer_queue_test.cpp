@@ -573,6 +573,70 @@ TEST_F(ProducerConsumerQueueTest, popManyUpToPopWithBlockingWithSpecialCost) {
     });
 }
 
+TEST_F(ProducerConsumerQueueTest, popManyUpToWithMaxCount) {
+    runPermutations([](auto helper) {
+        ProducerConsumerQueue<MoveOnly> pcq{};
+
+        std::vector<MoveOnly> vec;
+        for (int i = 0; i < 5; ++i) {
+            vec.emplace_back(MoveOnly(i));
+        }
+        pcq.pushMany(begin(vec), end(vec));
+
+        helper
+            .runThread("Consumer",
+                       [&](auto... interruptionArgs) {
+                           std::vector<MoveOnly> out;
+                           size_t spent;
+                           std::tie(spent, std::ignore) = pcq.popManyUpTo(
+                               100, 2, std::back_inserter(out), interruptionArgs...);
+
+                           ASSERT_EQUALS(spent, 2ul);
+                           ASSERT_EQUALS(out.size(), 2ul);
+                           ASSERT_EQUALS(out[0], MoveOnly(0));
+                           ASSERT_EQUALS(out[1], MoveOnly(1));
+
+                           // The budget still applies when it is reached before the count
+                           std::tie(spent, std::ignore) = pcq.popManyUpTo(
+                               1, 10, std::back_inserter(out), interruptionArgs...);
+
+                           ASSERT_EQUALS(spent, 1ul);
+                           ASSERT_EQUALS(out.size(), 3ul);
+                           ASSERT_EQUALS(out[2], MoveOnly(2));
+                       })
+            .join();
+
+        ASSERT_EQUALS(pcq.sizeForTest(), 2ul);
+    });
+}
+
+TEST_F(ProducerConsumerQueueTest, pushManyWakesAConsumerPerItem) {
+    runPermutations([](auto helper) {
+        ProducerConsumerQueue<MoveOnly> pcq{};
+
+        std::array<stdx::thread, 3> threads;
+        for (auto& thread : threads) {
+            thread = helper.runThread("Consumer", [&](auto... interruptionArgs) {
+                std::vector<MoveOnly> out;
+                pcq.popManyUpTo(100, 1, std::back_inserter(out), interruptionArgs...);
+                ASSERT_EQUALS(out.size(), 1ul);
+            });
+        }
+
+        std::vector<MoveOnly> vec;
+        for (int i = 0; i < 3; ++i) {
+            vec.emplace_back(MoveOnly(i));
+        }
+        pcq.pushMany(begin(vec), end(vec));
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        ASSERT_TRUE(pcq.emptyForTest());
+    });
+}
+
 TEST_F(ProducerConsumerQueueTest, singleProducerMultiConsumer) {
     runPermutations([](auto helper) {
         ProducerConsumerQueue<MoveOnly> pcq{};
@@ -0,0 +1,616 @@
+/**
+ * Copyright (C) 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <boost/optional.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <type_traits>
+
+#include "mongo/platform/atomic_word.h"
+#include "mongo/platform/compiler.h"
+#include "mongo/platform/pause.h"
+#include "mongo/stdx/new.h"
+#include "mongo/stdx/thread.h"
+#include "mongo/util/producer_consumer_queue.h"
+
+namespace mongo {
+
+namespace producer_consumer_queue_detail {
+
+/**
+ * A bounded multi-producer, multi-consumer ring of T, after Dmitry Vyukov's design.
+ *
+ * Every cell carries a sequence number which tells producers and consumers, without taking any
+ * locks, whether the cell is ready for them: a producer at position pos may fill the cell once its
+ * sequence equals pos, and a consumer at position pos may empty it once its sequence equals
+ * pos + 1. Producers and consumers only contend on their own position counters, which live on
+ * separate cache lines.
+ *
+ * The ring does no accounting of its own. Callers must reserve room before pushing, which lets a
+ * push claim its position with a single fetch-and-add rather than a compare and swap loop.
+ */
+template <typename T>
+class MPMCRing {
+public:
+    explicit MPMCRing(size_t capacity)
+        : _mask(_roundUpToPowerOfTwo(capacity) - 1), _cells(new Cell[_mask + 1]) {
+        for (size_t i = 0; i <= _mask; ++i) {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MPMCRing(const MPMCRing&) = delete;
+    MPMCRing& operator=(const MPMCRing&) = delete;
+
+    ~MPMCRing() {
+        while (tryPop()) {
+        }
+    }
+
+    size_t capacity() const {
+        return _mask + 1;
+    }
+
+    // Stores t at the next position. Since the caller reserved room for it, the only thing this can
+    // have to wait for is a consumer which has claimed the cell but not yet moved its value out.
+    void push(T&& t) {
+        const size_t pos = _enqueuePos.fetch_add(1, std::memory_order_relaxed);
+        auto& cell = _cells[pos & _mask];
+
+        for (size_t spins = 0; cell.sequence.load(std::memory_order_acquire) != pos; ++spins) {
+            if (spins < kSpinsBeforeYield) {
+                MONGO_YIELD_CORE_FOR_SMT();
+            } else {
+                stdx::this_thread::yield();
+            }
+        }
+
+        new (&cell.storage) T(std::move(t));
+        cell.sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    // Takes the value at the next position, or returns boost::none if the ring is empty or the
+    // producer of that position hasn't finished storing its value yet.
+    boost::optional<T> tryPop() {
+        size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+
+        while (true) {
+            auto& cell = _cells[pos & _mask];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto diff =
+                static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+
+            if (diff == 0) {
+                if (_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    auto value = reinterpret_cast<T*>(&cell.storage);
+                    boost::optional<T> out(std::move(*value));
+                    value->~T();
+                    cell.sequence.store(pos + _mask + 1, std::memory_order_release);
+                    return out;
+                }
+            } else if (diff < 0) {
+                return boost::none;
+            } else {
+                pos = _dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    static constexpr size_t kSpinsBeforeYield = 64;
+
+    struct Cell {
+        std::atomic<size_t> sequence;  // NOLINT
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    };
+
+    static size_t _roundUpToPowerOfTwo(size_t n) {
+        size_t out = 1;
+        while (out < n) {
+            out <<= 1;
+        }
+        return out;
+    }
+
+    const size_t _mask;
+    const std::unique_ptr<Cell[]> _cells;
+
+    alignas(stdx::hardware_destructive_interference_size)
+        std::atomic<size_t> _enqueuePos{0};  // NOLINT
+    alignas(stdx::hardware_destructive_interference_size)
+        std::atomic<size_t> _dequeuePos{0};  // NOLINT
+};
+
+}  // namespace producer_consumer_queue_detail
+
+/**
+ * A bounded, blocking, thread safe, cost parametrizable, multi-producer, multi-consumer queue which
+ * only takes a lock when a caller has to block.
+ *
+ * This has the same interface and semantics as ProducerConsumerQueue, including interruptibility,
+ * exceptions and the cost function, but pushes and pops which don't have to wait go through a lock
+ * free ring (see MPMCRing) instead of a mutex. Callers only park on a condition variable when the
+ * queue is empty or full, and producers and consumers only take the mutex to wake parked callers.
+ * Prefer it over ProducerConsumerQueue when many threads push or pop at the same time.
+ *
+ * Differences from ProducerConsumerQueue:
+ *   - The queue is always bounded, both in the number of items it holds (its capacity), and in
+ *     CostFunc units. Both bounds must fit in 32 bits.
+ *   - Any number of threads may push concurrently.
+ *   - Items pushed by concurrent producers may be popped in any order relative to each other.
+ *   - A consumer may briefly see the queue as empty while a producer which has claimed the next
+ *     position is still moving its value in; a blocking pop will be woken when it finishes.
+ *   - The lifecycle methods of T must not throw.
+ */
+template <typename T, typename CostFunc = producer_consumer_queue_detail::DefaultCostFunction>
+class ProducerConsumerRingQueue {
+
+public:
+    // Holds up to capacity items, and up to capacity in CostFunc units
+    explicit ProducerConsumerRingQueue(size_t capacity)
+        : ProducerConsumerRingQueue(capacity, capacity, CostFunc{}) {}
+
+    // Holds up to capacity items, whose total cost may not exceed maxCost
+    ProducerConsumerRingQueue(size_t capacity, size_t maxCost, CostFunc costFunc = CostFunc{})
+        : _capacity(capacity), _max(maxCost), _costFunc(std::move(costFunc)), _ring(capacity) {
+        invariant(capacity > 0);
+        invariant(capacity <= kMaxBound);
+        invariant(maxCost <= kMaxBound);
+    }
+
+    ProducerConsumerRingQueue(const ProducerConsumerRingQueue&) = delete;
+    ProducerConsumerRingQueue& operator=(const ProducerConsumerRingQueue&) = delete;
+
+    ProducerConsumerRingQueue(ProducerConsumerRingQueue&&) = delete;
+    ProducerConsumerRingQueue& operator=(ProducerConsumerRingQueue&&) = delete;
+
+    ~ProducerConsumerRingQueue() {
+        invariant(!_producersWaiting.load());
+        invariant(!_consumersWaiting.load());
+    }
+
+    // Pushes the passed T into the queue
+    //
+    // Leaves T unchanged if an interrupt exception is thrown while waiting for space
+    template <
+        typename... InterruptionArgs,
+        typename = std::enable_if_t<decltype(producer_consumer_queue_detail::areInterruptionArgs(
+            std::declval<InterruptionArgs>()...))::value>>
+    void push(T&& t, InterruptionArgs&&... interruptionArgs) {
+        const auto cost = _invokeCostFunc(t);
+        uassert(ErrorCodes::ProducerConsumerQueueBatchTooLarge,
+                str::stream() << "cost of item (" << cost << ") larger than maximum queue size ("
+                              << _max
+                              << ")",
+                cost <= _max);
+
+        _reserve(cost, 1, std::forward<InterruptionArgs>(interruptionArgs)...);
+        _ring.push(std::move(t));
+        _notifyConsumers(1);
+    }
+
+    // Pushes all Ts into the queue
+    //
+    // Blocks until there is room for all of the Ts at once, but other producers' items may be
+    // interleaved with them
+    //
+    // StartIterator must be ForwardIterator
+    //
+    // Leaves the values underneath the iterators unchanged if an interrupt exception is thrown
+    // while waiting for space
+    template <
+        typename StartIterator,
+        typename EndIterator,
+        typename... InterruptionArgs,
+        typename = std::enable_if_t<decltype(producer_consumer_queue_detail::areInterruptionArgs(
+            std::declval<InterruptionArgs>()...))::value>>
+    void pushMany(StartIterator start, EndIterator last, InterruptionArgs&&... interruptionArgs) {
+        size_t cost = 0;
+        size_t count = 0;
+        for (auto iter = start; iter != last; ++iter) {
+            cost += _invokeCostFunc(*iter);
+            ++count;
+        }
+
+        uassert(ErrorCodes::ProducerConsumerQueueBatchTooLarge,
+                str::stream() << "cost of items in batch (" << cost
+                              << ") larger than maximum queue size ("
+                              << _max
+                              << ")",
+                cost <= _max);
+        uassert(ErrorCodes::ProducerConsumerQueueBatchTooLarge,
+                str::stream() << "number of items in batch (" << count
+                              << ") larger than queue capacity ("
+                              << _capacity
+                              << ")",
+                count <= _capacity);
+
+        _reserve(cost, count, std::forward<InterruptionArgs>(interruptionArgs)...);
+
+        for (auto iter = start; iter != last; ++iter) {
+            _ring.push(std::move(*iter));
+        }
+
+        _notifyConsumers(count);
+    }
+
+    // Attempts a non-blocking push of a value
+    //
+    // Leaves T unchanged if it fails
+    bool tryPush(T&& t) {
+        _checkProducerClosed();
+
+        const auto cost = _invokeCostFunc(t);
+        if (!_tryReserve(cost, 1)) {
+            return false;
+        }
+
+        _checkReservationNotClosed(cost, 1);
+        _ring.push(std::move(t));
+        _notifyConsumers(1);
+        return true;
+    }
+
+    // Pops one T out of the queue
+    template <
+        typename... InterruptionArgs,
+        typename = std::enable_if_t<decltype(producer_consumer_queue_detail::areInterruptionArgs(
+            std::declval<InterruptionArgs>()...))::value>>
+    T pop(InterruptionArgs&&... interruptionArgs) {
+        auto t = _waitAndPop(std::forward<InterruptionArgs>(interruptionArgs)...);
+        _release(_invokeCostFunc(t), 1);
+        return t;
+    }
+
+    // Waits for at least one item in the queue, then pops items out of the queue until it would
+    // block
+    //
+    // OutputIterator must not throw on move assignment to *iter or popped values may be lost
+    //
+    // Returns the cost value of the items extracted, along with the updated output iterator
+    template <
+        typename OutputIterator,
+        typename... InterruptionArgs,
+        typename = std::enable_if_t<decltype(producer_consumer_queue_detail::areInterruptionArgs(
+            std::declval<InterruptionArgs>()...))::value>>
+    std::pair<size_t, OutputIterator> popMany(OutputIterator iterator,
+                                              InterruptionArgs&&... interruptionArgs) {
+        return popManyUpTo(_max, iterator, std::forward<InterruptionArgs>(interruptionArgs)...);
+    }
+
+    // Waits for at least one item in the queue, then pops items out of the queue until it would
+    // block, or we've exceeded our budget
+    //
+    // OutputIterator must not throw on move assignment to *iter or popped values may be lost
+    //
+    // Returns the cost value of the items extracted, along with the updated output iterator
+    template <
+        typename OutputIterator,
+        typename... InterruptionArgs,
+        typename = std::enable_if_t<decltype(producer_consumer_queue_detail::areInterruptionArgs(
+            std::declval<InterruptionArgs>()...))::value>>
+    std::pair<size_t, OutputIterator> popManyUpTo(size_t budget,
+                                                  OutputIterator iterator,
+                                                  InterruptionArgs&&... interruptionArgs) {
+        return popManyUpTo(budget,
+                           std::numeric_limits<size_t>::max(),
+                           iterator,
+                           std::forward<InterruptionArgs>(interruptionArgs)...);
+    }
+
+    // Waits for at least one item in the queue, then pops items out of the queue until it would
+    // block, we've popped maxCount items, or we've exceeded our budget
+    //
+    // OutputIterator must not throw on move assignment to *iter or popped values may be lost
+    //
+    // Returns the cost value of the items extracted, along with the updated output iterator
+    template <
+        typename OutputIterator,
+        typename... InterruptionArgs,
+        typename = std::enable_if_t<decltype(producer_consumer_queue_detail::areInterruptionArgs(
+            std::declval<InterruptionArgs>()...))::value>>
+    std::pair<size_t, OutputIterator> popManyUpTo(size_t budget,
+                                                  size_t maxCount,
+                                                  OutputIterator iterator,
+                                                  InterruptionArgs&&... interruptionArgs) {
+        invariant(maxCount);
+
+        auto first = _waitAndPop(std::forward<InterruptionArgs>(interruptionArgs)...);
+
+        size_t cost = _invokeCostFunc(first);
+        size_t count = 1;
+        // Give back the space for the whole batch at once, so producers are woken at most once
+        const auto guard = MakeGuard([&] { _release(cost, count); });
+
+        *iterator = std::move(first);
+        ++iterator;
+
+        while (cost < budget && count < maxCount) {
+            auto out = _ring.tryPop();
+            if (!out) {
+                break;
+            }
+
+            cost += _invokeCostFunc(*out);
+            ++count;
+            *iterator = std::move(*out);
+            ++iterator;
+        }
+
+        return std::make_pair(cost, iterator);
+    }
+
+    // Attempts a non-blocking pop of a value
+    boost::optional<T> tryPop() {
+        _checkConsumerClosed();
+
+        auto out = _ring.tryPop();
+        if (out) {
+            _release(_invokeCostFunc(*out), 1);
+        }
+
+        return out;
+    }
+
+    // Closes the producer end. Consumers will continue to consume until the queue is exhausted, at
+    // which time they will begin to throw with an interruption dbexception
+    void closeProducerEnd() {
+        _producerEndClosed.store(true);
+
+        _notifyAll();
+    }
+
+    // Closes the consumer end. This causes all callers to throw with an interruption dbexception
+    void closeConsumerEnd() {
+        _consumerEndClosed.store(true);
+        _producerEndClosed.store(true);
+
+        _notifyAll();
+    }
+
+    // TEST ONLY FUNCTIONS
+
+    // Returns the current depth of the queue in CostFunction units, including space reserved by
+    // pushes which are still in progress
+    size_t sizeForTest() const {
+        return _usage.load() >> kCostShift;
+    }
+
+    // Returns true if the queue is empty
+    bool emptyForTest() const {
+        return sizeForTest() == 0;
+    }
+
+private:
+    // The number of items in the queue and their total cost are packed into one word, so that both
+    // bounds can be checked and claimed with a single compare and swap. Items are counted in the
+    // low bits.
+    static constexpr int kCostShift = 32;
+    static constexpr size_t kMaxBound = std::numeric_limits<uint32_t>::max();
+
+    static uint64_t _pack(size_t cost, size_t count) {
+        return (static_cast<uint64_t>(cost) << kCostShift) | count;
+    }
+
+    static size_t _countOf(uint64_t usage) {
+        return usage & kMaxBound;
+    }
+
+    static size_t _costOf(uint64_t usage) {
+        return usage >> kCostShift;
+    }
+
+    size_t _invokeCostFunc(const T& t) {
+        auto cost = _costFunc(t);
+        invariant(cost);
+        return cost;
+    }
+
+    void _checkProducerClosed() {
+        uassert(ErrorCodes::ProducerConsumerQueueEndClosed,
+                "Producer end closed",
+                !_producerEndClosed.load());
+        uassert(ErrorCodes::ProducerConsumerQueueEndClosed,
+                "Consumer end closed",
+                !_consumerEndClosed.load());
+    }
+
+    void _checkConsumerClosed() {
+        uassert(ErrorCodes::ProducerConsumerQueueEndClosed,
+                "Consumer end closed",
+                !_consumerEndClosed.load());
+        // Items that have been reserved but not yet stored count as present, so that a push which
+        // raced with closeProducerEnd() is never stranded in the queue
+        uassert(ErrorCodes::ProducerConsumerQueueEndClosed,
+                "Producer end closed and values exhausted",
+                !(_producerEndClosed.load() && _countOf(_usage.load()) == 0));
+    }
+
+    // Claims room for count more items costing cost in total, if both bounds allow it
+    bool _tryReserve(size_t cost, size_t count) {
+        auto usage = _usage.load();
+
+        while (true) {
+            if (_countOf(usage) + count > _capacity || _costOf(usage) + cost > _max) {
+                return false;
+            }
+
+            const auto observed = _usage.compareAndSwap(usage, usage + _pack(cost, count));
+            if (observed == usage) {
+                return true;
+            }
+
+            usage = observed;
+        }
+    }
+
+    // Claims room for the items, waiting for space if necessary
+    template <typename... InterruptionArgs>
+    void _reserve(size_t cost, size_t count, InterruptionArgs&&... interruptionArgs) {
+        _checkProducerClosed();
+
+        if (!_tryReserve(cost, count)) {
+            stdx::unique_lock<stdx::mutex> lk(_mutex);
+
+            _producersWaiting.fetchAndAdd(1);
+            const auto guard = MakeGuard([&] { _producersWaiting.fetchAndSubtract(1); });
+            // Pairs with the fence in _release(), so that either we see the space it freed or it
+            // sees us waiting
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            producer_consumer_queue_detail::waitFor(
+                lk,
+                _condvarProducer,
+                [&] {
+                    _checkProducerClosed();
+                    return _tryReserve(cost, count);
+                },
+                std::forward<InterruptionArgs>(interruptionArgs)...);
+        }
+
+        _checkReservationNotClosed(cost, count);
+    }
+
+    // Consumers may have decided that the queue is exhausted if the producer end was closed between
+    // our check and our reservation, in which case the reservation is given back and the push fails
+    void _checkReservationNotClosed(size_t cost, size_t count) {
+        if (MONGO_likely(!_producerEndClosed.load())) {
+            return;
+        }
+
+        _release(cost, count);
+        _checkProducerClosed();
+    }
+
+    // Pops the next item, waiting for one if necessary. The caller must _release() its space.
+    template <typename... InterruptionArgs>
+    T _waitAndPop(InterruptionArgs&&... interruptionArgs) {
+        _checkConsumerClosed();
+
+        if (auto out = _ring.tryPop()) {
+            return std::move(*out);
+        }
+
+        stdx::unique_lock<stdx::mutex> lk(_mutex);
+
+        _consumersWaiting.fetchAndAdd(1);
+        const auto guard = MakeGuard([&] { _consumersWaiting.fetchAndSubtract(1); });
+        // Pairs with the fence in _notifyConsumers(), so that either we see the item it stored or
+        // it sees us waiting
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        boost::optional<T> out;
+        producer_consumer_queue_detail::waitFor(
+            lk,
+            _condvarConsumer,
+            [&] {
+                _checkConsumerClosed();
+                out = _ring.tryPop();
+                return static_cast<bool>(out);
+            },
+            std::forward<InterruptionArgs>(interruptionArgs)...);
+
+        return std::move(*out);
+    }
+
+    // Gives back the space held by popped items, or by a failed push, and wakes any producers
+    // waiting for it
+    void _release(size_t cost, size_t count) {
+        const auto usage = _usage.subtractAndFetch(_pack(cost, count));
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const bool producersWaiting = _producersWaiting.load();
+        const bool consumersWaiting = _consumersWaiting.load();
+        if (MONGO_likely(!producersWaiting && !consumersWaiting)) {
+            return;
+        }
+
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+
+        // Waiting producers may want different amounts of space, so wake them all and let them
+        // race for it
+        if (producersWaiting) {
+            _condvarProducer.notify_all();
+        }
+
+        if (consumersWaiting) {
+            if (_countOf(usage) == 0) {
+                // The last item is gone. If the producer end is closed, everyone must now throw.
+                if (_producerEndClosed.load()) {
+                    _condvarConsumer.notify_all();
+                }
+            } else {
+                // A consumer woken for an item which we took instead passes the wakeup on
+                _condvarConsumer.notify_one();
+            }
+        }
+    }
+
+    // Wakes one waiting consumer for each of count newly stored items
+    void _notifyConsumers(size_t count) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const size_t consumersWaiting = _consumersWaiting.load();
+        if (MONGO_likely(!consumersWaiting)) {
+            return;
+        }
+
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        for (size_t i = 0; i < std::min(count, consumersWaiting); ++i) {
+            _condvarConsumer.notify_one();
+        }
+    }
+
+    void _notifyAll() {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        _condvarConsumer.notify_all();
+        _condvarProducer.notify_all();
+    }
+
+    // Only guards parking and waking, never the contents of the queue
+    stdx::mutex _mutex;
+    stdx::condition_variable _condvarConsumer;
+    stdx::condition_variable _condvarProducer;
+
+    // Max number of items in the queue
+    const size_t _capacity;
+
+    // Max size of the queue
+    const size_t _max;
+
+    // User's cost function
+    CostFunc _costFunc;
+
+    producer_consumer_queue_detail::MPMCRing<T> _ring;
+
+    // Packed number of items and their cost, see _pack()
+    AtomicWord<unsigned long long> _usage{0};
+
+    // Counters for callers parked on the condition variables
+    AtomicWord<unsigned> _producersWaiting{0};
+    AtomicWord<unsigned> _consumersWaiting{0};
+
+    // Flags that we're shutting down the queue
+    AtomicWord<bool> _consumerEndClosed{false};
+    AtomicWord<bool> _producerEndClosed{false};
+};
+
+}  // namespace mongo
@@ -0,0 +1,305 @@
+/**
+ * Copyright (C) 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/unittest/unittest.h"
+
+#include "mongo/util/producer_consumer_ring_queue.h"
+
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include "mongo/stdx/thread.h"
+#include "mongo/util/assert_util.h"
+
+namespace mongo {
+
+namespace {
+
+struct SizeCost {
+    size_t operator()(const std::vector<int>& v) const {
+        return v.size();
+    }
+};
+
+TEST(ProducerConsumerRingQueueTest, basicPushPop) {
+    ProducerConsumerRingQueue<std::unique_ptr<int>> pcq(4);
+
+    pcq.push(std::make_unique<int>(1));
+    pcq.push(std::make_unique<int>(2));
+    ASSERT_EQUALS(pcq.sizeForTest(), 2ul);
+
+    ASSERT_EQUALS(*pcq.pop(), 1);
+    ASSERT_EQUALS(*pcq.pop(), 2);
+    ASSERT_TRUE(pcq.emptyForTest());
+}
+
+TEST(ProducerConsumerRingQueueTest, tryPushRespectsCapacity) {
+    // The ring rounds up to 4 cells, but the queue must still stop at 3 items
+    ProducerConsumerRingQueue<int> pcq(3);
+
+    ASSERT_TRUE(pcq.tryPush(1));
+    ASSERT_TRUE(pcq.tryPush(2));
+    ASSERT_TRUE(pcq.tryPush(3));
+    ASSERT_FALSE(pcq.tryPush(4));
+
+    ASSERT_EQUALS(*pcq.tryPop(), 1);
+    ASSERT_TRUE(pcq.tryPush(4));
+
+    ASSERT_EQUALS(*pcq.tryPop(), 2);
+    ASSERT_EQUALS(*pcq.tryPop(), 3);
+    ASSERT_EQUALS(*pcq.tryPop(), 4);
+    ASSERT_FALSE(pcq.tryPop());
+}
+
+TEST(ProducerConsumerRingQueueTest, tryPushWithSpecialCost) {
+    ProducerConsumerRingQueue<std::vector<int>, SizeCost> pcq(8, 5);
+
+    ASSERT_TRUE(pcq.tryPush(std::vector<int>{1, 2, 3}));
+    ASSERT_FALSE(pcq.tryPush(std::vector<int>{1, 2, 3}));
+    ASSERT_TRUE(pcq.tryPush(std::vector<int>{1, 2}));
+    ASSERT_EQUALS(pcq.sizeForTest(), 5ul);
+
+    ASSERT_EQUALS(pcq.tryPop()->size(), 3ul);
+    ASSERT_EQUALS(pcq.sizeForTest(), 2ul);
+}
+
+TEST(ProducerConsumerRingQueueTest, pushTooLarge) {
+    ProducerConsumerRingQueue<std::vector<int>, SizeCost> pcq(2, 4);
+
+    ASSERT_THROWS_CODE(pcq.push(std::vector<int>(5)),
+                       DBException,
+                       ErrorCodes::ProducerConsumerQueueBatchTooLarge);
+
+    std::vector<std::vector<int>> tooCostly{std::vector<int>(3), std::vector<int>(2)};
+    ASSERT_THROWS_CODE(pcq.pushMany(tooCostly.begin(), tooCostly.end()),
+                       DBException,
+                       ErrorCodes::ProducerConsumerQueueBatchTooLarge);
+
+    std::vector<std::vector<int>> tooMany{
+        std::vector<int>(1), std::vector<int>(1), std::vector<int>(1)};
+    ASSERT_THROWS_CODE(pcq.pushMany(tooMany.begin(), tooMany.end()),
+                       DBException,
+                       ErrorCodes::ProducerConsumerQueueBatchTooLarge);
+
+    ASSERT_TRUE(pcq.emptyForTest());
+}
+
+TEST(ProducerConsumerRingQueueTest, popsWithTimeout) {
+    ProducerConsumerRingQueue<int> pcq(4);
+
+    ASSERT_THROWS_CODE(pcq.pop(Milliseconds(10)), DBException, ErrorCodes::ExceededTimeLimit);
+    ASSERT_THROWS_CODE(pcq.pop(Date_t::now() + Milliseconds(10)),
+                       DBException,
+                       ErrorCodes::ExceededTimeLimit);
+
+    std::vector<int> vec;
+    ASSERT_THROWS_CODE(pcq.popMany(std::back_inserter(vec), Milliseconds(10)),
+                       DBException,
+                       ErrorCodes::ExceededTimeLimit);
+    ASSERT_TRUE(vec.empty());
+}
+
+TEST(ProducerConsumerRingQueueTest, pushesWithTimeout) {
+    ProducerConsumerRingQueue<std::unique_ptr<int>> pcq(1);
+
+    pcq.push(std::make_unique<int>(1));
+
+    auto value = std::make_unique<int>(2);
+    ASSERT_THROWS_CODE(
+        pcq.push(std::move(value), Milliseconds(10)), DBException, ErrorCodes::ExceededTimeLimit);
+    // A push which times out leaves its argument alone
+    ASSERT_TRUE(value);
+    ASSERT_EQUALS(pcq.sizeForTest(), 1ul);
+}
+
+TEST(ProducerConsumerRingQueueTest, blockedPushIsWokenByPop) {
+    ProducerConsumerRingQueue<int> pcq(1);
+
+    pcq.push(1);
+
+    stdx::thread producer([&] { pcq.push(2); });
+
+    ASSERT_EQUALS(pcq.pop(), 1);
+    ASSERT_EQUALS(pcq.pop(), 2);
+
+    producer.join();
+}
+
+TEST(ProducerConsumerRingQueueTest, pushManyWaitsForRoomForTheWholeBatch) {
+    ProducerConsumerRingQueue<int> pcq(4);
+
+    pcq.push(0);
+    pcq.push(0);
+
+    std::vector<int> batch{1, 2, 3};
+    stdx::thread producer([&] { pcq.pushMany(batch.begin(), batch.end()); });
+
+    ASSERT_EQUALS(pcq.pop(), 0);
+    ASSERT_EQUALS(pcq.pop(), 0);
+
+    std::vector<int> out;
+    while (out.size() < 3) {
+        pcq.popMany(std::back_inserter(out));
+    }
+    ASSERT_TRUE(out == batch);
+
+    producer.join();
+}
+
+TEST(ProducerConsumerRingQueueTest, popManyUpToWithSpecialCost) {
+    ProducerConsumerRingQueue<std::vector<int>, SizeCost> pcq(8, 10);
+
+    pcq.push(std::vector<int>(2));
+    pcq.push(std::vector<int>(3));
+    pcq.push(std::vector<int>(4));
+
+    std::vector<std::vector<int>> out;
+    auto result = pcq.popManyUpTo(4, std::back_inserter(out));
+    ASSERT_EQUALS(result.first, 5ul);
+    ASSERT_EQUALS(out.size(), 2ul);
+    ASSERT_EQUALS(pcq.sizeForTest(), 4ul);
+
+    result = pcq.popManyUpTo(100, std::back_inserter(out));
+    ASSERT_EQUALS(result.first, 4ul);
+    ASSERT_EQUALS(out.size(), 3ul);
+    ASSERT_TRUE(pcq.emptyForTest());
+}
+
+TEST(ProducerConsumerRingQueueTest, popManyUpToWithMaxCount) {
+    ProducerConsumerRingQueue<int> pcq(8);
+
+    std::vector<int> in{1, 2, 3, 4, 5};
+    pcq.pushMany(in.begin(), in.end());
+
+    std::vector<int> out;
+    auto result = pcq.popManyUpTo(100, 2, std::back_inserter(out));
+    ASSERT_EQUALS(result.first, 2ul);
+    ASSERT_TRUE(out == std::vector<int>({1, 2}));
+
+    result = pcq.popManyUpTo(100, 10, std::back_inserter(out));
+    ASSERT_EQUALS(result.first, 3ul);
+    ASSERT_TRUE(out == in);
+    ASSERT_TRUE(pcq.emptyForTest());
+}
+
+TEST(ProducerConsumerRingQueueTest, closeProducerEnd) {
+    ProducerConsumerRingQueue<int> pcq(4);
+
+    pcq.push(1);
+
+    stdx::thread consumer([&] {
+        ASSERT_EQUALS(pcq.pop(), 1);
+        ASSERT_THROWS_CODE(pcq.pop(), DBException, ErrorCodes::ProducerConsumerQueueEndClosed);
+    });
+
+    pcq.closeProducerEnd();
+    consumer.join();
+
+    ASSERT_THROWS_CODE(pcq.push(2), DBException, ErrorCodes::ProducerConsumerQueueEndClosed);
+    ASSERT_THROWS_CODE(pcq.tryPop(), DBException, ErrorCodes::ProducerConsumerQueueEndClosed);
+}
+
+TEST(ProducerConsumerRingQueueTest, closeConsumerEnd) {
+    ProducerConsumerRingQueue<int> pcq(1);
+
+    pcq.push(1);
+
+    stdx::thread producer([&] {
+        ASSERT_THROWS_CODE(pcq.push(2), DBException, ErrorCodes::ProducerConsumerQueueEndClosed);
+    });
+
+    pcq.closeConsumerEnd();
+    producer.join();
+
+    ASSERT_THROWS_CODE(pcq.pop(), DBException, ErrorCodes::ProducerConsumerQueueEndClosed);
+}
+
+TEST(ProducerConsumerRingQueueTest, multiProducerMultiConsumer) {
+    const int kProducers = 8;
+    const int kConsumers = 8;
+    const int kItemsPerProducer = 20000;
+
+    // A small queue keeps producers and consumers parking and waking each other
+    ProducerConsumerRingQueue<int> pcq(16);
+
+    std::vector<stdx::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&, p] {
+            for (int i = 0; i < kItemsPerProducer; ++i) {
+                if (i % 2) {
+                    pcq.push(p * kItemsPerProducer + i);
+                } else {
+                    while (!pcq.tryPush(p * kItemsPerProducer + i)) {
+                        stdx::this_thread::yield();
+                    }
+                }
+            }
+        });
+    }
+
+    std::vector<long long> sums(kConsumers);
+    std::vector<int> counts(kConsumers);
+    std::vector<stdx::thread> consumers;
+    for (int c = 0; c < kConsumers; ++c) {
+        consumers.emplace_back([&, c] {
+            std::vector<int> batch;
+            try {
+                while (true) {
+                    batch.clear();
+                    if (c % 2) {
+                        batch.push_back(pcq.pop());
+                    } else {
+                        pcq.popManyUpTo(4, std::back_inserter(batch));
+                    }
+
+                    for (auto value : batch) {
+                        sums[c] += value;
+                        ++counts[c];
+                    }
+                }
+            } catch (const DBException& ex) {
+                ASSERT_EQUALS(ex.code(), ErrorCodes::ProducerConsumerQueueEndClosed);
+            }
+        });
+    }
+
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    pcq.closeProducerEnd();
+    for (auto& consumer : consumers) {
+        consumer.join();
+    }
+
+    long long sum = 0;
+    int count = 0;
+    for (int c = 0; c < kConsumers; ++c) {
+        sum += sums[c];
+        count += counts[c];
+    }
+
+    const long long n = kProducers * kItemsPerProducer;
+    ASSERT_EQUALS(count, n);
+    ASSERT_EQUALS(sum, n * (n - 1) / 2);
+    ASSERT_TRUE(pcq.emptyForTest());
+}
+
+}  // namespace
+
+}  // namespace mongo
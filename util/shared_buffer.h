@@ -16,7 +16,10 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <boost/intrusive_ptr.hpp>
+#include <cstring>
 
 #include "mongo/platform/atomic_word.h"
 #include "mongo/util/allocator.h"
@@ -39,6 +42,39 @@ public:
         return takeOwnership(mongoMalloc(sizeof(Holder) + bytes), bytes);
     }
 
+    // Requests larger than this aren't pooled. See allocatePooled().
+    static constexpr size_t kMaxPooledBytes = (size_t(1) << 16) - 16;
+
+    /**
+     * Like allocate(), but takes the memory from a cache of power-of-two sized blocks kept by the
+     * calling thread. When the last reference goes away the block goes back to the cache of the
+     * thread that released it rather than to free(). capacity() rounds up to the size of the
+     * block, so it may be larger than "bytes".
+     *
+     * This is meant for short-lived buffers which are allocated and released at a high rate, such
+     * as incoming network messages. Requests larger than kMaxPooledBytes fall back to allocate().
+     */
+    static SharedBuffer allocatePooled(size_t bytes) {
+        if (bytes > kMaxPooledBytes) {
+            return allocate(bytes);
+        }
+
+        const uint32_t sizeClass = _sizeClassFor(sizeof(Holder) + bytes);
+        const size_t blockSize = _sizeClassBytes(sizeClass);
+
+        void* block = nullptr;
+        if (auto cache = ThreadCache::get()) {
+            block = cache->pop(sizeClass);
+        }
+        if (!block) {
+            block = mongoMalloc(blockSize);
+        }
+
+        auto buffer = takeOwnership(block, blockSize - sizeof(Holder));
+        buffer._holder->_sizeClass = sizeClass;
+        return buffer;
+    }
+
     /**
      * Resizes the buffer, copying the current contents.
      *
@@ -50,6 +86,14 @@ public:
     void realloc(size_t size) {
         invariant(!_holder || !_holder->isShared());
 
+        if (_holder && _holder->_sizeClass != kNotPooled) {
+            // Pooled blocks have to stay the size of their class, so move to an ordinary buffer.
+            auto tmp = allocate(size);
+            memcpy(tmp.get(), get(), std::min(size, capacity()));
+            swap(tmp);
+            return;
+        }
+
         const size_t realSize = size + sizeof(Holder);
         void* newPtr = mongoRealloc(_holder.get(), realSize);
 
@@ -85,6 +129,91 @@ public:
     }
 
 private:
+    // Pooled blocks are 2^kMinSizeClassBits bytes and up, doubling for each size class.
+    static constexpr uint32_t kMinSizeClassBits = 6;
+    static constexpr uint32_t kNumSizeClasses = 11;
+    static constexpr uint32_t kNotPooled = ~uint32_t(0);
+
+    // Bytes each thread may keep cached per size class, so idle threads don't hoard memory.
+    static constexpr size_t kMaxCachedBytesPerSizeClass = 128 * 1024;
+
+    static size_t _sizeClassBytes(uint32_t sizeClass) {
+        return size_t(1) << (kMinSizeClassBits + sizeClass);
+    }
+
+    static uint32_t _sizeClassFor(size_t blockBytes) {
+        uint32_t sizeClass = 0;
+        while (_sizeClassBytes(sizeClass) < blockBytes) {
+            ++sizeClass;
+        }
+        return sizeClass;
+    }
+
+    /**
+     * Per-thread free lists of pooled blocks, one per size class. Nothing is shared between
+     * threads, so no synchronization is needed; a block allocated on one thread and released on
+     * another simply migrates to the releasing thread's cache.
+     */
+    class ThreadCache {
+    public:
+        explicit ThreadCache(bool* destroyed) : _destroyed(destroyed) {}
+
+        ~ThreadCache() {
+            for (auto head : _freeLists) {
+                while (head) {
+                    auto next = head->next;
+                    free(head);
+                    head = next;
+                }
+            }
+            *_destroyed = true;
+        }
+
+        /**
+         * Returns the calling thread's cache, or null if the thread is exiting and has already
+         * destroyed it.
+         */
+        static ThreadCache* get() {
+            // A plain bool has no destructor, so it's still safe to read while the thread's other
+            // thread_locals are torn down and release their buffers.
+            static thread_local bool destroyed = false;
+            if (destroyed) {
+                return nullptr;
+            }
+            static thread_local ThreadCache cache(&destroyed);
+            return &cache;
+        }
+
+        void* pop(uint32_t sizeClass) {
+            auto block = _freeLists[sizeClass];
+            if (block) {
+                _freeLists[sizeClass] = block->next;
+                --_counts[sizeClass];
+            }
+            return block;
+        }
+
+        // Returns false if the size class is already holding as much as it may.
+        bool push(void* ptr, uint32_t sizeClass) {
+            if (_counts[sizeClass] * _sizeClassBytes(sizeClass) >= kMaxCachedBytesPerSizeClass) {
+                return false;
+            }
+            auto block = new (ptr) FreeBlock{_freeLists[sizeClass]};
+            _freeLists[sizeClass] = block;
+            ++_counts[sizeClass];
+            return true;
+        }
+
+    private:
+        struct FreeBlock {
+            FreeBlock* next;
+        };
+
+        bool* const _destroyed;
+        std::array<FreeBlock*, kNumSizeClasses> _freeLists{};
+        std::array<size_t, kNumSizeClasses> _counts{};
+    };
+
     class Holder {
     public:
         explicit Holder(AtomicUInt32::WordType initial, size_t capacity)
@@ -101,8 +230,9 @@ private:
             if (h->_refCount.subtractAndFetch(1) == 0) {
                 // We placement new'ed a Holder in takeOwnership above,
                 // so we must destroy the object here.
+                const auto sizeClass = h->_sizeClass;
                 h->~Holder();
-                free(h);
+                _deallocate(h, sizeClass);
             }
         }
 
@@ -118,9 +248,22 @@ private:
             return _refCount.load() > 1;
         }
 
+        static void _deallocate(void* ptr, uint32_t sizeClass) {
+            if (sizeClass != kNotPooled) {
+                auto cache = ThreadCache::get();
+                if (cache && cache->push(ptr, sizeClass)) {
+                    return;
+                }
+            }
+            free(ptr);
+        }
+
         AtomicUInt32 _refCount;
         uint32_t _capacity;
+        uint32_t _sizeClass = kNotPooled;
+        uint32_t _unused = 0;  // Pads the Holder to 16 bytes so that data() stays 16-byte aligned.
     };
+    static_assert(sizeof(Holder) == 16, "kMaxPooledBytes assumes a 16 byte Holder");
 
     explicit SharedBuffer(Holder* holder) : _holder(holder, /*add_ref=*/false) {
         // NOTE: The 'false' above is because we have already initialized the Holder with a
@@ -0,0 +1,87 @@
+/**
+ *    Copyright (C) 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include <cstring>
+#include <vector>
+
+#include "mongo/stdx/thread.h"
+#include "mongo/unittest/unittest.h"
+#include "mongo/util/shared_buffer.h"
+
+namespace mongo {
+namespace {
+
+TEST(SharedBufferTest, PooledCapacityRoundsUpToSizeClass) {
+    auto buffer = SharedBuffer::allocatePooled(100);
+    ASSERT_GTE(buffer.capacity(), 100U);
+    ASSERT_LT(buffer.capacity(), 128U);
+
+    auto exact = SharedBuffer::allocatePooled(buffer.capacity());
+    ASSERT_EQ(exact.capacity(), buffer.capacity());
+}
+
+TEST(SharedBufferTest, PooledBlocksAreReusedAfterLastRelease) {
+    auto buffer = SharedBuffer::allocatePooled(1000);
+    const char* const ptr = buffer.get();
+
+    auto copy = buffer;
+    buffer = SharedBuffer();
+    ASSERT_NE(SharedBuffer::allocatePooled(1000).get(), ptr);
+
+    copy = SharedBuffer();
+    ASSERT_EQ(SharedBuffer::allocatePooled(1000).get(), ptr);
+}
+
+TEST(SharedBufferTest, LargeRequestsAreNotPooled) {
+    const size_t bytes = SharedBuffer::kMaxPooledBytes + 1;
+    auto buffer = SharedBuffer::allocatePooled(bytes);
+    ASSERT_EQ(buffer.capacity(), bytes);
+}
+
+TEST(SharedBufferTest, ReallocOfPooledBufferKeepsContents) {
+    auto buffer = SharedBuffer::allocatePooled(10);
+    std::strcpy(buffer.get(), "pooled");
+
+    buffer.realloc(100000);
+    ASSERT_EQ(buffer.capacity(), 100000U);
+    ASSERT_EQ(std::strcmp(buffer.get(), "pooled"), 0);
+
+    buffer.realloc(4);
+    ASSERT_EQ(buffer.capacity(), 4U);
+    ASSERT_EQ(std::memcmp(buffer.get(), "pool", 4), 0);
+}
+
+TEST(SharedBufferTest, BuffersCanBeReleasedOnOtherThreads) {
+    std::vector<SharedBuffer> buffers;
+    for (size_t i = 0; i < 1000; ++i) {
+        buffers.push_back(SharedBuffer::allocatePooled(i * 50));
+    }
+
+    // The other thread's cache keeps some of these and frees the rest when the thread exits.
+    stdx::thread([&] { buffers.clear(); }).join();
+
+    stdx::thread([&] {
+        for (size_t i = 0; i < 1000; ++i) {
+            buffers.push_back(SharedBuffer::allocatePooled(i * 50));
+        }
+    }).join();
+    buffers.clear();
+}
+
+}  // namespace
+}  // namespace mongo
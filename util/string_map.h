@@ -21,16 +21,89 @@
 
 #include "mongo/base/string_data.h"
 #include "mongo/util/assert_util.h"
+#include "mongo/util/crc32c.h"
 #include "mongo/util/unordered_fast_key_table.h"
+#include "mongo/util/wyhash.h"
 
 namespace mongo {
 
-struct StringMapTraits {
+/**
+ * Hash functions that can be used by StringMap. Each provides
+ *
+ *     static uint32_t hash(StringData);  // or uint64_t
+ *
+ * Maps are keyed by their hasher, so a hash computed with one can only be reused with maps that
+ * use the same one.
+ */
+
+/**
+ * The default. A portable and well distributed 32-bit hash, but it processes the key one byte at a
+ * time which makes it relatively slow.
+ */
+struct StringMapMurmurHasher {
     static uint32_t hash(StringData a) {
         uint32_t hash;
         MurmurHash3_x86_32(a.rawData(), a.size(), 0, &hash);
         return hash;
     }
+};
+
+/**
+ * A 64-bit hash that reads the key eight bytes at a time. Usually the fastest choice in software.
+ */
+struct StringMapWyHasher {
+    static uint64_t hash(StringData a) {
+        return wyhash(a.rawData(), a.size());
+    }
+};
+
+/**
+ * A 32-bit hash using the CRC32C instructions of x86-64 and ARMv8 CPUs. Users must depend on the
+ * util/crc32c library.
+ */
+struct StringMapCrc32cHasher {
+    static uint32_t hash(StringData a) {
+        return crc32c(0, a.rawData(), a.size());
+    }
+};
+
+/**
+ * A key paired with its hash. Computing one of these up front and passing it to find(), count(),
+ * try_emplace() etc. avoids rehashing the key when it is looked up in several maps. It can be used
+ * with any StringMap or ControlByteStringMap using the same Hasher, whatever the value type.
+ */
+template <typename Hasher>
+class StringMapHashedKey {
+public:
+    using HashType = decltype(Hasher::hash(StringData()));
+
+    explicit StringMapHashedKey(StringData key = "") : _key(key), _hash(Hasher::hash(_key)) {}
+
+    StringMapHashedKey(StringData key, HashType hash) : _key(key), _hash(hash) {
+        // If you claim to know the hash, it better be correct.
+        dassert(_hash == Hasher::hash(_key));
+    }
+
+    const StringData& key() const {
+        return _key;
+    }
+
+    HashType hash() const {
+        return _hash;
+    }
+
+private:
+    StringData _key;
+    HashType _hash;
+};
+
+template <typename Hasher>
+struct BasicStringMapTraits {
+    using HashedKey = StringMapHashedKey<Hasher>;
+
+    static typename HashedKey::HashType hash(StringData a) {
+        return Hasher::hash(a);
+    }
 
     static bool equals(StringData a, StringData b) {
         return a == b;
@@ -43,34 +116,33 @@ struct StringMapTraits {
     static StringData toLookup(const std::string& s) {
         return StringData(s);
     }
+};
 
-    class HashedKey {
-    public:
-        explicit HashedKey(StringData key = "") : _key(key), _hash(StringMapTraits::hash(_key)) {}
-
-        HashedKey(StringData key, uint32_t hash) : _key(key), _hash(hash) {
-            // If you claim to know the hash, it better be correct.
-            dassert(_hash == StringMapTraits::hash(_key));
-        }
-
-        const StringData& key() const {
-            return _key;
-        }
-
-        uint32_t hash() const {
-            return _hash;
-        }
-
-    private:
-        StringData _key;
-        uint32_t _hash;
-    };
+/**
+ * Same as BasicStringMapTraits, but selects the control byte layout of UnorderedFastKeyTable.
+ */
+template <typename Hasher>
+struct BasicControlByteStringMapTraits : BasicStringMapTraits<Hasher> {
+    static constexpr bool kUseControlBytes = true;
 };
 
-template <typename V>
+using StringMapTraits = BasicStringMapTraits<StringMapMurmurHasher>;
+using ControlByteStringMapTraits = BasicControlByteStringMapTraits<StringMapMurmurHasher>;
+
+template <typename V, typename Hasher = StringMapMurmurHasher>
 using StringMap = UnorderedFastKeyTable<StringData,   // K_L
                                         std::string,  // K_S
                                         V,
-                                        StringMapTraits>;
+                                        BasicStringMapTraits<Hasher>>;
+
+/**
+ * A StringMap whose lookups probe 16 one-byte hash tags at a time and only compare keys whose tag
+ * matches. Prefer this for maps that are looked up far more often than they are modified.
+ */
+template <typename V, typename Hasher = StringMapMurmurHasher>
+using ControlByteStringMap = UnorderedFastKeyTable<StringData,   // K_L
+                                                   std::string,  // K_S
+                                                   V,
+                                                   BasicControlByteStringMapTraits<Hasher>>;
 
 }  // namespace mongo
@@ -0,0 +1,127 @@
+/**
+ *    Copyright (C) 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include <benchmark/benchmark.h>
+#include <string>
+#include <vector>
+
+#include "mongo/stdx/unordered_map.h"
+#include "mongo/util/string_map.h"
+
+namespace mongo {
+namespace {
+
+/**
+ * Makes keys that look like field names. The prefix is shared so that comparisons have to look
+ * past the first few bytes, as they do for real documents.
+ */
+std::vector<std::string> makeKeys(size_t count, StringData prefix) {
+    std::vector<std::string> keys;
+    keys.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        keys.push_back(prefix.toString() + std::to_string(i));
+    }
+    return keys;
+}
+
+template <typename Map>
+Map makeMap(const std::vector<std::string>& keys) {
+    Map map;
+    for (size_t i = 0; i < keys.size(); i++) {
+        map[keys[i]] = i;
+    }
+    return map;
+}
+
+template <typename Map>
+void BM_findHit(benchmark::State& state) {
+    const auto keys = makeKeys(state.range(0), "someFieldName_");
+    const auto map = makeMap<Map>(keys);
+
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(map.find(keys[i]));
+        if (++i == keys.size())
+            i = 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <typename Map>
+void BM_findMiss(benchmark::State& state) {
+    const auto map = makeMap<Map>(makeKeys(state.range(0), "someFieldName_"));
+    const auto missing = makeKeys(state.range(0), "someOtherName_");
+
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(map.find(missing[i]));
+        if (++i == missing.size())
+            i = 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <typename Map>
+void BM_insert(benchmark::State& state) {
+    const auto keys = makeKeys(state.range(0), "someFieldName_");
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(makeMap<Map>(keys));
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+template <typename Hasher>
+void BM_hash(benchmark::State& state) {
+    const std::string key(state.range(0), 'x');
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Hasher::hash(key));
+    }
+    state.SetBytesProcessed(state.iterations() * key.size());
+}
+
+using UnorderedMap = stdx::unordered_map<std::string, size_t>;
+
+BENCHMARK_TEMPLATE(BM_hash, StringMapMurmurHasher)->RangeMultiplier(4)->Range(4, 1024);
+BENCHMARK_TEMPLATE(BM_hash, StringMapWyHasher)->RangeMultiplier(4)->Range(4, 1024);
+BENCHMARK_TEMPLATE(BM_hash, StringMapCrc32cHasher)->RangeMultiplier(4)->Range(4, 1024);
+
+BENCHMARK_TEMPLATE(BM_findHit, StringMap<size_t>)->RangeMultiplier(8)->Range(8, 1 << 18);
+BENCHMARK_TEMPLATE(BM_findHit, ControlByteStringMap<size_t>)->RangeMultiplier(8)->Range(8, 1 << 18);
+BENCHMARK_TEMPLATE(BM_findHit, UnorderedMap)->RangeMultiplier(8)->Range(8, 1 << 18);
+
+BENCHMARK_TEMPLATE(BM_findMiss, StringMap<size_t>)->RangeMultiplier(8)->Range(8, 1 << 18);
+BENCHMARK_TEMPLATE(BM_findMiss, ControlByteStringMap<size_t>)
+    ->RangeMultiplier(8)
+    ->Range(8, 1 << 18);
+BENCHMARK_TEMPLATE(BM_findMiss, UnorderedMap)->RangeMultiplier(8)->Range(8, 1 << 18);
+
+BENCHMARK_TEMPLATE(BM_findHit, StringMap<size_t, StringMapWyHasher>)
+    ->RangeMultiplier(8)
+    ->Range(8, 1 << 18);
+BENCHMARK_TEMPLATE(BM_findHit, ControlByteStringMap<size_t, StringMapWyHasher>)
+    ->RangeMultiplier(8)
+    ->Range(8, 1 << 18);
+
+BENCHMARK_TEMPLATE(BM_insert, StringMap<size_t>)->RangeMultiplier(8)->Range(8, 1 << 15);
+BENCHMARK_TEMPLATE(BM_insert, ControlByteStringMap<size_t>)->RangeMultiplier(8)->Range(8, 1 << 15);
+BENCHMARK_TEMPLATE(BM_insert, UnorderedMap)->RangeMultiplier(8)->Range(8, 1 << 15);
+
+}  // namespace
+}  // namespace mongo
@@ -205,4 +205,171 @@ TEST(StringMapTest, InitWithInitializerList) {
     ASSERT_EQ(2, smap["coollog"]);
     ASSERT_EQ(3, smap["mango"]);
 }
+
+TEST(ControlByteStringMapTest, Basic) {
+    ControlByteStringMap<int> m;
+    ASSERT_EQUALS(0U, m.size());
+    ASSERT_EQUALS(true, m.empty());
+    ASSERT(m.find("eliot") == m.end());
+    m["eliot"] = 5;
+    ASSERT_EQUALS(5, m["eliot"]);
+    ASSERT_EQUALS(1U, m.size());
+    ASSERT_EQUALS(1U, m.count("eliot"));
+    ASSERT_EQUALS(0U, m.count("bob"));
+}
+
+TEST(ControlByteStringMapTest, GrowAndFind) {
+    ControlByteStringMap<int> m;
+    char buf[64];
+
+    for (int i = 0; i < 10000; i++) {
+        sprintf(buf, "foo%d", i);
+        ASSERT_TRUE(m.try_emplace(buf, i).second);
+    }
+    ASSERT_EQUALS(10000U, m.size());
+
+    for (int i = 0; i < 10000; i++) {
+        sprintf(buf, "foo%d", i);
+        auto it = m.find(buf);
+        ASSERT(it != m.end());
+        ASSERT_EQUALS(buf, it->first);
+        ASSERT_EQUALS(i, it->second);
+
+        sprintf(buf, "bar%d", i);
+        ASSERT(m.find(buf) == m.end());
+    }
+
+    int sum = 0;
+    size_t count = 0;
+    for (auto&& entry : m) {
+        sum += entry.second;
+        count++;
+    }
+    ASSERT_EQUALS(m.size(), count);
+    ASSERT_EQUALS(10000 * 9999 / 2, sum);
+}
+
+TEST(ControlByteStringMapTest, EraseReusesSpace) {
+    ControlByteStringMap<int> m;
+    char buf[64];
+
+    m["eliot"] = 5;
+    ASSERT_EQUALS(1U, m.erase("eliot"));
+    ASSERT_EQUALS(0U, m.erase("eliot"));
+    ASSERT(m.find("eliot") == m.end());
+    ASSERT_TRUE(m.empty());
+
+    size_t before = m.capacity();
+    for (int i = 0; i < 10000; i++) {
+        sprintf(buf, "foo%d", i);
+        m[buf] = i;
+        ASSERT_EQUALS(i, m[buf]);
+        ASSERT_EQUALS(1U, m.erase(buf));
+        ASSERT(m.end() == m.find(buf));
+    }
+    ASSERT_EQUALS(before, m.capacity());
+}
+
+TEST(ControlByteStringMapTest, EraseKeepsOtherKeysReachable) {
+    ControlByteStringMap<int> m;
+    char buf[64];
+
+    for (int i = 0; i < 1000; i++) {
+        sprintf(buf, "foo%d", i);
+        m[buf] = i;
+    }
+    for (int i = 0; i < 1000; i += 2) {
+        sprintf(buf, "foo%d", i);
+        ASSERT_EQUALS(1U, m.erase(buf));
+    }
+    ASSERT_EQUALS(500U, m.size());
+
+    for (int i = 0; i < 1000; i++) {
+        sprintf(buf, "foo%d", i);
+        ASSERT_EQUALS(i % 2 == 0 ? 0U : 1U, m.count(buf));
+    }
+}
+
+TEST(ControlByteStringMapTest, CopyAndAssign) {
+    ControlByteStringMap<int> m;
+    m["eliot"] = 5;
+    ControlByteStringMap<int> y = m;
+    ASSERT_EQUALS(5, y["eliot"]);
+
+    m["eliot"] = 6;
+    ASSERT_EQUALS(6, m["eliot"]);
+    ASSERT_EQUALS(5, y["eliot"]);
+
+    ControlByteStringMap<int> z;
+    z["bob"] = 7;
+    z = m;
+    ASSERT_EQUALS(6, z["eliot"]);
+    ASSERT_EQUALS(0U, z.count("bob"));
+}
+
+template <typename Hasher>
+void checkHasher() {
+    auto hash = Hasher::hash;
+    ASSERT_EQUALS(hash(""), hash(""));
+    ASSERT_EQUALS(hash("abc"), hash("abc"));
+    ASSERT_EQUALS(hash("a somewhat longer field name that takes the bulk path"),
+                  hash("a somewhat longer field name that takes the bulk path"));
+
+    ASSERT_NOT_EQUALS(hash(""), hash("a"));
+    ASSERT_NOT_EQUALS(hash("a"), hash("ab"));
+    ASSERT_NOT_EQUALS(hash("foo28"), hash("foo35"));
+
+    // Only the bytes in the StringData may be hashed.
+    const char buf[] = "abcdef";
+    ASSERT_EQUALS(hash(StringData(buf, 3)), hash("abc"));
+}
+
+template <typename Hasher>
+void checkMapWithHasher() {
+    StringMap<int, Hasher> m;
+    ControlByteStringMap<int, Hasher> cm;
+    char buf[64];
+
+    for (int i = 0; i < 10000; i++) {
+        sprintf(buf, "foo%d", i);
+        m[buf] = i;
+        cm[buf] = i;
+    }
+    for (int i = 0; i < 10000; i++) {
+        sprintf(buf, "foo%d", i);
+        ASSERT_EQUALS(i, m[buf]);
+        ASSERT_EQUALS(i, cm[buf]);
+    }
+    ASSERT_EQUALS(10000U, m.size());
+    ASSERT_EQUALS(10000U, cm.size());
+}
+
+TEST(StringMapHasherTest, Murmur) {
+    checkHasher<StringMapMurmurHasher>();
+    checkMapWithHasher<StringMapMurmurHasher>();
+}
+
+TEST(StringMapHasherTest, Wy) {
+    checkHasher<StringMapWyHasher>();
+    checkMapWithHasher<StringMapWyHasher>();
+}
+
+TEST(StringMapHasherTest, Crc32c) {
+    checkHasher<StringMapCrc32cHasher>();
+    checkMapWithHasher<StringMapCrc32cHasher>();
+}
+
+TEST(StringMapHasherTest, ReuseHashedKeyAcrossMaps) {
+    StringMap<int, StringMapWyHasher> ints;
+    ControlByteStringMap<std::string, StringMapWyHasher> strings;
+    ints["field"] = 1;
+    strings["field"] = "one";
+
+    const StringMapHashedKey<StringMapWyHasher> key("field");
+    ASSERT_EQUALS(1U, ints.count(key));
+    ASSERT_EQUALS(1, ints.find(key)->second);
+    ASSERT_EQUALS("one", strings.find(key)->second);
+    ASSERT_TRUE(strings.try_emplace(StringMapHashedKey<StringMapWyHasher>("other"), "two").second);
+    ASSERT_EQUALS(2U, strings.size());
+}
 }
@@ -0,0 +1,605 @@
+/**
+ *    Copyright (C) 2018 MongoDB, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iterator>
+#include <list>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/stdx/unordered_map.h"
+#include "mongo/util/assert_util.h"
+
+namespace mongo {
+
+namespace tiny_lfu_cache_detail {
+
+/**
+ * The default cost function for TinyLFUCache. All entries have equal weight, so the maximum cost
+ * of the cache is a number of entries.
+ */
+struct DefaultCostFunction {
+    template <typename T>
+    size_t operator()(const T&) const {
+        return 1;
+    }
+};
+
+/**
+ * Estimates how often each hash has been seen recently using a count-min sketch: four rows of
+ * saturating 4-bit counters, each indexed by a different function of the hash. The estimate is the
+ * minimum of the four counters, which can only over-count.
+ *
+ * To keep the estimates about recent history, every counter is halved once the number of
+ * increments reaches ten times the width of the sketch.
+ */
+class FrequencySketch {
+public:
+    explicit FrequencySketch(size_t expectedEntries) {
+        size_t width = 16;
+        while (width < expectedEntries)
+            width *= 2;
+        _mask = width - 1;
+        _counters.resize(kRows * width);
+        _sampleSize = 10 * width;
+    }
+
+    void increment(uint64_t hash) {
+        bool incremented = false;
+        for (size_t row = 0; row < kRows; row++) {
+            auto& counter = _counters[_index(row, hash)];
+            if (counter < kMaxCount) {
+                counter++;
+                incremented = true;
+            }
+        }
+
+        if (incremented && ++_additions >= _sampleSize)
+            _age();
+    }
+
+    unsigned estimate(uint64_t hash) const {
+        unsigned count = kMaxCount;
+        for (size_t row = 0; row < kRows; row++) {
+            count = std::min<unsigned>(count, _counters[_index(row, hash)]);
+        }
+        return count;
+    }
+
+    void clear() {
+        std::fill(_counters.begin(), _counters.end(), 0);
+        _additions = 0;
+    }
+
+private:
+    static constexpr size_t kRows = 4;
+    static constexpr uint8_t kMaxCount = 15;
+
+    size_t _index(size_t row, uint64_t hash) const {
+        static const uint64_t kSeeds[kRows] = {0xc3a5c85c97cb3127ull,
+                                               0xb492b66fbe98f273ull,
+                                               0x9ae16a3b2f90404full,
+                                               0xcbf29ce484222325ull};
+        const uint64_t h = (hash + row) * kSeeds[row];
+        return row * (_mask + 1) + ((h >> 32) & _mask);
+    }
+
+    void _age() {
+        for (auto&& counter : _counters) {
+            counter >>= 1;
+        }
+        _additions /= 2;
+    }
+
+    size_t _mask;
+    size_t _sampleSize;
+    size_t _additions = 0;
+    std::vector<uint8_t> _counters;
+};
+
+}  // namespace tiny_lfu_cache_detail
+
+/**
+ * A caching structure using the W-TinyLFU admission and replacement policy. Unlike LRUCache, which
+ * admits every new entry, it only lets a new entry displace an existing one if the new key has been
+ * requested more often recently. A single scan over many keys therefore can't flush out the
+ * working set.
+ *
+ * The cache is made of three LRU ordered regions:
+ *   window - about 1% of the capacity. Every new entry starts here, which gives bursts of
+ *            accesses to new keys a chance to build up frequency before they have to compete.
+ *   probation - entries that left the window and were admitted to the main region, but have not
+ *               been used since.
+ *   protected - about 80% of the main region, holding entries that were used again while on
+ *               probation.
+ * When an entry is pushed out of the window, it is compared against the least recently used
+ * entry on probation using a FrequencySketch, and whichever has been seen less often is evicted.
+ *
+ * Entries can have different costs, as computed by CostFunc, and the cache is bounded by their
+ * total cost rather than the number of entries. CostFunc follows the same rules as the cost
+ * function of ProducerConsumerQueue: it takes a const V& and returns a non-zero size_t, and it
+ * must be pure for a given value.
+ *
+ * The interface matches LRUCache, so one can be swapped for the other. Iteration visits every
+ * entry, but not in a single recency order; see begin().
+ *
+ * This cache is not thread safe.
+ */
+template <typename K,
+          typename V,
+          typename CostFunc = tiny_lfu_cache_detail::DefaultCostFunction,
+          typename Hash = typename stdx::unordered_map<K, V>::hasher,
+          typename KeyEqual = typename stdx::unordered_map<K, V, Hash>::key_equal>
+class TinyLFUCache {
+    MONGO_DISALLOW_COPYING(TinyLFUCache);
+
+public:
+    /**
+     * Creates a cache holding entries with a total cost of at most maxCost, where every entry has
+     * the same cost. The frequency sketch is sized for maxCost entries.
+     */
+    explicit TinyLFUCache(size_t maxCost) : TinyLFUCache(maxCost, maxCost, CostFunc{}) {}
+
+    /**
+     * Creates a cache with a total cost of at most maxCost. expectedEntries should be roughly the
+     * number of entries the cache holds when full, which sizes the frequency sketch.
+     */
+    TinyLFUCache(size_t maxCost, size_t expectedEntries, CostFunc costFunc = CostFunc{})
+        : _maxWindowCost(std::min(maxCost, std::max<size_t>(1, maxCost / 100))),
+          _maxMainCost(maxCost - _maxWindowCost),
+          _maxProtectedCost(_maxMainCost * 8 / 10),
+          _costFunc(std::move(costFunc)),
+          _sketch(expectedEntries) {}
+
+    TinyLFUCache(TinyLFUCache&&) = delete;
+    TinyLFUCache& operator=(TinyLFUCache&&) = delete;
+
+private:
+    enum class Region { kWindow, kProtected, kProbation };
+    static constexpr int kNumRegions = 3;
+
+    struct Node {
+        std::pair<K, V> entry;
+        size_t cost;
+        uint64_t hash;
+        Region region;
+    };
+
+    using List = std::list<Node>;
+
+    template <bool IsConst>
+    class Iterator;
+
+public:
+    using ListEntry = std::pair<K, V>;
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    using Map = stdx::unordered_map<K, typename List::iterator, Hash, KeyEqual>;
+
+    using key_type = K;
+    using mapped_type = V;
+
+    /**
+     * Inserts an entry into the cache, replacing the entry for the same key if there is one, and
+     * records an access to the key.
+     *
+     * If an entry had to be evicted to make room, its value is returned to the caller. That may be
+     * the value that was just added, if it lost the admission check or if its cost alone exceeds
+     * the capacity of the cache. With a non-uniform CostFunc, one add() can evict several entries;
+     * only the first of them is returned and the rest are destroyed.
+     */
+    boost::optional<V> add(const K& key, V entry) {
+        const uint64_t hash = Hash()(key);
+        _sketch.increment(hash);
+
+        boost::optional<V> evicted;
+
+        auto it = _map.find(key);
+        if (it != _map.end()) {
+            auto node = it->second;
+            const size_t newCost = _costFunc(entry);
+            _regionCost(node->region) -= node->cost;
+            _regionCost(node->region) += newCost;
+            node->entry.second = std::move(entry);
+            node->cost = newCost;
+            _onHit(node);
+        } else {
+            const size_t cost = _costFunc(entry);
+            invariant(cost > 0);
+            _window.push_front(Node{{key, std::move(entry)}, cost, hash, Region::kWindow});
+            _windowCost += cost;
+            _map.emplace(key, _window.begin());
+        }
+
+        _evictFromWindow(&evicted);
+        _evictFromMain(&evicted);
+        return evicted;
+    }
+
+    /**
+     * Finds an element in the cache by key. Whether or not it is found, this counts as an access
+     * to the key, which raises its frequency estimate.
+     */
+    iterator find(const K& key) {
+        _sketch.increment(Hash()(key));
+        return promote(key);
+    }
+
+    /**
+     * Finds an element in the cache by key, without recording an access or promoting it.
+     *
+     * This method is meant for testing and other callers that wish to "observe" items in the cache
+     * without actually using them.
+     */
+    const_iterator cfind(const K& key) const {
+        auto it = _map.find(key);
+        return it == _map.end() ? end() : const_iterator(this, it->second);
+    }
+
+    /**
+     * Promotes the element matching the given key, if one exists in the cache, to be the most
+     * recently used element of its region. An element on probation moves to the protected region.
+     *
+     * Unlike find(), this does not raise the key's frequency estimate.
+     */
+    iterator promote(const K& key) {
+        auto it = _map.find(key);
+        return it == _map.end() ? end() : _promote(it->second);
+    }
+
+    /**
+     * Promotes the element pointed to by the given iterator, as promote(const K&) does.
+     */
+    iterator promote(const iterator& iter) {
+        return iter == end() ? iter : _promote(iter._node);
+    }
+
+    /**
+     * Promotes the element pointed to by the given const_iterator, as promote(const K&) does.
+     */
+    const_iterator promote(const const_iterator& iter) {
+        return iter == cend() ? iter : const_iterator(_promote(_mutableNode(iter._node)));
+    }
+
+    /**
+     * Removes the entry stored for this key, if one exists. Returns the count of elements erased.
+     */
+    typename Map::size_type erase(const K& key) {
+        auto it = _map.find(key);
+        if (it == _map.end())
+            return 0;
+
+        auto node = it->second;
+        _regionCost(node->region) -= node->cost;
+        _list(node->region).erase(node);
+        _map.erase(it);
+        return 1;
+    }
+
+    /**
+     * Removes the element pointed to by the given iterator from this cache, and returns an
+     * iterator to the element after it in iteration order, or the end iterator.
+     */
+    iterator erase(iterator it) {
+        invariant(it != end());
+        auto next = std::next(it);
+        invariant(erase(it->first) == 1);
+        return next;
+    }
+
+    /**
+     * Removes all items from the cache and forgets all recorded accesses.
+     */
+    void clear() {
+        _map.clear();
+        _window.clear();
+        _probation.clear();
+        _protected.clear();
+        _windowCost = _probationCost = _protectedCost = 0;
+        _sketch.clear();
+    }
+
+    bool hasKey(const K& key) const {
+        return _map.find(key) != _map.end();
+    }
+
+    typename Map::size_type count(const K& key) const {
+        return _map.count(key);
+    }
+
+    /**
+     * Returns the number of entries in the cache.
+     */
+    std::size_t size() const {
+        return _map.size();
+    }
+
+    bool empty() const {
+        return _map.empty();
+    }
+
+    /**
+     * Returns the total cost of the entries in the cache, which never exceeds the maximum cost.
+     */
+    size_t cost() const {
+        return _windowCost + _probationCost + _protectedCost;
+    }
+
+    /**
+     * Iteration visits the window, then the protected region, then probation, each from most to
+     * least recently used. The last element visited is the next eviction candidate.
+     */
+    iterator begin() {
+        return iterator(this, Region::kWindow);
+    }
+
+    iterator end() {
+        return iterator(this);
+    }
+
+    const_iterator begin() const {
+        return const_iterator(this, Region::kWindow);
+    }
+
+    const_iterator end() const {
+        return const_iterator(this);
+    }
+
+    const_iterator cbegin() const {
+        return begin();
+    }
+
+    const_iterator cend() const {
+        return end();
+    }
+
+private:
+    /**
+     * A forward iterator over every region in turn. The end iterator has no region and a
+     * value-initialized list iterator.
+     */
+    template <bool IsConst>
+    class Iterator {
+        using CachePtr = std::conditional_t<IsConst, const TinyLFUCache*, TinyLFUCache*>;
+        using NodeIt =
+            std::conditional_t<IsConst, typename List::const_iterator, typename List::iterator>;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = ListEntry;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::conditional_t<IsConst, const ListEntry&, ListEntry&>;
+        using pointer = std::conditional_t<IsConst, const ListEntry*, ListEntry*>;
+
+        Iterator() = default;
+
+        // Allows converting an iterator to a const_iterator.
+        template <bool OtherConst, typename = std::enable_if_t<IsConst && !OtherConst>>
+        Iterator(const Iterator<OtherConst>& other)
+            : _cache(other._cache), _region(other._region), _node(other._node) {}
+
+        reference operator*() const {
+            return _node->entry;
+        }
+
+        pointer operator->() const {
+            return &_node->entry;
+        }
+
+        Iterator& operator++() {
+            ++_node;
+            _skipEmpty();
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            auto old = *this;
+            ++*this;
+            return old;
+        }
+
+        friend bool operator==(const Iterator& lhs, const Iterator& rhs) {
+            return lhs._region == rhs._region && lhs._node == rhs._node;
+        }
+
+        friend bool operator!=(const Iterator& lhs, const Iterator& rhs) {
+            return !(lhs == rhs);
+        }
+
+    private:
+        friend class TinyLFUCache;
+        template <bool>
+        friend class Iterator;
+
+        explicit Iterator(CachePtr cache) : _cache(cache), _region(kNumRegions) {}
+
+        Iterator(CachePtr cache, Region region)
+            : _cache(cache), _region(static_cast<int>(region)), _node(_list().begin()) {
+            _skipEmpty();
+        }
+
+        Iterator(CachePtr cache, NodeIt node)
+            : _cache(cache), _region(static_cast<int>(node->region)), _node(node) {}
+
+        auto& _list() const {
+            return _cache->_list(static_cast<Region>(_region));
+        }
+
+        void _skipEmpty() {
+            while (_node == _list().end()) {
+                if (++_region == kNumRegions) {
+                    _node = NodeIt();
+                    return;
+                }
+                _node = _list().begin();
+            }
+        }
+
+        CachePtr _cache = nullptr;
+        int _region = kNumRegions;
+        NodeIt _node;
+    };
+
+    List& _list(Region region) {
+        return const_cast<List&>(static_cast<const TinyLFUCache*>(this)->_list(region));
+    }
+
+    const List& _list(Region region) const {
+        switch (region) {
+            case Region::kWindow:
+                return _window;
+            case Region::kProtected:
+                return _protected;
+            case Region::kProbation:
+                return _probation;
+        }
+        MONGO_UNREACHABLE;
+    }
+
+    size_t& _regionCost(Region region) {
+        switch (region) {
+            case Region::kWindow:
+                return _windowCost;
+            case Region::kProtected:
+                return _protectedCost;
+            case Region::kProbation:
+                return _probationCost;
+        }
+        MONGO_UNREACHABLE;
+    }
+
+    typename List::iterator _mutableNode(typename List::const_iterator node) {
+        // Erasing an empty range turns a const_iterator into an iterator without a lookup.
+        auto& list = _list(node->region);
+        return list.erase(node, node);
+    }
+
+    iterator _promote(typename List::iterator node) {
+        _onHit(node);
+        return iterator(this, node);
+    }
+
+    /**
+     * Moves the node to the front of the given region. Iterators stay valid when splicing between
+     * lists, so the map doesn't need updating.
+     */
+    void _moveTo(typename List::iterator node, Region region) {
+        _regionCost(node->region) -= node->cost;
+        _list(region).splice(_list(region).begin(), _list(node->region), node);
+        node->region = region;
+        _regionCost(region) += node->cost;
+    }
+
+    void _onHit(typename List::iterator node) {
+        if (node->region == Region::kProbation) {
+            // Used again while on probation, so it has earned protection.
+            _moveTo(node, Region::kProtected);
+            while (_protectedCost > _maxProtectedCost && _protected.size() > 1) {
+                _moveTo(std::prev(_protected.end()), Region::kProbation);
+            }
+        } else {
+            _moveTo(node, node->region);
+        }
+    }
+
+    /**
+     * Moves the least recently used window entries into probation until the window is within its
+     * budget. They are not admitted yet; _admitOrReject() decides which ones stay.
+     */
+    void _evictFromWindow(boost::optional<V>* evicted) {
+        while (_windowCost > _maxWindowCost && !_window.empty()) {
+            auto candidate = std::prev(_window.end());
+            if (candidate->cost > _maxMainCost) {
+                // It could never fit in the main region.
+                _evict(candidate, evicted);
+                continue;
+            }
+            _moveTo(candidate, Region::kProbation);
+            _admitOrReject(candidate, evicted);
+        }
+    }
+
+    /**
+     * Called with a candidate that has just moved to the front of probation. Evicts entries from
+     * the back of the main region until it is within budget, as long as each victim is used less
+     * often than the candidate. Otherwise the candidate itself is evicted.
+     */
+    void _admitOrReject(typename List::iterator candidate, boost::optional<V>* evicted) {
+        const unsigned candidateFrequency = _sketch.estimate(candidate->hash);
+        while (_probationCost + _protectedCost > _maxMainCost) {
+            auto victim = _probation.size() > 1 ? std::prev(_probation.end())
+                                                : std::prev(_protected.end());
+            invariant(victim != candidate);
+
+            if (candidateFrequency <= _sketch.estimate(victim->hash)) {
+                _evict(candidate, evicted);
+                return;
+            }
+            _evict(victim, evicted);
+        }
+    }
+
+    /**
+     * Replacing an entry with a more expensive value can push the main region over its budget
+     * without anything new coming through the window. Evict from the back of probation, then
+     * protected, to make room.
+     */
+    void _evictFromMain(boost::optional<V>* evicted) {
+        while (_probationCost + _protectedCost > _maxMainCost) {
+            _evict(_probation.empty() ? std::prev(_protected.end()) : std::prev(_probation.end()),
+                   evicted);
+        }
+    }
+
+    void _evict(typename List::iterator node, boost::optional<V>* evicted) {
+        _regionCost(node->region) -= node->cost;
+        if (!*evicted)
+            *evicted = std::move(node->entry.second);
+        invariant(_map.erase(node->entry.first) == 1);
+        _list(node->region).erase(node);
+    }
+
+    const size_t _maxWindowCost;
+    const size_t _maxMainCost;
+    const size_t _maxProtectedCost;
+
+    CostFunc _costFunc;
+    tiny_lfu_cache_detail::FrequencySketch _sketch;
+
+    // Each region is ordered from most to least recently used.
+    List _window;
+    List _protected;
+    List _probation;
+
+    size_t _windowCost = 0;
+    size_t _protectedCost = 0;
+    size_t _probationCost = 0;
+
+    // Maps from a key to its node, in whichever region it is.
+    Map _map;
+};
+
+}  // namespace mongo
@@ -0,0 +1,201 @@
+/**
+ *    Copyright (C) 2018 MongoDB, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include <iterator>
+#include <set>
+#include <string>
+
+#include "mongo/unittest/unittest.h"
+#include "mongo/util/lru_cache.h"
+#include "mongo/util/tiny_lfu_cache.h"
+
+namespace mongo {
+namespace {
+
+TEST(TinyLFUCacheTest, BasicAddFindErase) {
+    TinyLFUCache<int, int> cache(100);
+    ASSERT_TRUE(cache.empty());
+    ASSERT(cache.find(1) == cache.end());
+
+    ASSERT_FALSE(cache.add(1, 10));
+    ASSERT_FALSE(cache.add(2, 20));
+    ASSERT_EQ(cache.size(), 2u);
+    ASSERT_EQ(cache.cost(), 2u);
+    ASSERT_TRUE(cache.hasKey(1));
+    ASSERT_EQ(cache.find(1)->second, 10);
+    ASSERT_EQ(cache.cfind(2)->second, 20);
+
+    ASSERT_FALSE(cache.add(1, 11));
+    ASSERT_EQ(cache.find(1)->second, 11);
+    ASSERT_EQ(cache.size(), 2u);
+
+    ASSERT_EQ(cache.erase(1), 1u);
+    ASSERT_EQ(cache.erase(1), 0u);
+    ASSERT(cache.cfind(1) == cache.cend());
+    ASSERT_EQ(cache.size(), 1u);
+    ASSERT_EQ(cache.cost(), 1u);
+
+    cache.clear();
+    ASSERT_TRUE(cache.empty());
+    ASSERT_EQ(cache.cost(), 0u);
+}
+
+TEST(TinyLFUCacheTest, SizeZeroCache) {
+    TinyLFUCache<int, int> cache(0);
+    auto evicted = cache.add(1, 2);
+    ASSERT_TRUE(evicted);
+    ASSERT_EQ(*evicted, 2);
+    ASSERT_TRUE(cache.empty());
+    ASSERT(cache.find(1) == cache.end());
+}
+
+TEST(TinyLFUCacheTest, NeverExceedsMaxCost) {
+    for (size_t maxCost : {1, 2, 3, 10, 100, 1000}) {
+        TinyLFUCache<int, int> cache(maxCost);
+        for (int i = 0; i < 5000; i++) {
+            cache.add(i % 1500, i);
+            cache.find(i % 7);
+            ASSERT_LTE(cache.cost(), maxCost);
+            ASSERT_EQ(cache.cost(), cache.size());
+        }
+    }
+}
+
+TEST(TinyLFUCacheTest, ScanDoesNotFlushFrequentlyUsedEntries) {
+    const int kWorkingSet = 50;
+    TinyLFUCache<int, int> cache(100);
+    LRUCache<int, int> lru(100);
+
+    for (int round = 0; round < 5; round++) {
+        for (int i = 0; i < kWorkingSet; i++) {
+            if (cache.find(i) == cache.end())
+                cache.add(i, i);
+            if (lru.find(i) == lru.end())
+                lru.add(i, i);
+        }
+    }
+
+    // A scan over many keys that are each used once.
+    for (int i = 1000; i < 2000; i++) {
+        cache.add(i, i);
+        lru.add(i, i);
+    }
+
+    int tinyLFUHits = 0;
+    int lruHits = 0;
+    for (int i = 0; i < kWorkingSet; i++) {
+        tinyLFUHits += cache.hasKey(i);
+        lruHits += lru.hasKey(i);
+    }
+    ASSERT_EQ(lruHits, 0);
+    ASSERT_EQ(tinyLFUHits, kWorkingSet);
+}
+
+TEST(TinyLFUCacheTest, SingleEvictionWithUniformCost) {
+    TinyLFUCache<int, int> cache(10);
+    size_t evictions = 0;
+    for (int i = 0; i < 100; i++) {
+        if (auto evicted = cache.add(i, i)) {
+            evictions++;
+            ASSERT_FALSE(cache.hasKey(*evicted));
+        }
+    }
+    ASSERT_EQ(cache.size(), 10u);
+    ASSERT_EQ(evictions, 90u);
+}
+
+TEST(TinyLFUCacheTest, IterationVisitsEveryEntry) {
+    TinyLFUCache<int, int> cache(200);
+    for (int i = 0; i < 100; i++) {
+        cache.add(i, i * 10);
+    }
+    // Move some entries out of probation and into the protected region.
+    for (int i = 0; i < 100; i += 3) {
+        cache.find(i);
+    }
+
+    std::set<int> seen;
+    for (auto&& entry : cache) {
+        ASSERT_EQ(entry.second, entry.first * 10);
+        ASSERT_TRUE(seen.insert(entry.first).second);
+    }
+    ASSERT_EQ(seen.size(), cache.size());
+
+    const auto& constCache = cache;
+    ASSERT_EQ(static_cast<size_t>(std::distance(constCache.begin(), constCache.end())),
+              cache.size());
+}
+
+TEST(TinyLFUCacheTest, PromoteAndEraseByIterator) {
+    TinyLFUCache<int, int> cache(200);
+    for (int i = 0; i < 50; i++) {
+        cache.add(i, i);
+    }
+
+    ASSERT(cache.promote(1000) == cache.end());
+    auto it = cache.promote(7);
+    ASSERT(it != cache.end());
+    ASSERT_EQ(it->first, 7);
+    ASSERT_EQ(cache.promote(it)->first, 7);
+    TinyLFUCache<int, int>::const_iterator cit = cache.cfind(8);
+    ASSERT_EQ(cache.promote(cit)->first, 8);
+
+    // Erasing every entry through the iterator returned by erase() empties the cache.
+    size_t erased = 0;
+    for (auto it = cache.begin(); it != cache.end();) {
+        it = cache.erase(it);
+        erased++;
+    }
+    ASSERT_EQ(erased, 50u);
+    ASSERT_TRUE(cache.empty());
+    ASSERT_EQ(cache.cost(), 0u);
+}
+
+struct StringCost {
+    size_t operator()(const std::string& s) const {
+        return s.size();
+    }
+};
+
+TEST(TinyLFUCacheTest, CostWeighted) {
+    TinyLFUCache<int, std::string, StringCost> cache(1000, 100);
+
+    ASSERT_FALSE(cache.add(1, std::string(100, 'a')));
+    ASSERT_FALSE(cache.add(2, std::string(200, 'b')));
+    ASSERT_EQ(cache.cost(), 300u);
+
+    // An entry too big for the whole cache is evicted straight away.
+    auto evicted = cache.add(3, std::string(2000, 'c'));
+    ASSERT_TRUE(evicted);
+    ASSERT_EQ(evicted->size(), 2000u);
+    ASSERT_FALSE(cache.hasKey(3));
+
+    // Growing a value updates the cost, and shrinking it frees the space again.
+    cache.add(1, std::string(500, 'a'));
+    ASSERT_EQ(cache.cost(), 700u);
+    cache.add(1, std::string(10, 'a'));
+    ASSERT_EQ(cache.cost(), 210u);
+
+    for (int i = 10; i < 100; i++) {
+        cache.add(i, std::string(50, 'x'));
+        ASSERT_LTE(cache.cost(), 1000u);
+    }
+}
+
+}  // namespace
+}  // namespace mongo
@@ -23,6 +23,7 @@
 
 #include "mongo/base/disallow_copying.h"
 #include "mongo/util/assert_util.h"
+#include "mongo/util/unordered_fast_key_table_control_bytes.h"
 
 namespace mongo {
 
@@ -43,6 +44,14 @@ namespace mongo {
  *     const K_L& key() const;
  *     uint32_t hash() const; // Should be free to call repeatedly.
  * };
+ *
+ * Wherever uint32_t appears above, Traits may use uint64_t instead as long as it does so
+ * consistently.
+ *
+ * Traits may also declare 'static constexpr bool kUseControlBytes = true;' to store the table as a
+ * separate array of 7-bit hash tags that are probed a group of 16 at a time, with the entries kept
+ * out of line. This makes lookups, and misses in particular, touch far less memory when the keys
+ * or values are large. See unordered_fast_key_table_control_bytes.h.
  */
 template <typename K_L,  // key lookup
           typename K_S,  // key storage
@@ -58,6 +67,8 @@ public:
     using HashedKey = typename Traits::HashedKey;
 
 private:
+    using HashType = unordered_fast_key_table_detail::HashTypeOf<HashedKey>;
+
     class Entry {
     public:
         Entry() = default;
@@ -114,7 +125,7 @@ private:
             return _everUsed;
         }
 
-        uint32_t getCurHash() const {
+        HashType getCurHash() const {
             dassert(isUsed());
             return _curHash;
         }
@@ -138,15 +149,15 @@ private:
     private:
         bool _used = false;
         bool _everUsed = false;
-        uint32_t _curHash;
+        HashType _curHash;
         typename std::aligned_storage<sizeof(value_type),
                                       std::alignment_of<value_type>::value>::type _data;
     };
 
-    struct Area {
-        Area() = default;  // TODO constexpr
+    struct EntryArea {
+        EntryArea() = default;  // TODO constexpr
 
-        Area(unsigned capacity, unsigned maxProbe)
+        EntryArea(unsigned capacity, unsigned maxProbe)
             : _hashMask(capacity - 1),
               _maxProbe(maxProbe),
               _entries(capacity ? new Entry[capacity] : nullptr) {
@@ -154,20 +165,20 @@ private:
             dassert((capacity & (capacity - 1)) == 0);
         }
 
-        Area(const Area& other) : Area(other.capacity(), other._maxProbe) {
+        EntryArea(const EntryArea& other) : EntryArea(other.capacity(), other._maxProbe) {
             std::copy(other.begin(), other.end(), begin());
         }
 
-        Area& operator=(const Area& other) {
-            Area(other).swap(this);
+        EntryArea& operator=(const EntryArea& other) {
+            EntryArea(other).swap(this);
             return *this;
         }
 
         int find(const HashedKey& key, int* firstEmpty) const;
 
-        bool transfer(Area* newArea) const;
+        bool transfer(EntryArea* newArea) const;
 
-        void swap(Area* other) {
+        void swap(EntryArea* other) {
             using std::swap;
             swap(_hashMask, other->_hashMask);
             swap(_maxProbe, other->_maxProbe);
@@ -178,6 +189,27 @@ private:
             return _hashMask + 1;
         }
 
+        bool isUsed(unsigned pos) const {
+            return _entries[pos].isUsed();
+        }
+
+        template <typename... Args>
+        void emplaceData(unsigned pos, const HashedKey& key, Args&&... args) {
+            _entries[pos].emplaceData(key, std::forward<Args>(args)...);
+        }
+
+        void unUse(unsigned pos) {
+            _entries[pos].unUse();
+        }
+
+        value_type& getData(unsigned pos) {
+            return _entries[pos].getData();
+        }
+
+        const value_type& getData(unsigned pos) const {
+            return _entries[pos].getData();
+        }
+
         Entry* begin() {
             return _entries.get();
         }
@@ -201,6 +233,11 @@ private:
         std::unique_ptr<Entry[]> _entries = {};
     };
 
+    using Area = typename std::conditional<
+        unordered_fast_key_table_detail::UsesControlBytes<Traits>::value,
+        unordered_fast_key_table_detail::ControlByteArea<Traits, HashedKey, value_type>,
+        EntryArea>::type;
+
 public:
     UnorderedFastKeyTable() = default;  // TODO constexpr
 
@@ -251,7 +288,7 @@ public:
     }
 
     template <typename AreaPtr,
-              typename reference = decltype(AreaPtr()->begin()->getData()),
+              typename reference = decltype(std::declval<AreaPtr>()->getData(0)),
               typename pointer = typename std::add_pointer<reference>::type>
     class iterator_impl
         : public std::
@@ -279,11 +316,11 @@ public:
             : _area(other._area), _position(other._position), _max(other._max) {}
 
         pointer operator->() const {
-            return &_area->_entries[_position].getData();
+            return &_area->getData(_position);
         }
 
         reference operator*() const {
-            return _area->_entries[_position].getData();
+            return _area->getData(_position);
         }
 
         iterator_impl& operator++() {
@@ -314,7 +351,7 @@ public:
                     _position = -1;
                     break;
                 }
-                if (_area->_entries[_position].isUsed())
+                if (_area->isUsed(_position))
                     break;
                 ++_position;
             }
@@ -0,0 +1,339 @@
+/*    Copyright 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MONGO_UNORDERED_FAST_KEY_TABLE_USE_SSE2
+#endif
+
+#include "mongo/platform/bits.h"
+#include "mongo/stdx/type_traits.h"
+#include "mongo/util/assert_util.h"
+
+namespace mongo {
+namespace unordered_fast_key_table_detail {
+
+/**
+ * Returns whether Traits opted into the control byte layout by declaring
+ * 'static constexpr bool kUseControlBytes = true;'. Traits that say nothing get the original
+ * inline-entry layout.
+ */
+template <typename Traits, typename = void>
+struct UsesControlBytes : std::false_type {};
+
+template <typename Traits>
+struct UsesControlBytes<Traits, stdx::void_t<decltype(Traits::kUseControlBytes)>>
+    : std::integral_constant<bool, Traits::kUseControlBytes> {};
+
+/**
+ * The type returned by HashedKey::hash(). Tables work with either 32 or 64-bit hashes.
+ */
+template <typename HashedKey>
+using HashTypeOf = typename std::decay<decltype(std::declval<const HashedKey&>().hash())>::type;
+
+/**
+ * Values of the control bytes that don't describe a full slot. Full slots store the low 7 bits of
+ * the hash so they always have the high bit clear, while both of these have it set.
+ */
+enum ControlByte : int8_t {
+    kEmpty = -128,  // 0b10000000
+    kDeleted = -2,  // 0b11111110
+};
+
+/**
+ * Number of slots whose control bytes are examined together. Probing always starts at a multiple
+ * of this, which is why the capacity of the table must be a multiple of it.
+ */
+constexpr unsigned kGroupWidth = 16;
+
+/**
+ * A view over kGroupWidth consecutive control bytes. Each match function returns a bitmask where
+ * bit i is set if control byte i satisfies the condition.
+ */
+class ControlByteGroup {
+public:
+    explicit ControlByteGroup(const int8_t* ctrl) {
+#ifdef MONGO_UNORDERED_FAST_KEY_TABLE_USE_SSE2
+        _ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+#else
+        std::memcpy(_ctrl, ctrl, kGroupWidth);
+#endif
+    }
+
+    uint32_t match(int8_t tag) const {
+#ifdef MONGO_UNORDERED_FAST_KEY_TABLE_USE_SSE2
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(tag), _ctrl)));
+#else
+        uint32_t mask = 0;
+        for (unsigned i = 0; i < kGroupWidth; i++) {
+            mask |= uint32_t(_ctrl[i] == tag) << i;
+        }
+        return mask;
+#endif
+    }
+
+    uint32_t matchEmpty() const {
+        return match(kEmpty);
+    }
+
+private:
+#ifdef MONGO_UNORDERED_FAST_KEY_TABLE_USE_SSE2
+    __m128i _ctrl;
+#else
+    int8_t _ctrl[kGroupWidth];
+#endif
+};
+
+/**
+ * Storage for UnorderedFastKeyTable that keeps a separate array of one-byte tags next to the
+ * slots. Lookups compare a whole group of tags at once and only touch slots whose tag matches,
+ * so a miss usually costs a single cache line of control bytes instead of a walk over full
+ * entries.
+ *
+ * The full hashes are kept in their own array so that growing doesn't need to rehash keys.
+ * They are never read on the lookup path.
+ *
+ * This exposes the same interface to UnorderedFastKeyTable as its inline-entry Area.
+ */
+template <typename Traits, typename HashedKey, typename ValueType>
+class ControlByteArea {
+public:
+    ControlByteArea() = default;
+
+    /**
+     * The maxProbe argument is accepted for interface compatibility but ignored. This layout
+     * bounds probe lengths with a maximum load factor rather than a probe count.
+     */
+    ControlByteArea(unsigned capacity, unsigned maxProbe)
+        : _hashMask(capacity - 1),
+          _growthLeft(maxLoad(capacity)),
+          _ctrl(capacity ? new int8_t[capacity] : nullptr),
+          _hashes(capacity ? new HashType[capacity] : nullptr),
+          _slots(capacity ? new Slot[capacity] : nullptr) {
+        // Capacity must be zero or a power of two that is at least one full group.
+        dassert((capacity & (capacity - 1)) == 0);
+        dassert(capacity == 0 || capacity >= kGroupWidth);
+        if (capacity)
+            std::memset(_ctrl.get(), kEmpty, capacity);
+    }
+
+    ControlByteArea(const ControlByteArea& other) : ControlByteArea(other.capacity(), 0) {
+        if (!capacity())
+            return;
+        _growthLeft = other._growthLeft;
+        std::copy(other._ctrl.get(), other._ctrl.get() + capacity(), _ctrl.get());
+        std::copy(other._hashes.get(), other._hashes.get() + capacity(), _hashes.get());
+        for (unsigned pos = 0; pos < capacity(); pos++) {
+            if (other.isUsed(pos))
+                new (&_slots[pos]) ValueType(other.getData(pos));
+        }
+    }
+
+    ControlByteArea& operator=(const ControlByteArea& other) {
+        ControlByteArea(other).swap(this);
+        return *this;
+    }
+
+    ~ControlByteArea() {
+        for (unsigned pos = 0; pos < capacity(); pos++) {
+            if (isUsed(pos))
+                getData(pos).~ValueType();
+        }
+    }
+
+    int find(const HashedKey& key, int* firstEmpty) const;
+
+    bool transfer(ControlByteArea* newArea);
+
+    void swap(ControlByteArea* other) {
+        using std::swap;
+        swap(_hashMask, other->_hashMask);
+        swap(_growthLeft, other->_growthLeft);
+        swap(_ctrl, other->_ctrl);
+        swap(_hashes, other->_hashes);
+        swap(_slots, other->_slots);
+    }
+
+    unsigned capacity() const {
+        return _hashMask + 1;
+    }
+
+    bool isUsed(unsigned pos) const {
+        return _ctrl[pos] >= 0;
+    }
+
+    template <typename... Args>
+    void emplaceData(unsigned pos, const HashedKey& key, Args&&... args) {
+        dassert(!isUsed(pos));
+        if (_ctrl[pos] == kEmpty) {
+            dassert(_growthLeft > 0);
+            --_growthLeft;
+        }
+        _ctrl[pos] = tagOf(key.hash());
+        _hashes[pos] = key.hash();
+        new (&_slots[pos]) ValueType(std::piecewise_construct,
+                                     std::forward_as_tuple(Traits::toStorage(key.key())),
+                                     std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    void unUse(unsigned pos) {
+        dassert(isUsed(pos));
+        getData(pos).~ValueType();
+
+        // If this slot's group still has an empty slot, the group has never been full, so no probe
+        // sequence has ever continued past it and the slot can go straight back to empty.
+        const unsigned base = pos & ~(kGroupWidth - 1);
+        if (ControlByteGroup(&_ctrl[base]).matchEmpty()) {
+            _ctrl[pos] = kEmpty;
+            ++_growthLeft;
+        } else {
+            _ctrl[pos] = kDeleted;
+        }
+    }
+
+    ValueType& getData(unsigned pos) {
+        dassert(isUsed(pos));
+        return *reinterpret_cast<ValueType*>(&_slots[pos]);
+    }
+
+    const ValueType& getData(unsigned pos) const {
+        dassert(isUsed(pos));
+        return *reinterpret_cast<const ValueType*>(&_slots[pos]);
+    }
+
+private:
+    using HashType = HashTypeOf<HashedKey>;
+    using Slot = typename std::aligned_storage<sizeof(ValueType), alignof(ValueType)>::type;
+
+    // Keep at most 7/8 of the slots full (or deleted) so that probe sequences stay short.
+    static unsigned maxLoad(unsigned capacity) {
+        return capacity - capacity / 8;
+    }
+
+    static int8_t tagOf(HashType hash) {
+        return static_cast<int8_t>(hash & 0x7F);
+    }
+
+    // The high bits of the hash pick the first group so they are independent of the tag.
+    unsigned firstGroup(HashType hash) const {
+        return (hash >> 7) & (_hashMask / kGroupWidth);
+    }
+
+    unsigned numGroups() const {
+        return capacity() / kGroupWidth;
+    }
+
+    // Since the number of groups is a power of two, stepping by 1, 2, 3, ... groups visits every
+    // group exactly once before repeating.
+    unsigned nextGroup(unsigned group, unsigned probe) const {
+        return (group + probe) & (numGroups() - 1);
+    }
+
+    // Capacity is always a power of two. See UnorderedFastKeyTable::EntryArea for why the mask is
+    // stored rather than the capacity.
+    unsigned _hashMask = -1;
+
+    // Number of empty slots that can be filled before the table must grow. Reusing a deleted slot
+    // doesn't count against this.
+    unsigned _growthLeft = 0;
+
+    std::unique_ptr<int8_t[]> _ctrl = {};
+    std::unique_ptr<HashType[]> _hashes = {};
+    std::unique_ptr<Slot[]> _slots = {};
+};
+
+template <typename Traits, typename HashedKey, typename ValueType>
+inline int ControlByteArea<Traits, HashedKey, ValueType>::find(const HashedKey& key,
+                                                               int* firstEmpty) const {
+    dassert(capacity());                        // Caller must special-case empty tables.
+    dassert(!firstEmpty || *firstEmpty == -1);  // Caller must initialize *firstEmpty.
+
+    const int8_t tag = tagOf(key.hash());
+    unsigned group = firstGroup(key.hash());
+    for (unsigned probe = 0; probe < numGroups(); group = nextGroup(group, ++probe)) {
+        const unsigned base = group * kGroupWidth;
+        const ControlByteGroup ctrl(&_ctrl[base]);
+
+        for (uint32_t matches = ctrl.match(tag); matches; matches &= matches - 1) {
+            const unsigned pos = base + countTrailingZeros64(matches);
+            if (Traits::equals(key.key(), Traits::toLookup(getData(pos).first)))
+                return pos;
+        }
+
+        if (firstEmpty && *firstEmpty == -1) {
+            // Prefer reusing a tombstone. Claiming a truly empty slot is only allowed while we are
+            // under the maximum load, otherwise the caller is told there is no room so it grows.
+            if (const uint32_t deleted = ctrl.match(kDeleted)) {
+                *firstEmpty = base + countTrailingZeros64(deleted);
+            } else if (const uint32_t empty = ctrl.matchEmpty()) {
+                if (_growthLeft > 0)
+                    *firstEmpty = base + countTrailingZeros64(empty);
+            }
+        }
+
+        if (ctrl.matchEmpty())
+            return -1;
+    }
+    return -1;
+}
+
+template <typename Traits, typename HashedKey, typename ValueType>
+inline bool ControlByteArea<Traits, HashedKey, ValueType>::transfer(ControlByteArea* newArea) {
+    // Entries are moved out as they are transferred, so decide whether they all fit up front
+    // rather than failing part way through. This counts tombstones too, which only errs towards
+    // growing more.
+    if (maxLoad(capacity()) - _growthLeft > newArea->_growthLeft)
+        return false;
+
+    for (unsigned oldPos = 0; oldPos < capacity(); oldPos++) {
+        if (!isUsed(oldPos))
+            continue;
+
+        // Every key is distinct and newArea has no tombstones, so the first empty slot along the
+        // probe sequence is where the entry belongs.
+        const HashType hash = _hashes[oldPos];
+        unsigned group = newArea->firstGroup(hash);
+        int newPos = -1;
+        for (unsigned probe = 0; probe < newArea->numGroups();
+             group = newArea->nextGroup(group, ++probe)) {
+            const unsigned base = group * kGroupWidth;
+            if (const uint32_t empty = ControlByteGroup(&newArea->_ctrl[base]).matchEmpty()) {
+                newPos = base + countTrailingZeros64(empty);
+                break;
+            }
+        }
+
+        invariant(newPos >= 0);
+        --newArea->_growthLeft;
+        newArea->_ctrl[newPos] = tagOf(hash);
+        newArea->_hashes[newPos] = hash;
+        new (&newArea->_slots[newPos]) ValueType(std::move(getData(oldPos)));
+    }
+    return true;
+}
+
+}  // namespace unordered_fast_key_table_detail
+}  // namespace mongo
+
+#undef MONGO_UNORDERED_FAST_KEY_TABLE_USE_SSE2
@@ -23,8 +23,8 @@
 namespace mongo {
 
 template <typename K_L, typename K_S, typename V, typename Traits>
-inline int UnorderedFastKeyTable<K_L, K_S, V, Traits>::Area::find(const HashedKey& key,
-                                                                  int* firstEmpty) const {
+inline int UnorderedFastKeyTable<K_L, K_S, V, Traits>::EntryArea::find(const HashedKey& key,
+                                                                       int* firstEmpty) const {
     dassert(capacity());                        // Caller must special-case empty tables.
     dassert(!firstEmpty || *firstEmpty == -1);  // Caller must initialize *firstEmpty.
 
@@ -60,7 +60,8 @@ inline int UnorderedFastKeyTable<K_L, K_S, V, Traits>::Area::find(const HashedKe
 }
 
 template <typename K_L, typename K_S, typename V, typename Traits>
-inline bool UnorderedFastKeyTable<K_L, K_S, V, Traits>::Area::transfer(Area* newArea) const {
+inline bool UnorderedFastKeyTable<K_L, K_S, V, Traits>::EntryArea::transfer(
+    EntryArea* newArea) const {
     for (auto&& entry : *this) {
         if (!entry.isUsed())
             continue;
@@ -109,7 +110,7 @@ inline size_t UnorderedFastKeyTable<K_L, K_S, V, Traits>::erase(const HashedKey&
         return 0;
 
     --_size;
-    _area._entries[pos].unUse();
+    _area.unUse(pos);
     return 1;
 }
 
@@ -119,7 +120,7 @@ void UnorderedFastKeyTable<K_L, K_S, V, Traits>::erase(const_iterator it) {
     dassert(it._area == &_area);
 
     --_size;
-    _area._entries[it._position].unUse();
+    _area.unUse(it._position);
 }
 
 template <typename K_L, typename K_S, typename V, typename Traits>
@@ -127,7 +128,7 @@ template <typename... Args>
 inline auto UnorderedFastKeyTable<K_L, K_S, V, Traits>::try_emplace(const HashedKey& key,
                                                                     Args&&... args)
     -> std::pair<iterator, bool> {
-    if (!_area._entries) {
+    if (_area.capacity() == 0) {
         // This is the first insert ever. Need to allocate initial space.
         dassert(_area.capacity() == 0);
         _grow();
@@ -147,7 +148,7 @@ inline auto UnorderedFastKeyTable<K_L, K_S, V, Traits>::try_emplace(const Hashed
         // need to add
         if (firstEmpty >= 0) {
             _size++;
-            _area._entries[firstEmpty].emplaceData(key, std::forward<Args>(args)...);
+            _area.emplaceData(firstEmpty, key, std::forward<Args>(args)...);
             return {iterator(&_area, firstEmpty), true};
         }
 
@@ -0,0 +1,132 @@
+/*    Copyright 2018 MongoDB Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+#include "mongo/platform/compiler.h"
+
+namespace mongo {
+namespace wyhash_detail {
+
+const uint64_t kSecret[4] = {
+    0xa0761d6478bd642full, 0xe7037ed1a0b428dbull, 0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull};
+
+/**
+ * Replaces *a and *b with the low and high halves of their 128-bit product.
+ */
+inline void multiply128(uint64_t* a, uint64_t* b) {
+#if defined(__SIZEOF_INT128__)
+    const unsigned __int128 r = static_cast<unsigned __int128>(*a) * *b;
+    *a = static_cast<uint64_t>(r);
+    *b = static_cast<uint64_t>(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    *a = _umul128(*a, *b, b);
+#else
+    const uint64_t ha = *a >> 32, hb = *b >> 32, la = uint32_t(*a), lb = uint32_t(*b);
+    const uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    const uint64_t t = rl + (rm0 << 32);
+    uint64_t carry = t < rl;
+    const uint64_t lo = t + (rm1 << 32);
+    carry += lo < t;
+    const uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+    *a = lo;
+    *b = hi;
+#endif
+}
+
+inline uint64_t mix(uint64_t a, uint64_t b) {
+    multiply128(&a, &b);
+    return a ^ b;
+}
+
+inline uint64_t read8(const uint8_t* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t read4(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t read3(const uint8_t* p, size_t k) {
+    return (uint64_t(p[0]) << 16) | (uint64_t(p[k >> 1]) << 8) | p[k - 1];
+}
+
+}  // namespace wyhash_detail
+
+/**
+ * A fast, high quality 64-bit non-cryptographic hash built the same way as the public domain wyhash
+ * algorithm. Short inputs, like field names, take a couple of multiplies and no loops.
+ *
+ * The result depends on the byte order of the machine, so it must never be persisted or sent over
+ * the wire.
+ */
+inline uint64_t wyhash(const void* data, size_t length, uint64_t seed = 0) {
+    using namespace wyhash_detail;
+
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    seed ^= mix(seed ^ kSecret[0], kSecret[1]);
+
+    uint64_t a, b;
+    if (MONGO_likely(length <= 16)) {
+        if (MONGO_likely(length >= 4)) {
+            a = (read4(p) << 32) | read4(p + ((length >> 3) << 2));
+            b = (read4(p + length - 4) << 32) | read4(p + length - 4 - ((length >> 3) << 2));
+        } else if (MONGO_likely(length > 0)) {
+            a = read3(p, length);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = length;
+        if (MONGO_unlikely(i > 48)) {
+            uint64_t seed1 = seed, seed2 = seed;
+            do {
+                seed = mix(read8(p) ^ kSecret[1], read8(p + 8) ^ seed);
+                seed1 = mix(read8(p + 16) ^ kSecret[2], read8(p + 24) ^ seed1);
+                seed2 = mix(read8(p + 32) ^ kSecret[3], read8(p + 40) ^ seed2);
+                p += 48;
+                i -= 48;
+            } while (MONGO_likely(i > 48));
+            seed ^= seed1 ^ seed2;
+        }
+        while (MONGO_unlikely(i > 16)) {
+            seed = mix(read8(p) ^ kSecret[1], read8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = read8(p + i - 16);
+        b = read8(p + i - 8);
+    }
+
+    a ^= kSecret[1];
+    b ^= seed;
+    multiply128(&a, &b);
+    return mix(a ^ kSecret[0] ^ length, b ^ kSecret[1]);
+}
+
+}  // namespace mongo